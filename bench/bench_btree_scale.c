@@ -0,0 +1,140 @@
+#include "../include/coredb.h"
+#include <time.h>
+
+#define DEFAULT_KEYS 10000000
+#define BUILD_FRAMES 32768   // pool used while inserting (128 MB)
+#define LOOKUP_FRAMES 64     // small pool for the cold lookups, so reads reach the file
+#define LOOKUPS 100000
+#define BENCH_FILE "bench_scale.db"
+
+// Seconds on the monotonic clock
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Greatest common divisor, to pick a stride that permutes 1..n
+static long gcd(long a, long b)
+{
+    while (b != 0)
+    {
+        long t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// The i-th key of the insert order: 1..n in sequence, or a fixed permutation of it
+static int key_at(long i, long n, long stride)
+{
+    return (int)((i * stride) % n) + 1;
+}
+
+// Levels from the root down to the leftmost leaf
+static int tree_height(Database *db)
+{
+    int height = 1;
+    BTreeNode node;
+    read_node(db, db->root_offset, &node);
+    while (!node.is_leaf)
+    {
+        read_node(db, PAGE_OFFSET(node.data.internal.children[0]), &node);
+        height++;
+    }
+    return height;
+}
+
+// Open the benchmark file with a pool of the given size
+static Database open_bench(int frames)
+{
+    DbOptions options;
+    memset(&options, 0, sizeof(DbOptions));
+    options.no_sync = 1;
+    options.pool_frames = frames;
+    return init_db_with_options(BENCH_FILE, &options);
+}
+
+// Insert keys in one order up to max_keys, measuring lookups at every power of ten
+static void run_order(const char *name, long max_keys, long stride)
+{
+    char wal_path[256];
+    snprintf(wal_path, sizeof(wal_path), "%s.wal", BENCH_FILE);
+    remove(BENCH_FILE);
+    remove(wal_path);
+    remove(BENCH_FILE ".crc");
+    remove(BENCH_FILE ".dwb");
+
+    printf("\n%s inserts\n", name);
+    printf("  %10s  %6s  %12s  %12s  %12s\n", "keys", "height", "insert us", "pages/lookup",
+           "reads/lookup");
+    Database db = open_bench(BUILD_FRAMES);
+    long inserted = 0;
+    for (long target = 1000; target <= max_keys; target *= 10)
+    {
+        long stage_keys = target - inserted;
+        double start = now();
+        for (; inserted < target; inserted++)
+        {
+            int id = key_at(inserted, max_keys, stride);
+            btree_insert(&db, id, (off_t)id * PAGE_SIZE);
+            if (inserted % 1024 == 0)
+            {
+                checkpoint_if_needed(&db);
+            }
+        }
+        double insert_us = (now() - start) * 1e6 / stage_keys;
+        int height = tree_height(&db);
+        close_db(&db);
+
+        // Cold lookups of inserted keys through a small pool
+        db = open_bench(LOOKUP_FRAMES);
+        srand(7);
+        buffer_pool_reset_stats(db.pool);
+        for (int l = 0; l < LOOKUPS; l++)
+        {
+            off_t address;
+            int id = key_at(((long)rand() * RAND_MAX + rand()) % inserted, max_keys, stride);
+            btree_search(&db, id, &address);
+            if (address != (off_t)id * PAGE_SIZE)
+            {
+                printf("Error: Key %d not found\n", id);
+                exit(1);
+            }
+        }
+        BufferPoolStats stats;
+        buffer_pool_get_stats(db.pool, &stats);
+        close_db(&db);
+        printf("  %10ld  %6d  %12.2f  %12.2f  %12.2f\n", target, height, insert_us,
+               (double)(stats.hits + stats.misses) / LOOKUPS, (double)stats.misses / LOOKUPS);
+        db = open_bench(BUILD_FRAMES);
+    }
+    close_db(&db);
+    remove(BENCH_FILE);
+    remove(wal_path);
+    remove(BENCH_FILE ".crc");
+    remove(BENCH_FILE ".dwb");
+}
+
+int main(int argc, char **argv)
+{
+    long max_keys = argc > 1 ? atol(argv[1]) : DEFAULT_KEYS;
+    if (max_keys < 1000)
+    {
+        printf("Error: Use at least 1000 keys\n");
+        return 1;
+    }
+    long stride = 1000003;
+    while (gcd(stride, max_keys) != 1)
+    {
+        stride++;
+    }
+
+    printf("B-tree scaling up to %ld keys (%d keys per leaf, %d per internal node, %d-frame pool for lookups)\n",
+           max_keys, LEAF_MAX_KEYS, INTERNAL_MAX_KEYS, LOOKUP_FRAMES);
+    run_order("Sequential", max_keys, 1);
+    run_order("Random", max_keys, stride);
+    return 0;
+}
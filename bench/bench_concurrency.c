@@ -0,0 +1,147 @@
+#include "../include/coredb.h"
+#include <time.h>
+
+#define DEFAULT_ROWS 1000000
+#define POOL_FRAMES 32768    // holds the whole table (128 MB), so threads contend on pages, not I/O
+#define LOOKUPS 2000000      // point lookups per run, split between the reader threads
+#define MAX_THREADS 32
+#define BENCH_FILE "bench_concurrency.db"
+
+// One run: readers share the lookups while an optional writer renames rows until they finish
+typedef struct {
+    Database *db;
+    long rows;
+    long lookups;           // per reader
+    int readers_left;       // the writer stops once this drops to 0
+    long writes;
+} Run;
+
+// Seconds on the monotonic clock
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Look up random rows
+static void *reader(void *arg)
+{
+    Run *run = arg;
+    unsigned int seed = (unsigned int)(size_t)&seed;
+    for (long l = 0; l < run->lookups; l++)
+    {
+        struct Row row;
+        int id = (int)(((long)rand_r(&seed) * RAND_MAX + rand_r(&seed)) % run->rows) + 1;
+        if (!select_by_id(run->db, id, &row))
+        {
+            printf("Error: Row %d not found\n", id);
+            exit(1);
+        }
+    }
+    __atomic_sub_fetch(&run->readers_left, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+// Rename random rows (each update commits on its own) until the readers are done
+static void *writer(void *arg)
+{
+    Run *run = arg;
+    unsigned int seed = 11;
+    while (__atomic_load_n(&run->readers_left, __ATOMIC_ACQUIRE) > 0)
+    {
+        char name[60];
+        int id = (int)(((long)rand_r(&seed) * RAND_MAX + rand_r(&seed)) % run->rows) + 1;
+        snprintf(name, sizeof(name), "Renamed%d", id);
+        update_row(run->db, id, name);
+        run->writes++;
+    }
+    return NULL;
+}
+
+// Run the lookups on a number of reader threads, with or without a writer next to them;
+// returns the lookups per second
+static double run_threads(Database *db, long rows, int threads, int with_writer, double *writes_per_sec)
+{
+    Run run;
+    memset(&run, 0, sizeof(Run));
+    run.db = db;
+    run.rows = rows;
+    run.lookups = LOOKUPS / threads;
+    run.readers_left = threads;
+    pthread_t readers[MAX_THREADS];
+    pthread_t writer_thread;
+
+    double start = now();
+    for (int t = 0; t < threads; t++)
+    {
+        pthread_create(&readers[t], NULL, reader, &run);
+    }
+    if (with_writer)
+    {
+        pthread_create(&writer_thread, NULL, writer, &run);
+    }
+    for (int t = 0; t < threads; t++)
+    {
+        pthread_join(readers[t], NULL);
+    }
+    double seconds = now() - start;
+    if (with_writer)
+    {
+        pthread_join(writer_thread, NULL);
+    }
+    *writes_per_sec = run.writes / seconds;
+    return run.lookups * threads / seconds;
+}
+
+int main(int argc, char **argv)
+{
+    long rows = argc > 1 ? atol(argv[1]) : DEFAULT_ROWS;
+    if (rows < 1000 || rows > INT32_MAX)
+    {
+        printf("Error: Use between 1000 and %d rows\n", INT32_MAX);
+        return 1;
+    }
+    char wal_path[256];
+    snprintf(wal_path, sizeof(wal_path), "%s.wal", BENCH_FILE);
+    remove(BENCH_FILE);
+    remove(wal_path);
+    remove(BENCH_FILE ".crc");
+    remove(BENCH_FILE ".dwb");
+
+    DbOptions options;
+    memset(&options, 0, sizeof(DbOptions));
+    options.no_sync = 1;
+    options.pool_frames = POOL_FRAMES;
+    Database db = init_db_with_options(BENCH_FILE, &options);
+    struct Row *batch = malloc(10000 * sizeof(struct Row));
+    for (long first = 1; first <= rows; first += 10000)
+    {
+        int count = rows - first + 1 < 10000 ? (int)(rows - first + 1) : 10000;
+        for (int i = 0; i < count; i++)
+        {
+            batch[i].id = (int)(first + i);
+            snprintf(batch[i].name, sizeof(batch[i].name), "Row%ld", first + i);
+        }
+        insert_rows(&db, batch, count);
+    }
+    free(batch);
+    checkpoint(&db);
+
+    printf("Point lookups over %ld rows from 1 to %d reader threads (%d lookups per run)\n", rows,
+           MAX_THREADS, LOOKUPS);
+    printf("  %7s  %14s  %14s  %14s\n", "threads", "lookups/s", "with writer", "writes/s");
+    for (int threads = 1; threads <= MAX_THREADS; threads *= 2)
+    {
+        double writes;
+        double alone = run_threads(&db, rows, threads, 0, &writes);
+        double mixed = run_threads(&db, rows, threads, 1, &writes);
+        printf("  %7d  %14.0f  %14.0f  %14.0f\n", threads, alone, mixed, writes);
+    }
+    close_db(&db);
+    remove(BENCH_FILE);
+    remove(wal_path);
+    remove(BENCH_FILE ".crc");
+    remove(BENCH_FILE ".dwb");
+    return 0;
+}
@@ -0,0 +1,135 @@
+#include "../include/coredb.h"
+#include <time.h>
+
+#define DEFAULT_KEYS 1000000
+#define BUILD_FRAMES 32768   // pool used while inserting and for cached lookups (128 MB)
+#define LOOKUP_FRAMES 64     // small pool for the cold lookups, so reads reach the file
+#define LOOKUPS 1000000
+#define BENCH_FILE "bench_hash.db"
+
+// Seconds on the monotonic clock
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Greatest common divisor, to pick a stride that permutes 1..n
+static long gcd(long a, long b)
+{
+    while (b != 0)
+    {
+        long t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+// The i-th key of a fixed permutation of 1..n
+static int key_at(long i, long n, long stride)
+{
+    return (int)((i * stride) % n) + 1;
+}
+
+// Open the benchmark file with a pool of the given size (hashed applies to a new file)
+static Database open_bench(int frames, int hashed)
+{
+    DbOptions options;
+    memset(&options, 0, sizeof(DbOptions));
+    options.no_sync = 1;
+    options.pool_frames = frames;
+    options.hashed = hashed;
+    return init_db_with_options(BENCH_FILE, &options);
+}
+
+// Look up random inserted keys, returning the nanoseconds per lookup and the pool
+// counters they produced
+static double run_lookups(Database *db, long keys, long stride, BufferPoolStats *stats)
+{
+    srand(7);
+    buffer_pool_reset_stats(db->pool);
+    double start = now();
+    for (int l = 0; l < LOOKUPS; l++)
+    {
+        off_t address;
+        int id = key_at(((long)rand() * RAND_MAX + rand()) % keys, keys, stride);
+        btree_search(db, id, &address);
+        if (address != (off_t)id * PAGE_SIZE)
+        {
+            printf("Error: Key %d not found\n", id);
+            exit(1);
+        }
+    }
+    double ns = (now() - start) * 1e9 / LOOKUPS;
+    buffer_pool_get_stats(db->pool, stats);
+    return ns;
+}
+
+// Insert keys in random order into one kind of index, then time lookups from a pool that
+// holds the whole index and count page reads through a small one
+static void run_index(const char *name, int hashed, long keys, long stride)
+{
+    char wal_path[256];
+    snprintf(wal_path, sizeof(wal_path), "%s.wal", BENCH_FILE);
+    remove(BENCH_FILE);
+    remove(wal_path);
+    remove(BENCH_FILE ".crc");
+    remove(BENCH_FILE ".dwb");
+
+    Database db = open_bench(BUILD_FRAMES, hashed);
+    double start = now();
+    for (long i = 0; i < keys; i++)
+    {
+        int id = key_at(i, keys, stride);
+        btree_insert(&db, id, (off_t)id * PAGE_SIZE);
+        if (i % 1024 == 0)
+        {
+            checkpoint_if_needed(&db);
+        }
+    }
+    double insert_us = (now() - start) * 1e6 / keys;
+    checkpoint(&db);
+    off_t pages = db.header.page_count;
+
+    // Every page is cached after one warm-up pass
+    BufferPoolStats stats;
+    run_lookups(&db, keys, stride, &stats);
+    double hot_ns = run_lookups(&db, keys, stride, &stats);
+    double hot_pages = (double)(stats.hits + stats.misses) / LOOKUPS;
+    close_db(&db);
+
+    db = open_bench(LOOKUP_FRAMES, hashed);
+    double cold_ns = run_lookups(&db, keys, stride, &stats);
+    close_db(&db);
+    printf("  %-8s  %8lld  %9.2f  %9.1f  %12.2f  %9.1f  %12.2f\n", name, (long long)pages,
+           insert_us, hot_ns, hot_pages, cold_ns, (double)stats.misses / LOOKUPS);
+    remove(BENCH_FILE);
+    remove(wal_path);
+    remove(BENCH_FILE ".crc");
+    remove(BENCH_FILE ".dwb");
+}
+
+int main(int argc, char **argv)
+{
+    long keys = argc > 1 ? atol(argv[1]) : DEFAULT_KEYS;
+    if (keys < 1000)
+    {
+        printf("Error: Use at least 1000 keys\n");
+        return 1;
+    }
+    long stride = 1000003;
+    while (gcd(stride, keys) != 1)
+    {
+        stride++;
+    }
+
+    printf("Point lookups over %ld keys inserted in random order (%d lookups; cold: %d-frame pool)\n",
+           keys, LOOKUPS, LOOKUP_FRAMES);
+    printf("  %-8s  %8s  %9s  %9s  %12s  %9s  %12s\n", "index", "pages", "insert us", "cached ns",
+           "pages/lookup", "cold ns", "reads/lookup");
+    run_index("B+tree", 0, keys, stride);
+    run_index("hash", 1, keys, stride);
+    return 0;
+}
@@ -0,0 +1,75 @@
+#include "../include/coredb.h"
+#include <time.h>
+
+#define NODES 1024
+#define SEARCHES 4000000
+
+// Seconds on the monotonic clock
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Fill a node with INTERNAL_MAX_KEYS strictly increasing random keys
+static void fill_keys(int *keys)
+{
+    int key = rand() % 16;
+    for (int i = 0; i < INTERNAL_MAX_KEYS; i++)
+    {
+        key += 1 + rand() % 16;
+        keys[i] = key;
+    }
+}
+
+// Time one child search implementation over random probes into full nodes
+static double time_search(const char *name, int (*search)(const int *, int, int),
+                          int (*keys)[INTERNAL_MAX_KEYS], const int *probes, double baseline)
+{
+    long checksum = 0;
+    double start = now();
+    for (int i = 0; i < SEARCHES; i++)
+    {
+        checksum += search(keys[i % NODES], INTERNAL_MAX_KEYS, probes[i]);
+    }
+    double ns = (now() - start) * 1e9 / SEARCHES;
+    printf("  %-8s %7.1f ns/search", name, ns);
+    if (baseline > 0)
+    {
+        printf("  %5.1fx faster than linear", baseline / ns);
+    }
+    printf("  (checksum %ld)\n", checksum);
+    return ns;
+}
+
+int main(void)
+{
+    static int keys[NODES][INTERNAL_MAX_KEYS];
+    int *probes = malloc(SEARCHES * sizeof(int));
+    if (probes == NULL)
+    {
+        printf("Error: Could not allocate probes\n");
+        return 1;
+    }
+
+    srand(42);
+    for (int n = 0; n < NODES; n++)
+    {
+        fill_keys(keys[n]);
+    }
+    for (int i = 0; i < SEARCHES; i++)
+    {
+        const int *node = keys[i % NODES];
+        probes[i] = rand() % (node[INTERNAL_MAX_KEYS - 1] + 16);
+    }
+
+    printf("Child search in full internal nodes (%d keys, %d nodes, %d searches)\n",
+           INTERNAL_MAX_KEYS, NODES, SEARCHES);
+    double linear = time_search("linear", child_index_linear, keys, probes, 0);
+    time_search("binary", child_index_binary, keys, probes, linear);
+    time_search(node_search_simd_name(), child_index_simd, keys, probes, linear);
+
+    free(probes);
+    return 0;
+}
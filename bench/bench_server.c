@@ -0,0 +1,292 @@
+#include "../include/coredb.h"
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+#define DEFAULT_REQUESTS 200000
+#define ROWS 100000             // rows loaded before the runs; requests pick ids among them
+#define MAX_CLIENTS 32
+#define MAX_DEPTH 16
+#define BENCH_FILE "bench_server.db"
+
+// One connection of the load generator, keeping depth requests in flight
+typedef struct {
+    int fd;
+    int write_percent;          // UPDATE share of the requests, the rest are GETs
+    double sent[MAX_DEPTH];     // send times of the requests in flight, oldest at head
+    int head;
+    int in_flight;
+    char buffer[4096];          // reply bytes not yet split into lines
+    size_t len;
+} LoadClient;
+
+// Seconds on the monotonic clock
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Compare latencies for qsort
+static int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Run the event loop of the in-process server until server_stop
+static void *serve_thread(void *arg)
+{
+    server_run(arg);
+    return NULL;
+}
+
+// Connect to the server on the loopback interface (exits on failure)
+static int connect_loopback(int port)
+{
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd == -1 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        printf("Error: Could not connect to port %d\n", port);
+        exit(1);
+    }
+    int nodelay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    return fd;
+}
+
+// Send count requests on a connection: random UPDATEs at the client's write share, GETs otherwise
+static void send_requests(LoadClient *client, int count, unsigned int *seed)
+{
+    char requests[MAX_DEPTH * 40];
+    size_t len = 0;
+    double sent = now();
+    for (int r = 0; r < count; r++)
+    {
+        int id = (int)(rand_r(seed) % ROWS) + 1;
+        if ((int)(rand_r(seed) % 100) < client->write_percent)
+        {
+            len += sprintf(requests + len, "UPDATE %d load%d\n", id, rand_r(seed) % 1000);
+        }
+        else
+        {
+            len += sprintf(requests + len, "GET %d\n", id);
+        }
+        client->sent[(client->head + client->in_flight) % MAX_DEPTH] = sent;
+        client->in_flight++;
+    }
+    // Requests in flight are bounded, so the server's receive buffer always has room
+    if (write(client->fd, requests, len) != (ssize_t)len)
+    {
+        printf("Error: Could not send requests\n");
+        exit(1);
+    }
+}
+
+// Load the rows with pipelined INSERTs (rows already there are refused and kept)
+static void load_rows(int port)
+{
+    int fd = connect_loopback(port);
+    char requests[100 * 32];
+    char replies[65536];
+    for (int first = 1; first <= ROWS; first += 100)
+    {
+        size_t len = 0;
+        for (int id = first; id < first + 100; id++)
+        {
+            len += sprintf(requests + len, "INSERT %d row%d\n", id, id);
+        }
+        if (write(fd, requests, len) != (ssize_t)len)
+        {
+            printf("Error: Could not send requests\n");
+            exit(1);
+        }
+        for (int lines = 0; lines < 100;)
+        {
+            ssize_t n = read(fd, replies, sizeof(replies));
+            if (n <= 0)
+            {
+                printf("Error: The server hung up during the load\n");
+                exit(1);
+            }
+            for (ssize_t i = 0; i < n; i++)
+            {
+                lines += replies[i] == '\n';
+            }
+        }
+    }
+    close(fd);
+}
+
+// Run requests over clients connections with depth requests in flight on each, storing
+// the latency of every request (returns the requests per second)
+static double run_load(int port, int clients, int depth, int write_percent, long requests, double *latencies)
+{
+    LoadClient *conns = calloc(clients, sizeof(LoadClient));
+    int epoll_fd = epoll_create1(0);
+    unsigned int seed = 42;
+    long issued = 0;
+    long done = 0;
+    for (int c = 0; c < clients; c++)
+    {
+        conns[c].fd = connect_loopback(port);
+        conns[c].write_percent = write_percent;
+        struct epoll_event event;
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.u32 = (uint32_t)c;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, conns[c].fd, &event);
+    }
+
+    double start = now();
+    for (int c = 0; c < clients && issued < requests; c++)
+    {
+        int count = requests - issued < depth ? (int)(requests - issued) : depth;
+        send_requests(&conns[c], count, &seed);
+        issued += count;
+    }
+    struct epoll_event events[MAX_CLIENTS];
+    while (done < requests)
+    {
+        int ready = epoll_wait(epoll_fd, events, MAX_CLIENTS, -1);
+        for (int e = 0; e < ready; e++)
+        {
+            LoadClient *client = &conns[events[e].data.u32];
+            ssize_t n = read(client->fd, client->buffer + client->len, sizeof(client->buffer) - client->len);
+            if (n <= 0)
+            {
+                printf("Error: The server hung up\n");
+                exit(1);
+            }
+            client->len += n;
+            double received = now();
+            int replies = 0;
+            size_t start_of_line = 0;
+            for (size_t i = 0; i < client->len; i++)
+            {
+                if (client->buffer[i] != '\n')
+                {
+                    continue;
+                }
+                latencies[done++] = received - client->sent[client->head];
+                client->head = (client->head + 1) % MAX_DEPTH;
+                client->in_flight--;
+                replies++;
+                start_of_line = i + 1;
+            }
+            memmove(client->buffer, client->buffer + start_of_line, client->len - start_of_line);
+            client->len -= start_of_line;
+            // Refill the pipeline with as many requests as were answered
+            int count = requests - issued < replies ? (int)(requests - issued) : replies;
+            if (count > 0)
+            {
+                send_requests(client, count, &seed);
+                issued += count;
+            }
+        }
+    }
+    double seconds = now() - start;
+
+    for (int c = 0; c < clients; c++)
+    {
+        close(conns[c].fd);
+    }
+    close(epoll_fd);
+    free(conns);
+    return requests / seconds;
+}
+
+int main(int argc, char **argv)
+{
+    long requests = argc > 1 ? atol(argv[1]) : DEFAULT_REQUESTS;
+    int port = argc > 2 ? atoi(argv[2]) : 0;
+    if (requests < 1000)
+    {
+        printf("Error: Use at least 1000 requests\n");
+        return 1;
+    }
+
+    // Without a port, serve a fresh database from a thread of this process
+    Database db;
+    Server *server = NULL;
+    pthread_t thread;
+    char wal_path[256];
+    snprintf(wal_path, sizeof(wal_path), "%s.wal", BENCH_FILE);
+    if (port == 0)
+    {
+        remove(BENCH_FILE);
+        remove(wal_path);
+        remove(BENCH_FILE ".crc");
+        remove(BENCH_FILE ".dwb");
+        DbOptions options;
+        memset(&options, 0, sizeof(DbOptions));
+        options.no_sync = 1;
+        options.pool_frames = 4096;
+        db = init_db_with_options(BENCH_FILE, &options);
+        ServerOptions server_options = {NULL, 0, NULL};
+        server = server_open(&db, &server_options);
+        if (server == NULL)
+        {
+            return 1;
+        }
+        port = server->port;
+        pthread_create(&thread, NULL, serve_thread, server);
+    }
+    load_rows(port);
+
+    double *latencies = malloc(requests * sizeof(double));
+    printf("Loopback load on port %d: %ld requests per run over %d rows\n", port, requests, ROWS);
+    printf("  %7s  %7s  %5s  %10s  %8s  %8s  %8s  %13s\n", "writes", "clients", "depth", "ops/s", "p50 us",
+           "p99 us", "p999 us", "writes/commit");
+    int write_percents[] = {10, 100};
+    int client_counts[] = {1, 8, 32};
+    int depths[] = {1, 16};
+    for (int w = 0; w < 2; w++)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            for (int d = 0; d < 2; d++)
+            {
+                unsigned long writes = server != NULL ? server->writes : 0;
+                unsigned long commits = server != NULL ? server->commits : 0;
+                double ops = run_load(port, client_counts[c], depths[d], write_percents[w], requests, latencies);
+                qsort(latencies, requests, sizeof(double), compare_doubles);
+                printf("  %6d%%  %7d  %5d  %10.0f  %8.1f  %8.1f  %8.1f", write_percents[w], client_counts[c],
+                       depths[d], ops, latencies[requests / 2] * 1e6, latencies[requests * 99 / 100] * 1e6,
+                       latencies[requests * 999 / 1000] * 1e6);
+                if (server != NULL && server->commits > commits)
+                {
+                    printf("  %13.1f\n", (double)(server->writes - writes) / (server->commits - commits));
+                }
+                else
+                {
+                    printf("  %13s\n", "-");
+                }
+            }
+        }
+    }
+    free(latencies);
+
+    if (server != NULL)
+    {
+        server_stop(server);
+        pthread_join(thread, NULL);
+        server_close(server);
+        close_db(&db);
+        remove(BENCH_FILE);
+        remove(wal_path);
+        remove(BENCH_FILE ".crc");
+        remove(BENCH_FILE ".dwb");
+    }
+    return 0;
+}
@@ -0,0 +1,187 @@
+#include "../include/coredb.h"
+#include <time.h>
+
+#define DEFAULT_ROWS 500000
+#define POOL_FRAMES 16384    // holds the whole table, so the runs measure locking, not I/O
+#define WRITES 200000        // single-row updates per run
+#define BENCH_FILE "bench_snapshots.db"
+
+// One run: a writer renames random rows while a scanner reads the whole table over and over
+typedef struct {
+    Database *db;
+    long rows;
+    int scan_mode;          // 0: no scanner, 1: snapshot scans, 2: scans under the writer lock
+    int writer_done;
+    long scans;
+    long max_records;       // most row images the version store held during a scan
+    double *latencies;
+} Run;
+
+// Seconds on the monotonic clock
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Compare latencies for qsort
+static int compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Rename random rows, timing each update
+static void *writer(void *arg)
+{
+    Run *run = arg;
+    unsigned int seed = 11;
+    for (long w = 0; w < WRITES; w++)
+    {
+        char name[60];
+        int id = (int)(((long)rand_r(&seed) * RAND_MAX + rand_r(&seed)) % run->rows) + 1;
+        snprintf(name, sizeof(name), "Renamed%ld", w);
+        double start = now();
+        update_row(run->db, id, name);
+        run->latencies[w] = now() - start;
+    }
+    __atomic_store_n(&run->writer_done, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+// Scan the whole table until the writer is done: from a snapshot, or holding the writer
+// lock for the length of the scan as a scan without versions would have to
+static void *scanner(void *arg)
+{
+    Run *run = arg;
+    while (!__atomic_load_n(&run->writer_done, __ATOMIC_ACQUIRE))
+    {
+        struct Row row;
+        long count = 0;
+        if (run->scan_mode == 1)
+        {
+            Snapshot snapshot;
+            SnapshotCursor cursor;
+            snapshot_begin(run->db, &snapshot);
+            select_range_snapshot(run->db, &snapshot, 1, INT32_MAX, &cursor);
+            while (snapshot_next(run->db, &cursor, &row))
+            {
+                count++;
+            }
+            VersionStats stats;
+            versions_get_stats(run->db, &stats);
+            if (stats.records > run->max_records)
+            {
+                run->max_records = stats.records;
+            }
+            snapshot_cursor_close(&cursor);
+            snapshot_end(run->db, &snapshot);
+        }
+        else
+        {
+            RangeCursor cursor;
+            lock_writer(run->db);
+            select_range(run->db, 1, INT32_MAX, &cursor);
+            while (range_next(run->db, &cursor, &row))
+            {
+                count++;
+            }
+            unlock_writer(run->db);
+        }
+        if (count != run->rows)
+        {
+            printf("Error: A scan returned %ld of %ld rows\n", count, run->rows);
+            exit(1);
+        }
+        run->scans++;
+    }
+    return NULL;
+}
+
+// Run the writer with or without a scanner and print its throughput and latency
+static void run_writes(Database *db, long rows, int scan_mode, const char *label)
+{
+    Run run;
+    memset(&run, 0, sizeof(Run));
+    run.db = db;
+    run.rows = rows;
+    run.scan_mode = scan_mode;
+    run.latencies = malloc(WRITES * sizeof(double));
+    pthread_t writer_thread;
+    pthread_t scanner_thread;
+
+    double start = now();
+    pthread_create(&writer_thread, NULL, writer, &run);
+    if (scan_mode)
+    {
+        pthread_create(&scanner_thread, NULL, scanner, &run);
+    }
+    pthread_join(writer_thread, NULL);
+    double seconds = now() - start;
+    if (scan_mode)
+    {
+        pthread_join(scanner_thread, NULL);
+    }
+    qsort(run.latencies, WRITES, sizeof(double), compare_doubles);
+    printf("  %-22s  %10.0f  %8.1f  %10.1f  %6ld", label, WRITES / seconds, run.latencies[WRITES / 2] * 1e6,
+           run.latencies[WRITES * 999 / 1000] * 1e6, run.scans);
+    if (scan_mode == 1)
+    {
+        printf("  %12ld\n", run.max_records);
+    }
+    else
+    {
+        printf("  %12s\n", "-");
+    }
+    free(run.latencies);
+}
+
+int main(int argc, char **argv)
+{
+    long rows = argc > 1 ? atol(argv[1]) : DEFAULT_ROWS;
+    if (rows < 1000 || rows > INT32_MAX)
+    {
+        printf("Error: Use between 1000 and %d rows\n", INT32_MAX);
+        return 1;
+    }
+    char wal_path[256];
+    snprintf(wal_path, sizeof(wal_path), "%s.wal", BENCH_FILE);
+    remove(BENCH_FILE);
+    remove(wal_path);
+    remove(BENCH_FILE ".crc");
+    remove(BENCH_FILE ".dwb");
+
+    DbOptions options;
+    memset(&options, 0, sizeof(DbOptions));
+    options.no_sync = 1;
+    options.pool_frames = POOL_FRAMES;
+    Database db = init_db_with_options(BENCH_FILE, &options);
+    struct Row *batch = malloc(10000 * sizeof(struct Row));
+    for (long first = 1; first <= rows; first += 10000)
+    {
+        int count = rows - first + 1 < 10000 ? (int)(rows - first + 1) : 10000;
+        for (int i = 0; i < count; i++)
+        {
+            batch[i].id = (int)(first + i);
+            snprintf(batch[i].name, sizeof(batch[i].name), "Row%ld", first + i);
+        }
+        insert_rows(&db, batch, count);
+    }
+    free(batch);
+    checkpoint(&db);
+
+    printf("%d single-row updates over %ld rows, next to full-table scans\n", WRITES, rows);
+    printf("  %-22s  %10s  %8s  %10s  %6s  %12s\n", "scans", "writes/s", "p50 us", "p99.9 us", "scans",
+           "max versions");
+    run_writes(&db, rows, 0, "none");
+    run_writes(&db, rows, 1, "snapshot");
+    run_writes(&db, rows, 2, "under the writer lock");
+    close_db(&db);
+    remove(BENCH_FILE);
+    remove(wal_path);
+    remove(BENCH_FILE ".crc");
+    remove(BENCH_FILE ".dwb");
+    return 0;
+}
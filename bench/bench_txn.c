@@ -0,0 +1,118 @@
+#include "../include/coredb.h"
+#include <time.h>
+
+#define DEFAULT_ROWS 10000
+#define BENCH_FILE "bench_txn.db"
+
+// Seconds on the monotonic clock
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Open a fresh database that syncs its log on every commit
+static Database open_fresh(void)
+{
+    char wal_path[256];
+    snprintf(wal_path, sizeof(wal_path), "%s.wal", BENCH_FILE);
+    remove(BENCH_FILE);
+    remove(wal_path);
+    remove(BENCH_FILE ".crc");
+    remove(BENCH_FILE ".dwb");
+    DbOptions options;
+    memset(&options, 0, sizeof(DbOptions));
+    options.pool_frames = 4096;
+    return init_db_with_options(BENCH_FILE, &options);
+}
+
+// Print the time and log syncs one way of writing rows took
+static void report(const char *label, long rows, double seconds, const WalStats *before, const WalStats *after)
+{
+    printf("  %-26s  %10.0f  %9.3f  %6lu\n", label, rows / seconds, seconds, after->flushes - before->flushes);
+}
+
+// Write rows with one of: 0 single-row inserts, 1 one transaction of inserts, 2 a rolled
+// back transaction, 3 one transaction of updates over the inserted rows
+static void run(long rows, int mode, const char *label)
+{
+    Database db = open_fresh();
+    if (mode == 3)
+    {
+        Transaction txn;
+        txn_begin(&db, &txn);
+        for (long i = 1; i <= rows; i++)
+        {
+            txn_insert(&txn, (int)i, "Loaded");
+        }
+        txn_commit(&txn);
+    }
+    WalStats before, after;
+    wal_get_stats(db.wal, &before);
+    double start = now();
+    if (mode == 0)
+    {
+        for (long i = 1; i <= rows; i++)
+        {
+            char name[60];
+            snprintf(name, sizeof(name), "Row%ld", i);
+            insert_row(&db, (int)i, name);
+        }
+    }
+    else
+    {
+        Transaction txn;
+        txn_begin(&db, &txn);
+        for (long i = 1; i <= rows; i++)
+        {
+            char name[60];
+            snprintf(name, sizeof(name), "Row%ld", i);
+            if (mode == 3)
+            {
+                txn_update(&txn, (int)i, name);
+            }
+            else
+            {
+                txn_insert(&txn, (int)i, name);
+            }
+        }
+        if (mode == 2)
+        {
+            txn_abort(&txn);
+        }
+        else if (!txn_commit(&txn))
+        {
+            printf("Error: The transaction did not commit\n");
+            exit(1);
+        }
+    }
+    double seconds = now() - start;
+    wal_get_stats(db.wal, &after);
+    report(label, rows, seconds, &before, &after);
+    close_db(&db);
+}
+
+int main(int argc, char **argv)
+{
+    long rows = argc > 1 ? atol(argv[1]) : DEFAULT_ROWS;
+    if (rows < 100 || rows > INT32_MAX)
+    {
+        printf("Error: Use between 100 and %d rows\n", INT32_MAX);
+        return 1;
+    }
+    printf("%ld rows written durably (the log is synced at every commit)\n", rows);
+    printf("  %-26s  %10s  %9s  %6s\n", "writes", "rows/s", "seconds", "syncs");
+    run(rows, 0, "single-row inserts");
+    run(rows, 1, "one transaction, inserts");
+    run(rows, 3, "one transaction, updates");
+    run(rows, 2, "one transaction, rollback");
+
+    char wal_path[256];
+    snprintf(wal_path, sizeof(wal_path), "%s.wal", BENCH_FILE);
+    remove(BENCH_FILE);
+    remove(wal_path);
+    remove(BENCH_FILE ".crc");
+    remove(BENCH_FILE ".dwb");
+    return 0;
+}
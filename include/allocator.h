@@ -0,0 +1,16 @@
+#ifndef ALLOCATOR_H
+#define ALLOCATOR_H
+
+#include "coredb.h"
+
+// Header page (returns 1 if the file predates the header and must be migrated)
+int read_header(Database *db, off_t file_size);
+void write_header(Database *db);
+uint32_t header_checksum(const DbHeader *header);
+
+// Page allocation shared by index and data pages
+off_t allocate_page(Database *db);
+off_t allocate_extent(Database *db, int pages);
+void free_page(Database *db, off_t offset);
+
+#endif // ALLOCATOR_H
@@ -0,0 +1,21 @@
+#ifndef BLOOM_H
+#define BLOOM_H
+
+#include "coredb.h"
+
+// Bloom filter over the ids, consulted before any descent of the primary index
+int bloom_open(Database *db);
+int bloom_build(Database *db);
+void bloom_close(Database *db);
+int bloom_may_contain(Database *db, int id);
+void bloom_false_positive(Database *db);
+void bloom_add(Database *db, int id);
+
+// Checkpoint hooks: list the changed pages, then move the header to the filter
+int bloom_collect_dirty(Database *db, PageWrite *writes, int max_writes);
+void bloom_mark_clean(Database *db);
+int bloom_release_old(Database *db);
+
+void bloom_get_stats(Database *db, BloomStats *stats);
+
+#endif // BLOOM_H
@@ -7,10 +7,36 @@
 void read_node(Database *db, off_t offset, BTreeNode *node);
 void write_node(Database *db, off_t offset, BTreeNode *node);
 off_t allocate_node(Database *db);
+void free_node(Database *db, off_t offset);
+int node_max_keys(const BTreeNode *node);
+off_t leaf_rid(const BTreeNode *node, int i);
+void leaf_set_entry(BTreeNode *node, int i, int id, off_t rid);
 
 // B-Tree operations
 void btree_search(Database *db, int id, off_t *address);
-void btree_insert(Database *db, int id, off_t address);
+int btree_insert(Database *db, int id, off_t address);
+int btree_insert_row(Database *db, const struct Row *row);
+int btree_update(Database *db, int id, off_t address);
 void btree_delete(Database *db, int id);
+int btree_verify(Database *db, BTreeStats *stats);
+
+// Rows kept in row leaves (clustered tables), by an address from btree_search or btree_next
+int btree_read_row(Database *db, off_t address, struct Row *row);
+int btree_search_row(Database *db, int id, struct Row *row);
+int btree_write_row(Database *db, off_t address, const struct Row *row);
+
+// Batched operations on sorted ids, sharing descents between ids in the same leaf
+void btree_search_batch(Database *db, const int *ids, int count, off_t *addresses);
+int btree_leaf_run(Database *db, const int *ids, int count);
+void btree_insert_run(Database *db, const IndexEntry *entries, const struct Row *rows, int count);
+
+// Ordered scans along the leaf chain (chain order over the buckets of a hashed table)
+void btree_seek(Database *db, int id, RangeCursor *cursor);
+int btree_next(Database *db, RangeCursor *cursor, int *id, off_t *address);
+
+// Order statistics from the subtree counts of internal nodes (B+tree only, except the count)
+long btree_count(Database *db);
+long btree_rank(Database *db, int id);
+void btree_seek_rank(Database *db, long rank, RangeCursor *cursor);
 
 #endif // BTREE_H
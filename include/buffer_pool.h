@@ -0,0 +1,36 @@
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include "coredb.h"
+
+// Buffer pool lifecycle
+BufferPool *buffer_pool_create(int fd, int num_frames);
+BufferPool *buffer_pool_create_mmap(int fd, size_t file_size);
+void buffer_pool_destroy(BufferPool *pool);
+
+// Grow the mmap backend to cover file_size bytes in place (returns -1 on error)
+int buffer_pool_remap(BufferPool *pool, size_t file_size);
+
+// Page access for the writer (pages stay pinned and latched until buffer_pool_unpin)
+void *buffer_pool_fetch(BufferPool *pool, off_t offset);
+void *buffer_pool_fetch_new(BufferPool *pool, off_t offset);
+void buffer_pool_unpin(BufferPool *pool, off_t offset, int is_dirty);
+void buffer_pool_discard(BufferPool *pool, off_t offset);
+
+// Shared page access for readers (until buffer_pool_unlatch)
+const void *buffer_pool_latch(BufferPool *pool, off_t offset);
+void buffer_pool_unlatch(BufferPool *pool, off_t offset);
+
+// Write-back of dirty pages
+int buffer_pool_flush_page(BufferPool *pool, off_t offset);
+int buffer_pool_flush_all(BufferPool *pool);
+
+// Checkpoint support: list dirty pages, then mark them clean once written
+int buffer_pool_collect_dirty(BufferPool *pool, PageWrite *writes, int max_writes);
+void buffer_pool_mark_clean(BufferPool *pool, off_t offset);
+
+// Statistics
+void buffer_pool_get_stats(BufferPool *pool, BufferPoolStats *stats);
+void buffer_pool_reset_stats(BufferPool *pool);
+
+#endif // BUFFER_POOL_H
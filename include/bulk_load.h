@@ -0,0 +1,21 @@
+#ifndef BULK_LOAD_H
+#define BULK_LOAD_H
+
+#include "coredb.h"
+
+// Build an empty table from rows in one sequential pass (rows are sorted in place)
+int bulk_load(Database *db, struct Row *rows, int count, int fill_percent);
+
+// Build the name index from the table in one sequential pass (returns 1 on success)
+int build_name_index(Database *db);
+
+// Rewrite a table from before version 4 into slotted pages (returns 1 on success)
+int upgrade_table(Database *db, int legacy);
+
+// Rebuild the index of a version 5 to 9 file with subtree counts (returns 1 on success)
+int upgrade_index_counts(Database *db);
+
+// Bulk load "<id> <name>" lines from a text file (returns rows loaded, -1 on failure)
+int load_file(Database *db, const char *path, int fill_percent);
+
+#endif // BULK_LOAD_H
@@ -0,0 +1,24 @@
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include "coredb.h"
+
+// Checksum file lifecycle
+PageChecksums *page_checksums_open(const char *path, int truncate, int no_sync);
+void page_checksums_close(PageChecksums *checksums);
+int page_checksums_reset(PageChecksums *checksums);
+
+// Pages written and read
+void page_checksums_set(PageChecksums *checksums, off_t offset, const void *page);
+int page_checksums_check(PageChecksums *checksums, off_t offset, const void *page);
+
+// Checkpoint support: list the changed blocks, then mark them written
+int page_checksums_collect_dirty(PageChecksums *checksums, PageWrite *writes, int max_writes);
+void page_checksums_mark_clean(PageChecksums *checksums, const PageWrite *writes, int count);
+int page_checksums_flush(PageChecksums *checksums);
+
+// Statistics, and a check of every page in the file
+void page_checksums_get_stats(PageChecksums *checksums, ChecksumStats *stats);
+int verify_page_checksums(Database *db, ChecksumStats *stats);
+
+#endif // CHECKSUM_H
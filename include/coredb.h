@@ -5,16 +5,83 @@
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <pthread.h>
+#include <time.h>
 
 // Constants
 #define PAGE_SIZE 4096
-#define MAX_ROWS ((PAGE_SIZE - sizeof(int)) / sizeof(struct Row))
-#define MAX_PAGES 10
-#define INDEX_PAGES 10
+#define MAX_ROWS ((PAGE_SIZE - sizeof(DataPageHeader)) / (sizeof(struct Row) + sizeof(uint16_t)))
+#define DATA_PAGE_MAGIC 0x534c4f54 // "SLOT"
+// Index nodes refer to pages by number
+#define PAGE_NUMBER(offset) ((uint32_t)((offset) / PAGE_SIZE))
+#define PAGE_OFFSET(number) ((off_t)(number) * PAGE_SIZE)
+// Record IDs name a slot of a data page, so rows can move within their page freely
+#define RID(page_offset, slot) ((page_offset) + (off_t)(slot))
+#define RID_PAGE(rid) ((rid) - (rid) % PAGE_SIZE)
+#define RID_SLOT(rid) ((int)((rid) % PAGE_SIZE))
 #define HEADER_PAGES 1
-#define DATA_START_OFFSET ((HEADER_PAGES + INDEX_PAGES) * PAGE_SIZE)
-#define MAX_KEYS 255
-#define MAX_CHILDREN 256
+#define DB_MAGIC 0x42444f43 // "CODB"
+#define DB_VERSION 11 // version 11: header checksum and checkpoint LSN (page checksums beside the file)
+// Fixed layout of files written before the page allocator: 10 index pages, then data
+#define LEGACY_INDEX_PAGES 10
+#define LEGACY_DATA_START_OFFSET ((HEADER_PAGES + LEGACY_INDEX_PAGES) * PAGE_SIZE)
+// Data pages before version 4: [int num_rows][rows], link to the next page at the end
+#define LEGACY_DATA_PAGE_NEXT_OFFSET (PAGE_SIZE - sizeof(off_t))
+#define NODE_HEADER_SIZE 8
+// Leaf entries are an id, a page number and a slot (10 bytes); internal entries a key, a
+// child page number and the number of entries below that child (12 bytes)
+#define LEAF_MAX_KEYS ((int)((PAGE_SIZE - NODE_HEADER_SIZE) / (sizeof(int32_t) + sizeof(uint32_t) + sizeof(uint16_t))))
+#define INTERNAL_MAX_KEYS ((int)((PAGE_SIZE - NODE_HEADER_SIZE - 2 * sizeof(uint32_t)) / (sizeof(int32_t) + 2 * sizeof(uint32_t))))
+#define MAX_CHILDREN (INTERNAL_MAX_KEYS + 1)
+// Internal nodes of versions 5 to 9 had no counts and held 510 keys
+#define UNCOUNTED_INTERNAL_KEYS ((int)((PAGE_SIZE - NODE_HEADER_SIZE - sizeof(uint32_t)) / (sizeof(int32_t) + sizeof(uint32_t))))
+// Leaves of a clustered table hold whole rows (64 bytes each)
+#define CLUSTERED_LEAF_ROWS ((int)((PAGE_SIZE - NODE_HEADER_SIZE) / sizeof(struct Row)))
+// Name index entries are a full name and an id (64 bytes); internal entries add a child
+#define NAME_LEAF_KEYS ((int)((PAGE_SIZE - NODE_HEADER_SIZE) / sizeof(NameKey)))
+#define NAME_INTERNAL_KEYS ((int)((PAGE_SIZE - NODE_HEADER_SIZE - sizeof(uint32_t)) / (sizeof(NameKey) + sizeof(uint32_t))))
+// Hash buckets hold leaf entries; the directory root lists the directory pages, and each
+// directory page holds bucket page numbers
+#define HASH_BUCKET_KEYS LEAF_MAX_KEYS
+#define HASH_DIRECTORY_ENTRIES ((int)(PAGE_SIZE / sizeof(uint32_t)))
+#define HASH_MAX_DIRECTORY_PAGES ((int)((PAGE_SIZE - 4 * sizeof(uint32_t)) / sizeof(uint32_t)))
+// Kinds of node, stored in BTreeNode.is_leaf
+#define NODE_INTERNAL 0
+#define NODE_LEAF 1         // entries point at rows in data pages
+#define NODE_ROW_LEAF 2     // entries are the rows themselves (clustered tables)
+// Nodes before version 5: 16-byte leaf entries and 8-byte child offsets
+#define LEGACY_MAX_KEYS 255
+#define LEGACY_MAX_CHILDREN 256
+#define BTREE_MAX_HEIGHT 16
+#define BUFFER_POOL_FRAMES 256
+#define WAL_CHECKPOINT_BYTES (1024 * 1024)
+#define CHECKPOINT_INTERVAL_SECONDS 30
+#define COMPACTION_FREE_PERCENT 25 // free row slots, as a share of data page slots, that trigger compaction
+#define BULK_LOAD_FILL_PERCENT 90  // share of each bulk-loaded index node that is filled
+#define BULK_BATCH_PAGES 256        // pages staged per sequential bulk-load write
+#define ROW_READ_ATTEMPTS 8         // lookups a reader repeats when the writer moves the row it found
+// Blocked Bloom filter: each id sets BLOOM_PROBES bits of one 512-bit block (a cache line),
+// sized for BLOOM_BITS_PER_KEY bits per id (about 1% false positives)
+#define BLOOM_BITS_PER_KEY 10
+#define BLOOM_PROBES 7
+#define BLOOM_BLOCK_BITS 512
+// Network server (see run_server)
+#define SERVER_DEFAULT_PORT 7878
+#define SERVER_MAX_CLIENTS 1024
+#define SERVER_INPUT_BYTES 65536    // unparsed request bytes buffered per client
+#define SERVER_MAX_LINE 256         // longest request line
+#define SERVER_OUTPUT_LIMIT (1024 * 1024) // queued reply bytes at which a client's input is paused
+#define SERVER_BATCH_WRITES 1024    // pipelined writes applied and committed together
+#define SERVER_MAX_RANGE_ROWS 1000
+// Page checksum file: one block per PAGE_CHECKSUMS_PER_BLOCK pages, each with a CRC32C of its own
+#define PAGE_CHECKSUMS_PER_BLOCK ((int)((PAGE_SIZE - 16) / sizeof(PageChecksum)))
+#define PAGE_CHECKSUM_BLOCK_MAGIC 0x4b4c4243 // "CBLK"
+#define DOUBLE_WRITE_MAGIC 0x42574244 // "DBWB"
+// Files a double-write batch restores pages of
+#define DOUBLE_WRITE_DATABASE 0
+#define DOUBLE_WRITE_CHECKSUMS 1
 
 // Core data structures
 struct Row {
@@ -24,38 +91,638 @@ struct Row {
 
 typedef struct {
     int id;
-    off_t address;
+    off_t address;     // record ID of the row (see RID)
 } IndexEntry;
 
+// Start of every data page. The slot directory (one uint16_t row offset per slot, 0 for a
+// free slot) follows it, and rows are packed from the end of the page down to rows_start.
+typedef struct {
+    uint32_t magic;
+    uint16_t num_slots;     // slots in the directory, free ones included
+    uint16_t live_rows;
+    uint16_t rows_start;    // lowest row offset in use, PAGE_SIZE when the page is empty
+    uint16_t free_bytes;    // bytes not taken by the header, the directory or live rows
+    uint16_t in_free_list;  // page is linked into the free-space map
+    uint16_t reserved;
+    off_t next;             // next page of the data chain, 0 at the tail
+    off_t next_free;        // next page of the free-space map, 0 at the end
+} DataPageHeader;
+
+// Index page. Entries are stored as parallel arrays so the keys stay contiguous for the
+// node search, and pages are referred to by number (file offset / PAGE_SIZE). Both leaf
+// layouts start with their ids, so searches read data.leaf.ids for either kind.
+typedef struct {
+    uint16_t num_keys;
+    uint16_t is_leaf;       // NODE_INTERNAL, NODE_LEAF or NODE_ROW_LEAF
+    uint32_t next;          // leaf: right sibling's page number in key order, 0 for the last leaf
+    union {
+        struct {
+            int32_t ids[LEAF_MAX_KEYS];
+            uint32_t pages[LEAF_MAX_KEYS];  // record ID of each row: data page number ...
+            uint16_t slots[LEAF_MAX_KEYS];  // ... and slot
+        } leaf;
+        struct {
+            int32_t ids[CLUSTERED_LEAF_ROWS];
+            char names[CLUSTERED_LEAF_ROWS][60];
+        } rows;
+        struct {
+            int32_t keys[INTERNAL_MAX_KEYS];
+            uint32_t children[MAX_CHILDREN];
+            uint32_t counts[MAX_CHILDREN];  // entries in each child's subtree (version 10)
+        } internal;
+    } data;
+} BTreeNode;
+
+// Index page as written by versions 5 to 9, read once when such a file is upgraded: leaves
+// kept their layout, internal nodes had no counts
+typedef union {
+    BTreeNode leaf;
+    struct {
+        uint16_t num_keys;
+        uint16_t is_leaf;
+        uint32_t next;
+        int32_t keys[UNCOUNTED_INTERNAL_KEYS];
+        uint32_t children[UNCOUNTED_INTERNAL_KEYS + 1];
+    } internal;
+} UncountedNode;
+
+// Index page as written before version 5, read once when such a file is upgraded
 typedef struct {
     int num_keys;
     int is_leaf;
     union {
         struct {
-            IndexEntry entries[MAX_KEYS];
+            IndexEntry entries[LEGACY_MAX_KEYS];
+            off_t next;     // right sibling in key order (version 3)
         } leaf;
         struct {
-            int keys[MAX_KEYS];
-            off_t children[MAX_CHILDREN];
+            int keys[LEGACY_MAX_KEYS];
+            off_t children[LEGACY_MAX_CHILDREN];
         } internal;
     } data;
-} BTreeNode;
+} LegacyBTreeNode;
 
+// Key of the name index; rows with the same name are told apart (and ordered) by id
 typedef struct {
-    FILE *file;
-    void **pages;
+    char name[60];          // zero padded, compared as a whole
+    int32_t id;
+} NameKey;
+
+// Name index page, laid out like BTreeNode with NameKey keys
+typedef struct {
+    uint16_t num_keys;
+    uint16_t is_leaf;
+    uint32_t next;          // leaf: right sibling's page number, 0 for the last leaf
+    union {
+        NameKey entries[NAME_LEAF_KEYS];
+        struct {
+            NameKey keys[NAME_INTERNAL_KEYS];
+            uint32_t children[NAME_INTERNAL_KEYS + 1];
+        } internal;
+    } data;
+} NameNode;
+
+// Bucket of a hashed primary index: the entries whose hash shares its low depth bits,
+// kept sorted by id like a leaf
+typedef struct {
+    uint16_t num_keys;
+    uint16_t depth;         // local depth: bits of the hash common to every id in the bucket
+    uint32_t next;          // next bucket in scan order (page number), 0 for the last
+    int32_t ids[HASH_BUCKET_KEYS];
+    uint32_t pages[HASH_BUCKET_KEYS];   // record ID of each row: data page number ...
+    uint16_t slots[HASH_BUCKET_KEYS];   // ... and slot
+} HashBucket;
+
+// Root page of a hashed primary index (at root_offset)
+typedef struct {
+    uint32_t depth;         // global depth: the directory has 2^depth entries
+    uint32_t num_pages;     // directory pages in use
+    uint32_t first_bucket;  // head of the bucket chain (page number)
+    uint32_t buckets;       // buckets in the chain
+    uint32_t pages[HASH_MAX_DIRECTORY_PAGES];  // directory pages, HASH_DIRECTORY_ENTRIES each
+} HashDirectory;
+
+// Shape of a hashed index as measured by hash_verify
+typedef struct {
+    int depth;              // global depth
+    long directory_pages;
+    long buckets;
+    long keys;
+    long capacity;          // keys all buckets could hold
+    long empty;             // buckets emptied by deletes (buckets are not merged)
+} HashStats;
+
+// Shape of the index as measured by btree_verify
+typedef struct {
+    int height;         // levels, leaves included
+    long nodes;
+    long leaves;
+    long keys;          // entries in the leaves
+    long used_keys;     // keys in all nodes, for the average fill
+    long capacity;      // keys all nodes could hold
+    long underfull;     // nodes other than the root below half full (sparse bulk loads leave some)
+} BTreeStats;
+
+// Position of an ordered scan along the leaf chain (see select_range)
+typedef struct {
+    off_t leaf;     // leaf holding the next entry, 0 once the scan is done
+    int index;      // next entry within that leaf (a hint once the leaf may have changed)
+    int hi;         // last id in the range (inclusive)
+    int lo;         // first id in the range, for hashed tables whose buckets are not in id order
+    int next;       // smallest id not returned yet, to find the place again after a restructure
+    unsigned long version;  // index version the position was taken at (see read_begin)
+    off_t root;     // hashed tables: directory the scan started in (a bulk load replaces it)
+    int depth;      // hashed tables: depth of the current bucket when the scan reached it, -1 before
+    off_t after;    // hashed tables: the bucket that followed it then; buckets split off it since lie between
+} RangeCursor;
+
+// Position of a scan over the names equal to (or starting with) a string
+typedef struct {
+    off_t leaf;     // leaf holding the next entry, 0 once the scan is done
+    int index;      // next entry within that leaf (a hint once the leaf may have changed)
+    char name[60];  // name or prefix to match
+    int prefix;     // match names that start with name instead of equal to it
+    NameKey last;   // key of the entry returned last, valid once started is set
+    int started;
+    unsigned long version;  // index version the position was taken at (see read_begin)
+} NameCursor;
+
+// Checksum of one page of the database file as the last checkpoint wrote it
+typedef struct {
+    uint32_t crc;           // CRC32C of the page
+    uint32_t valid;         // 0: not written since checksums were kept, not checked
+    uint64_t lsn;           // checkpoint LSN of the write
+} PageChecksum;
+
+// Block of the checksum file: the entries of PAGE_CHECKSUMS_PER_BLOCK consecutive pages
+typedef struct {
+    PageChecksum entries[PAGE_CHECKSUMS_PER_BLOCK];
+    uint32_t magic;
+    uint32_t crc;           // CRC32C of the entries, so a torn block is dropped, not trusted
+    uint64_t reserved;
+} PageChecksumBlock;
+
+// Checksums of the database pages, kept in a file beside it and read a block at a time as
+// pages are first read; the writer updates them as it writes pages
+typedef struct {
+    int fd;
+    int no_sync;
+    pthread_mutex_t lock;
+    PageChecksumBlock **blocks; // NULL until the block is first used
+    unsigned char *dirty;       // per block: changed since it was last written
+    long num_blocks;            // slots in blocks and dirty
+    int num_dirty;
+    uint64_t lsn;               // checkpoint LSN given to the pages written from now on
+    unsigned long verified;     // page reads that matched their checksum
+    unsigned long failures;     // ... that did not
+    unsigned long unchecked;    // ... of pages without a checksum
+    unsigned long dropped_blocks; // torn blocks whose entries were forgotten
+} PageChecksums;
+
+// Reader/writer latch of a cached page. Readers share it; the writer holds it exclusively
+// while it has the page pinned, and its nested pins and latches of that page reuse the hold.
+typedef struct {
+    pthread_rwlock_t lock;
+    pthread_t owner;        // thread holding the latch exclusively, valid while depth > 0
+    int depth;
+} PageLatch;
+
+// Buffer pool frame holding one cached index or data page
+typedef struct {
+    off_t offset;       // file offset of the cached page, -1 if the frame is free
+    int pin_count;      // callers using the frame; -1 while it is being claimed for another page
+    int dirty;          // page differs from its on-disk copy
+    int referenced;     // CLOCK reference bit
+    int hash_next;      // next frame in the same hash bucket, -1 terminates
+    unsigned char *data;
+    PageLatch latch;
+} BufferFrame;
+
+// Counters exposed for sizing the buffer pool
+typedef struct {
+    int num_frames;
+    int pages_cached;
+    int pages_pinned;
+    int pages_dirty;
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+    unsigned long writebacks;
+    size_t mapped_bytes;    // non-zero when pages are served from a memory mapping
+} BufferPoolStats;
+
+// Fixed-size page cache with CLOCK eviction, or a whole-file mapping in mmap mode
+typedef struct {
+    int fd;
+    unsigned char *map;     // mmap backend: pages are served in place, NULL when frames are used
+    size_t map_size;        // bytes reserved by the mapping (may exceed the file size)
+    unsigned char *map_dirty; // mmap backend: one flag per mapped page awaiting write-back
+    int no_steal;           // never evict dirty frames (they are written only at checkpoints)
+    int num_dirty;          // frames (or mapped pages) awaiting write-back
+    BufferFrame *frames;
+    int num_frames;
+    int *buckets;       // page number hash -> first frame index
+    int num_buckets;
+    int clock_hand;
+    pthread_mutex_t lock;   // frame table: hash chains, claims and the clock hand
+    PageChecksums *checksums; // pages read are checked against it, pages written update it
+    PageLatch **map_latches; // mmap backend: latches of the mapped pages, MAP_LATCH_CHUNK per chunk
+    size_t map_limit;       // mmap backend: address space reserved, the mapping never moves
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+    unsigned long writebacks;
+} BufferPool;
+
+// Redo record types
+#define WAL_INSERT 1
+#define WAL_UPDATE 2
+#define WAL_DELETE 3
+// Markers around the records of a transaction (id: the number of records between them);
+// replay applies the records only once it reaches the commit marker
+#define WAL_BEGIN 4
+#define WAL_COMMIT 5
+// Follows the commit marker of a transaction that could not apply in full (id: its number
+// of records); replay drops the transaction, and the records logged after the marker undo
+// whatever part of it a checkpoint wrote
+#define WAL_ROLLBACK 6
+
+// Redo record appended to the write-ahead log for every committed change
+typedef struct {
+    uint32_t checksum;      // covers every field after this one
+    uint32_t type;
+    uint64_t lsn;
+    int32_t id;
+    char name[60];
+} WalRecord;
+
+// One change of a batch applied in order with a single commit (see apply_writes)
+typedef struct {
+    int type;               // WAL_INSERT, WAL_UPDATE or WAL_DELETE
+    int id;
+    char name[60];          // new name (inserts and updates)
+    int applied;            // set by apply_writes: 0 for a duplicate, missing or invalid id
+} WriteRequest;
+
+// Counters exposed for tuning group commit
+typedef struct {
+    unsigned long records;
+    unsigned long commits;
+    unsigned long flushes;      // write+sync rounds; commits / flushes is the average group size
+    unsigned long bytes_written;
+    off_t size;
+    uint64_t next_lsn;          // LSN the next record will get
+} WalStats;
+
+// Append-only redo log with group commit
+typedef struct {
+    int fd;
+    int no_sync;                // write records but skip fdatasync at commit
+    pthread_mutex_t lock;
+    pthread_cond_t flushed;
+    unsigned char *buffer;      // records appended but not written yet
+    size_t buffer_len;
+    size_t buffer_cap;
+    unsigned char *spare;       // second buffer, swapped in while the leader writes
+    size_t spare_cap;
+    uint64_t next_lsn;
+    uint64_t durable_lsn;       // every record with a smaller LSN is on disk
+    int flush_in_progress;
+    off_t size;
+    unsigned long records;
+    unsigned long commits;
+    unsigned long flushes;
+    unsigned long bytes_written;
+} Wal;
+
+// One page queued for write-back at a checkpoint
+typedef struct {
+    off_t offset;
+    const void *data;
+} PageWrite;
+
+// What checkpoints wrote, for tracking write amplification
+typedef struct {
+    unsigned long checkpoints;
+    size_t last_bytes;
+    int last_pages;
+    int last_writes;            // pwritev calls after coalescing adjacent pages
+    size_t total_bytes;
+    size_t double_write_bytes;  // copies written to the double-write file first, all checkpoints
+} CheckpointStats;
+
+// What one checkpoint writes: dirty pages, the checksum blocks covering them, the header
+typedef struct {
+    PageWrite *pages;
+    int count;
+    PageWrite *blocks;
+    int num_blocks;
+    int header_changed;
+} CheckpointBatch;
+
+// Header page contents; index and data pages are allocated anywhere after it
+typedef struct {
+    off_t root_offset;      // first, where files from before the header kept it
+    uint32_t magic;
+    uint32_t version;
+    off_t page_count;       // pages in the file, header included
+    off_t free_head;        // first page of the free list (each links to the next), 0 if empty
+    off_t free_count;
+    off_t first_data_page;  // head of the data page chain
+    off_t last_data_page;   // tail of the chain (version 2)
+    off_t data_pages;       // pages in the chain (version 2)
+    off_t row_count;        // live rows (version 4)
+    off_t free_space_head;  // free-space map: first data page with room for a row (version 4)
+    off_t clustered;        // rows live in the index leaves, there are no data pages (version 6)
+    off_t name_root;        // root of the name index, 0 until it is built (version 7)
+    off_t hashed;           // the primary index is a hash table, root_offset its directory (version 8)
+    off_t bloom_offset;     // first page of the Bloom filter extent, 0 until it is built (version 9)
+    off_t bloom_pages;
+    off_t bloom_keys;       // ids added to the filter since it was built
+    uint64_t checkpoint_lsn; // log records from this LSN on are not in the pages yet (version 11)
+    uint32_t checksum;      // CRC32C of the header with this field zero (version 11)
+    uint32_t reserved;
+} DbHeader;
+
+// Checksum counters, and the result of a full scan by verify_page_checksums
+typedef struct {
+    unsigned long verified;
+    unsigned long failures;
+    unsigned long unchecked;
+    unsigned long dropped_blocks;
+    int hardware;           // CRC32C computed with SSE4.2 instructions
+} ChecksumStats;
+
+// Start of the double-write file: descriptors of the pages that follow, then their images
+// from the next page boundary on, one page each
+typedef struct {
+    uint32_t magic;
+    uint32_t count;
+    uint64_t lsn;           // checkpoint LSN of the batch
+    uint32_t crc;           // CRC32C of the descriptors and images
+    uint32_t reserved;
+} DoubleWriteHeader;
+
+// Where one page of a double-write batch belongs
+typedef struct {
+    uint32_t file;          // DOUBLE_WRITE_DATABASE or DOUBLE_WRITE_CHECKSUMS
+    uint32_t length;        // bytes of the image to restore (the header is shorter than a page)
+    int64_t offset;
+} DoubleWriteEntry;
+
+// Copy of a checkpoint's pages, made durable before any of them is written in place, so a
+// crash partway through leaves a whole copy to finish the checkpoint from
+typedef struct {
+    int fd;
+    int no_sync;
+    unsigned long batches;
+} DoubleWrite;
+
+// What opening the database had to do after a crash
+typedef struct {
+    int repaired_pages;     // pages the double-write file restored
+    long replayed;          // log records applied
+    long skipped;           // log records the pages already held (below the checkpoint LSN)
+    long discarded;         // records of a transaction that did not commit
+} RecoveryStats;
+
+// Bloom filter over the ids, kept in memory and written to its extent at checkpoints
+typedef struct {
+    uint64_t *bits;         // num_pages pages of BLOOM_BLOCK_BITS-bit blocks, NULL until built
     int num_pages;
-    int max_pages;
+    off_t offset;           // extent holding the filter in the file
+    unsigned char *dirty;   // per page: changed since the last checkpoint
+    int num_dirty;
+    off_t old_offset;       // extent of the filter before a resize, freed once the header moves
+    int old_pages;
+    long keys;              // ids added since the filter was built (deleted ids stay in it)
+    unsigned long checks;   // lookups that consulted the filter
+    unsigned long negatives;        // answered "absent" without a descent
+    unsigned long false_positives;  // let through, but the id was not there
+} BloomFilter;
+
+// Bloom filter size and how well its answers held up
+typedef struct {
+    int pages;
+    long keys;
+    long capacity;          // ids it holds at BLOOM_BITS_PER_KEY bits each before it is resized
+    unsigned long checks;
+    unsigned long negatives;
+    unsigned long false_positives;
+} BloomStats;
+
+// Options chosen when a database is opened
+typedef struct {
+    int use_mmap;           // map header, index and data regions instead of using stdio and frames
+    int no_sync;            // commit without fdatasync (survives process crashes, not power loss)
+    int pool_frames;        // buffer pool size in pages, shared by index and data pages (0: default)
+    int checkpoint_seconds; // checkpoint at least this often while changes are pending (0: default)
+    off_t checkpoint_wal_bytes; // checkpoint once the log reaches this size (0: default)
+    int clustered;          // new files only: keep rows in the index leaves instead of data pages
+    int hashed;             // new files only: index ids with a hash table instead of a B+tree
+} DbOptions;
+
+// State shared by the threads of one database: changes are made by one writer at a time,
+// lookups and scans run next to it and validate what they read against the version
+typedef struct {
+    pthread_mutex_t writer;     // held by the thread changing the database (recursive)
+    pthread_t writer_thread;    // valid while writer_depth > 0
+    int writer_depth;
+    unsigned long version;      // odd while the writer moves entries between pages or frees them
+    int restructure_depth;
+    pthread_rwlock_t bloom;     // lookups share it, replacing the filter's arrays excludes them
+    int keep_log;               // a transaction is being applied: checkpoints keep its log records
+    uint64_t unapplied_lsn;     // ... and its records from this LSN on are not applied yet
+} DbSync;
+
+// Image of a row before a change, kept while a snapshot older than the change is open
+typedef struct {
+    uint64_t ts;            // timestamp of the change that replaced the image
+    long older;             // position of the previous record of the same id, -1 if none
+    int id;
+    int existed;            // 0 when the change inserted the row
+    char name[60];
+} VersionRecord;
+
+// Undo chains for snapshot reads: records are kept in timestamp order at positions counted
+// from the first record ever kept, and the id map points at the newest record of each id
+typedef struct {
+    pthread_mutex_t lock;
+    pthread_cond_t published_cond; // signalled whenever the writer publishes its changes
+    uint64_t published;     // snapshots taken now see every change up to this timestamp
+    uint64_t newest;        // timestamp of the newest record kept, 0 when there is none
+    int pending;            // the writer changed rows since it last published
+    int unversioned;        // ... and kept no records for them (no snapshot was open)
+    VersionRecord *records; // records[0] is at position base
+    long base;
+    long count;
+    long capacity;
+    int *map_ids;           // open addressing on the id, 0 marks a free slot
+    long *map_positions;
+    long map_capacity;
+    uint64_t *snapshots;    // timestamps of the open snapshots
+    int num_snapshots;
+    int snapshot_capacity;
+    unsigned long recorded;
+    unsigned long collected;
+} VersionStore;
+
+// A consistent view of the table: the rows as of the changes published before snapshot_begin
+typedef struct {
+    uint64_t ts;
+} Snapshot;
+
+// Range scan over a snapshot: the walk of the index merged with the ids changed since the
+// snapshot was taken (rows deleted meanwhile are no longer in the index)
+typedef struct {
+    const Snapshot *snapshot;
+    RangeCursor range;
+    int hi;
+    int last;               // id returned last, the scan goes on above it
+    int index_ready;        // index_row holds the next row of the index walk
+    int index_done;
+    struct Row index_row;
+    int *changed;           // ids above last changed since the snapshot, ascending from changed_pos
+    int num_changed;
+    int changed_pos;
+    int changed_capacity;
+    long seen;              // position of the first version record not looked at yet
+} SnapshotCursor;
+
+// Version store size, for spotting snapshots held open too long
+typedef struct {
+    long records;
+    int snapshots;
+    uint64_t published;
+    unsigned long recorded;
+    unsigned long collected;
+} VersionStats;
+
+typedef struct {
+    FILE *file;
+    BufferPool *pool;
+    DbSync *sync;           // shared by every copy of the struct
+    VersionStore *versions; // shared by every copy of the struct
+    Wal *wal;
+    int replaying;          // applying logged changes at startup, do not log them again
+    PageChecksums *checksums;
+    DoubleWrite *double_write;
+    int use_mmap;
+    int no_sync;
+    int clustered;          // copy of header.clustered
+    int hashed;             // copy of header.hashed
+    BloomFilter bloom;
+    int checkpoint_seconds;
+    off_t checkpoint_wal_bytes;
+    time_t last_checkpoint;
+    DbHeader header;
+    DbHeader checkpointed_header;   // header as of the last checkpoint
+    CheckpointStats checkpoint_stats;
+    RecoveryStats recovery;
     off_t root_offset;
-    int page_dirty[MAX_PAGES];
+    off_t name_root;        // root of the name index (header.name_root once checkpointed)
 } Database;
 
+// Changes of an explicit transaction, buffered until txn_commit applies them as one
+typedef struct {
+    Database *db;
+    int active;             // between txn_begin and txn_commit or txn_abort
+    WriteRequest *writes;   // in the order they were made
+    int count;
+    int capacity;
+    int *map_ids;           // open addressing on the id, 0 marks a free slot
+    int *map_writes;        // latest write of the id
+    int map_capacity;
+} Transaction;
+
+// Where the server listens
+typedef struct {
+    const char *bind_address;   // TCP address (NULL: 127.0.0.1)
+    int port;                   // TCP port, 0 for any free one, -1 for no TCP listener
+    const char *socket_path;    // Unix socket path (NULL: none)
+} ServerOptions;
+
+// A connection to the server: requests are read into in, replies queued in out
+typedef struct {
+    int fd;                 // -1 for a free slot
+    char *in;               // SERVER_INPUT_BYTES
+    size_t in_len;
+    char *out;
+    size_t out_len;
+    size_t out_sent;
+    size_t out_cap;
+    int pending_writes;     // requests of this client waiting in the write batch
+    int events;             // epoll events registered
+    int closing;            // close once the queued replies are sent
+} ServerClient;
+
+// Event loop serving one database to many clients
+typedef struct {
+    Database *db;
+    int epoll_fd;
+    int tcp_fd;             // listeners, -1 if not used
+    int unix_fd;
+    int wake_fd;            // eventfd that server_stop writes to
+    int port;               // bound TCP port
+    char socket_path[108];
+    int stopping;
+    ServerClient *clients;  // SERVER_MAX_CLIENTS slots
+    int num_clients;
+    WriteRequest *batch;    // writes read since the last commit, in arrival order
+    int *batch_clients;     // client slot of each
+    int batch_len;
+    unsigned long requests;
+    unsigned long writes;
+    unsigned long commits;  // apply_writes calls; writes / commits is the average batch
+} Server;
+
+// Consecutive new pages staged in memory and written out in large sequential batches
+typedef struct {
+    int fd;
+    off_t next_offset;      // file offset of the next page handed out
+    off_t batch_offset;     // file offset of the first staged page
+    int batch_pages;
+    unsigned char *batch;   // BULK_BATCH_PAGES pages
+    PageChecksums *checksums; // take the checksum of every page written
+} PageStream;
+
+// Table written after the end of the file by the bulk builder, not yet in the header
+typedef struct {
+    off_t root_offset;
+    off_t first_data_page;
+    off_t last_data_page;
+    off_t data_pages;
+    off_t free_space_head;
+    off_t end_offset;       // file offset just past the last page written
+} BuiltTable;
+
+// Bucket planned by the bulk builder of a hashed index: a run of the entries
+typedef struct {
+    int first;
+    int count;
+    uint32_t pattern;       // low depth bits of the hash shared by the entries
+    int depth;
+} HashBucketPlan;
+
 // Function declarations will be included from other headers
 #include "database.h"
 #include "btree.h"
+#include "name_index.h"
+#include "hash_index.h"
+#include "bloom.h"
+#include "mvcc.h"
+#include "node_search.h"
+#include "buffer_pool.h"
+#include "wal.h"
+#include "checksum.h"
+#include "double_write.h"
 #include "crud.h"
+#include "txn.h"
+#include "bulk_load.h"
 #include "storage.h"
+#include "allocator.h"
 #include "utils.h"
 #include "repl.h"
+#include "server.h"
 
 #endif // COREDB_H
@@ -7,8 +7,33 @@
 int insert_row(Database *db, int id, const char *name);
 int select_rows(Database *db, struct Row *rows, int max_rows);
 int select_by_id(Database *db, int id, struct Row *row);
+int select_range(Database *db, int lo, int hi, RangeCursor *cursor);
+int range_next(Database *db, RangeCursor *cursor, struct Row *row);
+int select_from_offset(Database *db, long offset, RangeCursor *cursor);
+void select_by_name(Database *db, const char *name, int prefix, NameCursor *cursor);
+int name_next(Database *db, NameCursor *cursor, struct Row *row);
 int update_row(Database *db, int id, const char *name);
 int delete_row(Database *db, int id);
-void compact_pages(Database *db);
+
+// Reads as of a snapshot (see snapshot_begin), unaffected by writes made since
+int select_by_id_snapshot(Database *db, const Snapshot *snapshot, int id, struct Row *row);
+int select_range_snapshot(Database *db, const Snapshot *snapshot, int lo, int hi, SnapshotCursor *cursor);
+int snapshot_next(Database *db, SnapshotCursor *cursor, struct Row *row);
+void snapshot_cursor_close(SnapshotCursor *cursor);
+
+// Order statistics over ids, from the subtree counts of the B+tree
+long count_rows(Database *db, int lo, int hi);
+long rank_of_id(Database *db, int id);
+
+// Data page compaction
+int compact_table(Database *db);
+void compact_if_needed(Database *db);
+
+// Batched operations, committed with one log flush
+int insert_rows(Database *db, const struct Row *rows, int count);
+int update_rows(Database *db, const struct Row *rows, int count);
+int delete_rows(Database *db, const int *ids, int count);
+int apply_writes(Database *db, WriteRequest *writes, int count);
+int commit_writes(Database *db, WriteRequest *writes, int count);
 
 #endif // CRUD_H
@@ -5,9 +5,23 @@
 
 // Database lifecycle functions
 Database init_db(const char *filename);
+Database init_db_with_options(const char *filename, const DbOptions *options);
 void close_db(Database *db);
+void release_db(Database *db);
+
+// One writer at a time; lookups and scans validate their pages against the version
+void lock_writer(Database *db);
+void unlock_writer(Database *db);
+int holds_writer(Database *db);
+void begin_restructure(Database *db);
+void end_restructure(Database *db);
+unsigned long read_begin(Database *db);
+int read_valid(Database *db, unsigned long version);
 
 // Database state management
 void write_buffer(Database *db);
+size_t checkpoint(Database *db);
+void checkpoint_if_needed(Database *db);
+void stage_checkpoint(Database *db);
 
 #endif // DATABASE_H
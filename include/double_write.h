@@ -0,0 +1,18 @@
+#ifndef DOUBLE_WRITE_H
+#define DOUBLE_WRITE_H
+
+#include "coredb.h"
+
+// Double-write file lifecycle
+DoubleWrite *double_write_open(const char *path, int truncate, int no_sync);
+void double_write_close(DoubleWrite *dw);
+
+// Checkpoint support: copy the pages aside, then drop the copy once they are in place
+int double_write_stage(DoubleWrite *dw, const PageWrite *pages, int count, const PageWrite *blocks,
+                       int num_blocks, const DbHeader *header, uint64_t lsn, size_t *bytes);
+int double_write_clear(DoubleWrite *dw);
+
+// Startup: finish a checkpoint a crash cut short (returns the pages repaired, -1 on failure)
+int double_write_recover(DoubleWrite *dw, int db_fd, int checksum_fd);
+
+#endif // DOUBLE_WRITE_H
@@ -0,0 +1,23 @@
+#ifndef HASH_INDEX_H
+#define HASH_INDEX_H
+
+#include "coredb.h"
+
+// Hashed primary index (extendible hashing), reached through the btree_* functions when
+// db->hashed is set
+uint32_t hash_id(int id);
+void hash_index_init(Database *db);
+void hash_index_free(Database *db, off_t root_offset);
+void hash_index_search(Database *db, int id, off_t *address);
+int hash_index_update(Database *db, int id, off_t address);
+int hash_index_insert(Database *db, int id, off_t address);
+void hash_index_delete(Database *db, int id);
+
+// Scans over every bucket, in chain order rather than id order
+void hash_index_seek(Database *db, int lo, RangeCursor *cursor);
+int hash_index_next(Database *db, RangeCursor *cursor, int *id, off_t *address);
+
+// Check the directory and the bucket chain and measure them (returns 1 if valid)
+int hash_index_verify(Database *db, HashStats *stats);
+
+#endif // HASH_INDEX_H
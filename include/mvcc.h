@@ -0,0 +1,21 @@
+#ifndef MVCC_H
+#define MVCC_H
+
+#include "coredb.h"
+
+// Version store: images of changed rows for the snapshots that may still read them
+VersionStore *versions_open(void);
+void versions_close(VersionStore *store);
+void version_record(Database *db, int id, const struct Row *before);
+void versions_publish(Database *db);
+
+// Snapshots: begin takes no lock the writer waits for
+void snapshot_begin(Database *db, Snapshot *snapshot);
+void snapshot_end(Database *db, Snapshot *snapshot);
+int snapshot_version(Database *db, const Snapshot *snapshot, int id, struct Row *row);
+long versions_changed(Database *db, const Snapshot *snapshot, long position, int lo, int hi, int **ids,
+                      int *count, int *capacity);
+
+void versions_get_stats(Database *db, VersionStats *stats);
+
+#endif // MVCC_H
@@ -0,0 +1,19 @@
+#ifndef NAME_INDEX_H
+#define NAME_INDEX_H
+
+#include "coredb.h"
+
+// Name index maintenance (no-ops while db->name_root is 0, before the index is built)
+void name_index_init(Database *db, off_t offset);
+int name_index_insert(Database *db, const char *name, int id);
+void name_index_delete(Database *db, const char *name, int id);
+void name_index_free(Database *db);
+
+// Ordered scans over the ids of rows with a name, or with names starting with a prefix
+void name_index_seek(Database *db, const char *name, int prefix, NameCursor *cursor);
+int name_index_next(Database *db, NameCursor *cursor, int *id);
+
+// Check key order along the leaf chain and count the entries (returns 1 if valid)
+int name_index_verify(Database *db, long *keys);
+
+#endif // NAME_INDEX_H
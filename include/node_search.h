@@ -0,0 +1,16 @@
+#ifndef NODE_SEARCH_H
+#define NODE_SEARCH_H
+
+#include "coredb.h"
+
+// Search inside one B-tree node
+int node_child_index(const BTreeNode *node, int id);
+int node_leaf_index(const BTreeNode *node, int id);
+
+// Child search implementations over a sorted key array (count of keys <= id)
+int child_index_linear(const int *keys, int num_keys, int id);
+int child_index_binary(const int *keys, int num_keys, int id);
+int child_index_simd(const int *keys, int num_keys, int id);
+const char *node_search_simd_name(void);
+
+#endif // NODE_SEARCH_H
@@ -0,0 +1,12 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "coredb.h"
+
+// Network server: an epoll loop speaking the line protocol described in server.c
+Server *server_open(Database *db, const ServerOptions *options);
+int server_run(Server *server);
+void server_stop(Server *server);
+void server_close(Server *server);
+
+#endif // SERVER_H
@@ -4,8 +4,32 @@
 #include "coredb.h"
 
 // File I/O operations
-int read_page_from_file(Database *db, int page_num);
-int write_page_to_file(Database *db, int page_num);
-void flush_all_pages(Database *db);
+int write_page_runs(int fd, PageWrite *writes, int count, int *num_writes);
+
+// Data page chain (pages are read on demand through the buffer pool)
+int open_data_pages(Database *db);
+int append_data_page(Database *db);
+void *fetch_data_page(Database *db, off_t offset);
+const void *latch_data_page(Database *db, off_t offset, unsigned long version);
+off_t data_page_next(const void *page);
+void set_data_page_next(void *page, off_t next);
+
+// Slotted page layout
+void data_page_init(void *page);
+int data_page_slots(const void *page);
+int data_page_has_room(const void *page);
+int data_page_insert(void *page, const struct Row *row);
+int data_page_delete(void *page, int slot);
+int data_page_read(const void *page, int slot, struct Row *row);
+
+// Free-space map: data pages with room for another row
+void free_space_push(Database *db, off_t offset, void *page);
+void free_space_pop(Database *db, off_t offset, void *page);
+off_t free_space_find(Database *db);
+void free_space_rebuild(Database *db);
+
+// Row access by record ID
+int read_row(Database *db, off_t rid, struct Row *row);
+int write_row(Database *db, off_t rid, const struct Row *row);
 
 #endif // STORAGE_H
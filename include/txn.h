@@ -0,0 +1,15 @@
+#ifndef TXN_H
+#define TXN_H
+
+#include "coredb.h"
+
+// Explicit transactions: changes are buffered, then applied and made durable as one
+void txn_begin(Database *db, Transaction *txn);
+int txn_insert(Transaction *txn, int id, const char *name);
+int txn_update(Transaction *txn, int id, const char *name);
+int txn_delete(Transaction *txn, int id);
+int txn_select(Transaction *txn, int id, struct Row *row);
+int txn_commit(Transaction *txn);
+void txn_abort(Transaction *txn);
+
+#endif // TXN_H
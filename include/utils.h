@@ -7,4 +7,19 @@
 int is_valid_id(int id);
 void format_row_name(char *dest, const char *src, size_t max_len);
 
+// qsort comparators for ordering batches by id
+int compare_row_ids(const void *a, const void *b);
+int compare_entry_ids(const void *a, const void *b);
+int compare_name_keys(const void *a, const void *b);
+int compare_ints(const void *a, const void *b);
+
+// Checksum used to detect torn or corrupt records
+uint32_t checksum32(const void *data, size_t len);
+
+// CRC32C of pages and headers, on SSE4.2 when the CPU has it
+uint32_t crc32c(const void *data, size_t len);
+uint32_t crc32c_extend(uint32_t crc, const void *data, size_t len);
+uint32_t crc32c_software(uint32_t crc, const void *data, size_t len);
+int crc32c_hardware(void);
+
 #endif // UTILS_H
@@ -0,0 +1,21 @@
+#ifndef WAL_H
+#define WAL_H
+
+#include "coredb.h"
+
+// Write-ahead log lifecycle
+Wal *wal_open(const char *path, int truncate, int no_sync, uint64_t first_lsn);
+void wal_close(Wal *wal);
+
+// Logging and group commit
+uint64_t wal_append(Wal *wal, int type, int id, const char *name);
+int wal_commit(Wal *wal, uint64_t lsn);
+
+// Recovery and checkpoint support
+int wal_read_record(Wal *wal, off_t *position, WalRecord *record);
+int wal_reset(Wal *wal);
+
+// Statistics
+void wal_get_stats(Wal *wal, WalStats *stats);
+
+#endif // WAL_H
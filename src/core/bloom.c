@@ -0,0 +1,351 @@
+#include "../../include/coredb.h"
+#include <unistd.h>
+
+#define BLOOM_BLOCK_WORDS (BLOOM_BLOCK_BITS / 64)
+#define BLOOM_PAGE_BLOCKS (PAGE_SIZE * 8 / BLOOM_BLOCK_BITS)
+
+// Mix the bits of a 64-bit value (the splitmix64 finalizer)
+static uint64_t mix64(uint64_t h)
+{
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ull;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebull;
+    h ^= h >> 31;
+    return h;
+}
+
+// Ids the filter holds at BLOOM_BITS_PER_KEY bits each
+static long bloom_capacity(int pages)
+{
+    return (long)pages * PAGE_SIZE * 8 / BLOOM_BITS_PER_KEY;
+}
+
+// Block of an id: the high half of its hash scaled to the block count (no division)
+static long bloom_block(const BloomFilter *bloom, uint64_t hash)
+{
+    uint64_t blocks = (uint64_t)bloom->num_pages * BLOOM_PAGE_BLOCKS;
+    return (long)(((hash >> 32) * blocks) >> 32);
+}
+
+// Set the bits of an id in its block and mark that page for the next checkpoint (the bits
+// are set atomically: lookups test them at the same time)
+static void bloom_set(BloomFilter *bloom, int id)
+{
+    uint64_t hash = mix64((uint64_t)(uint32_t)id);
+    long block = bloom_block(bloom, hash);
+    uint64_t *words = bloom->bits + block * BLOOM_BLOCK_WORDS;
+    uint64_t probes = mix64(hash);
+    for (int k = 0; k < BLOOM_PROBES; k++)
+    {
+        int bit = (int)(probes >> (9 * k)) & (BLOOM_BLOCK_BITS - 1);
+        __atomic_fetch_or(&words[bit / 64], 1ull << (bit % 64), __ATOMIC_RELAXED);
+    }
+    long page = block / BLOOM_PAGE_BLOCKS;
+    if (!bloom->dirty[page])
+    {
+        bloom->dirty[page] = 1;
+        bloom->num_dirty++;
+    }
+}
+
+// Check the bits of an id in its block (0: certainly absent)
+static int bloom_test(const BloomFilter *bloom, int id)
+{
+    uint64_t hash = mix64((uint64_t)(uint32_t)id);
+    const uint64_t *words = bloom->bits + bloom_block(bloom, hash) * BLOOM_BLOCK_WORDS;
+    uint64_t probes = mix64(hash);
+    for (int k = 0; k < BLOOM_PROBES; k++)
+    {
+        int bit = (int)(probes >> (9 * k)) & (BLOOM_BLOCK_BITS - 1);
+        if (!(__atomic_load_n(&words[bit / 64], __ATOMIC_RELAXED) & (1ull << (bit % 64))))
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Allocate the in-memory copy of a filter of the given size into an empty BloomFilter
+// (returns 0 on failure)
+static int bloom_alloc(BloomFilter *bloom, int pages)
+{
+    uint64_t *bits = calloc((size_t)pages, PAGE_SIZE);
+    unsigned char *dirty = calloc((size_t)pages, 1);
+    if (bits == NULL || dirty == NULL)
+    {
+        printf("Error: Could not allocate memory for the Bloom filter\n");
+        free(bits);
+        free(dirty);
+        return 0;
+    }
+    bloom->bits = bits;
+    bloom->dirty = dirty;
+    bloom->num_pages = pages;
+    bloom->num_dirty = 0;
+    return 1;
+}
+
+// Hand an extent no header refers to over to the free list, writing its links directly
+// (the pages never pass through the buffer pool)
+static int release_extent(Database *db, off_t offset, int pages)
+{
+    unsigned char *links = calloc((size_t)pages, PAGE_SIZE);
+    if (links == NULL)
+    {
+        printf("Error: Could not allocate memory to free the old Bloom filter\n");
+        return 0;
+    }
+    for (int i = 0; i < pages; i++)
+    {
+        off_t next = i + 1 < pages ? offset + (off_t)(i + 1) * PAGE_SIZE : db->header.free_head;
+        memcpy(links + (size_t)i * PAGE_SIZE, &next, sizeof(off_t));
+        page_checksums_set(db->checksums, offset + (off_t)i * PAGE_SIZE, links + (size_t)i * PAGE_SIZE);
+    }
+    size_t size = (size_t)pages * PAGE_SIZE;
+    if (pwrite(fileno(db->file), links, size, offset) != (ssize_t)size)
+    {
+        printf("Error: Failed to free the old Bloom filter at offset %lld\n", (long long)offset);
+        free(links);
+        return 0;
+    }
+    if (db->use_mmap)
+    {
+        // Keep the private mapping in step with the file
+        memcpy(db->pool->map + offset, links, size);
+    }
+    free(links);
+    db->header.free_head = offset;
+    db->header.free_count += pages;
+    return 1;
+}
+
+// Read the filter the header points at, or build it when the file has none
+// (returns 1 on success)
+int bloom_open(Database *db)
+{
+    BloomFilter *bloom = &db->bloom;
+    memset(bloom, 0, sizeof(BloomFilter));
+    if (db->header.bloom_offset == 0)
+    {
+        return bloom_build(db);
+    }
+    if (!bloom_alloc(bloom, (int)db->header.bloom_pages))
+    {
+        return 0;
+    }
+    size_t size = (size_t)bloom->num_pages * PAGE_SIZE;
+    if (pread(fileno(db->file), bloom->bits, size, db->header.bloom_offset) != (ssize_t)size)
+    {
+        printf("Error: Could not read the Bloom filter\n");
+        return 0;
+    }
+    bloom->offset = db->header.bloom_offset;
+    bloom->keys = (long)db->header.bloom_keys;
+    for (int i = 0; i < bloom->num_pages; i++)
+    {
+        off_t offset = bloom->offset + (off_t)i * PAGE_SIZE;
+        if (!page_checksums_check(db->checksums, offset, (unsigned char *)bloom->bits + (size_t)i * PAGE_SIZE))
+        {
+            // The filter is derived from the index, so a damaged copy is simply rebuilt
+            printf("Warning: The Bloom filter fails its checksum, rebuilding it\n");
+            return bloom_build(db);
+        }
+    }
+    return 1;
+}
+
+// Size the filter for twice the ids and fill it from a scan of the primary index; a new
+// size moves it to a new extent at the end of the file. The new copy is filled aside and
+// swapped in, so lookups never see it half built (returns 1 on success).
+int bloom_build(Database *db)
+{
+    BloomFilter *bloom = &db->bloom;
+    // Ids indexed without a row (bench loads) are counted by the filter itself
+    long ids = (long)db->header.row_count > bloom->keys ? (long)db->header.row_count : bloom->keys;
+    long target = 2 * (ids + 1);
+    int pages = (int)((target * BLOOM_BITS_PER_KEY / 8 + PAGE_SIZE - 1) / PAGE_SIZE);
+    BloomFilter built;
+    memset(&built, 0, sizeof(BloomFilter));
+    if (!bloom_alloc(&built, pages))
+    {
+        return 0;
+    }
+
+    RangeCursor cursor;
+    int id;
+    off_t address;
+    select_range(db, 1, INT32_MAX, &cursor);
+    while (btree_next(db, &cursor, &id, &address))
+    {
+        bloom_set(&built, id);
+        built.keys++;
+    }
+
+    built.offset = bloom->offset;
+    if (bloom->bits == NULL || pages != bloom->num_pages)
+    {
+        off_t old_offset = bloom->offset;
+        int old_pages = bloom->num_pages;
+        built.offset = allocate_extent(db, pages);
+        if (built.offset == -1)
+        {
+            free(built.bits);
+            free(built.dirty);
+            return 0;
+        }
+        if (old_offset != 0 && old_offset == db->checkpointed_header.bloom_offset)
+        {
+            // The durable header still refers to the old extent until the next checkpoint
+            bloom->old_offset = old_offset;
+            bloom->old_pages = old_pages;
+        }
+        else if (old_offset != 0 && !release_extent(db, old_offset, old_pages))
+        {
+            free(built.bits);
+            free(built.dirty);
+            return 0;
+        }
+    }
+    // Every page is written at the next checkpoint, set bits or not
+    memset(built.dirty, 1, (size_t)pages);
+    built.num_dirty = pages;
+
+    pthread_rwlock_wrlock(&db->sync->bloom);
+    uint64_t *old_bits = bloom->bits;
+    unsigned char *old_dirty = bloom->dirty;
+    bloom->bits = built.bits;
+    bloom->dirty = built.dirty;
+    bloom->num_pages = built.num_pages;
+    bloom->num_dirty = built.num_dirty;
+    bloom->keys = built.keys;
+    bloom->offset = built.offset;
+    pthread_rwlock_unlock(&db->sync->bloom);
+    free(old_bits);
+    free(old_dirty);
+    return 1;
+}
+
+// Free the in-memory copy of the filter
+void bloom_close(Database *db)
+{
+    free(db->bloom.bits);
+    free(db->bloom.dirty);
+    memset(&db->bloom, 0, sizeof(BloomFilter));
+}
+
+// Whether an id may be in the primary index (0: certainly absent, so no descent is needed).
+// Replay runs against pages that may be older than the filter, so it always descends.
+int bloom_may_contain(Database *db, int id)
+{
+    BloomFilter *bloom = &db->bloom;
+    if (db->replaying)
+    {
+        return 1;
+    }
+    // A resize swaps the arrays under the write lock
+    pthread_rwlock_rdlock(&db->sync->bloom);
+    int may_contain = bloom->bits == NULL || bloom_test(bloom, id);
+    if (bloom->bits != NULL)
+    {
+        __atomic_add_fetch(&bloom->checks, 1, __ATOMIC_RELAXED);
+        if (!may_contain)
+        {
+            __atomic_add_fetch(&bloom->negatives, 1, __ATOMIC_RELAXED);
+        }
+    }
+    pthread_rwlock_unlock(&db->sync->bloom);
+    return may_contain;
+}
+
+// Count a lookup the filter let through for an id that was not there
+void bloom_false_positive(Database *db)
+{
+    if (db->bloom.bits != NULL && !db->replaying)
+    {
+        __atomic_add_fetch(&db->bloom.false_positives, 1, __ATOMIC_RELAXED);
+    }
+}
+
+// Add a new id, rebuilding the filter at twice the rows once it holds its capacity
+void bloom_add(Database *db, int id)
+{
+    BloomFilter *bloom = &db->bloom;
+    if (bloom->bits == NULL)
+    {
+        return;
+    }
+    if (bloom->keys >= bloom_capacity(bloom->num_pages))
+    {
+        // The id is already in the index, so the scan picks it up
+        if (!bloom_build(db))
+        {
+            printf("Error: Could not resize the Bloom filter\n");
+            exit(1);
+        }
+        return;
+    }
+    bloom_set(bloom, id);
+    bloom->keys++;
+}
+
+// List the filter pages changed since the last checkpoint (returns the number listed)
+int bloom_collect_dirty(Database *db, PageWrite *writes, int max_writes)
+{
+    BloomFilter *bloom = &db->bloom;
+    int count = 0;
+    for (int page = 0; page < bloom->num_pages && count < max_writes; page++)
+    {
+        if (bloom->dirty[page])
+        {
+            writes[count].offset = bloom->offset + (off_t)page * PAGE_SIZE;
+            writes[count].data = (const unsigned char *)bloom->bits + (size_t)page * PAGE_SIZE;
+            count++;
+        }
+    }
+    db->header.bloom_offset = bloom->offset;
+    db->header.bloom_pages = bloom->num_pages;
+    db->header.bloom_keys = bloom->keys;
+    return count;
+}
+
+// Mark every filter page clean after the checkpoint wrote them
+void bloom_mark_clean(Database *db)
+{
+    if (db->bloom.dirty != NULL)
+    {
+        memset(db->bloom.dirty, 0, (size_t)db->bloom.num_pages);
+    }
+    db->bloom.num_dirty = 0;
+}
+
+// Free the extent of the filter before its last resize, once the durable header has moved
+// to the new one (returns 1 if the header changed and must be written again)
+int bloom_release_old(Database *db)
+{
+    BloomFilter *bloom = &db->bloom;
+    if (bloom->old_offset == 0)
+    {
+        return 0;
+    }
+    // A crash before the next header write only leaks these pages
+    if (!release_extent(db, bloom->old_offset, bloom->old_pages))
+    {
+        exit(1);
+    }
+    bloom->old_offset = 0;
+    bloom->old_pages = 0;
+    return 1;
+}
+
+// Snapshot the filter size and counters
+void bloom_get_stats(Database *db, BloomStats *stats)
+{
+    const BloomFilter *bloom = &db->bloom;
+    stats->pages = bloom->num_pages;
+    stats->keys = bloom->keys;
+    stats->capacity = bloom_capacity(bloom->num_pages);
+    stats->checks = bloom->checks;
+    stats->negatives = bloom->negatives;
+    stats->false_positives = bloom->false_positives;
+}
@@ -1,325 +1,1157 @@
 #include "../../include/coredb.h"
 
-// Read a B-Tree node from disk
+// Read a B-Tree node through the buffer pool
 void read_node(Database *db, off_t offset, BTreeNode *node)
 {
-    unsigned char buffer[PAGE_SIZE];
-    fseek(db->file, offset, SEEK_SET);
-    size_t bytes_read = fread(buffer, 1, PAGE_SIZE, db->file);
-    if (bytes_read != PAGE_SIZE)
+    void *page = buffer_pool_fetch(db->pool, offset);
+    if (page == NULL)
     {
         printf("Error: Failed to read node at offset %lld\n", (long long)offset);
         exit(1);
     }
-    memcpy(node, buffer, sizeof(BTreeNode));
+    memcpy(node, page, sizeof(BTreeNode));
+    buffer_pool_unpin(db->pool, offset, 0);
 }
 
-// Write a B-Tree node to disk
+// Write a B-Tree node into the buffer pool (flushed to disk by write_buffer)
 void write_node(Database *db, off_t offset, BTreeNode *node)
 {
-    unsigned char buffer[PAGE_SIZE];
-    memset(buffer, 0, PAGE_SIZE);
-    memcpy(buffer, node, sizeof(BTreeNode));
-
-    fseek(db->file, offset, SEEK_SET);
-    size_t bytes_written = fwrite(buffer, 1, PAGE_SIZE, db->file);
-    if (bytes_written != PAGE_SIZE)
+    void *page = buffer_pool_fetch_new(db->pool, offset);
+    if (page == NULL)
     {
         printf("Error: Failed to write node at offset %lld\n", (long long)offset);
         exit(1);
     }
-    fflush(db->file);
+    memset(page, 0, PAGE_SIZE);
+    memcpy(page, node, sizeof(BTreeNode));
+    buffer_pool_unpin(db->pool, offset, 1);
 }
 
-// Allocate a new node (find a free page in the index section)
+// Allocate a new node from the page allocator (free list first, then the end of the file)
 off_t allocate_node(Database *db)
 {
-    // Simple sequential allocation in the index section
-    // We'll use a simple approach: allocate nodes sequentially
-    // starting after the header and root pages
-    static off_t next_offset = PAGE_SIZE * 2; // header(0) + root(PAGE_SIZE)
-    
-    // Check if we have space in the index section
-    if (next_offset >= DATA_START_OFFSET)
+    off_t new_offset = allocate_page(db);
+    if (new_offset == -1)
     {
-        printf("Error: Index section full (tried to allocate at offset %lld, max is %lld)\n", 
-               (long long)next_offset, (long long)DATA_START_OFFSET);
+        printf("Error: Could not allocate an index page\n");
         return -1; // Indicate failure
     }
-    
-    off_t new_offset = next_offset;
-    next_offset += PAGE_SIZE;
-    
+
     // Initialize the new node with zeros
     BTreeNode new_node = {0};
     write_node(db, new_offset, &new_node);
-    
+
     return new_offset;
 }
 
-// Search the B-Tree for an ID, return its address
+// Return the page of a node that is no longer referenced (e.g. emptied by a merge)
+void free_node(Database *db, off_t offset)
+{
+    free_page(db, offset);
+}
+
+// Keys a node of this kind holds when full
+int node_max_keys(const BTreeNode *node)
+{
+    if (node->is_leaf == NODE_ROW_LEAF)
+    {
+        return CLUSTERED_LEAF_ROWS;
+    }
+    return node->is_leaf ? LEAF_MAX_KEYS : INTERNAL_MAX_KEYS;
+}
+
+// Entries in the subtree under a node: its own keys for a leaf, its child counts above
+static long node_entries(const BTreeNode *node)
+{
+    if (node->is_leaf)
+    {
+        return node->num_keys;
+    }
+    long entries = 0;
+    for (int c = 0; c <= node->num_keys; c++)
+    {
+        entries += node->data.internal.counts[c];
+    }
+    return entries;
+}
+
+// Record ID of a leaf entry
+off_t leaf_rid(const BTreeNode *node, int i)
+{
+    return RID(PAGE_OFFSET(node->data.leaf.pages[i]), node->data.leaf.slots[i]);
+}
+
+// Store an id and its record ID in a leaf entry
+void leaf_set_entry(BTreeNode *node, int i, int id, off_t rid)
+{
+    node->data.leaf.ids[i] = id;
+    node->data.leaf.pages[i] = PAGE_NUMBER(rid);
+    node->data.leaf.slots[i] = (uint16_t)RID_SLOT(rid);
+}
+
+// Address of a leaf entry: its record ID, or for a row leaf at offset the entry itself
+// (valid until the leaf next changes)
+static off_t entry_address(const BTreeNode *node, off_t offset, int i)
+{
+    return node->is_leaf == NODE_ROW_LEAF ? RID(offset, i) : leaf_rid(node, i);
+}
+
+// Store a new leaf entry: the record ID for index leaves, the name for row leaves
+static void leaf_put(BTreeNode *node, int i, int id, off_t address, const char *name)
+{
+    if (node->is_leaf == NODE_ROW_LEAF)
+    {
+        node->data.rows.ids[i] = id;
+        strncpy(node->data.rows.names[i], name, 59);
+        node->data.rows.names[i][59] = '\0';
+        return;
+    }
+    leaf_set_entry(node, i, id, address);
+}
+
+// Move count leaf entries between (or within) leaves; the ranges may overlap
+static void move_leaf_entries(BTreeNode *to, int to_i, const BTreeNode *from, int from_i, int count)
+{
+    if (from->is_leaf == NODE_ROW_LEAF)
+    {
+        memmove(&to->data.rows.ids[to_i], &from->data.rows.ids[from_i], count * sizeof(int32_t));
+        memmove(to->data.rows.names[to_i], from->data.rows.names[from_i], count * sizeof(from->data.rows.names[0]));
+        return;
+    }
+    memmove(&to->data.leaf.ids[to_i], &from->data.leaf.ids[from_i], count * sizeof(int32_t));
+    memmove(&to->data.leaf.pages[to_i], &from->data.leaf.pages[from_i], count * sizeof(uint32_t));
+    memmove(&to->data.leaf.slots[to_i], &from->data.leaf.slots[from_i], count * sizeof(uint16_t));
+}
+
+// Latch a node for a lookup or scan that started at version (see read_begin); NULL, with
+// nothing latched, once a restructure has begun and the reader has to start over
+static const BTreeNode *latch_node(Database *db, off_t offset, unsigned long version)
+{
+    const BTreeNode *node = buffer_pool_latch(db->pool, offset);
+    if (!read_valid(db, version))
+    {
+        if (node != NULL)
+        {
+            buffer_pool_unlatch(db->pool, offset);
+        }
+        return NULL;
+    }
+    if (node == NULL)
+    {
+        printf("Error: Failed to read node at offset %lld\n", (long long)offset);
+        exit(1);
+    }
+    return node;
+}
+
+// Descend to the leaf that holds id for a reader and return it latched, with the version
+// it is valid at. Only one node is latched at a time; a descent that meets a restructure
+// starts over from the root. *fence (if not NULL) is set as by find_leaf.
+static const BTreeNode *latch_leaf(Database *db, int id, unsigned long *version, off_t *leaf_offset,
+                                   int *fence)
+{
+    while (1)
+    {
+        *version = read_begin(db);
+        off_t current_offset = __atomic_load_n(&db->root_offset, __ATOMIC_ACQUIRE);
+        int upper = INT32_MAX;
+        const BTreeNode *node;
+        while ((node = latch_node(db, current_offset, *version)) != NULL && !node->is_leaf)
+        {
+            int i = node_child_index(node, id);
+            if (i < node->num_keys)
+            {
+                upper = node->data.internal.keys[i];
+            }
+            off_t child_offset = PAGE_OFFSET(node->data.internal.children[i]);
+            buffer_pool_unlatch(db->pool, current_offset);
+            current_offset = child_offset;
+        }
+        if (node != NULL)
+        {
+            *leaf_offset = current_offset;
+            if (fence != NULL)
+            {
+                *fence = upper;
+            }
+            return node;
+        }
+    }
+}
+
+// Descend to the entry of an id and return its address (-1 if absent)
+static void search_index(Database *db, int id, off_t *address)
+{
+    if (db->hashed)
+    {
+        hash_index_search(db, id, address);
+        return;
+    }
+    // Inspect the leaf in place while it is latched instead of copying it out
+    unsigned long version;
+    off_t leaf_offset;
+    const BTreeNode *leaf = latch_leaf(db, id, &version, &leaf_offset, NULL);
+    int i = node_leaf_index(leaf, id);
+    *address = -1; // Not found
+    if (i < leaf->num_keys && leaf->data.leaf.ids[i] == id)
+    {
+        *address = entry_address(leaf, leaf_offset, i);
+    }
+    buffer_pool_unlatch(db->pool, leaf_offset);
+}
+
+// Search the B-Tree for an ID, return its address; ids the Bloom filter rules out are
+// answered without a descent
 void btree_search(Database *db, int id, off_t *address)
 {
-    BTreeNode node;
+    if (!bloom_may_contain(db, id))
+    {
+        *address = -1;
+        return;
+    }
+    search_index(db, id, address);
+    if (*address == -1)
+    {
+        bloom_false_positive(db);
+    }
+}
+
+// Look up the row of an id in a clustered table, copying it out while its leaf is latched
+// so inserts that shift the leaf cannot move it away (returns 0 if absent)
+int btree_search_row(Database *db, int id, struct Row *row)
+{
+    if (!bloom_may_contain(db, id))
+    {
+        return 0;
+    }
+    unsigned long version;
+    off_t leaf_offset;
+    const BTreeNode *leaf = latch_leaf(db, id, &version, &leaf_offset, NULL);
+    int i = node_leaf_index(leaf, id);
+    int found = i < leaf->num_keys && leaf->data.rows.ids[i] == id;
+    if (found)
+    {
+        row->id = id;
+        memcpy(row->name, leaf->data.rows.names[i], sizeof(row->name));
+    }
+    buffer_pool_unlatch(db->pool, leaf_offset);
+    if (!found)
+    {
+        bloom_false_positive(db);
+    }
+    return found;
+}
+
+// Point an existing key at a new row address (returns 1 if the key was found)
+int btree_update(Database *db, int id, off_t address)
+{
+    if (db->hashed)
+    {
+        return hash_index_update(db, id, address);
+    }
     off_t current_offset = db->root_offset;
 
     while (1)
     {
-        read_node(db, current_offset, &node);
-        if (node.is_leaf)
+        BTreeNode *node = buffer_pool_fetch(db->pool, current_offset);
+        if (node == NULL)
+        {
+            printf("Error: Failed to read node at offset %lld\n", (long long)current_offset);
+            exit(1);
+        }
+        off_t node_offset = current_offset;
+        if (node->is_leaf)
         {
-            // Search in leaf node
-            for (int i = 0; i < node.num_keys; i++)
+            int i = node_leaf_index(node, id);
+            if (i < node->num_keys && node->data.leaf.ids[i] == id)
             {
-                if (node.data.leaf.entries[i].id == id)
-                {
-                    *address = node.data.leaf.entries[i].address;
-                    return;
-                }
+                leaf_set_entry(node, i, id, address);
+                buffer_pool_unpin(db->pool, node_offset, 1);
+                return 1;
             }
-            *address = -1; // Not found
-            return;
+            buffer_pool_unpin(db->pool, node_offset, 0);
+            return 0;
         }
-        else
+
+        current_offset = PAGE_OFFSET(node->data.internal.children[node_child_index(node, id)]);
+        buffer_pool_unpin(db->pool, node_offset, 0);
+    }
+}
+
+// Descend to the leaf that holds id for the writer; *fence receives the smallest separator
+// above it, so every id below the fence (and not below id) lives in the same leaf
+static off_t find_leaf(Database *db, int id, int *fence)
+{
+    off_t current_offset = db->root_offset;
+    *fence = INT32_MAX;
+
+    while (1)
+    {
+        const BTreeNode *node = buffer_pool_fetch(db->pool, current_offset);
+        if (node == NULL)
+        {
+            printf("Error: Failed to read node at offset %lld\n", (long long)current_offset);
+            exit(1);
+        }
+        off_t node_offset = current_offset;
+        int is_leaf = node->is_leaf;
+        if (!is_leaf)
+        {
+            int i = node_child_index(node, id);
+            if (i < node->num_keys)
+            {
+                *fence = node->data.internal.keys[i];
+            }
+            current_offset = PAGE_OFFSET(node->data.internal.children[i]);
+        }
+        buffer_pool_unpin(db->pool, node_offset, 0);
+        if (is_leaf)
+        {
+            return node_offset;
+        }
+    }
+}
+
+// Look up sorted ids, sharing one descent among the ids that fall in the same leaf
+// (addresses[i] is -1 for ids that are not in the tree)
+void btree_search_batch(Database *db, const int *ids, int count, off_t *addresses)
+{
+    if (db->hashed)
+    {
+        // Sorted ids are scattered over the buckets: nothing to share
+        for (int k = 0; k < count; k++)
         {
-            // Search in internal node
-            int i;
-            for (i = 0; i < node.num_keys; i++)
+            btree_search(db, ids[k], &addresses[k]);
+        }
+        return;
+    }
+    // Ids the Bloom filter rules out are -1 already; the rest are marked 0 (the header
+    // page, never an address) until their leaf is searched
+    for (int k = 0; k < count; k++)
+    {
+        addresses[k] = bloom_may_contain(db, ids[k]) ? 0 : -1;
+    }
+    int k = 0;
+    while (k < count)
+    {
+        if (addresses[k] == -1)
+        {
+            k++;
+            continue;
+        }
+        int fence;
+        unsigned long version;
+        off_t leaf_offset;
+        const BTreeNode *leaf = latch_leaf(db, ids[k], &version, &leaf_offset, &fence);
+        do
+        {
+            if (addresses[k] == 0)
             {
-                if (id < node.data.internal.keys[i])
+                int i = node_leaf_index(leaf, ids[k]);
+                addresses[k] = -1;
+                if (i < leaf->num_keys && leaf->data.leaf.ids[i] == ids[k])
+                {
+                    addresses[k] = entry_address(leaf, leaf_offset, i);
+                }
+                else
                 {
-                    break;
+                    bloom_false_positive(db);
                 }
             }
-            current_offset = node.data.internal.children[i];
-        }
+            k++;
+        } while (k < count && ids[k] < fence);
+        buffer_pool_unlatch(db->pool, leaf_offset);
     }
 }
 
-// Insert into the B-Tree
-void btree_insert(Database *db, int id, off_t address)
+// Count the leading sorted ids that fit into the leaf of ids[0] without a split
+// (0 when that leaf is full and the next insert has to split it)
+int btree_leaf_run(Database *db, const int *ids, int count)
 {
-    BTreeNode root;
-    read_node(db, db->root_offset, &root);
+    if (db->hashed)
+    {
+        return 0; // consecutive ids land in different buckets: insert them one by one
+    }
+    int fence;
+    off_t leaf_offset = find_leaf(db, ids[0], &fence);
+    const BTreeNode *leaf = buffer_pool_fetch(db->pool, leaf_offset);
+    if (leaf == NULL)
+    {
+        printf("Error: Failed to read node at offset %lld\n", (long long)leaf_offset);
+        exit(1);
+    }
+    int room = node_max_keys(leaf) - leaf->num_keys;
+    buffer_pool_unpin(db->pool, leaf_offset, 0);
 
-    // If root is full, split it and create a new root
-    if (root.num_keys >= MAX_KEYS)
+    int run = 0;
+    while (run < count && run < room && ids[run] < fence)
     {
-        off_t old_root_offset = db->root_offset;
-        off_t new_root_offset = allocate_node(db);
-        off_t right_offset = allocate_node(db);
+        run++;
+    }
+    return run;
+}
 
-        // Check if we have space for new nodes
-        if (new_root_offset == -1 || right_offset == -1)
+// Add delta to the count of every subtree on the path from the root to the leaf of id
+static void count_path(Database *db, int id, int delta)
+{
+    off_t current_offset = db->root_offset;
+    while (1)
+    {
+        BTreeNode *node = buffer_pool_fetch(db->pool, current_offset);
+        if (node == NULL)
+        {
+            printf("Error: Failed to read node at offset %lld\n", (long long)current_offset);
+            exit(1);
+        }
+        off_t node_offset = current_offset;
+        if (node->is_leaf)
         {
-            printf("Error: Cannot split B-tree root - index section full\n");
-            return; // Exit early if we can't allocate new nodes
+            buffer_pool_unpin(db->pool, node_offset, 0);
+            return;
         }
+        int i = node_child_index(node, id);
+        node->data.internal.counts[i] += delta;
+        current_offset = PAGE_OFFSET(node->data.internal.children[i]);
+        buffer_pool_unpin(db->pool, node_offset, 1);
+    }
+}
 
-        BTreeNode new_root = (BTreeNode){0};
-        BTreeNode right = (BTreeNode){0};
-        new_root.is_leaf = 0;
-        right.is_leaf = root.is_leaf;
-        new_root.num_keys = 0;
-        right.num_keys = 0;
+// Insert a sorted run of new entries measured by btree_leaf_run, with one descent; row
+// leaves take the names from rows, which match the entries one for one
+void btree_insert_run(Database *db, const IndexEntry *entries, const struct Row *rows, int count)
+{
+    int fence;
+    off_t leaf_offset = find_leaf(db, entries[0].id, &fence);
+    BTreeNode *leaf = buffer_pool_fetch(db->pool, leaf_offset);
+    if (leaf == NULL)
+    {
+        printf("Error: Failed to read node at offset %lld\n", (long long)leaf_offset);
+        exit(1);
+    }
+    if (leaf->num_keys + count > node_max_keys(leaf))
+    {
+        printf("Error: Leaf overflow before insert (keys=%d)\n", leaf->num_keys);
+        exit(1);
+    }
 
-        // Split the old root
-        int mid = MAX_KEYS / 2;
-        int mid_key = root.is_leaf ? root.data.leaf.entries[mid].id : root.data.internal.keys[mid];
+    // Merge from the back so every existing entry moves at most once
+    int i = leaf->num_keys - 1;
+    int j = count - 1;
+    for (int out = leaf->num_keys + count - 1; j >= 0; out--)
+    {
+        if (i >= 0 && leaf->data.leaf.ids[i] > entries[j].id)
+        {
+            move_leaf_entries(leaf, out, leaf, i--, 1);
+        }
+        else
+        {
+            leaf_put(leaf, out, entries[j].id, entries[j].address, rows[j].name);
+            j--;
+        }
+    }
+    leaf->num_keys += count;
+    buffer_pool_unpin(db->pool, leaf_offset, 1);
+    count_path(db, entries[0].id, count);
+    for (int k = 0; k < count; k++)
+    {
+        bloom_add(db, entries[k].id);
+    }
+}
+
+// Position a cursor on the first entry with an id >= id (one descent from the root)
+void btree_seek(Database *db, int id, RangeCursor *cursor)
+{
+    if (db->hashed)
+    {
+        hash_index_seek(db, id, cursor);
+        return;
+    }
+    const BTreeNode *leaf = latch_leaf(db, id, &cursor->version, &cursor->leaf, NULL);
+    cursor->index = node_leaf_index(leaf, id);
+    cursor->next = id;
+    buffer_pool_unlatch(db->pool, cursor->leaf);
+}
 
-        // Move second half to right node
-        for (int i = mid + (root.is_leaf ? 0 : 1); i < root.num_keys; i++)
+// Latch the leaf under a cursor and return the index of its next entry there. The writer
+// shifts entries within leaves in place, so the index is checked against the next id, and
+// a leaf that was split, merged or freed since is found again by a descent to that id.
+static const BTreeNode *latch_cursor(Database *db, RangeCursor *cursor, int *index)
+{
+    const BTreeNode *node = latch_node(db, cursor->leaf, cursor->version);
+    if (node == NULL)
+    {
+        node = latch_leaf(db, cursor->next, &cursor->version, &cursor->leaf, NULL);
+    }
+    int i = cursor->index;
+    if (i > node->num_keys || (i < node->num_keys && node->data.leaf.ids[i] < cursor->next) ||
+        (i > 0 && i <= node->num_keys && node->data.leaf.ids[i - 1] >= cursor->next))
+    {
+        i = node_leaf_index(node, cursor->next);
+    }
+    *index = i;
+    return node;
+}
+
+// Return the entry under the cursor and advance it along the leaf chain
+// (returns 0 once the chain ends or the next id is past cursor->hi)
+int btree_next(Database *db, RangeCursor *cursor, int *id, off_t *address)
+{
+    if (db->hashed)
+    {
+        return hash_index_next(db, cursor, id, address);
+    }
+    while (cursor->leaf != 0)
+    {
+        int index;
+        const BTreeNode *node = latch_cursor(db, cursor, &index);
+        off_t node_offset = cursor->leaf;
+        if (index < node->num_keys)
         {
-            if (root.is_leaf)
+            int in_range = node->data.leaf.ids[index] <= cursor->hi;
+            if (in_range)
             {
-                right.data.leaf.entries[right.num_keys] = root.data.leaf.entries[i];
+                *id = node->data.leaf.ids[index];
+                *address = entry_address(node, node_offset, index);
+                cursor->index = index + 1;
+                cursor->next = *id + (*id < INT32_MAX);
+                if (*id == INT32_MAX)
+                {
+                    cursor->leaf = 0; // no id can follow
+                }
             }
             else
             {
-                right.data.internal.keys[right.num_keys] = root.data.internal.keys[i];
-                right.data.internal.children[right.num_keys] = root.data.internal.children[i];
+                cursor->leaf = 0;
             }
-            right.num_keys++;
-        }
-        if (!root.is_leaf)
-        {
-            right.data.internal.children[right.num_keys] = root.data.internal.children[root.num_keys];
+            buffer_pool_unlatch(db->pool, node_offset);
+            return in_range;
         }
-        root.num_keys = mid;
 
-        // Update new root
-        new_root.data.internal.keys[0] = mid_key;
-        new_root.data.internal.children[0] = old_root_offset;
-        new_root.data.internal.children[1] = right_offset;
-        new_root.num_keys = 1;
+        // Leaf exhausted (or emptied by deletes): continue with its right sibling
+        cursor->leaf = PAGE_OFFSET(node->next);
+        cursor->index = 0;
+        buffer_pool_unlatch(db->pool, node_offset);
+    }
+    return 0;
+}
 
-        // Write nodes
-        write_node(db, old_root_offset, &root);
-        write_node(db, right_offset, &right);
-        write_node(db, new_root_offset, &new_root);
-        db->root_offset = new_root_offset;
+// Number of entries in the index (the root's subtree)
+long btree_count(Database *db)
+{
+    if (db->hashed)
+    {
+        return (long)db->header.row_count;
+    }
+    while (1)
+    {
+        unsigned long version = read_begin(db);
+        off_t root_offset = __atomic_load_n(&db->root_offset, __ATOMIC_ACQUIRE);
+        const BTreeNode *root = latch_node(db, root_offset, version);
+        if (root != NULL)
+        {
+            long entries = node_entries(root);
+            buffer_pool_unlatch(db->pool, root_offset);
+            return entries;
+        }
     }
+}
 
-    // Now insert into the appropriate node
-    off_t current_offset = db->root_offset;
+// Number of entries with an id below id, from one descent that adds up the counts of the
+// subtrees left of the path
+long btree_rank(Database *db, int id)
+{
     while (1)
     {
-        read_node(db, current_offset, &root);
-        if (root.is_leaf)
+        long rank = 0;
+        unsigned long version = read_begin(db);
+        off_t current_offset = __atomic_load_n(&db->root_offset, __ATOMIC_ACQUIRE);
+        const BTreeNode *node;
+        while ((node = latch_node(db, current_offset, version)) != NULL)
         {
-            // Insert into leaf
-            if (root.num_keys >= MAX_KEYS)
+            off_t node_offset = current_offset;
+            if (node->is_leaf)
             {
-                printf("Error: Leaf overflow before insert (keys=%d)\n", root.num_keys);
-                exit(1);
+                rank += node_leaf_index(node, id);
+                buffer_pool_unlatch(db->pool, node_offset);
+                return rank;
             }
-            int i;
-            for (i = root.num_keys; i > 0 && root.data.leaf.entries[i - 1].id > id; i--)
+            int i = node_child_index(node, id);
+            for (int c = 0; c < i; c++)
             {
-                root.data.leaf.entries[i] = root.data.leaf.entries[i - 1];
+                rank += node->data.internal.counts[c];
             }
-            root.data.leaf.entries[i].id = id;
-            root.data.leaf.entries[i].address = address;
-            root.num_keys++;
-            write_node(db, current_offset, &root);
-            break;
+            current_offset = PAGE_OFFSET(node->data.internal.children[i]);
+            buffer_pool_unlatch(db->pool, node_offset);
         }
-        else
+        // A restructure moved entries under the descent: count again
+    }
+}
+
+// Position a cursor on the entry of a rank (0 for the smallest id) with one descent that
+// skips whole subtrees by their counts; past the last entry the cursor is done
+void btree_seek_rank(Database *db, long rank, RangeCursor *cursor)
+{
+    while (1)
+    {
+        long left = rank;
+        cursor->version = read_begin(db);
+        off_t current_offset = __atomic_load_n(&db->root_offset, __ATOMIC_ACQUIRE);
+        const BTreeNode *node;
+        while ((node = latch_node(db, current_offset, cursor->version)) != NULL)
         {
-            // Find the child to descend into
-            int i;
-            for (i = 0; i < root.num_keys; i++)
+            off_t node_offset = current_offset;
+            if (node->is_leaf)
             {
-                if (id < root.data.internal.keys[i])
+                cursor->leaf = left < node->num_keys ? node_offset : 0;
+                cursor->index = (int)left;
+                if (cursor->leaf != 0)
                 {
-                    break;
+                    cursor->next = node->data.leaf.ids[left];
                 }
+                buffer_pool_unlatch(db->pool, node_offset);
+                return;
             }
-
-            // Before descending, check if the target child (leaf) is full; if so, split it
-            off_t child_offset = root.data.internal.children[i];
-            BTreeNode child;
-            read_node(db, child_offset, &child);
-            if (child.is_leaf && child.num_keys >= MAX_KEYS)
+            int c = 0;
+            while (c < node->num_keys && left >= node->data.internal.counts[c])
             {
-                // Split leaf child
-                int mid = child.num_keys / 2;
-                int pivot = child.data.leaf.entries[mid].id;
+                left -= node->data.internal.counts[c];
+                c++;
+            }
+            current_offset = PAGE_OFFSET(node->data.internal.children[c]);
+            buffer_pool_unlatch(db->pool, node_offset);
+        }
+        // A restructure moved entries under the descent: skip the subtrees again
+    }
+}
 
-                off_t right_offset = allocate_node(db);
-                if (right_offset == -1)
-                {
-                    printf("Error: Cannot split leaf - index section full\n");
-                    return;
-                }
-                BTreeNode right = (BTreeNode){0};
-                right.is_leaf = 1;
+// Split the full child i of a node that has room, moving the upper half of the child into
+// a new right sibling and its separator into the parent (returns 0 if no page is left)
+static int split_child(Database *db, off_t parent_offset, BTreeNode *parent, int i)
+{
+    BTreeNode child;
+    off_t child_offset = PAGE_OFFSET(parent->data.internal.children[i]);
+    read_node(db, child_offset, &child);
+    off_t right_offset = allocate_node(db);
+    if (right_offset == -1)
+    {
+        printf("Error: Cannot split B-tree node - no page for a new node\n");
+        return 0;
+    }
+    begin_restructure(db);
+    BTreeNode right = (BTreeNode){0};
+    right.is_leaf = child.is_leaf;
 
-                // Move second half to right leaf
-                int k = 0;
-                for (int j = mid; j < child.num_keys; j++)
-                {
-                    right.data.leaf.entries[k++] = child.data.leaf.entries[j];
-                }
-                right.num_keys = k;
-                child.num_keys = mid;
+    int mid = child.num_keys / 2;
+    int pivot;
+    long right_entries;
+    if (child.is_leaf)
+    {
+        // Leaves keep every key: the right half starts at the pivot
+        pivot = child.data.leaf.ids[mid];
+        right.num_keys = child.num_keys - mid;
+        move_leaf_entries(&right, 0, &child, mid, right.num_keys);
+        right.next = child.next;
+        child.next = PAGE_NUMBER(right_offset);
+        right_entries = right.num_keys;
+    }
+    else
+    {
+        // Internal nodes hand the middle key up to the parent
+        pivot = child.data.internal.keys[mid];
+        right.num_keys = child.num_keys - mid - 1;
+        memcpy(right.data.internal.keys, &child.data.internal.keys[mid + 1],
+               right.num_keys * sizeof(int32_t));
+        memcpy(right.data.internal.children, &child.data.internal.children[mid + 1],
+               (right.num_keys + 1) * sizeof(uint32_t));
+        memcpy(right.data.internal.counts, &child.data.internal.counts[mid + 1],
+               (right.num_keys + 1) * sizeof(uint32_t));
+        right_entries = node_entries(&right);
+    }
+    child.num_keys = mid;
 
-                // Insert pivot and new right child into parent at position i
-                for (int j = root.num_keys; j > i; j--)
-                {
-                    root.data.internal.keys[j] = root.data.internal.keys[j - 1];
-                    root.data.internal.children[j + 1] = root.data.internal.children[j];
-                }
-                root.data.internal.keys[i] = pivot;
-                root.data.internal.children[i + 1] = right_offset;
-                root.num_keys++;
+    memmove(&parent->data.internal.keys[i + 1], &parent->data.internal.keys[i],
+            (parent->num_keys - i) * sizeof(int32_t));
+    memmove(&parent->data.internal.children[i + 2], &parent->data.internal.children[i + 1],
+            (parent->num_keys - i) * sizeof(uint32_t));
+    memmove(&parent->data.internal.counts[i + 2], &parent->data.internal.counts[i + 1],
+            (parent->num_keys - i) * sizeof(uint32_t));
+    parent->data.internal.keys[i] = pivot;
+    parent->data.internal.children[i + 1] = PAGE_NUMBER(right_offset);
+    parent->data.internal.counts[i] -= (uint32_t)right_entries;
+    parent->data.internal.counts[i + 1] = (uint32_t)right_entries;
+    parent->num_keys++;
 
-                // Persist nodes
-                write_node(db, child_offset, &child);
-                write_node(db, right_offset, &right);
-                write_node(db, current_offset, &root);
+    write_node(db, child_offset, &child);
+    write_node(db, right_offset, &right);
+    write_node(db, parent_offset, parent);
+    end_restructure(db);
+    return 1;
+}
 
-                // Decide which side to descend
-                if (id < pivot)
-                {
-                    current_offset = child_offset;
-                }
-                else
-                {
-                    current_offset = right_offset;
-                }
-                continue;
+// Insert into the B-Tree. Full nodes are split on the way down (the root first, by giving
+// it a new parent), so the parent of every split has room for the separator at any depth.
+// The subtree counts on the path grow only once the entry is in its leaf, so a split that
+// runs out of pages leaves a valid tree behind (returns 0 then).
+static int insert_entry(Database *db, int id, off_t address, const char *name)
+{
+    BTreeNode node;
+    read_node(db, db->root_offset, &node);
+    if (node.num_keys >= node_max_keys(&node))
+    {
+        off_t new_root_offset = allocate_node(db);
+        if (new_root_offset == -1)
+        {
+            printf("Error: Cannot split B-tree root - no page for a new node\n");
+            return 0;
+        }
+        BTreeNode new_root = (BTreeNode){0};
+        new_root.data.internal.children[0] = PAGE_NUMBER(db->root_offset);
+        new_root.data.internal.counts[0] = (uint32_t)node_entries(&node);
+        begin_restructure(db);
+        if (!split_child(db, new_root_offset, &new_root, 0))
+        {
+            free_node(db, new_root_offset);
+            end_restructure(db);
+            return 0;
+        }
+        __atomic_store_n(&db->root_offset, new_root_offset, __ATOMIC_RELEASE);
+        end_restructure(db);
+        node = new_root;
+    }
+
+    off_t path[BTREE_MAX_HEIGHT];
+    int path_index[BTREE_MAX_HEIGHT];
+    int depth = 0;
+    off_t current_offset = db->root_offset;
+    while (!node.is_leaf)
+    {
+        int i = node_child_index(&node, id);
+        off_t child_offset = PAGE_OFFSET(node.data.internal.children[i]);
+        BTreeNode child;
+        read_node(db, child_offset, &child);
+        if (child.num_keys >= node_max_keys(&child))
+        {
+            if (!split_child(db, current_offset, &node, i))
+            {
+                return 0;
+            }
+            // Descend on the side of the new separator that holds id
+            if (id >= node.data.internal.keys[i])
+            {
+                i++;
+                child_offset = PAGE_OFFSET(node.data.internal.children[i]);
             }
+            read_node(db, child_offset, &child);
+        }
+        // The new entry lands below child i
+        path[depth] = current_offset;
+        path_index[depth++] = i;
+        current_offset = child_offset;
+        node = child;
+    }
 
-            // Descend as usual
-            current_offset = child_offset;
-            // Check if child needs splitting (simplified, recurse if needed)
+    // Open a gap at the insert position with one block move
+    int i = node_leaf_index(&node, id);
+    move_leaf_entries(&node, i + 1, &node, i, node.num_keys - i);
+    leaf_put(&node, i, id, address, name);
+    node.num_keys++;
+    write_node(db, current_offset, &node);
+    for (int level = 0; level < depth; level++)
+    {
+        BTreeNode *parent = buffer_pool_fetch(db->pool, path[level]);
+        if (parent == NULL)
+        {
+            printf("Error: Failed to read node at offset %lld\n", (long long)path[level]);
+            exit(1);
         }
+        parent->data.internal.counts[path_index[level]]++;
+        buffer_pool_unpin(db->pool, path[level], 1);
     }
+    return 1;
+}
 
-    // Update root_offset in file
-    fseek(db->file, 0, SEEK_SET);
-    fwrite(&db->root_offset, sizeof(off_t), 1, db->file);
+// Insert an id pointing at a row in a data page (returns 0 if the index has no page left
+// for a split, leaving it as it was)
+int btree_insert(Database *db, int id, off_t address)
+{
+    int inserted = db->hashed ? hash_index_insert(db, id, address) : insert_entry(db, id, address, NULL);
+    if (inserted)
+    {
+        bloom_add(db, id);
+    }
+    return inserted;
 }
 
-// Delete from the B-Tree (simplified, no rebalancing)
+// Insert a row into a row leaf (clustered tables; returns 0 as btree_insert does)
+int btree_insert_row(Database *db, const struct Row *row)
+{
+    if (!insert_entry(db, row->id, 0, row->name))
+    {
+        return 0;
+    }
+    bloom_add(db, row->id);
+    return 1;
+}
+
+// Copy the row of a row leaf entry that an address from btree_search or btree_next names
+// (returns 0 if the entry is gone)
+int btree_read_row(Database *db, off_t address, struct Row *row)
+{
+    off_t leaf_offset = RID_PAGE(address);
+    int i = RID_SLOT(address);
+    const BTreeNode *leaf = buffer_pool_latch(db->pool, leaf_offset);
+    if (leaf == NULL)
+    {
+        return 0;
+    }
+    // The leaf may have changed since the address was taken: callers compare the id
+    int found = leaf->is_leaf == NODE_ROW_LEAF && i < leaf->num_keys;
+    if (found)
+    {
+        row->id = leaf->data.rows.ids[i];
+        memcpy(row->name, leaf->data.rows.names[i], sizeof(row->name));
+    }
+    buffer_pool_unlatch(db->pool, leaf_offset);
+    return found;
+}
+
+// Overwrite the row of a row leaf entry in place (returns 0 if the entry is gone)
+int btree_write_row(Database *db, off_t address, const struct Row *row)
+{
+    off_t leaf_offset = RID_PAGE(address);
+    int i = RID_SLOT(address);
+    BTreeNode *leaf = buffer_pool_fetch(db->pool, leaf_offset);
+    if (leaf == NULL)
+    {
+        return 0;
+    }
+    int found = leaf->is_leaf == NODE_ROW_LEAF && i < leaf->num_keys && leaf->data.rows.ids[i] == row->id;
+    if (found)
+    {
+        memcpy(leaf->data.rows.names[i], row->name, sizeof(row->name));
+    }
+    buffer_pool_unpin(db->pool, leaf_offset, found);
+    return found;
+}
+
+// Fix an underfull child of an internal node: borrow an entry from a sibling that can
+// spare one, otherwise merge the child with a sibling and free the emptied page. The
+// parent loses a key on a merge, so the caller checks it for underflow in turn.
+static void rebalance_child(Database *db, off_t parent_offset, BTreeNode *parent, int i)
+{
+    BTreeNode child, left, right;
+    off_t child_offset = PAGE_OFFSET(parent->data.internal.children[i]);
+    off_t left_offset = i > 0 ? PAGE_OFFSET(parent->data.internal.children[i - 1]) : 0;
+    off_t right_offset = i < parent->num_keys ? PAGE_OFFSET(parent->data.internal.children[i + 1]) : 0;
+    read_node(db, child_offset, &child);
+    if (left_offset != 0)
+    {
+        read_node(db, left_offset, &left);
+    }
+    if (right_offset != 0)
+    {
+        read_node(db, right_offset, &right);
+    }
+    int min_keys = node_max_keys(&child) / 2;
+
+    if (left_offset != 0 && left.num_keys > min_keys)
+    {
+        // Rotate the last entry of the left sibling through the parent
+        if (child.is_leaf)
+        {
+            move_leaf_entries(&child, 1, &child, 0, child.num_keys);
+            move_leaf_entries(&child, 0, &left, left.num_keys - 1, 1);
+            parent->data.internal.keys[i - 1] = child.data.leaf.ids[0];
+            parent->data.internal.counts[i - 1]--;
+            parent->data.internal.counts[i]++;
+        }
+        else
+        {
+            uint32_t moved = left.data.internal.counts[left.num_keys];
+            memmove(&child.data.internal.keys[1], &child.data.internal.keys[0],
+                    child.num_keys * sizeof(int32_t));
+            memmove(&child.data.internal.children[1], &child.data.internal.children[0],
+                    (child.num_keys + 1) * sizeof(uint32_t));
+            memmove(&child.data.internal.counts[1], &child.data.internal.counts[0],
+                    (child.num_keys + 1) * sizeof(uint32_t));
+            child.data.internal.keys[0] = parent->data.internal.keys[i - 1];
+            child.data.internal.children[0] = left.data.internal.children[left.num_keys];
+            child.data.internal.counts[0] = moved;
+            parent->data.internal.keys[i - 1] = left.data.internal.keys[left.num_keys - 1];
+            parent->data.internal.counts[i - 1] -= moved;
+            parent->data.internal.counts[i] += moved;
+        }
+        child.num_keys++;
+        left.num_keys--;
+        write_node(db, left_offset, &left);
+        write_node(db, child_offset, &child);
+        write_node(db, parent_offset, parent);
+        return;
+    }
+
+    if (right_offset != 0 && right.num_keys > min_keys)
+    {
+        // Rotate the first entry of the right sibling through the parent
+        if (child.is_leaf)
+        {
+            move_leaf_entries(&child, child.num_keys, &right, 0, 1);
+            move_leaf_entries(&right, 0, &right, 1, right.num_keys - 1);
+            parent->data.internal.keys[i] = right.data.leaf.ids[0];
+            parent->data.internal.counts[i + 1]--;
+            parent->data.internal.counts[i]++;
+        }
+        else
+        {
+            uint32_t moved = right.data.internal.counts[0];
+            child.data.internal.keys[child.num_keys] = parent->data.internal.keys[i];
+            child.data.internal.children[child.num_keys + 1] = right.data.internal.children[0];
+            child.data.internal.counts[child.num_keys + 1] = moved;
+            parent->data.internal.keys[i] = right.data.internal.keys[0];
+            parent->data.internal.counts[i + 1] -= moved;
+            parent->data.internal.counts[i] += moved;
+            memmove(&right.data.internal.keys[0], &right.data.internal.keys[1],
+                    (right.num_keys - 1) * sizeof(int32_t));
+            memmove(&right.data.internal.children[0], &right.data.internal.children[1],
+                    right.num_keys * sizeof(uint32_t));
+            memmove(&right.data.internal.counts[0], &right.data.internal.counts[1],
+                    right.num_keys * sizeof(uint32_t));
+        }
+        child.num_keys++;
+        right.num_keys--;
+        write_node(db, right_offset, &right);
+        write_node(db, child_offset, &child);
+        write_node(db, parent_offset, parent);
+        return;
+    }
+
+    // Neither sibling can spare an entry: merge the pair at j and j + 1 into the left node
+    int j = left_offset != 0 ? i - 1 : i;
+    BTreeNode *into = left_offset != 0 ? &left : &child;
+    BTreeNode *from = left_offset != 0 ? &child : &right;
+    off_t into_offset = PAGE_OFFSET(parent->data.internal.children[j]);
+    off_t from_offset = PAGE_OFFSET(parent->data.internal.children[j + 1]);
+    if (into->is_leaf)
+    {
+        move_leaf_entries(into, into->num_keys, from, 0, from->num_keys);
+        into->num_keys += from->num_keys;
+        into->next = from->next;
+    }
+    else
+    {
+        // The separator comes down between the two key ranges
+        into->data.internal.keys[into->num_keys] = parent->data.internal.keys[j];
+        memcpy(&into->data.internal.keys[into->num_keys + 1], from->data.internal.keys,
+               from->num_keys * sizeof(int32_t));
+        memcpy(&into->data.internal.children[into->num_keys + 1], from->data.internal.children,
+               (from->num_keys + 1) * sizeof(uint32_t));
+        memcpy(&into->data.internal.counts[into->num_keys + 1], from->data.internal.counts,
+               (from->num_keys + 1) * sizeof(uint32_t));
+        into->num_keys += from->num_keys + 1;
+    }
+    parent->data.internal.counts[j] += parent->data.internal.counts[j + 1];
+    memmove(&parent->data.internal.keys[j], &parent->data.internal.keys[j + 1],
+            (parent->num_keys - j - 1) * sizeof(int32_t));
+    memmove(&parent->data.internal.children[j + 1], &parent->data.internal.children[j + 2],
+            (parent->num_keys - j - 1) * sizeof(uint32_t));
+    memmove(&parent->data.internal.counts[j + 1], &parent->data.internal.counts[j + 2],
+            (parent->num_keys - j - 1) * sizeof(uint32_t));
+    parent->num_keys--;
+    write_node(db, into_offset, into);
+    write_node(db, parent_offset, parent);
+    free_node(db, from_offset);
+}
+
+// Delete from the B-Tree: nodes left below half full borrow from or merge with a sibling on
+// the way back up, and a root left with a single child is replaced by that child
 void btree_delete(Database *db, int id)
 {
+    off_t path[BTREE_MAX_HEIGHT];
+    int child_index[BTREE_MAX_HEIGHT];
+    int depth = 0;
     BTreeNode node;
     off_t current_offset = db->root_offset;
-    off_t parent_offset = -1;
-    int child_index = -1;
+    if (db->hashed)
+    {
+        hash_index_delete(db, id);
+        return;
+    }
 
     while (1)
     {
         read_node(db, current_offset, &node);
+        path[depth] = current_offset;
         if (node.is_leaf)
         {
-            // Delete from leaf
-            int i;
-            for (i = 0; i < node.num_keys; i++)
-            {
-                if (node.data.leaf.entries[i].id == id)
-                {
-                    break;
-                }
-            }
-            if (i == node.num_keys)
-            {
-                return; // Not found
-            }
-            // Shift entries
-            for (int j = i; j < node.num_keys - 1; j++)
-            {
-                node.data.leaf.entries[j] = node.data.leaf.entries[j + 1];
-            }
-            node.num_keys--;
-            write_node(db, current_offset, &node);
             break;
         }
-        else
+        if (depth + 1 == BTREE_MAX_HEIGHT)
         {
-            // Find child to descend into
-            int i;
-            for (i = 0; i < node.num_keys; i++)
-            {
-                if (id < node.data.internal.keys[i])
-                {
-                    break;
-                }
-            }
-            parent_offset = current_offset;
-            child_index = i;
-            current_offset = node.data.internal.children[i];
+            printf("Error: B-tree deeper than %d levels\n", BTREE_MAX_HEIGHT);
+            exit(1);
+        }
+        child_index[depth] = node_child_index(&node, id);
+        current_offset = PAGE_OFFSET(node.data.internal.children[child_index[depth]]);
+        depth++;
+    }
+
+    int i = node_leaf_index(&node, id);
+    if (i == node.num_keys || node.data.leaf.ids[i] != id)
+    {
+        return; // Not found
+    }
+    move_leaf_entries(&node, i, &node, i + 1, node.num_keys - i - 1);
+    node.num_keys--;
+    write_node(db, current_offset, &node);
+    count_path(db, id, -1);
+
+    // Separators stay valid bounds after a leaf loses a key, so parents only change when
+    // a node underflows
+    if (depth == 0 || node.num_keys >= node_max_keys(&node) / 2)
+    {
+        return;
+    }
+    begin_restructure(db);
+    while (depth > 0 && node.num_keys < node_max_keys(&node) / 2)
+    {
+        depth--;
+        read_node(db, path[depth], &node);
+        rebalance_child(db, path[depth], &node, child_index[depth]);
+    }
+
+    BTreeNode root;
+    read_node(db, db->root_offset, &root);
+    if (!root.is_leaf && root.num_keys == 0)
+    {
+        // The last merge emptied the root: its only child becomes the root, one level less
+        off_t old_root = db->root_offset;
+        __atomic_store_n(&db->root_offset, PAGE_OFFSET(root.data.internal.children[0]), __ATOMIC_RELEASE);
+        free_node(db, old_root);
+    }
+    end_restructure(db);
+}
+
+// Check one subtree: keys sorted and inside the bounds given by the separators above
+// (lo inclusive, hi exclusive), leaves all at one depth and chained in key order
+static int verify_node(Database *db, off_t offset, int depth, long lo, long hi, int is_root,
+                       BTreeStats *stats, off_t *expected_leaf)
+{
+    BTreeNode node;
+    read_node(db, offset, &node);
+    stats->nodes++;
+    if (node.is_leaf > NODE_ROW_LEAF || node.num_keys > node_max_keys(&node) || (!node.is_leaf && node.num_keys < 1))
+    {
+        printf("Error: Node at offset %lld holds %d keys\n", (long long)offset, node.num_keys);
+        return 0;
+    }
+    if (!is_root && node.num_keys < node_max_keys(&node) / 2)
+    {
+        stats->underfull++;
+    }
+    stats->used_keys += node.num_keys;
+    stats->capacity += node_max_keys(&node);
+
+    for (int k = 0; k < node.num_keys; k++)
+    {
+        long key = node.is_leaf ? node.data.leaf.ids[k] : node.data.internal.keys[k];
+        long previous = k > 0 ? (node.is_leaf ? node.data.leaf.ids[k - 1]
+                                              : node.data.internal.keys[k - 1])
+                              : lo - 1;
+        if (key <= previous || key < lo || key >= hi)
+        {
+            printf("Error: Key %ld out of order in node at offset %lld\n", key, (long long)offset);
+            return 0;
         }
     }
 
-    // Update parent key if necessary (simplified)
-    if (parent_offset != -1 && node.num_keys > 0)
+    if (node.is_leaf)
     {
-        BTreeNode parent;
-        read_node(db, parent_offset, &parent);
-        parent.data.internal.keys[child_index] = node.data.leaf.entries[0].id;
-        write_node(db, parent_offset, &parent);
+        if ((node.is_leaf == NODE_ROW_LEAF) != db->clustered)
+        {
+            printf("Error: Leaf at offset %lld does not match the table layout\n", (long long)offset);
+            return 0;
+        }
+        if (stats->height == 0)
+        {
+            stats->height = depth + 1;
+        }
+        else if (stats->height != depth + 1)
+        {
+            printf("Error: Leaf at offset %lld is at depth %d, not %d\n", (long long)offset,
+                   depth + 1, stats->height);
+            return 0;
+        }
+        if (*expected_leaf != -1 && *expected_leaf != offset)
+        {
+            printf("Error: Leaf chain reaches offset %lld instead of %lld\n",
+                   (long long)*expected_leaf, (long long)offset);
+            return 0;
+        }
+        *expected_leaf = PAGE_OFFSET(node.next);
+        stats->leaves++;
+        stats->keys += node.num_keys;
+        return 1;
+    }
+
+    for (int c = 0; c <= node.num_keys; c++)
+    {
+        long child_lo = c > 0 ? node.data.internal.keys[c - 1] : lo;
+        long child_hi = c < node.num_keys ? node.data.internal.keys[c] : hi;
+        long keys_before = stats->keys;
+        if (!verify_node(db, PAGE_OFFSET(node.data.internal.children[c]), depth + 1, child_lo, child_hi, 0,
+                         stats, expected_leaf))
+        {
+            return 0;
+        }
+        if (stats->keys - keys_before != node.data.internal.counts[c])
+        {
+            printf("Error: Child %d of node at offset %lld counts %u entries but holds %ld\n", c,
+                   (long long)offset, node.data.internal.counts[c], stats->keys - keys_before);
+            return 0;
+        }
     }
+    return 1;
+}
+
+// Check the index invariants and measure its shape, with the writer locked out
+static int verify_index(Database *db, BTreeStats *stats)
+{
+    memset(stats, 0, sizeof(BTreeStats));
+    if (db->hashed)
+    {
+        // A lookup reads the directory root, a directory page and a bucket
+        HashStats hash_stats;
+        int valid = hash_index_verify(db, &hash_stats);
+        stats->height = 3;
+        stats->leaves = hash_stats.buckets;
+        stats->nodes = hash_stats.buckets + hash_stats.directory_pages + 1;
+        stats->keys = stats->used_keys = hash_stats.keys;
+        stats->capacity = hash_stats.capacity;
+        return valid;
+    }
+    off_t expected_leaf = -1;
+    if (!verify_node(db, db->root_offset, 0, INT32_MIN, (long)INT32_MAX + 1, 1, stats, &expected_leaf))
+    {
+        return 0;
+    }
+    if (expected_leaf != 0)
+    {
+        printf("Error: Leaf chain does not end at the last leaf\n");
+        return 0;
+    }
+    if (stats->keys != db->header.row_count)
+    {
+        printf("Error: Index holds %ld keys but the table %lld rows\n", stats->keys,
+               (long long)db->header.row_count);
+        return 0;
+    }
+    return 1;
+}
+
+// Check the index invariants and measure its shape (returns 1 if the tree is valid)
+int btree_verify(Database *db, BTreeStats *stats)
+{
+    lock_writer(db);
+    int valid = verify_index(db, stats);
+    unlock_writer(db);
+    return valid;
 }
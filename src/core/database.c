@@ -1,10 +1,138 @@
 #include "../../include/coredb.h"
 #include <unistd.h>
+#include <sched.h>
 
-// Initialize the database
+static void recover_from_wal(Database *db);
+
+// Create the state the threads using a database share
+static DbSync *create_sync(void)
+{
+    DbSync *sync = malloc(sizeof(DbSync));
+    if (sync == NULL)
+    {
+        printf("Error: Could not allocate database locks\n");
+        exit(1);
+    }
+    memset(sync, 0, sizeof(DbSync));
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&sync->writer, &attr);
+    pthread_mutexattr_destroy(&attr);
+    pthread_rwlock_init(&sync->bloom, NULL);
+    return sync;
+}
+
+// Whether the calling thread is the writer
+int holds_writer(Database *db)
+{
+    if (__atomic_load_n(&db->sync->writer_depth, __ATOMIC_ACQUIRE) == 0)
+    {
+        return 0;
+    }
+    pthread_t writer;
+    __atomic_load(&db->sync->writer_thread, &writer, __ATOMIC_RELAXED);
+    return pthread_equal(writer, pthread_self());
+}
+
+// Become the writer: changes to the database are made by one thread at a time (a thread
+// that is the writer already may nest)
+void lock_writer(Database *db)
+{
+    pthread_mutex_lock(&db->sync->writer);
+    if (db->sync->writer_depth == 0)
+    {
+        pthread_t self = pthread_self();
+        __atomic_store(&db->sync->writer_thread, &self, __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&db->sync->writer_depth, db->sync->writer_depth + 1, __ATOMIC_RELEASE);
+}
+
+// Give up one hold of the writer lock
+void unlock_writer(Database *db)
+{
+    if (db->sync->writer_depth == 1)
+    {
+        versions_publish(db);
+    }
+    __atomic_store_n(&db->sync->writer_depth, db->sync->writer_depth - 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&db->sync->writer);
+}
+
+// Start moving entries between pages or freeing pages: readers that started before the
+// change, or run into it, start over (see read_begin)
+void begin_restructure(Database *db)
+{
+    lock_writer(db);
+    if (db->sync->restructure_depth++ == 0)
+    {
+        __atomic_add_fetch(&db->sync->version, 1, __ATOMIC_SEQ_CST);
+    }
+}
+
+// Finish a change started by begin_restructure
+void end_restructure(Database *db)
+{
+    if (--db->sync->restructure_depth == 0)
+    {
+        __atomic_add_fetch(&db->sync->version, 1, __ATOMIC_SEQ_CST);
+    }
+    unlock_writer(db);
+}
+
+// Take the version a lookup or scan validates its pages against, waiting out a restructure
+// in progress (the writer itself reads its own changes at any time)
+unsigned long read_begin(Database *db)
+{
+    unsigned long version = __atomic_load_n(&db->sync->version, __ATOMIC_ACQUIRE);
+    if (holds_writer(db))
+    {
+        return version;
+    }
+    while (version & 1)
+    {
+        sched_yield();
+        version = __atomic_load_n(&db->sync->version, __ATOMIC_ACQUIRE);
+    }
+    return version;
+}
+
+// Whether no restructure started since read_begin returned version: pages latched since
+// then are still where the reader found them (check after latching, before using a page)
+int read_valid(Database *db, unsigned long version)
+{
+    return __atomic_load_n(&db->sync->version, __ATOMIC_ACQUIRE) == version;
+}
+
+// Initialize the database with default options
 Database init_db(const char *filename)
+{
+    DbOptions options = {0};
+    return init_db_with_options(filename, &options);
+}
+
+// Initialize the database
+Database init_db_with_options(const char *filename, const DbOptions *options)
 {
     Database db;
+    db.sync = create_sync();
+    db.versions = versions_open();
+    db.pool = NULL;
+    db.wal = NULL;
+    db.checksums = NULL;
+    db.double_write = NULL;
+    db.replaying = 0;
+    db.use_mmap = options->use_mmap;
+    db.no_sync = options->no_sync;
+    db.checkpoint_seconds = options->checkpoint_seconds > 0 ? options->checkpoint_seconds
+                                                             : CHECKPOINT_INTERVAL_SECONDS;
+    db.checkpoint_wal_bytes = options->checkpoint_wal_bytes > 0 ? options->checkpoint_wal_bytes
+                                                                 : WAL_CHECKPOINT_BYTES;
+    db.last_checkpoint = time(NULL);
+    memset(&db.checkpoint_stats, 0, sizeof(CheckpointStats));
+    memset(&db.recovery, 0, sizeof(RecoveryStats));
+    memset(&db.bloom, 0, sizeof(BloomFilter));
+    int created = 0;
     db.file = fopen(filename, "r+");
     if (db.file == NULL)
     {
@@ -21,134 +149,518 @@ Database init_db(const char *filename)
             perror("Error: Could not reopen file\n");
             exit(1);
         }
-        // Initialize B-Tree with an empty root node
-        db.root_offset = PAGE_SIZE; // root at start of first index page
-        BTreeNode root = {0};
-        root.is_leaf = 1;
-        write_node(&db, db.root_offset, &root);
-        fseek(db.file, 0, SEEK_SET);
-        fwrite(&db.root_offset, sizeof(off_t), 1, db.file);
-    }
-    else
-    {
-        // Read root_offset
-        fseek(db.file, 0, SEEK_SET);
-        fread(&db.root_offset, sizeof(off_t), 1, db.file);
+        created = 1;
     }
-    db.max_pages = MAX_PAGES;
-    db.pages = malloc(db.max_pages * sizeof(void *)); // 10 * 8 bytes
-    if (db.pages == NULL)
+
+    // Page checksums live beside the file; a checkpoint a crash cut short is finished from
+    // the double-write file before anything is read
+    char path[4096];
+    snprintf(path, sizeof(path), "%s.crc", filename);
+    db.checksums = page_checksums_open(path, created, db.no_sync);
+    snprintf(path, sizeof(path), "%s.dwb", filename);
+    db.double_write = db.checksums != NULL ? double_write_open(path, created, db.no_sync) : NULL;
+    if (db.double_write == NULL)
     {
-        perror("Error: Could not allocate pages array\n");
         fclose(db.file);
         exit(1);
     }
-    db.num_pages = 0;
-    for (int i = 0; i < MAX_PAGES; i++)
+    db.recovery.repaired_pages = double_write_recover(db.double_write, fileno(db.file), db.checksums->fd);
+    if (db.recovery.repaired_pages < 0)
     {
-        db.page_dirty[i] = 0;
+        fclose(db.file);
+        exit(1);
     }
 
-    // read data pages
-    fseek(db.file, DATA_START_OFFSET, SEEK_SET);
-    void *temp_buffer = malloc(PAGE_SIZE);
-    if (temp_buffer == NULL)
+    // An empty file (e.g. a crash before the first checkpoint) is initialized like a new one
+    fseek(db.file, 0, SEEK_END);
+    off_t file_size = ftello(db.file);
+    int is_new = (file_size == 0);
+    int legacy = read_header(&db, file_size);
+    if (db.checkpointed_header.version < 11 && !page_checksums_reset(db.checksums))
     {
-        perror("Error: Could not allocate temp buffer\n");
-        free(db.pages);
-        fclose(db.file);
+        // Pages of a new file or one an older version wrote have no checksums yet; any
+        // left over are stale
+        printf("Error: Could not reset page checksums\n");
         exit(1);
     }
-
-    while (1)
+    if (is_new)
     {
-        size_t bytesRead = fread(temp_buffer, 1, PAGE_SIZE, db.file);
-        if (bytesRead == 0)
-            break;
-        if (bytesRead < PAGE_SIZE && !feof(db.file))
+        if (options->clustered && options->hashed)
         {
-            printf("Error: Partial read, only %zu bytes read\n", bytesRead);
-            free(temp_buffer);
-            free(db.pages);
+            printf("Error: A clustered table keeps its rows in B+tree leaves and cannot be hashed\n");
             fclose(db.file);
             exit(1);
         }
-        void *page = malloc(PAGE_SIZE);
-        if (page == NULL)
+        // The layout and the index kind are fixed when the file is created
+        db.header.clustered = options->clustered != 0;
+        db.header.hashed = options->hashed != 0;
+    }
+    db.clustered = (int)db.header.clustered;
+    db.hashed = (int)db.header.hashed;
+    if (db.use_mmap)
+    {
+        // The mapping must cover every allocated page; later pages extend the file first
+        off_t mapped_size = db.header.page_count * PAGE_SIZE;
+        if (file_size < mapped_size && ftruncate(fileno(db.file), mapped_size) != 0)
         {
-            perror("Error: Could not allocate page\n");
-            free(temp_buffer);
-            free(db.pages);
+            perror("Error: Could not size database file");
             fclose(db.file);
             exit(1);
         }
-        memcpy(page, temp_buffer, PAGE_SIZE);
-        db.pages[db.num_pages] = page;
-        db.num_pages++;
+        db.pool = buffer_pool_create_mmap(fileno(db.file), (size_t)mapped_size);
+    }
+    else
+    {
+        int frames = options->pool_frames > 0 ? options->pool_frames : BUFFER_POOL_FRAMES;
+        db.pool = buffer_pool_create(fileno(db.file), frames);
+    }
+    if (db.pool == NULL)
+    {
+        printf("Error: Could not allocate buffer pool\n");
+        fclose(db.file);
+        exit(1);
+    }
+    db.pool->no_steal = 1; // Pages reach the file only at checkpoints
+    db.pool->checksums = db.checksums;
+
+    // Changes since the last checkpoint live only in the write-ahead log, numbered on from
+    // the ones the last checkpoint absorbed
+    snprintf(path, sizeof(path), "%s.wal", filename);
+    db.wal = wal_open(path, created, db.no_sync, db.checkpointed_header.checkpoint_lsn);
+    if (db.wal == NULL)
+    {
+        buffer_pool_destroy(db.pool);
+        fclose(db.file);
+        exit(1);
+    }
 
-        if (db.num_pages >= db.max_pages)
+    if (is_new)
+    {
+        // Initialize B-Tree with an empty root node (or the hash directory at its place)
+        if (db.hashed)
+        {
+            hash_index_init(&db);
+        }
+        else
         {
-            printf("Warning: Maximum pages reached\n");
-            break;
+            BTreeNode root = {0};
+            root.is_leaf = db.clustered ? NODE_ROW_LEAF : NODE_LEAF;
+            write_node(&db, db.root_offset, &root);
         }
+        name_index_init(&db, db.name_root);
     }
-    free(temp_buffer);
 
-    if (db.num_pages == 0)
+    // Tables written by an older version are rewritten once; the header keeps its old version
+    // until the new pages are durable, so an interrupted upgrade is simply redone on the next open
+    int upgraded = 0;
+    if (!is_new && db.checkpointed_header.version < 5)
     {
-        void *page = malloc(PAGE_SIZE);
-        if (page == NULL)
+        if (!upgrade_table(&db, legacy))
         {
-            perror("Error: Could not allocate first page\n");
-            free(db.pages);
-            fclose(db.file);
+            printf("Error: Could not upgrade the database file\n");
+            exit(1);
+        }
+        upgraded = 1;
+    }
+    else if (!is_new && !db.hashed && db.checkpointed_header.version < 10)
+    {
+        // Internal nodes gained subtree counts in version 10
+        if (!upgrade_index_counts(&db))
+        {
+            printf("Error: Could not upgrade the database index\n");
             exit(1);
         }
-        memset(page, 0, PAGE_SIZE); // Initialize the first page to zero
-        db.pages[0] = page;
-        db.num_pages = 1;
+        upgraded = 1;
+    }
+
+    // Data pages are read on demand; opening costs the same for any table size
+    if (!open_data_pages(&db))
+    {
+        printf("Error: Could not open data pages\n");
+        exit(1);
+    }
+
+    // The Bloom filter is read back, or built from the primary index for new files and
+    // files from before it
+    if (!bloom_open(&db))
+    {
+        printf("Error: Could not open the Bloom filter\n");
+        exit(1);
+    }
+
+    if (is_new)
+    {
+        // Make the empty database durable before anything is logged against it
+        checkpoint(&db);
+    }
+    else
+    {
+        recover_from_wal(&db);
+    }
+    if (upgraded)
+    {
+        checkpoint(&db);
+    }
+
+    // Files from before the name index get one, built from the table after the log is
+    // replayed (replay skips the name index until then)
+    if (db.name_root == 0)
+    {
+        if (!build_name_index(&db))
+        {
+            printf("Error: Could not build the name index\n");
+            exit(1);
+        }
+        checkpoint(&db);
     }
     return db;
 }
 
-// Write the buffer to the disk file
+// Gather what a checkpoint writes and record the checksum of every page in it; the header
+// takes the LSN the log replays from once these pages are durable
+static void prepare_checkpoint(Database *db, CheckpointBatch *batch)
+{
+    // Pages spread over the file can each dirty a block of their own
+    int max_writes = db->pool->num_dirty + db->bloom.num_dirty;
+    int max_blocks = db->checksums->num_dirty + max_writes + 1;
+    batch->pages = malloc((max_writes > 0 ? max_writes : 1) * sizeof(PageWrite));
+    batch->blocks = malloc(max_blocks * sizeof(PageWrite));
+    if (batch->pages == NULL || batch->blocks == NULL)
+    {
+        printf("Error: Could not allocate checkpoint write list\n");
+        exit(1);
+    }
+
+    // Dirty index and data pages all live in the buffer pool, the Bloom filter beside it
+    batch->count = buffer_pool_collect_dirty(db->pool, batch->pages, db->pool->num_dirty);
+    batch->count += bloom_collect_dirty(db, batch->pages + batch->count, max_writes - batch->count);
+
+    // A transaction being applied has its records from unapplied_lsn on still to replay
+    WalStats wal_stats;
+    wal_get_stats(db->wal, &wal_stats);
+    uint64_t lsn = db->sync->keep_log ? db->sync->unapplied_lsn : wal_stats.next_lsn;
+    db->checksums->lsn = lsn;
+    for (int i = 0; i < batch->count; i++)
+    {
+        page_checksums_set(db->checksums, batch->pages[i].offset, batch->pages[i].data);
+    }
+    batch->num_blocks = page_checksums_collect_dirty(db->checksums, batch->blocks, max_blocks);
+
+    db->header.root_offset = db->root_offset;
+    db->header.name_root = db->name_root;
+    db->header.checkpoint_lsn = lsn;
+    db->header.checksum = header_checksum(&db->header);
+    // Root, page count, free list or log position changed
+    batch->header_changed = memcmp(&db->header, &db->checkpointed_header, sizeof(DbHeader)) != 0;
+}
+
+// Copy a checkpoint's pages to the double-write file, where a crash while they are written
+// in place cannot tear them (exits on failure)
+static void stage_batch(Database *db, const CheckpointBatch *batch)
+{
+    if (batch->count == 0 && batch->num_blocks == 0 && !batch->header_changed)
+    {
+        return;
+    }
+    if (!double_write_stage(db->double_write, batch->pages, batch->count, batch->blocks, batch->num_blocks,
+                            batch->header_changed ? &db->header : NULL, db->header.checkpoint_lsn,
+                            &db->checkpoint_stats.double_write_bytes))
+    {
+        exit(1);
+    }
+}
+
+// Write the buffer to the disk file (the body of a checkpoint): only pages changed since
+// the last checkpoint are written, adjacent ones coalesced into a single pwritev. Pages,
+// checksum blocks and header go to the double-write file first, and are durable in place
+// before it is cleared.
 void write_buffer(Database *db)
 {
-    // Write root_offset
-    fseek(db->file, 0, SEEK_SET);
-    fwrite(&db->root_offset, sizeof(off_t), 1, db->file);
+    CheckpointBatch batch;
+    prepare_checkpoint(db, &batch);
+    stage_batch(db, &batch);
 
-    // Write data pages
-    for (int i = 0; i < db->num_pages; i++)
+    int num_writes = 0;
+    int block_writes = 0;
+    if (!write_page_runs(fileno(db->file), batch.pages, batch.count, &num_writes) ||
+        !write_page_runs(db->checksums->fd, batch.blocks, batch.num_blocks, &block_writes))
     {
-        fseek(db->file, DATA_START_OFFSET + (off_t)i * PAGE_SIZE, SEEK_SET);
-        size_t bytesWritten = fwrite(db->pages[i], 1, PAGE_SIZE, db->file);
-        if (bytesWritten != PAGE_SIZE)
+        exit(1);
+    }
+    page_checksums_mark_clean(db->checksums, batch.blocks, batch.num_blocks);
+    size_t bytes = (size_t)(batch.count + batch.num_blocks) * PAGE_SIZE;
+    num_writes += block_writes;
+    if (batch.header_changed)
+    {
+        write_header(db);
+        db->checkpointed_header = db->header;
+        bytes += sizeof(DbHeader);
+        num_writes++;
+    }
+    if (!db->no_sync && (fsync(fileno(db->file)) != 0 || fdatasync(db->checksums->fd) != 0))
+    {
+        perror("Error: Could not sync database file");
+        exit(1);
+    }
+    if ((batch.count > 0 || batch.num_blocks > 0 || batch.header_changed) && !double_write_clear(db->double_write))
+    {
+        exit(1);
+    }
+    for (int i = 0; i < batch.count; i++)
+    {
+        buffer_pool_mark_clean(db->pool, batch.pages[i].offset);
+    }
+    bloom_mark_clean(db);
+    free(batch.pages);
+    free(batch.blocks);
+
+    if (bloom_release_old(db))
+    {
+        // The extent the Bloom filter left joins the free list
+        write_header(db);
+        db->checkpointed_header = db->header;
+        bytes += sizeof(DbHeader);
+        num_writes++;
+        if (!db->no_sync && fsync(fileno(db->file)) != 0)
         {
-            printf("Error: Failed to write page %d, wrote %zu bytes\n", i, bytesWritten);
+            perror("Error: Could not sync database file");
             exit(1);
         }
-        db->page_dirty[i] = 0; // Reset dirty flag after writing
     }
 
-    // Truncate file to remove any unused pages at the end
-    off_t new_file_size = DATA_START_OFFSET + (off_t)db->num_pages * PAGE_SIZE;
+    // Size the file to the allocated pages (free pages stay, they are reused in place)
+    off_t new_file_size = db->header.page_count * PAGE_SIZE;
     if (ftruncate(fileno(db->file), new_file_size) != 0)
     {
         perror("Warning: Could not truncate file");
         // Don't exit here, just continue - this is not a critical error
     }
 
-    fflush(db->file); // ensure data is written to disk
+    db->checkpoint_stats.checkpoints++;
+    db->checkpoint_stats.last_bytes = bytes;
+    db->checkpoint_stats.last_pages = batch.count;
+    db->checkpoint_stats.last_writes = num_writes;
+    db->checkpoint_stats.total_bytes += bytes;
 }
 
-// cleanup function
-void close_db(Database *db)
+// Write dirty pages, make them durable and empty the write-ahead log (returns bytes written)
+size_t checkpoint(Database *db)
 {
-    for (int i = 0; i < db->num_pages; i++)
+    lock_writer(db);
+    write_buffer(db);
+    // A transaction being applied keeps its records: they replay over the pages just written
+    if (!db->sync->keep_log && !wal_reset(db->wal))
     {
-        free(db->pages[i]);
+        printf("Error: Could not reset write-ahead log\n");
+        exit(1);
     }
-    free(db->pages);
+    db->last_checkpoint = time(NULL);
+    size_t bytes = db->checkpoint_stats.last_bytes;
+    unlock_writer(db);
+    return bytes;
+}
+
+// Do only the first step of a checkpoint, copying its pages to the double-write file, and
+// leave the rest undone as a crash right after it would (the caller releases the database)
+void stage_checkpoint(Database *db)
+{
+    lock_writer(db);
+    CheckpointBatch batch;
+    prepare_checkpoint(db, &batch);
+    stage_batch(db, &batch);
+    free(batch.pages);
+    free(batch.blocks);
+    unlock_writer(db);
+}
+
+// Checkpoint on a size trigger (log size, dirty frames) or a time trigger, never per statement
+void checkpoint_if_needed(Database *db)
+{
+    lock_writer(db);
+    WalStats stats;
+    wal_get_stats(db->wal, &stats);
+    int log_full = stats.size >= db->checkpoint_wal_bytes;
+    int pool_full = !db->use_mmap && db->pool->num_dirty >= db->pool->num_frames / 2;
+    int interval_passed = stats.size > 0 &&
+                          time(NULL) - db->last_checkpoint >= db->checkpoint_seconds;
+    if (log_full || pool_full || interval_passed)
+    {
+        checkpoint(db);
+    }
+    unlock_writer(db);
+}
+
+// Re-apply one logged change (returns 0 for a record type replay does not know)
+static int replay_record(Database *db, const WalRecord *record)
+{
+    switch (record->type)
+    {
+    case WAL_INSERT:
+        insert_row(db, record->id, record->name);
+        return 1;
+    case WAL_UPDATE:
+        update_row(db, record->id, record->name);
+        return 1;
+    case WAL_DELETE:
+        delete_row(db, record->id);
+        return 1;
+    default:
+        printf("Warning: Skipping unknown log record type %u\n", record->type);
+        return 0;
+    }
+}
+
+// Re-apply the held records of a committed transaction (returns the number applied)
+static int replay_held(Database *db, const WalRecord *held, int num_held)
+{
+    int applied = 0;
+    for (int i = 0; i < num_held; i++)
+    {
+        applied += replay_record(db, &held[i]);
+        db->sync->unapplied_lsn = held[i].lsn + 1;
+    }
+    return applied;
+}
+
+// Re-apply the changes logged since the last checkpoint, from the LSN its header records:
+// earlier records are in the pages already (a crash can come after the checkpoint wrote
+// them, before the log was emptied). The records of a transaction are held back until its
+// commit marker, and applied unless a rollback marker follows; a transaction the log ends
+// in is dropped whole.
+static void recover_from_wal(Database *db)
+{
+    off_t position = 0;
+    WalRecord record;
+    int applied = 0;
+    long skipped = 0;
+    WalRecord *held = NULL;     // records of the open transaction still to apply
+    int num_held = 0;
+    int held_capacity = 0;
+    int num_seen = 0;           // records of the open transaction, applied ones included
+    int in_transaction = 0;
+    int committed = 0;          // the held records reached their commit marker
+    uint64_t first_lsn = db->checkpointed_header.checkpoint_lsn;
+
+    // Checkpoints a full pool forces on the way keep the log and record how far replay got
+    db->replaying = 1;
+    db->sync->keep_log = 1;
+    db->sync->unapplied_lsn = first_lsn;
+    while (wal_read_record(db->wal, &position, &record))
+    {
+        if (committed)
+        {
+            // The record after a commit marker tells whether the transaction stands
+            if (record.type != WAL_ROLLBACK)
+            {
+                applied += replay_held(db, held, num_held);
+            }
+            committed = 0;
+            num_held = 0;
+            if (record.type == WAL_ROLLBACK)
+            {
+                continue;
+            }
+        }
+        if (record.type == WAL_ROLLBACK)
+        {
+            printf("Warning: Skipping a rollback marker that follows no commit\n");
+            continue;
+        }
+        if (record.type == WAL_BEGIN)
+        {
+            in_transaction = 1;
+            num_held = 0;
+            num_seen = 0;
+            continue;
+        }
+        if (record.type == WAL_COMMIT)
+        {
+            if (!in_transaction || record.id != num_seen)
+            {
+                printf("Warning: Skipping a transaction commit that does not match its records\n");
+            }
+            else
+            {
+                committed = 1;
+            }
+            in_transaction = 0;
+            num_held = committed ? num_held : 0;
+            num_seen = 0;
+            continue;
+        }
+        if (record.lsn < first_lsn)
+        {
+            // A checkpoint applying a transaction wrote this one's effects already
+            skipped++;
+            num_seen += in_transaction;
+            continue;
+        }
+        if (!in_transaction)
+        {
+            applied += replay_record(db, &record);
+            db->sync->unapplied_lsn = record.lsn + 1;
+            continue;
+        }
+        if (num_held == held_capacity)
+        {
+            held_capacity = held_capacity > 0 ? held_capacity * 2 : 256;
+            WalRecord *grown = realloc(held, held_capacity * sizeof(WalRecord));
+            if (grown == NULL)
+            {
+                printf("Error: Could not allocate memory to replay a transaction\n");
+                exit(1);
+            }
+            held = grown;
+        }
+        held[num_held++] = record;
+        num_seen++;
+    }
+    if (committed)
+    {
+        applied += replay_held(db, held, num_held);
+    }
+    db->replaying = 0;
+    db->sync->keep_log = 0;
+    free(held);
+    db->recovery.replayed = applied;
+    db->recovery.skipped = skipped;
+    db->recovery.discarded = in_transaction ? num_seen : 0;
+    if (applied > 0)
+    {
+        printf("Recovered %d changes from the write-ahead log\n", applied);
+    }
+    if (in_transaction)
+    {
+        // Its records must not hold back the ones logged after them
+        printf("Discarding %d changes of a transaction that did not commit\n", num_seen);
+    }
+    if (applied > 0 || in_transaction || skipped > 0)
+    {
+        checkpoint(db);
+    }
+}
+
+// Release a database without a checkpoint (what a crash leaves: the log replays at the next
+// open); no other thread may use it any more
+void release_db(Database *db)
+{
+    bloom_close(db);
+    buffer_pool_destroy(db->pool);
+    wal_close(db->wal);
+    page_checksums_close(db->checksums);
+    double_write_close(db->double_write);
     fclose(db->file);
+    pthread_mutex_destroy(&db->sync->writer);
+    pthread_rwlock_destroy(&db->sync->bloom);
+    free(db->sync);
+    db->sync = NULL;
+    versions_close(db->versions);
+    db->versions = NULL;
+}
+
+// cleanup function
+void close_db(Database *db)
+{
+    checkpoint(db);
+    release_db(db);
 }
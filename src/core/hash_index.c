@@ -0,0 +1,580 @@
+#include "../../include/coredb.h"
+
+// Mix the bits of an id (the murmur3 finalizer), so that the low bits of the hash pick
+// buckets evenly even for strided ids
+uint32_t hash_id(int id)
+{
+    uint32_t h = (uint32_t)id;
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
+
+// Pin a page of the hash index for reading or changing in place
+static void *fetch_hash_page(Database *db, off_t offset)
+{
+    void *page = buffer_pool_fetch(db->pool, offset);
+    if (page == NULL)
+    {
+        printf("Error: Failed to read hash index page at offset %lld\n", (long long)offset);
+        exit(1);
+    }
+    return page;
+}
+
+// Write a whole hash index page into the buffer pool
+static void write_hash_page(Database *db, off_t offset, const void *data, size_t size)
+{
+    void *page = buffer_pool_fetch_new(db->pool, offset);
+    if (page == NULL)
+    {
+        printf("Error: Failed to write hash index page at offset %lld\n", (long long)offset);
+        exit(1);
+    }
+    memset(page, 0, PAGE_SIZE);
+    memcpy(page, data, size);
+    buffer_pool_unpin(db->pool, offset, 1);
+}
+
+// Copy the directory root out of the buffer pool
+static void read_directory(Database *db, HashDirectory *dir)
+{
+    memcpy(dir, fetch_hash_page(db, db->root_offset), sizeof(HashDirectory));
+    buffer_pool_unpin(db->pool, db->root_offset, 0);
+}
+
+// Offset of the bucket a hash belongs to: the directory entry of its low depth bits
+static off_t find_bucket(Database *db, uint32_t hash)
+{
+    const HashDirectory *dir = fetch_hash_page(db, db->root_offset);
+    uint32_t slot = hash & ((1u << dir->depth) - 1);
+    off_t page_offset = PAGE_OFFSET(dir->pages[slot / HASH_DIRECTORY_ENTRIES]);
+    buffer_pool_unpin(db->pool, db->root_offset, 0);
+
+    const uint32_t *entries = fetch_hash_page(db, page_offset);
+    off_t bucket_offset = PAGE_OFFSET(entries[slot % HASH_DIRECTORY_ENTRIES]);
+    buffer_pool_unpin(db->pool, page_offset, 0);
+    return bucket_offset;
+}
+
+// Latch a hash index page for a reader that started at version (see read_begin); NULL, with
+// nothing latched, once a bucket split has begun and the reader has to start over
+static const void *latch_hash_page(Database *db, off_t offset, unsigned long version)
+{
+    const void *page = buffer_pool_latch(db->pool, offset);
+    if (!read_valid(db, version))
+    {
+        if (page != NULL)
+        {
+            buffer_pool_unlatch(db->pool, offset);
+        }
+        return NULL;
+    }
+    if (page == NULL)
+    {
+        printf("Error: Failed to read hash index page at offset %lld\n", (long long)offset);
+        exit(1);
+    }
+    return page;
+}
+
+// Return the bucket a hash belongs to latched for a reader, with the version it is valid at
+// (one page latched at a time, starting over when a split moves entries meanwhile)
+static const HashBucket *latch_bucket(Database *db, uint32_t hash, unsigned long *version,
+                                      off_t *bucket_offset)
+{
+    while (1)
+    {
+        *version = read_begin(db);
+        off_t root_offset = __atomic_load_n(&db->root_offset, __ATOMIC_ACQUIRE);
+        const HashDirectory *dir = latch_hash_page(db, root_offset, *version);
+        if (dir == NULL)
+        {
+            continue;
+        }
+        uint32_t slot = hash & ((1u << dir->depth) - 1);
+        off_t page_offset = PAGE_OFFSET(dir->pages[slot / HASH_DIRECTORY_ENTRIES]);
+        buffer_pool_unlatch(db->pool, root_offset);
+
+        const uint32_t *entries = latch_hash_page(db, page_offset, *version);
+        if (entries == NULL)
+        {
+            continue;
+        }
+        *bucket_offset = PAGE_OFFSET(entries[slot % HASH_DIRECTORY_ENTRIES]);
+        buffer_pool_unlatch(db->pool, page_offset);
+
+        const HashBucket *bucket = latch_hash_page(db, *bucket_offset, *version);
+        if (bucket != NULL)
+        {
+            return bucket;
+        }
+    }
+}
+
+// Position of the first entry of a bucket not below id
+static int bucket_index(const HashBucket *bucket, int id)
+{
+    int lo = 0;
+    int hi = bucket->num_keys;
+    while (lo < hi)
+    {
+        int mid = (lo + hi) / 2;
+        if (bucket->ids[mid] < id)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// Append an entry to a bucket being filled in id order
+static void bucket_append(HashBucket *to, const HashBucket *from, int i)
+{
+    to->ids[to->num_keys] = from->ids[i];
+    to->pages[to->num_keys] = from->pages[i];
+    to->slots[to->num_keys] = from->slots[i];
+    to->num_keys++;
+}
+
+// Start an empty hash index whose directory root is at db->root_offset: one directory page
+// and one bucket of depth 0
+void hash_index_init(Database *db)
+{
+    off_t directory_offset = allocate_node(db);
+    off_t bucket_offset = allocate_node(db);
+    if (directory_offset == -1 || bucket_offset == -1)
+    {
+        printf("Error: Could not allocate the hash index\n");
+        exit(1);
+    }
+    HashBucket bucket = {0};
+    write_hash_page(db, bucket_offset, &bucket, sizeof(HashBucket));
+    uint32_t entries[HASH_DIRECTORY_ENTRIES] = {0};
+    entries[0] = PAGE_NUMBER(bucket_offset);
+    write_hash_page(db, directory_offset, entries, sizeof(entries));
+
+    HashDirectory dir = {0};
+    dir.num_pages = 1;
+    dir.pages[0] = PAGE_NUMBER(directory_offset);
+    dir.first_bucket = PAGE_NUMBER(bucket_offset);
+    dir.buckets = 1;
+    write_hash_page(db, db->root_offset, &dir, sizeof(HashDirectory));
+}
+
+// Find the address stored for an id (-1 if absent)
+void hash_index_search(Database *db, int id, off_t *address)
+{
+    unsigned long version;
+    off_t bucket_offset;
+    const HashBucket *bucket = latch_bucket(db, hash_id(id), &version, &bucket_offset);
+    int i = bucket_index(bucket, id);
+    *address = -1;
+    if (i < bucket->num_keys && bucket->ids[i] == id)
+    {
+        *address = RID(PAGE_OFFSET(bucket->pages[i]), bucket->slots[i]);
+    }
+    buffer_pool_unlatch(db->pool, bucket_offset);
+}
+
+// Point an existing id at a new row address (returns 1 if the id was found)
+int hash_index_update(Database *db, int id, off_t address)
+{
+    off_t bucket_offset = find_bucket(db, hash_id(id));
+    HashBucket *bucket = fetch_hash_page(db, bucket_offset);
+    int i = bucket_index(bucket, id);
+    int found = i < bucket->num_keys && bucket->ids[i] == id;
+    if (found)
+    {
+        bucket->pages[i] = PAGE_NUMBER(address);
+        bucket->slots[i] = (uint16_t)RID_SLOT(address);
+    }
+    buffer_pool_unpin(db->pool, bucket_offset, found);
+    return found;
+}
+
+// Double the directory: the new upper half repeats the lower half entry for entry, so
+// every bucket keeps its slots (returns 0 if the directory cannot grow)
+static int double_directory(Database *db)
+{
+    HashDirectory dir;
+    read_directory(db, &dir);
+    long entries = 1L << dir.depth;
+    if (entries * 2 > (long)HASH_MAX_DIRECTORY_PAGES * HASH_DIRECTORY_ENTRIES)
+    {
+        printf("Error: Hash directory is full at depth %u\n", dir.depth);
+        return 0;
+    }
+
+    if (entries < HASH_DIRECTORY_ENTRIES)
+    {
+        // Both halves fit the first directory page
+        off_t page_offset = PAGE_OFFSET(dir.pages[0]);
+        uint32_t *page = fetch_hash_page(db, page_offset);
+        memcpy(&page[entries], page, entries * sizeof(uint32_t));
+        buffer_pool_unpin(db->pool, page_offset, 1);
+    }
+    else
+    {
+        // Whole pages: copy each directory page into a new one
+        uint32_t num_pages = dir.num_pages;
+        for (uint32_t p = 0; p < num_pages; p++)
+        {
+            off_t copy_offset = allocate_node(db);
+            if (copy_offset == -1)
+            {
+                printf("Error: Cannot grow the hash directory - no page left\n");
+                return 0; // the pages copied so far are not referenced yet
+            }
+            uint32_t entries_copy[HASH_DIRECTORY_ENTRIES];
+            off_t page_offset = PAGE_OFFSET(dir.pages[p]);
+            memcpy(entries_copy, fetch_hash_page(db, page_offset), sizeof(entries_copy));
+            buffer_pool_unpin(db->pool, page_offset, 0);
+            write_hash_page(db, copy_offset, entries_copy, sizeof(entries_copy));
+            dir.pages[num_pages + p] = PAGE_NUMBER(copy_offset);
+        }
+        dir.num_pages = num_pages * 2;
+    }
+    dir.depth++;
+    write_hash_page(db, db->root_offset, &dir, sizeof(HashDirectory));
+    return 1;
+}
+
+// Split the full bucket a hash maps to on the next bit of the hash: entries with the bit
+// set move to a new bucket, which follows the old one in the chain, and the directory slots
+// with that bit point at it (returns 0 if no page is left)
+static int split_bucket_pages(Database *db, uint32_t hash)
+{
+    off_t bucket_offset = find_bucket(db, hash);
+    HashBucket old;
+    memcpy(&old, fetch_hash_page(db, bucket_offset), sizeof(HashBucket));
+    buffer_pool_unpin(db->pool, bucket_offset, 0);
+    HashDirectory dir;
+    read_directory(db, &dir);
+    if (old.depth == dir.depth)
+    {
+        if (!double_directory(db))
+        {
+            return 0;
+        }
+        read_directory(db, &dir);
+    }
+    off_t new_offset = allocate_node(db);
+    if (new_offset == -1)
+    {
+        printf("Error: Cannot split hash bucket - no page for a new bucket\n");
+        return 0;
+    }
+
+    uint32_t bit = 1u << old.depth;
+    HashBucket low = {0};
+    HashBucket high = {0};
+    low.depth = high.depth = old.depth + 1;
+    for (int i = 0; i < old.num_keys; i++)
+    {
+        bucket_append(hash_id(old.ids[i]) & bit ? &high : &low, &old, i);
+    }
+    high.next = old.next;
+    low.next = PAGE_NUMBER(new_offset);
+    write_hash_page(db, bucket_offset, &low, sizeof(HashBucket));
+    write_hash_page(db, new_offset, &high, sizeof(HashBucket));
+
+    // Slots ending in the bucket's bits plus the new bit, one every 2 * bit entries
+    uint32_t slot_count = 1u << dir.depth;
+    for (uint32_t slot = (hash & (bit - 1)) | bit; slot < slot_count; slot += bit * 2)
+    {
+        off_t page_offset = PAGE_OFFSET(dir.pages[slot / HASH_DIRECTORY_ENTRIES]);
+        uint32_t *entries = fetch_hash_page(db, page_offset);
+        entries[slot % HASH_DIRECTORY_ENTRIES] = PAGE_NUMBER(new_offset);
+        buffer_pool_unpin(db->pool, page_offset, 1);
+    }
+    dir.buckets++;
+    write_hash_page(db, db->root_offset, &dir, sizeof(HashDirectory));
+    return 1;
+}
+
+// Split a full bucket while readers are told to start over (see split_bucket_pages)
+static int split_bucket(Database *db, uint32_t hash)
+{
+    begin_restructure(db);
+    int split = split_bucket_pages(db, hash);
+    end_restructure(db);
+    return split;
+}
+
+// Insert an id pointing at a row, splitting its bucket (and doubling the directory) as
+// often as it takes to make room (returns 0 if no page is left for a split)
+int hash_index_insert(Database *db, int id, off_t address)
+{
+    uint32_t hash = hash_id(id);
+    while (1)
+    {
+        off_t bucket_offset = find_bucket(db, hash);
+        HashBucket *bucket = fetch_hash_page(db, bucket_offset);
+        if (bucket->num_keys < HASH_BUCKET_KEYS)
+        {
+            int i = bucket_index(bucket, id);
+            int move = bucket->num_keys - i;
+            memmove(&bucket->ids[i + 1], &bucket->ids[i], move * sizeof(int32_t));
+            memmove(&bucket->pages[i + 1], &bucket->pages[i], move * sizeof(uint32_t));
+            memmove(&bucket->slots[i + 1], &bucket->slots[i], move * sizeof(uint16_t));
+            bucket->ids[i] = id;
+            bucket->pages[i] = PAGE_NUMBER(address);
+            bucket->slots[i] = (uint16_t)RID_SLOT(address);
+            bucket->num_keys++;
+            buffer_pool_unpin(db->pool, bucket_offset, 1);
+            return 1;
+        }
+        buffer_pool_unpin(db->pool, bucket_offset, 0);
+        if (!split_bucket(db, hash))
+        {
+            return 0;
+        }
+    }
+}
+
+// Remove an id. Buckets are not merged: an emptied bucket keeps its slots and takes the
+// next inserts that hash to them.
+void hash_index_delete(Database *db, int id)
+{
+    off_t bucket_offset = find_bucket(db, hash_id(id));
+    HashBucket *bucket = fetch_hash_page(db, bucket_offset);
+    int i = bucket_index(bucket, id);
+    int found = i < bucket->num_keys && bucket->ids[i] == id;
+    if (found)
+    {
+        int move = bucket->num_keys - i - 1;
+        memmove(&bucket->ids[i], &bucket->ids[i + 1], move * sizeof(int32_t));
+        memmove(&bucket->pages[i], &bucket->pages[i + 1], move * sizeof(uint32_t));
+        memmove(&bucket->slots[i], &bucket->slots[i + 1], move * sizeof(uint16_t));
+        bucket->num_keys--;
+    }
+    buffer_pool_unpin(db->pool, bucket_offset, found);
+}
+
+// Return every page of a hash index, its directory root included, to the allocator
+void hash_index_free(Database *db, off_t root_offset)
+{
+    HashDirectory dir;
+    memcpy(&dir, fetch_hash_page(db, root_offset), sizeof(HashDirectory));
+    buffer_pool_unpin(db->pool, root_offset, 0);
+    off_t offset = PAGE_OFFSET(dir.first_bucket);
+    while (offset != 0)
+    {
+        const HashBucket *bucket = fetch_hash_page(db, offset);
+        off_t next = PAGE_OFFSET(bucket->next);
+        buffer_pool_unpin(db->pool, offset, 0);
+        free_node(db, offset);
+        offset = next;
+    }
+    for (uint32_t p = 0; p < dir.num_pages; p++)
+    {
+        free_node(db, PAGE_OFFSET(dir.pages[p]));
+    }
+    free_node(db, root_offset);
+}
+
+// Start a scan over ids lo..cursor->hi at the first bucket; buckets are visited in chain
+// order, so the ids come back unordered
+void hash_index_seek(Database *db, int lo, RangeCursor *cursor)
+{
+    while (1)
+    {
+        cursor->version = read_begin(db);
+        cursor->root = __atomic_load_n(&db->root_offset, __ATOMIC_ACQUIRE);
+        const HashDirectory *dir = latch_hash_page(db, cursor->root, cursor->version);
+        if (dir != NULL)
+        {
+            cursor->leaf = PAGE_OFFSET(dir->first_bucket);
+            buffer_pool_unlatch(db->pool, cursor->root);
+            break;
+        }
+    }
+    cursor->index = 0;
+    cursor->lo = lo;
+    cursor->next = lo;
+    cursor->depth = -1;
+}
+
+// Find the smallest id in range not below cursor->next in the current bucket and the buckets
+// split off it since the scan reached it, which the split put between it and cursor->after
+// (returns 1 if found, 0 if none is left, -1 if a split began meanwhile)
+static int family_next(Database *db, RangeCursor *cursor, unsigned long version, int *id, off_t *address)
+{
+    int found = 0;
+    off_t offset = cursor->leaf;
+    do
+    {
+        const HashBucket *bucket = latch_hash_page(db, offset, version);
+        if (bucket == NULL)
+        {
+            return -1;
+        }
+        int i = bucket_index(bucket, cursor->next);
+        if (i < bucket->num_keys && bucket->ids[i] <= cursor->hi && (!found || bucket->ids[i] < *id))
+        {
+            *id = bucket->ids[i];
+            *address = RID(PAGE_OFFSET(bucket->pages[i]), bucket->slots[i]);
+            found = 1;
+        }
+        off_t next_offset = PAGE_OFFSET(bucket->next);
+        buffer_pool_unlatch(db->pool, offset);
+        offset = next_offset;
+    } while (offset != 0 && offset != cursor->after);
+    return found;
+}
+
+// Return the next entry in range under the cursor (returns 0 once the chain ends). Buckets
+// stay in the chain once split, with the new bucket right after the old one. A split of the
+// bucket under the cursor moves entries it returned and entries it did not into the new
+// bucket, so from then on the scan takes ids in order across the bucket and those split off
+// it, and returns each once. A bulk load ends the scan.
+int hash_index_next(Database *db, RangeCursor *cursor, int *id, off_t *address)
+{
+    while (cursor->leaf != 0)
+    {
+        // Follow the chain only between splits: a new bucket is linked before it is filled
+        unsigned long version = read_begin(db);
+        if (__atomic_load_n(&db->root_offset, __ATOMIC_ACQUIRE) != cursor->root)
+        {
+            cursor->leaf = 0;
+            break;
+        }
+        const HashBucket *bucket = latch_hash_page(db, cursor->leaf, version);
+        if (bucket == NULL)
+        {
+            continue;
+        }
+        off_t bucket_offset = cursor->leaf;
+        if (cursor->depth == -1)
+        {
+            cursor->depth = bucket->depth;
+            cursor->after = PAGE_OFFSET(bucket->next);
+        }
+        int found = 0;
+        if (bucket->depth == cursor->depth)
+        {
+            // Not split: entries are sorted and shift in place, so find the place again by id
+            int i = cursor->index;
+            if (i > bucket->num_keys || (i < bucket->num_keys && bucket->ids[i] < cursor->next) ||
+                (i > 0 && i <= bucket->num_keys && bucket->ids[i - 1] >= cursor->next))
+            {
+                i = bucket_index(bucket, cursor->next);
+            }
+            if (i < bucket->num_keys && bucket->ids[i] <= cursor->hi)
+            {
+                *id = bucket->ids[i];
+                *address = RID(PAGE_OFFSET(bucket->pages[i]), bucket->slots[i]);
+                cursor->index = i + 1;
+                found = 1;
+            }
+            buffer_pool_unlatch(db->pool, bucket_offset);
+        }
+        else
+        {
+            buffer_pool_unlatch(db->pool, bucket_offset);
+            found = family_next(db, cursor, version, id, address);
+            if (found == -1)
+            {
+                continue;
+            }
+        }
+        if (found && *id < INT32_MAX)
+        {
+            cursor->next = *id + 1;
+            return 1;
+        }
+        // Nothing follows in this bucket (or those split off it)
+        cursor->leaf = cursor->after;
+        cursor->index = 0;
+        cursor->next = cursor->lo;
+        cursor->depth = -1;
+        if (found)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// Check that every directory slot names a bucket whose ids share the slot's low bits, that
+// the chain holds each bucket once with sorted ids, and measure the index (returns 1 if valid)
+int hash_index_verify(Database *db, HashStats *stats)
+{
+    memset(stats, 0, sizeof(HashStats));
+    HashDirectory dir;
+    read_directory(db, &dir);
+    stats->depth = (int)dir.depth;
+    stats->directory_pages = dir.num_pages;
+
+    uint32_t slot_count = 1u << dir.depth;
+    for (uint32_t slot = 0; slot < slot_count; slot++)
+    {
+        off_t page_offset = PAGE_OFFSET(dir.pages[slot / HASH_DIRECTORY_ENTRIES]);
+        const uint32_t *entries = fetch_hash_page(db, page_offset);
+        off_t bucket_offset = PAGE_OFFSET(entries[slot % HASH_DIRECTORY_ENTRIES]);
+        buffer_pool_unpin(db->pool, page_offset, 0);
+
+        const HashBucket *bucket = fetch_hash_page(db, bucket_offset);
+        uint32_t mask = (1u << bucket->depth) - 1;
+        int valid = bucket->depth <= dir.depth &&
+                    (bucket->num_keys == 0 || ((hash_id(bucket->ids[0]) ^ slot) & mask) == 0);
+        buffer_pool_unpin(db->pool, bucket_offset, 0);
+        if (!valid)
+        {
+            printf("Error: Directory slot %u names a bucket of other hashes\n", slot);
+            return 0;
+        }
+    }
+
+    // Each bucket owns 2^(global - local depth) slots; together they cover the directory
+    unsigned long covered = 0;
+    off_t offset = PAGE_OFFSET(dir.first_bucket);
+    while (offset != 0)
+    {
+        const HashBucket *bucket = fetch_hash_page(db, offset);
+        uint32_t mask = (1u << bucket->depth) - 1;
+        int valid = bucket->depth <= dir.depth && bucket->num_keys <= HASH_BUCKET_KEYS;
+        for (int i = 0; valid && i < bucket->num_keys; i++)
+        {
+            valid = ((hash_id(bucket->ids[i]) ^ hash_id(bucket->ids[0])) & mask) == 0 &&
+                    (i == 0 || bucket->ids[i - 1] < bucket->ids[i]);
+        }
+        stats->buckets++;
+        stats->keys += bucket->num_keys;
+        stats->capacity += HASH_BUCKET_KEYS;
+        stats->empty += bucket->num_keys == 0;
+        if (valid)
+        {
+            covered += 1ul << (dir.depth - bucket->depth);
+        }
+        off_t next = PAGE_OFFSET(bucket->next);
+        buffer_pool_unpin(db->pool, offset, 0);
+        if (!valid || stats->buckets > (long)dir.buckets)
+        {
+            printf("Error: Hash bucket at offset %lld is out of order or in the chain twice\n",
+                   (long long)offset);
+            return 0;
+        }
+        offset = next;
+    }
+    if (stats->buckets != (long)dir.buckets || covered != slot_count)
+    {
+        printf("Error: Bucket chain holds %ld of %u buckets\n", stats->buckets, dir.buckets);
+        return 0;
+    }
+    if (stats->keys != db->header.row_count)
+    {
+        printf("Error: Index holds %ld keys but the table %lld rows\n", stats->keys,
+               (long long)db->header.row_count);
+        return 0;
+    }
+    return 1;
+}
@@ -0,0 +1,342 @@
+#include "../../include/coredb.h"
+
+#define VERSION_MAP_MIN 1024
+#define VERSION_RECORDS_MIN 256
+
+// Slot of an id in the open addressing map (kept at most half full, see version_record)
+static long map_slot(const VersionStore *store, int id)
+{
+    uint64_t h = (uint64_t)(uint32_t)id * 0x9e3779b97f4a7c15ull;
+    long mask = store->map_capacity - 1;
+    long slot = (long)(h >> 32) & mask;
+    while (store->map_ids[slot] != 0 && store->map_ids[slot] != id)
+    {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+// Position of the newest record of an id still kept, -1 if none
+static long map_find(const VersionStore *store, int id)
+{
+    long slot = map_slot(store, id);
+    if (store->map_ids[slot] == 0 || store->map_positions[slot] < store->base)
+    {
+        return -1;
+    }
+    return store->map_positions[slot];
+}
+
+// Point the map at the newest record of every id kept, with room for at least keys ids at
+// half load (exits when memory runs out: snapshots could not be answered without records)
+static void map_rebuild(VersionStore *store, long keys)
+{
+    long capacity = store->map_capacity;
+    while (capacity < 2 * keys)
+    {
+        capacity *= 2;
+    }
+    if (capacity != store->map_capacity)
+    {
+        free(store->map_ids);
+        free(store->map_positions);
+        store->map_ids = malloc(capacity * sizeof(int));
+        store->map_positions = malloc(capacity * sizeof(long));
+        store->map_capacity = capacity;
+        if (store->map_ids == NULL || store->map_positions == NULL)
+        {
+            printf("Error: Could not allocate memory for row versions\n");
+            exit(1);
+        }
+    }
+    memset(store->map_ids, 0, capacity * sizeof(int));
+    for (long i = 0; i < store->count; i++)
+    {
+        long slot = map_slot(store, store->records[i].id);
+        store->map_ids[slot] = store->records[i].id;
+        store->map_positions[slot] = store->base + i;
+    }
+}
+
+// Drop the records no open snapshot can need: those at or below the oldest snapshot, or
+// every published one when no snapshot is open (records of the writer's changes in progress
+// are newer than both and stay)
+static void collect(VersionStore *store)
+{
+    uint64_t horizon = store->published;
+    for (int i = 0; i < store->num_snapshots; i++)
+    {
+        if (store->snapshots[i] < horizon)
+        {
+            horizon = store->snapshots[i];
+        }
+    }
+    long dropped = 0;
+    while (dropped < store->count && store->records[dropped].ts <= horizon)
+    {
+        dropped++;
+    }
+    if (dropped == 0)
+    {
+        return;
+    }
+    store->count -= dropped;
+    store->base += dropped;
+    store->collected += dropped;
+    memmove(store->records, store->records + dropped, store->count * sizeof(VersionRecord));
+    if (store->count == 0)
+    {
+        __atomic_store_n(&store->newest, 0, __ATOMIC_RELEASE);
+    }
+    map_rebuild(store, store->count);
+}
+
+// Create an empty version store
+VersionStore *versions_open(void)
+{
+    VersionStore *store = malloc(sizeof(VersionStore));
+    if (store == NULL)
+    {
+        printf("Error: Could not allocate memory for row versions\n");
+        exit(1);
+    }
+    memset(store, 0, sizeof(VersionStore));
+    pthread_mutex_init(&store->lock, NULL);
+    pthread_cond_init(&store->published_cond, NULL);
+    store->map_ids = malloc(VERSION_MAP_MIN * sizeof(int));
+    store->map_positions = malloc(VERSION_MAP_MIN * sizeof(long));
+    if (store->map_ids == NULL || store->map_positions == NULL)
+    {
+        printf("Error: Could not allocate memory for row versions\n");
+        exit(1);
+    }
+    store->map_capacity = VERSION_MAP_MIN;
+    map_rebuild(store, 0);
+    return store;
+}
+
+// Free a version store
+void versions_close(VersionStore *store)
+{
+    if (store == NULL)
+    {
+        return;
+    }
+    pthread_mutex_destroy(&store->lock);
+    pthread_cond_destroy(&store->published_cond);
+    free(store->records);
+    free(store->map_ids);
+    free(store->map_positions);
+    free(store->snapshots);
+    free(store);
+}
+
+// Keep the image of a row the writer is about to change (before NULL: the row does not
+// exist yet). Called before the change reaches any page, so a reader that sees the change
+// finds the record. Without open snapshots nothing is kept, and snapshot_begin waits for
+// the writer to publish instead.
+void version_record(Database *db, int id, const struct Row *before)
+{
+    VersionStore *store = db->versions;
+    if (db->replaying)
+    {
+        return;
+    }
+    pthread_mutex_lock(&store->lock);
+    store->pending = 1;
+    if (store->num_snapshots == 0)
+    {
+        store->unversioned = 1;
+        pthread_mutex_unlock(&store->lock);
+        return;
+    }
+    if (store->count == store->capacity)
+    {
+        long capacity = store->capacity > 0 ? store->capacity * 2 : VERSION_RECORDS_MIN;
+        VersionRecord *records = realloc(store->records, capacity * sizeof(VersionRecord));
+        if (records == NULL)
+        {
+            printf("Error: Could not allocate memory for row versions\n");
+            exit(1);
+        }
+        store->records = records;
+        store->capacity = capacity;
+    }
+    if (2 * (store->count + 1) > store->map_capacity)
+    {
+        map_rebuild(store, store->count + 1);
+    }
+
+    VersionRecord *record = &store->records[store->count];
+    record->ts = store->published + 1;
+    record->id = id;
+    record->existed = before != NULL;
+    memset(record->name, 0, sizeof(record->name));
+    if (before != NULL)
+    {
+        memcpy(record->name, before->name, sizeof(record->name));
+    }
+    long slot = map_slot(store, id);
+    record->older = store->map_ids[slot] != 0 && store->map_positions[slot] >= store->base
+                        ? store->map_positions[slot] : -1;
+    store->map_ids[slot] = id;
+    store->map_positions[slot] = store->base + store->count;
+    store->count++;
+    store->recorded++;
+    __atomic_store_n(&store->newest, record->ts, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&store->lock);
+}
+
+// Make the writer's changes visible to snapshots taken from now on, as one step, and drop
+// the records nobody needs any more (called as the writer lets go of its outermost hold)
+void versions_publish(Database *db)
+{
+    VersionStore *store = db->versions;
+    pthread_mutex_lock(&store->lock);
+    if (store->pending)
+    {
+        store->published++;
+        store->pending = 0;
+        store->unversioned = 0;
+        collect(store);
+        pthread_cond_broadcast(&store->published_cond);
+    }
+    pthread_mutex_unlock(&store->lock);
+}
+
+// Take a snapshot of the published changes. If the writer is in the middle of changes it
+// keeps no records for, wait until it publishes them (the writer never waits for readers);
+// a snapshot taken by the writer itself includes its own changes.
+void snapshot_begin(Database *db, Snapshot *snapshot)
+{
+    VersionStore *store = db->versions;
+    pthread_mutex_lock(&store->lock);
+    if (holds_writer(db))
+    {
+        snapshot->ts = store->published + (uint64_t)store->pending;
+    }
+    else
+    {
+        while (store->unversioned)
+        {
+            pthread_cond_wait(&store->published_cond, &store->lock);
+        }
+        snapshot->ts = store->published;
+    }
+    if (store->num_snapshots == store->snapshot_capacity)
+    {
+        int capacity = store->snapshot_capacity > 0 ? store->snapshot_capacity * 2 : 16;
+        uint64_t *snapshots = realloc(store->snapshots, capacity * sizeof(uint64_t));
+        if (snapshots == NULL)
+        {
+            printf("Error: Could not allocate memory for snapshots\n");
+            exit(1);
+        }
+        store->snapshots = snapshots;
+        store->snapshot_capacity = capacity;
+    }
+    store->snapshots[store->num_snapshots++] = snapshot->ts;
+    pthread_mutex_unlock(&store->lock);
+}
+
+// Close a snapshot, releasing the records only it still needed
+void snapshot_end(Database *db, Snapshot *snapshot)
+{
+    VersionStore *store = db->versions;
+    pthread_mutex_lock(&store->lock);
+    for (int i = 0; i < store->num_snapshots; i++)
+    {
+        if (store->snapshots[i] == snapshot->ts)
+        {
+            store->snapshots[i] = store->snapshots[--store->num_snapshots];
+            break;
+        }
+    }
+    collect(store);
+    pthread_mutex_unlock(&store->lock);
+}
+
+// How a row looked to a snapshot: 1 with the row copied out, 0 if it did not exist, or -1
+// if it has not changed since (the caller's read of the current row stands). Read the
+// current row first: a change the read saw has its record in place by then.
+int snapshot_version(Database *db, const Snapshot *snapshot, int id, struct Row *row)
+{
+    VersionStore *store = db->versions;
+    if (__atomic_load_n(&store->newest, __ATOMIC_ACQUIRE) <= snapshot->ts)
+    {
+        return -1; // nothing changed since the snapshot
+    }
+    pthread_mutex_lock(&store->lock);
+    // The oldest change after the snapshot holds the image the snapshot saw
+    const VersionRecord *oldest = NULL;
+    long position = map_find(store, id);
+    while (position >= store->base)
+    {
+        const VersionRecord *record = &store->records[position - store->base];
+        if (record->ts <= snapshot->ts)
+        {
+            break;
+        }
+        oldest = record;
+        position = record->older;
+    }
+    int result = -1;
+    if (oldest != NULL)
+    {
+        result = oldest->existed;
+        if (oldest->existed)
+        {
+            row->id = id;
+            memcpy(row->name, oldest->name, sizeof(row->name));
+        }
+    }
+    pthread_mutex_unlock(&store->lock);
+    return result;
+}
+
+// Append to ids (grown as needed) the ids in lo..hi changed after the snapshot, looking at
+// the records from position on; returns the position to continue from. Records a snapshot
+// needs are not dropped while it is open, so repeated calls see every change.
+long versions_changed(Database *db, const Snapshot *snapshot, long position, int lo, int hi, int **ids,
+                      int *count, int *capacity)
+{
+    VersionStore *store = db->versions;
+    pthread_mutex_lock(&store->lock);
+    long end = store->base + store->count;
+    for (long p = position > store->base ? position : store->base; p < end; p++)
+    {
+        const VersionRecord *record = &store->records[p - store->base];
+        if (record->ts <= snapshot->ts || record->id < lo || record->id > hi)
+        {
+            continue;
+        }
+        if (*count == *capacity)
+        {
+            int grown = *capacity > 0 ? *capacity * 2 : 64;
+            int *more = realloc(*ids, grown * sizeof(int));
+            if (more == NULL)
+            {
+                printf("Error: Could not allocate memory for row versions\n");
+                exit(1);
+            }
+            *ids = more;
+            *capacity = grown;
+        }
+        (*ids)[(*count)++] = record->id;
+    }
+    pthread_mutex_unlock(&store->lock);
+    return end;
+}
+
+// Report the records kept and the snapshots holding them
+void versions_get_stats(Database *db, VersionStats *stats)
+{
+    VersionStore *store = db->versions;
+    pthread_mutex_lock(&store->lock);
+    stats->records = store->count;
+    stats->snapshots = store->num_snapshots;
+    stats->published = store->published;
+    stats->recorded = store->recorded;
+    stats->collected = store->collected;
+    pthread_mutex_unlock(&store->lock);
+}
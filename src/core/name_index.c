@@ -0,0 +1,473 @@
+#include "../../include/coredb.h"
+
+// Pin a name index page for reading or changing in place
+static NameNode *fetch_name_node(Database *db, off_t offset)
+{
+    NameNode *node = buffer_pool_fetch(db->pool, offset);
+    if (node == NULL)
+    {
+        printf("Error: Failed to read name index node at offset %lld\n", (long long)offset);
+        exit(1);
+    }
+    return node;
+}
+
+// Copy a name index node out of the buffer pool
+static void read_name_node(Database *db, off_t offset, NameNode *node)
+{
+    memcpy(node, fetch_name_node(db, offset), sizeof(NameNode));
+    buffer_pool_unpin(db->pool, offset, 0);
+}
+
+// Write a name index node into the buffer pool
+static void write_name_node(Database *db, off_t offset, const NameNode *node)
+{
+    void *page = buffer_pool_fetch_new(db->pool, offset);
+    if (page == NULL)
+    {
+        printf("Error: Failed to write name index node at offset %lld\n", (long long)offset);
+        exit(1);
+    }
+    memset(page, 0, PAGE_SIZE);
+    memcpy(page, node, sizeof(NameNode));
+    buffer_pool_unpin(db->pool, offset, 1);
+}
+
+// Build the key of an entry; names are zero padded so whole keys compare with memcmp order
+static void make_key(NameKey *key, const char *name, int id)
+{
+    memset(key->name, 0, sizeof(key->name));
+    strncpy(key->name, name, sizeof(key->name) - 1);
+    key->id = id;
+}
+
+// Keys a name index node of this kind holds when full
+static int name_max_keys(const NameNode *node)
+{
+    return node->is_leaf ? NAME_LEAF_KEYS : NAME_INTERNAL_KEYS;
+}
+
+// Position of the first leaf entry not below key
+static int leaf_lower_bound(const NameNode *node, const NameKey *key)
+{
+    int lo = 0;
+    int hi = node->num_keys;
+    while (lo < hi)
+    {
+        int mid = (lo + hi) / 2;
+        if (compare_name_keys(&node->data.entries[mid], key) < 0)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// Child of an internal node that covers key: the number of separators not above it
+static int name_child_index(const NameNode *node, const NameKey *key)
+{
+    int lo = 0;
+    int hi = node->num_keys;
+    while (lo < hi)
+    {
+        int mid = (lo + hi) / 2;
+        if (compare_name_keys(&node->data.internal.keys[mid], key) <= 0)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// Latch a name index node for a reader that started at version (see read_begin); NULL, with
+// nothing latched, once a restructure has begun and the reader has to start over
+static const NameNode *latch_name_node(Database *db, off_t offset, unsigned long version)
+{
+    const NameNode *node = buffer_pool_latch(db->pool, offset);
+    if (!read_valid(db, version))
+    {
+        if (node != NULL)
+        {
+            buffer_pool_unlatch(db->pool, offset);
+        }
+        return NULL;
+    }
+    if (node == NULL)
+    {
+        printf("Error: Failed to read name index node at offset %lld\n", (long long)offset);
+        exit(1);
+    }
+    return node;
+}
+
+// Descend to the leaf that covers key for a reader and return it latched, with the version
+// it is valid at (NULL while there is no name index)
+static const NameNode *latch_name_leaf(Database *db, const NameKey *key, unsigned long *version,
+                                       off_t *leaf_offset)
+{
+    while (1)
+    {
+        *version = read_begin(db);
+        off_t offset = __atomic_load_n(&db->name_root, __ATOMIC_ACQUIRE);
+        if (offset == 0)
+        {
+            return NULL;
+        }
+        const NameNode *node;
+        while ((node = latch_name_node(db, offset, *version)) != NULL && !node->is_leaf)
+        {
+            off_t child_offset = PAGE_OFFSET(node->data.internal.children[name_child_index(node, key)]);
+            buffer_pool_unlatch(db->pool, offset);
+            offset = child_offset;
+        }
+        if (node != NULL)
+        {
+            *leaf_offset = offset;
+            return node;
+        }
+    }
+}
+
+// Split the full child i of a node that has room, as split_child does for the id index
+// (returns 0 if no page is left)
+static int split_name_child(Database *db, off_t parent_offset, NameNode *parent, int i)
+{
+    NameNode child;
+    off_t child_offset = PAGE_OFFSET(parent->data.internal.children[i]);
+    read_name_node(db, child_offset, &child);
+    off_t right_offset = allocate_node(db);
+    if (right_offset == -1)
+    {
+        printf("Error: Cannot split name index node - no page for a new node\n");
+        return 0;
+    }
+    begin_restructure(db);
+
+    NameNode right = {0};
+    right.is_leaf = child.is_leaf;
+    int mid = child.num_keys / 2;
+    NameKey pivot;
+    if (child.is_leaf)
+    {
+        // Leaf split: the right half starts with the separator, and joins the leaf chain
+        pivot = child.data.entries[mid];
+        right.num_keys = child.num_keys - mid;
+        memcpy(right.data.entries, &child.data.entries[mid], right.num_keys * sizeof(NameKey));
+        right.next = child.next;
+        child.next = PAGE_NUMBER(right_offset);
+    }
+    else
+    {
+        // Internal split: the middle key moves up and is kept in neither half
+        pivot = child.data.internal.keys[mid];
+        right.num_keys = child.num_keys - mid - 1;
+        memcpy(right.data.internal.keys, &child.data.internal.keys[mid + 1],
+               right.num_keys * sizeof(NameKey));
+        memcpy(right.data.internal.children, &child.data.internal.children[mid + 1],
+               (right.num_keys + 1) * sizeof(uint32_t));
+    }
+    child.num_keys = mid;
+
+    memmove(&parent->data.internal.keys[i + 1], &parent->data.internal.keys[i],
+            (parent->num_keys - i) * sizeof(NameKey));
+    memmove(&parent->data.internal.children[i + 2], &parent->data.internal.children[i + 1],
+            (parent->num_keys - i) * sizeof(uint32_t));
+    parent->data.internal.keys[i] = pivot;
+    parent->data.internal.children[i + 1] = PAGE_NUMBER(right_offset);
+    parent->num_keys++;
+
+    write_name_node(db, child_offset, &child);
+    write_name_node(db, right_offset, &right);
+    write_name_node(db, parent_offset, parent);
+    end_restructure(db);
+    return 1;
+}
+
+// Start an empty name index in a page the caller has allocated
+void name_index_init(Database *db, off_t offset)
+{
+    NameNode root = {0};
+    root.is_leaf = 1;
+    write_name_node(db, offset, &root);
+    __atomic_store_n(&db->name_root, offset, __ATOMIC_RELEASE);
+}
+
+// Add the entry of a row. Full nodes are split on the way down, as in btree_insert (returns
+// 0 if no page is left for a split).
+int name_index_insert(Database *db, const char *name, int id)
+{
+    if (db->name_root == 0)
+    {
+        return 1; // built from the table once the log is replayed
+    }
+    NameKey key;
+    make_key(&key, name, id);
+
+    NameNode node;
+    read_name_node(db, db->name_root, &node);
+    if (node.num_keys >= name_max_keys(&node))
+    {
+        off_t new_root_offset = allocate_node(db);
+        if (new_root_offset == -1)
+        {
+            printf("Error: Cannot split name index root - no page for a new node\n");
+            return 0;
+        }
+        NameNode new_root = {0};
+        new_root.data.internal.children[0] = PAGE_NUMBER(db->name_root);
+        begin_restructure(db);
+        if (!split_name_child(db, new_root_offset, &new_root, 0))
+        {
+            free_node(db, new_root_offset);
+            end_restructure(db);
+            return 0;
+        }
+        __atomic_store_n(&db->name_root, new_root_offset, __ATOMIC_RELEASE);
+        end_restructure(db);
+        node = new_root;
+    }
+
+    off_t current_offset = db->name_root;
+    while (!node.is_leaf)
+    {
+        int i = name_child_index(&node, &key);
+        off_t child_offset = PAGE_OFFSET(node.data.internal.children[i]);
+        NameNode child;
+        read_name_node(db, child_offset, &child);
+        if (child.num_keys >= name_max_keys(&child))
+        {
+            if (!split_name_child(db, current_offset, &node, i))
+            {
+                return 0;
+            }
+            if (compare_name_keys(&key, &node.data.internal.keys[i]) >= 0)
+            {
+                child_offset = PAGE_OFFSET(node.data.internal.children[i + 1]);
+            }
+            read_name_node(db, child_offset, &child);
+        }
+        current_offset = child_offset;
+        node = child;
+    }
+
+    int i = leaf_lower_bound(&node, &key);
+    memmove(&node.data.entries[i + 1], &node.data.entries[i], (node.num_keys - i) * sizeof(NameKey));
+    node.data.entries[i] = key;
+    node.num_keys++;
+    write_name_node(db, current_offset, &node);
+    return 1;
+}
+
+// Remove the entry of a row. Leaves are not merged: an emptied leaf stays in the chain
+// (scans step over it) and takes later inserts into its key range.
+void name_index_delete(Database *db, const char *name, int id)
+{
+    if (db->name_root == 0)
+    {
+        return;
+    }
+    NameKey key;
+    make_key(&key, name, id);
+
+    off_t offset = db->name_root;
+    NameNode *node = fetch_name_node(db, offset);
+    while (!node->is_leaf)
+    {
+        off_t child_offset = PAGE_OFFSET(node->data.internal.children[name_child_index(node, &key)]);
+        buffer_pool_unpin(db->pool, offset, 0);
+        offset = child_offset;
+        node = fetch_name_node(db, offset);
+    }
+    int i = leaf_lower_bound(node, &key);
+    int found = i < node->num_keys && compare_name_keys(&node->data.entries[i], &key) == 0;
+    if (found)
+    {
+        memmove(&node->data.entries[i], &node->data.entries[i + 1],
+                (node->num_keys - i - 1) * sizeof(NameKey));
+        node->num_keys--;
+    }
+    buffer_pool_unpin(db->pool, offset, found);
+}
+
+// Return every page of a name index subtree to the allocator
+static void free_name_tree(Database *db, off_t offset)
+{
+    NameNode node;
+    read_name_node(db, offset, &node);
+    if (!node.is_leaf)
+    {
+        for (int i = 0; i <= node.num_keys; i++)
+        {
+            free_name_tree(db, PAGE_OFFSET(node.data.internal.children[i]));
+        }
+    }
+    free_node(db, offset);
+}
+
+// Free the whole name index (before it is rebuilt)
+void name_index_free(Database *db)
+{
+    if (db->name_root != 0)
+    {
+        begin_restructure(db);
+        free_name_tree(db, db->name_root);
+        __atomic_store_n(&db->name_root, 0, __ATOMIC_RELEASE);
+        end_restructure(db);
+    }
+}
+
+// Position a cursor on the first entry for name (prefix: the first name starting with it)
+void name_index_seek(Database *db, const char *name, int prefix, NameCursor *cursor)
+{
+    NameKey key;
+    make_key(&key, name, INT32_MIN);
+    memcpy(cursor->name, key.name, sizeof(cursor->name));
+    cursor->prefix = prefix;
+    cursor->started = 0;
+    cursor->leaf = 0;
+    cursor->index = 0;
+    off_t offset;
+    const NameNode *node = latch_name_leaf(db, &key, &cursor->version, &offset);
+    if (node == NULL)
+    {
+        return;
+    }
+    cursor->leaf = offset;
+    cursor->index = leaf_lower_bound(node, &key);
+    buffer_pool_unlatch(db->pool, offset);
+}
+
+// Whether a leaf entry comes after the cursor: past the entry returned last, or not below
+// the name before the first
+static int after_cursor(const NameCursor *cursor, const NameKey *entry, const NameKey *start)
+{
+    int cmp = compare_name_keys(entry, start);
+    return cursor->started ? cmp > 0 : cmp >= 0;
+}
+
+// Latch the leaf under a cursor and return the index of its next entry there. Entries shift
+// within leaves in place, so the index is checked against the key returned last, and a leaf
+// split since is found again by a descent to that key.
+static const NameNode *latch_name_cursor(Database *db, NameCursor *cursor, int *index)
+{
+    NameKey start;
+    if (cursor->started)
+    {
+        start = cursor->last;
+    }
+    else
+    {
+        memcpy(start.name, cursor->name, sizeof(start.name));
+        start.id = INT32_MIN;
+    }
+    const NameNode *node = latch_name_node(db, cursor->leaf, cursor->version);
+    if (node == NULL)
+    {
+        node = latch_name_leaf(db, &start, &cursor->version, &cursor->leaf);
+        if (node == NULL)
+        {
+            cursor->leaf = 0; // the name index is being rebuilt
+            return NULL;
+        }
+    }
+    int i = cursor->index;
+    if (i > node->num_keys || (i < node->num_keys && !after_cursor(cursor, &node->data.entries[i], &start)) ||
+        (i > 0 && i <= node->num_keys && after_cursor(cursor, &node->data.entries[i - 1], &start)))
+    {
+        i = leaf_lower_bound(node, &start);
+        if (cursor->started && i < node->num_keys && compare_name_keys(&node->data.entries[i], &start) == 0)
+        {
+            i++;
+        }
+    }
+    *index = i;
+    return node;
+}
+
+// Return the id under the cursor and advance it along the leaf chain
+// (returns 0 once the names stop matching)
+int name_index_next(Database *db, NameCursor *cursor, int *id)
+{
+    while (cursor->leaf != 0)
+    {
+        int index;
+        const NameNode *node = latch_name_cursor(db, cursor, &index);
+        if (node == NULL)
+        {
+            return 0;
+        }
+        off_t node_offset = cursor->leaf;
+        if (index < node->num_keys)
+        {
+            const NameKey *entry = &node->data.entries[index];
+            int match = cursor->prefix ? strncmp(entry->name, cursor->name, strlen(cursor->name)) == 0
+                                       : memcmp(entry->name, cursor->name, sizeof(entry->name)) == 0;
+            if (match)
+            {
+                *id = entry->id;
+                cursor->last = *entry;
+                cursor->started = 1;
+                cursor->index = index + 1;
+            }
+            else
+            {
+                cursor->leaf = 0;
+            }
+            buffer_pool_unlatch(db->pool, node_offset);
+            return match;
+        }
+
+        // Leaf exhausted (or emptied by deletes): continue with its right sibling
+        cursor->leaf = PAGE_OFFSET(node->next);
+        cursor->index = 0;
+        buffer_pool_unlatch(db->pool, node_offset);
+    }
+    return 0;
+}
+
+// Check key order along the leaf chain and count the entries (returns 1 if valid)
+int name_index_verify(Database *db, long *keys)
+{
+    *keys = 0;
+    if (db->name_root == 0)
+    {
+        return 1;
+    }
+    NameNode node;
+    off_t offset = db->name_root;
+    read_name_node(db, offset, &node);
+    while (!node.is_leaf)
+    {
+        offset = PAGE_OFFSET(node.data.internal.children[0]);
+        read_name_node(db, offset, &node);
+    }
+
+    NameKey previous;
+    while (1)
+    {
+        for (int i = 0; i < node.num_keys; i++)
+        {
+            if (*keys > 0 && compare_name_keys(&previous, &node.data.entries[i]) >= 0)
+            {
+                printf("Error: Name index key out of order in leaf at offset %lld\n", (long long)offset);
+                return 0;
+            }
+            previous = node.data.entries[i];
+            (*keys)++;
+        }
+        if (node.next == 0)
+        {
+            return 1;
+        }
+        offset = PAGE_OFFSET(node.next);
+        read_name_node(db, offset, &node);
+    }
+}
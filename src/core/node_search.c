@@ -0,0 +1,168 @@
+#include "../../include/coredb.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#endif
+
+// Binary search narrows internal nodes to this many keys before the vector compare
+#define SIMD_WINDOW 16
+
+// Reference scan: index of the first key greater than id
+int child_index_linear(const int *keys, int num_keys, int id)
+{
+    int i;
+    for (i = 0; i < num_keys; i++)
+    {
+        if (id < keys[i])
+        {
+            break;
+        }
+    }
+    return i;
+}
+
+// Shrink [base, base + *len) to at most `window` keys that still hold the first key greater
+// than id. The comparison only selects the next base, so it compiles to a conditional move.
+static const int *narrow_keys(const int *base, int *len, int id, int window)
+{
+    int n = *len;
+    while (n > window)
+    {
+        int half = n / 2;
+        base = (base[half] <= id) ? base + half : base;
+        n -= half;
+    }
+    *len = n;
+    return base;
+}
+
+// Branchless binary search: number of keys less than or equal to id
+int child_index_binary(const int *keys, int num_keys, int id)
+{
+    if (num_keys == 0)
+    {
+        return 0;
+    }
+    int n = num_keys;
+    const int *base = narrow_keys(keys, &n, id, 1);
+    return (int)(base - keys) + (*base <= id);
+}
+
+// Count keys <= id in a short run
+static int count_keys_scalar(const int *keys, int n, int id)
+{
+    int count = 0;
+    for (int i = 0; i < n; i++)
+    {
+        count += (keys[i] <= id);
+    }
+    return count;
+}
+
+#ifdef HAVE_X86_SIMD
+// Count keys <= id, eight at a time
+__attribute__((target("avx2")))
+static int count_keys_avx2(const int *keys, int n, int id)
+{
+    __m256i target = _mm256_set1_epi32(id);
+    int count = 0;
+    int i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+        __m256i block = _mm256_loadu_si256((const __m256i *)(keys + i));
+        __m256i greater = _mm256_cmpgt_epi32(block, target);
+        count += 8 - __builtin_popcount(_mm256_movemask_ps(_mm256_castsi256_ps(greater)));
+    }
+    return count + count_keys_scalar(keys + i, n - i, id);
+}
+
+// Count keys <= id, four at a time
+__attribute__((target("sse4.2")))
+static int count_keys_sse4(const int *keys, int n, int id)
+{
+    __m128i target = _mm_set1_epi32(id);
+    int count = 0;
+    int i = 0;
+    for (; i + 4 <= n; i += 4)
+    {
+        __m128i block = _mm_loadu_si128((const __m128i *)(keys + i));
+        __m128i greater = _mm_cmpgt_epi32(block, target);
+        count += 4 - __builtin_popcount(_mm_movemask_ps(_mm_castsi128_ps(greater)));
+    }
+    return count + count_keys_scalar(keys + i, n - i, id);
+}
+#endif
+
+// Window counter picked on first use from the CPU's features
+static int (*count_keys)(const int *keys, int n, int id) = NULL;
+static const char *simd_name = NULL;
+
+// Choose the widest vector compare the CPU supports
+static void select_simd(void)
+{
+#ifdef HAVE_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        simd_name = "avx2";
+        count_keys = count_keys_avx2;
+        return;
+    }
+    if (__builtin_cpu_supports("sse4.2"))
+    {
+        simd_name = "sse4.2";
+        count_keys = count_keys_sse4;
+        return;
+    }
+#endif
+    simd_name = "scalar";
+    count_keys = count_keys_scalar;
+}
+
+// Binary search down to a window, then a vector compare across it
+int child_index_simd(const int *keys, int num_keys, int id)
+{
+    if (count_keys == NULL)
+    {
+        select_simd();
+    }
+    int n = num_keys;
+    const int *base = narrow_keys(keys, &n, id, SIMD_WINDOW);
+    return (int)(base - keys) + count_keys(base, n, id);
+}
+
+// Name of the vector instruction set in use ("scalar" without one)
+const char *node_search_simd_name(void)
+{
+    if (simd_name == NULL)
+    {
+        select_simd();
+    }
+    return simd_name;
+}
+
+// Child of an internal node to descend into for id
+int node_child_index(const BTreeNode *node, int id)
+{
+    return child_index_simd(node->data.internal.keys, node->num_keys, id);
+}
+
+// Position of the first leaf entry with an id not less than the one given
+int node_leaf_index(const BTreeNode *node, int id)
+{
+    const int32_t *ids = node->data.leaf.ids;
+    int n = node->num_keys;
+    if (n == 0)
+    {
+        return 0;
+    }
+    const int32_t *base = ids;
+    while (n > 1)
+    {
+        int half = n / 2;
+        base = (base[half] < id) ? base + half : base;
+        n -= half;
+    }
+    return (int)(base - ids) + (*base < id);
+}
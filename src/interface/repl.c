@@ -1,18 +1,273 @@
 #include "../../include/coredb.h"
+#include <limits.h>
+
+#define REPL_BATCH_ROWS 128
+
+// Parse "<id> <name>, <id> <name>, ..." (returns the rows parsed, -1 if malformed)
+static int parse_row_list(const char *list, struct Row *rows, int max_rows)
+{
+    char copy[1024];
+    snprintf(copy, sizeof(copy), "%s", list);
+    int count = 0;
+    for (char *item = strtok(copy, ","); item != NULL; item = strtok(NULL, ","))
+    {
+        char extra;
+        if (count == max_rows)
+        {
+            return -1;
+        }
+        memset(&rows[count], 0, sizeof(struct Row));
+        if (sscanf(item, "%d %59s %c", &rows[count].id, rows[count].name, &extra) != 2)
+        {
+            return -1;
+        }
+        count++;
+    }
+    return count;
+}
+
+// Parse "<id>, <id>, ..." (returns the ids parsed, -1 if malformed)
+static int parse_id_list(const char *list, int *ids, int max_ids)
+{
+    char copy[1024];
+    snprintf(copy, sizeof(copy), "%s", list);
+    int count = 0;
+    for (char *item = strtok(copy, ","); item != NULL; item = strtok(NULL, ","))
+    {
+        char extra;
+        if (count == max_ids || sscanf(item, "%d %c", &ids[count], &extra) != 1)
+        {
+            return -1;
+        }
+        count++;
+    }
+    return count;
+}
+
+// Print the rows with ids lo..hi in id order
+static void print_range(Database *db, int lo, int hi)
+{
+    RangeCursor cursor;
+    struct Row row;
+    int count = 0;
+    select_range(db, lo, hi, &cursor);
+    while (range_next(db, &cursor, &row))
+    {
+        printf("Row %d: id=%d, name=%s\n", count++, row.id, row.name);
+    }
+    if (count == 0)
+    {
+        printf("No rows to display\n");
+    }
+}
+
+// Print the rows named name (or, with prefix, whose names start with it) in name order
+static void print_names(Database *db, const char *name, int prefix)
+{
+    NameCursor cursor;
+    struct Row row;
+    int count = 0;
+    select_by_name(db, name, prefix, &cursor);
+    while (name_next(db, &cursor, &row))
+    {
+        printf("Row %d: id=%d, name=%s\n", count++, row.id, row.name);
+    }
+    if (count == 0)
+    {
+        printf("No rows to display\n");
+    }
+}
+
+// Run "SELECT WHERE name = <name>" or "SELECT WHERE name LIKE '<prefix>%'"
+static void select_where(Database *db, const char *input)
+{
+    char value[62];
+    char quote, extra;
+    if (sscanf(input, "SELECT WHERE name = %61s %c", value, &extra) == 1)
+    {
+        // The name may be quoted
+        size_t len = strlen(value);
+        if (len >= 2 && value[0] == '\'' && value[len - 1] == '\'')
+        {
+            value[len - 1] = '\0';
+            memmove(value, value + 1, len - 1);
+            len -= 2;
+        }
+        if (len < 60)
+        {
+            print_names(db, value, 0);
+            return;
+        }
+    }
+    else if (sscanf(input, "SELECT WHERE name LIKE '%60[^']%c %c", value, &quote, &extra) == 2)
+    {
+        // Only a trailing % is supported, and it turns the pattern into a prefix
+        size_t len = strlen(value);
+        int prefix = value[len - 1] == '%';
+        if (prefix)
+        {
+            value[--len] = '\0';
+        }
+        if (strchr(value, '%') == NULL && len < 60)
+        {
+            print_names(db, value, prefix);
+            return;
+        }
+    }
+    printf("Error: Invalid SELECT format. Use: SELECT WHERE name = <name> or SELECT WHERE name LIKE '<prefix>%%'\n");
+}
+
+// Run "SELECT COUNT" or "SELECT COUNT <lo>..<hi>"
+static void select_count(Database *db, const char *input)
+{
+    int lo = 1;
+    int hi = INT_MAX;
+    char extra;
+    if (strcmp(input, "SELECT COUNT") != 0 && sscanf(input, "SELECT COUNT %d..%d %c", &lo, &hi, &extra) != 2)
+    {
+        printf("Error: Invalid SELECT COUNT format. Use: SELECT COUNT or SELECT COUNT <lo>..<hi>\n");
+        return;
+    }
+    long count = count_rows(db, lo, hi);
+    if (count >= 0)
+    {
+        printf("Count: %ld\n", count);
+    }
+}
+
+// Run "SELECT ORDER BY id LIMIT <n> [OFFSET <m>]": one descent to the first row of the page
+static void select_page(Database *db, const char *input)
+{
+    int limit;
+    long offset = 0;
+    char extra;
+    int fields = sscanf(input, "SELECT ORDER BY id LIMIT %d OFFSET %ld %c", &limit, &offset, &extra);
+    if ((fields != 1 && fields != 2) || limit < 0 || (fields == 1 && strstr(input, "OFFSET") != NULL))
+    {
+        printf("Error: Invalid SELECT format. Use: SELECT ORDER BY id LIMIT <n> [OFFSET <m>]\n");
+        return;
+    }
+    RangeCursor cursor;
+    struct Row row;
+    int count = 0;
+    if (!select_from_offset(db, offset, &cursor))
+    {
+        return;
+    }
+    while (count < limit && range_next(db, &cursor, &row))
+    {
+        printf("Row %ld: id=%d, name=%s\n", offset + count, row.id, row.name);
+        count++;
+    }
+    if (count == 0)
+    {
+        printf("No rows to display\n");
+    }
+}
+
+// Queue each row of a list in the open transaction (returns the number queued)
+static int queue_rows(Transaction *txn, const struct Row *rows, int count, int type)
+{
+    int queued = 0;
+    for (int i = 0; i < count; i++)
+    {
+        queued += type == WAL_INSERT ? txn_insert(txn, rows[i].id, rows[i].name)
+                                     : txn_update(txn, rows[i].id, rows[i].name);
+    }
+    return queued;
+}
+
+// Handle BEGIN, COMMIT and ROLLBACK (returns 0 if input is none of them)
+static int transaction_command(Database *db, Transaction *txn, const char *input)
+{
+    if (strcmp(input, "BEGIN") == 0)
+    {
+        if (txn->active)
+        {
+            printf("Error: A transaction is already open\n");
+        }
+        else
+        {
+            txn_begin(db, txn);
+            printf("Transaction started\n");
+        }
+    }
+    else if (strcmp(input, "COMMIT") == 0)
+    {
+        int count = txn->count;
+        if (!txn->active)
+        {
+            printf("Error: No transaction is open\n");
+        }
+        else if (txn_commit(txn))
+        {
+            printf("Committed %d changes\n", count);
+        }
+        else
+        {
+            printf("Transaction rolled back: its changes no longer apply\n");
+        }
+    }
+    else if (strcmp(input, "ROLLBACK") == 0)
+    {
+        if (!txn->active)
+        {
+            printf("Error: No transaction is open\n");
+        }
+        else
+        {
+            printf("Rolled back %d changes\n", txn->count);
+            txn_abort(txn);
+        }
+    }
+    else
+    {
+        return 0;
+    }
+    return 1;
+}
 
 // REPL loop (unchanged)
+// Check every page of the file against its checksum
+static void verify_checksums(Database *db)
+{
+    ChecksumStats stats;
+    if (verify_page_checksums(db, &stats))
+    {
+        printf("Checksums OK: %lu pages verified, %lu without a checksum yet\n", stats.verified, stats.unchecked);
+    }
+    else
+    {
+        printf("Checksums FAILED: %lu of %lu pages\n", stats.failures, stats.verified + stats.failures);
+    }
+}
+
 void run_repl(Database *db)
 {
     // print instructions
     printf("Welcome to the database REPL!\n");
     printf("Available Commands:\n");
     printf("  INSERT <id> <name>      - Insert a new row\n");
+    printf("  INSERT <id> <name>, ... - Insert several rows with one commit\n");
     printf("  SELECT <id>             - Select a row by ID\n");
     printf("  SELECT                  - Select all rows\n");
-    printf("  UPDATE <id> <new_name>  - Update a row by ID\n");
-    printf("  DELETE <id>             - Delete a row by ID\n");
+    printf("  SELECT <lo>..<hi>       - Select rows with IDs in a range, in ID order\n");
+    printf("  SELECT ORDER BY id      - Select all rows in ID order\n");
+    printf("  SELECT WHERE name = <n> - Select rows by name (or LIKE '<prefix>%%')\n");
+    printf("  SELECT COUNT [<lo>..<hi>] - Count all rows, or the rows with IDs in a range\n");
+    printf("  SELECT ORDER BY id LIMIT <n> [OFFSET <m>] - Select a page of rows in ID order\n");
+    printf("  RANK <id>               - Count the rows with smaller IDs\n");
+    printf("  UPDATE <id> <new_name>  - Update a row by ID (or several: <id> <name>, ...)\n");
+    printf("  DELETE <id>             - Delete a row by ID (or several: <id>, <id>, ...)\n");
+    printf("  STATS                   - Show buffer pool and log statistics\n");
+    printf("  CHECKPOINT              - Write dirty pages and empty the log\n");
+    printf("  COMPACT                 - Move rows into free slots and free empty pages\n");
+    printf("  VERIFY                  - Check the index invariants and page checksums\n");
+    printf("  BEGIN / COMMIT / ROLLBACK - Group changes into one transaction, committed with one flush\n");
     printf("  exit                    - Exit the REPL\n");
-    char input[100];
+    char input[1024];
+    Transaction txn;
+    memset(&txn, 0, sizeof(Transaction)); // changes apply at once unless BEGIN opens it
     while (1)
     {
         printf("db>");
@@ -23,7 +278,27 @@ void run_repl(Database *db)
         input[strcspn(input, "\n")] = 0; // Remove newline character
 
         // Evaluate & Print part of REPL loop --------
-        if (strncmp(input, "INSERT", 6) == 0)
+        if (transaction_command(db, &txn, input))
+        {
+            continue;
+        }
+        if (strncmp(input, "INSERT", 6) == 0 && strchr(input, ',') != NULL)
+        {
+            struct Row rows[REPL_BATCH_ROWS];
+            int count = parse_row_list(input + 6, rows, REPL_BATCH_ROWS);
+            if (count < 0)
+            {
+                printf("Error: Invalid INSERT format. Use: INSERT <id> <name>, <id> <name>, ...\n");
+                continue;
+            }
+            if (txn.active)
+            {
+                printf("Queued %d of %d rows for insert\n", queue_rows(&txn, rows, count, WAL_INSERT), count);
+                continue;
+            }
+            printf("Inserted %d of %d rows\n", insert_rows(db, rows, count), count);
+        }
+        else if (strncmp(input, "INSERT", 6) == 0)
         {
             int id;
             char name[60];
@@ -38,15 +313,76 @@ void run_repl(Database *db)
                 continue;
             }
 
-            if (insert_row(db, id, name))
+            if (txn.active)
+            {
+                if (txn_insert(&txn, id, name))
+                {
+                    printf("Queued insert: id=%d, name=%s\n", id, name);
+                }
+            }
+            else if (insert_row(db, id, name))
             {
                 printf("Inserted row: id=%d, name=%s\n", id, name);
             }
         }
-        else if (strncmp(input, "SELECT", 6) == 0)
+        else if (strncmp(input, "SELECT WHERE", 12) == 0)
+        {
+            select_where(db, input);
+        }
+        else if (strncmp(input, "SELECT COUNT", 12) == 0)
+        {
+            select_count(db, input);
+        }
+        else if (strncmp(input, "SELECT ORDER BY id LIMIT", 24) == 0)
+        {
+            select_page(db, input);
+        }
+        else if (strncmp(input, "RANK", 4) == 0)
         {
             int id;
+            char extra;
+            if (sscanf(input, "RANK %d %c", &id, &extra) != 1)
+            {
+                printf("Error: Invalid RANK format. Use: RANK <id>\n");
+                continue;
+            }
+            long rank = rank_of_id(db, id);
+            if (rank >= 0)
+            {
+                printf("Rank of id=%d: %ld rows have smaller IDs\n", id, rank);
+            }
+        }
+        else if (strncmp(input, "SELECT", 6) == 0)
+        {
+            int id, lo, hi;
             char trailing[100];
+            int fields = sscanf(input, "SELECT %d..%d %99[^\n]", &lo, &hi, trailing);
+            if (fields >= 2 || strcmp(input, "SELECT ORDER BY id") == 0)
+            {
+                // Ranges and ordered listings walk the index leaves in key order
+                if (fields == 3 && strcmp(trailing, "ORDER BY id") != 0)
+                {
+                    printf("Error: Invalid SELECT format. Use: SELECT <lo>..<hi> [ORDER BY id]\n");
+                    continue;
+                }
+                if (fields < 2)
+                {
+                    lo = 1;
+                    hi = INT_MAX;
+                }
+                if (lo <= 0 || hi < lo)
+                {
+                    printf("Error: Invalid range %d..%d\n", lo, hi);
+                    continue;
+                }
+                if (db->hashed)
+                {
+                    printf("Error: Ranges need the B+tree index; this table is hashed (point lookups only)\n");
+                    continue;
+                }
+                print_range(db, lo, hi);
+                continue;
+            }
             if (sscanf(input, "SELECT %d %s", &id, trailing) == 2)
             {
                 printf("Error: Invalid SELECT format. Use: SELECT <id> or SELECT\n");
@@ -60,7 +396,8 @@ void run_repl(Database *db)
                     continue;
                 }
                 struct Row row;
-                if (select_by_id(db, id, &row))
+                // Inside a transaction its own changes show
+                if (txn.active ? txn_select(&txn, id, &row) : select_by_id(db, id, &row))
                 {
                     printf("Row: id=%d, name=%s\n", row.id, row.name);
                 }
@@ -86,6 +423,22 @@ void run_repl(Database *db)
                 }
             }
         }
+        else if (strncmp(input, "UPDATE", 6) == 0 && strchr(input, ',') != NULL)
+        {
+            struct Row rows[REPL_BATCH_ROWS];
+            int count = parse_row_list(input + 6, rows, REPL_BATCH_ROWS);
+            if (count < 0)
+            {
+                printf("Error: Invalid UPDATE format. Use: UPDATE <id> <new_name>, <id> <new_name>, ...\n");
+                continue;
+            }
+            if (txn.active)
+            {
+                printf("Queued %d of %d rows for update\n", queue_rows(&txn, rows, count, WAL_UPDATE), count);
+                continue;
+            }
+            printf("Updated %d of %d rows\n", update_rows(db, rows, count), count);
+        }
         else if (strncmp(input, "UPDATE", 6) == 0)
         {
             int id;
@@ -100,11 +453,39 @@ void run_repl(Database *db)
                 printf("Error: ID must be a positive integer (got %d)\n", id);
                 continue;
             }
-            if (update_row(db, id, name))
+            if (txn.active)
+            {
+                if (txn_update(&txn, id, name))
+                {
+                    printf("Queued update: id=%d, new name=%s\n", id, name);
+                }
+            }
+            else if (update_row(db, id, name))
             {
                 printf("Updated row: id=%d, new name=%s\n", id, name);
             }
         }
+        else if (strncmp(input, "DELETE", 6) == 0 && strchr(input, ',') != NULL)
+        {
+            int ids[REPL_BATCH_ROWS];
+            int count = parse_id_list(input + 6, ids, REPL_BATCH_ROWS);
+            if (count < 0)
+            {
+                printf("Error: Invalid DELETE format. Use: DELETE <id>, <id>, ...\n");
+                continue;
+            }
+            if (txn.active)
+            {
+                int queued = 0;
+                for (int i = 0; i < count; i++)
+                {
+                    queued += txn_delete(&txn, ids[i]);
+                }
+                printf("Queued %d of %d rows for delete\n", queued, count);
+                continue;
+            }
+            printf("Deleted %d of %d rows\n", delete_rows(db, ids, count), count);
+        }
         else if (strncmp(input, "DELETE", 6) == 0)
         {
             int id;
@@ -118,7 +499,14 @@ void run_repl(Database *db)
                 printf("Error: ID must be a positive integer (got %d)\n", id);
                 continue;
             }
-            if (!delete_row(db, id))
+            if (txn.active)
+            {
+                if (txn_delete(&txn, id))
+                {
+                    printf("Queued delete: id=%d\n", id);
+                }
+            }
+            else if (!delete_row(db, id))
             {
                 printf("Row with id=%d not found\n", id);
             }
@@ -127,6 +515,111 @@ void run_repl(Database *db)
                 printf("Deleted row with id=%d\n", id);
             }
         }
+        else if (strncmp(input, "STATS", 5) == 0)
+        {
+            BufferPoolStats stats;
+            buffer_pool_get_stats(db->pool, &stats);
+            if (stats.mapped_bytes > 0)
+            {
+                printf("Storage: mmap, %zu bytes mapped, %lu page accesses, %d dirty\n",
+                       stats.mapped_bytes, stats.hits, stats.pages_dirty);
+            }
+            else
+            {
+                unsigned long lookups = stats.hits + stats.misses;
+                printf("Buffer pool: %d/%d frames used, %d pinned, %d dirty\n",
+                       stats.pages_cached, stats.num_frames, stats.pages_pinned, stats.pages_dirty);
+                printf("  hits=%lu misses=%lu hit_ratio=%.2f%%\n", stats.hits, stats.misses,
+                       lookups ? 100.0 * stats.hits / lookups : 0.0);
+                printf("  evictions=%lu writebacks=%lu\n", stats.evictions, stats.writebacks);
+            }
+
+            WalStats wal_stats;
+            wal_get_stats(db->wal, &wal_stats);
+            printf("WAL: %lld bytes since checkpoint, %lu commits in %lu flushes (avg group %.2f)\n",
+                   (long long)wal_stats.size, wal_stats.commits, wal_stats.flushes,
+                   wal_stats.flushes ? (double)wal_stats.commits / wal_stats.flushes : 0.0);
+            if (db->clustered)
+            {
+                printf("Pages: %lld in file, %lld free; %lld rows in the index leaves (clustered)\n",
+                       (long long)db->header.page_count, (long long)db->header.free_count,
+                       (long long)db->header.row_count);
+            }
+            else
+            {
+                printf("Pages: %lld in file, %lld data, %lld free; %lld rows, %lld free row slots\n",
+                       (long long)db->header.page_count, (long long)db->header.data_pages,
+                       (long long)db->header.free_count, (long long)db->header.row_count,
+                       (long long)(db->header.data_pages * (off_t)MAX_ROWS - db->header.row_count));
+            }
+            BloomStats bloom;
+            bloom_get_stats(db, &bloom);
+            unsigned long absent = bloom.negatives + bloom.false_positives;
+            printf("Bloom filter: %d pages, %ld/%ld ids, %lu checks, %lu ruled out, false positive rate %.2f%%\n",
+                   bloom.pages, bloom.keys, bloom.capacity, bloom.checks, bloom.negatives,
+                   absent ? 100.0 * bloom.false_positives / absent : 0.0);
+            VersionStats versions;
+            versions_get_stats(db, &versions);
+            printf("Versions: %ld row images kept for %d open snapshots, %lu kept and %lu dropped in all\n",
+                   versions.records, versions.snapshots, versions.recorded, versions.collected);
+            CheckpointStats *ckpt = &db->checkpoint_stats;
+            printf("Checkpoints: %lu, last wrote %zu bytes (%d pages in %d writes), %zu bytes total, %zu double-written\n",
+                   ckpt->checkpoints, ckpt->last_bytes, ckpt->last_pages, ckpt->last_writes,
+                   ckpt->total_bytes, ckpt->double_write_bytes);
+            ChecksumStats sums;
+            page_checksums_get_stats(db->checksums, &sums);
+            printf("Checksums: CRC32C (%s), %lu page reads verified, %lu failed, %lu unchecked\n",
+                   sums.hardware ? "SSE4.2" : "software", sums.verified, sums.failures, sums.unchecked);
+            printf("Recovery: %d pages repaired, %ld log records replayed, %ld skipped as checkpointed\n",
+                   db->recovery.repaired_pages, db->recovery.replayed, db->recovery.skipped);
+        }
+        else if (strncmp(input, "CHECKPOINT", 10) == 0)
+        {
+            size_t bytes = checkpoint(db);
+            printf("Checkpoint wrote %zu bytes in %d writes\n", bytes, db->checkpoint_stats.last_writes);
+        }
+        else if (strncmp(input, "COMPACT", 7) == 0 && db->clustered)
+        {
+            printf("Nothing to compact: rows live in the index leaves, which merge as they empty\n");
+        }
+        else if (strncmp(input, "COMPACT", 7) == 0)
+        {
+            int freed = compact_table(db);
+            printf("Compacted %lld rows into %lld pages, freed %d pages\n",
+                   (long long)db->header.row_count, (long long)db->header.data_pages, freed);
+        }
+        else if (strncmp(input, "VERIFY", 6) == 0 && db->hashed)
+        {
+            HashStats stats;
+            if (hash_index_verify(db, &stats))
+            {
+                printf("Hash index OK: depth %d, %ld directory pages, %ld buckets (%ld empty), %ld keys, %.1f%% full\n",
+                       stats.depth, stats.directory_pages, stats.buckets, stats.empty, stats.keys,
+                       100.0 * stats.keys / (double)stats.capacity);
+            }
+            long names;
+            if (name_index_verify(db, &names))
+            {
+                printf("Name index OK: %ld entries\n", names);
+            }
+            verify_checksums(db);
+        }
+        else if (strncmp(input, "VERIFY", 6) == 0)
+        {
+            BTreeStats stats;
+            if (btree_verify(db, &stats))
+            {
+                printf("Index OK: height %d, %ld nodes (%ld leaves), %ld keys, %.1f%% full, %ld underfull\n",
+                       stats.height, stats.nodes, stats.leaves, stats.keys,
+                       100.0 * stats.used_keys / (double)stats.capacity, stats.underfull);
+            }
+            long names;
+            if (name_index_verify(db, &names))
+            {
+                printf("Name index OK: %ld entries\n", names);
+            }
+            verify_checksums(db);
+        }
         else if (strncmp(input, "exit", 4) == 0)
         {
             break; // Exit the loop
@@ -136,4 +629,9 @@ void run_repl(Database *db)
             printf("You entered: %s\n", input);
         }
     }
+    if (txn.active)
+    {
+        printf("Rolled back the open transaction (%d changes)\n", txn.count);
+        txn_abort(&txn);
+    }
 }
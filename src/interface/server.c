@@ -0,0 +1,700 @@
+#include "../../include/coredb.h"
+#include <errno.h>
+#include <stdarg.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// Line protocol, modeled on the simple types of RESP. A request is one line ending in "\n"
+// (a "\r" before it is ignored), and every request gets one reply, in order:
+//
+//   PING                     +PONG
+//   GET <id>                 =<id> <name>, or -ERR not found
+//   INSERT <id> <name>       +OK, or -ERR duplicate id
+//   UPDATE <id> <name>       +OK, or -ERR not found
+//   DELETE <id>              +OK, or -ERR not found
+//   RANGE <lo> <hi> [<n>]    *<count>, then one =<id> <name> line per row (n: at most
+//                            SERVER_MAX_RANGE_ROWS, the default)
+//   COUNT                    :<rows>
+//   QUIT                     +BYE, then the server closes the connection
+//
+// Replies end in "\r\n"; malformed requests get -ERR <message>. Clients may pipeline: send
+// many requests before reading the replies. Writes are acknowledged only once durable, and
+// the writes read in one pass over the ready connections are applied and committed together.
+
+// epoll tags of the descriptors that are not clients
+#define TAG_TCP SERVER_MAX_CLIENTS
+#define TAG_UNIX (SERVER_MAX_CLIENTS + 1)
+#define TAG_WAKE (SERVER_MAX_CLIENTS + 2)
+// Wake up this often when idle, so a pending timed checkpoint is not held back
+#define IDLE_WAIT_MS 1000
+
+// Make a descriptor non-blocking (returns 0 on failure)
+static int set_nonblocking(int fd)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags != -1 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) != -1;
+}
+
+// Register a descriptor with the event loop (returns 0 on failure)
+static int watch(Server *server, int fd, uint32_t events, int tag, int op)
+{
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = events;
+    event.data.u32 = (uint32_t)tag;
+    return epoll_ctl(server->epoll_fd, op, fd, &event) == 0;
+}
+
+// Open a listening TCP socket on address:port (returns the descriptor, -1 on failure)
+static int listen_tcp(Server *server, const char *address, int port)
+{
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)port);
+    if (inet_pton(AF_INET, address, &addr.sin_addr) != 1)
+    {
+        printf("Error: Invalid listen address %s\n", address);
+        return -1;
+    }
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int reuse = 1;
+    if (fd == -1 || setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) != 0 ||
+        bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, SOMAXCONN) != 0 ||
+        !set_nonblocking(fd))
+    {
+        printf("Error: Could not listen on %s:%d: %s\n", address, port, strerror(errno));
+        if (fd != -1)
+        {
+            close(fd);
+        }
+        return -1;
+    }
+    // Report the port picked for port 0
+    socklen_t len = sizeof(addr);
+    getsockname(fd, (struct sockaddr *)&addr, &len);
+    server->port = ntohs(addr.sin_port);
+    return fd;
+}
+
+// Open a listening Unix socket, replacing a stale socket file (returns -1 on failure)
+static int listen_unix(const char *path)
+{
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path))
+    {
+        printf("Error: Socket path %s is too long\n", path);
+        return -1;
+    }
+    strcpy(addr.sun_path, path);
+    unlink(path);
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1 || bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, SOMAXCONN) != 0 ||
+        !set_nonblocking(fd))
+    {
+        printf("Error: Could not listen on %s: %s\n", path, strerror(errno));
+        if (fd != -1)
+        {
+            close(fd);
+        }
+        return -1;
+    }
+    return fd;
+}
+
+// Create the listeners and the event loop for a database (returns NULL on failure)
+Server *server_open(Database *db, const ServerOptions *options)
+{
+    Server *server = calloc(1, sizeof(Server));
+    if (server == NULL)
+    {
+        printf("Error: Could not allocate memory for the server\n");
+        return NULL;
+    }
+    server->db = db;
+    server->tcp_fd = -1;
+    server->unix_fd = -1;
+    server->wake_fd = -1;
+    server->clients = calloc(SERVER_MAX_CLIENTS, sizeof(ServerClient));
+    server->batch = malloc(SERVER_BATCH_WRITES * sizeof(WriteRequest));
+    server->batch_clients = malloc(SERVER_BATCH_WRITES * sizeof(int));
+    server->epoll_fd = epoll_create1(0);
+    server->wake_fd = eventfd(0, EFD_NONBLOCK);
+    if (server->clients == NULL || server->batch == NULL || server->batch_clients == NULL ||
+        server->epoll_fd == -1 || server->wake_fd == -1)
+    {
+        printf("Error: Could not set up the server event loop\n");
+        server_close(server);
+        return NULL;
+    }
+    for (int c = 0; c < SERVER_MAX_CLIENTS; c++)
+    {
+        server->clients[c].fd = -1;
+    }
+
+    if (options->port >= 0)
+    {
+        const char *address = options->bind_address != NULL ? options->bind_address : "127.0.0.1";
+        server->tcp_fd = listen_tcp(server, address, options->port);
+        if (server->tcp_fd == -1)
+        {
+            server_close(server);
+            return NULL;
+        }
+    }
+    if (options->socket_path != NULL)
+    {
+        server->unix_fd = listen_unix(options->socket_path);
+        if (server->unix_fd == -1)
+        {
+            server_close(server);
+            return NULL;
+        }
+        snprintf(server->socket_path, sizeof(server->socket_path), "%s", options->socket_path);
+    }
+    if (server->tcp_fd == -1 && server->unix_fd == -1)
+    {
+        printf("Error: The server needs a TCP port or a socket path\n");
+        server_close(server);
+        return NULL;
+    }
+    if ((server->tcp_fd != -1 && !watch(server, server->tcp_fd, EPOLLIN, TAG_TCP, EPOLL_CTL_ADD)) ||
+        (server->unix_fd != -1 && !watch(server, server->unix_fd, EPOLLIN, TAG_UNIX, EPOLL_CTL_ADD)) ||
+        !watch(server, server->wake_fd, EPOLLIN, TAG_WAKE, EPOLL_CTL_ADD))
+    {
+        printf("Error: Could not register the listeners with epoll\n");
+        server_close(server);
+        return NULL;
+    }
+    return server;
+}
+
+// Queue reply text for a client (a client that cannot get memory is dropped)
+static void reply(ServerClient *client, const char *format, ...)
+{
+    char line[SERVER_MAX_LINE + 64];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (len >= (int)sizeof(line))
+    {
+        len = sizeof(line) - 1;
+    }
+    if (client->out_len + len + 2 > client->out_cap)
+    {
+        size_t cap = client->out_cap ? client->out_cap * 2 : 4096;
+        while (cap < client->out_len + len + 2)
+        {
+            cap *= 2;
+        }
+        char *out = realloc(client->out, cap);
+        if (out == NULL)
+        {
+            printf("Error: Could not allocate memory for a reply, dropping the client\n");
+            client->closing = 1;
+            client->out_len = client->out_sent;
+            return;
+        }
+        client->out = out;
+        client->out_cap = cap;
+    }
+    memcpy(client->out + client->out_len, line, len);
+    memcpy(client->out + client->out_len + len, "\r\n", 2);
+    client->out_len += len + 2;
+}
+
+// Apply the batched writes with one commit and queue their replies
+static void flush_batch(Server *server)
+{
+    if (server->batch_len == 0)
+    {
+        return;
+    }
+    apply_writes(server->db, server->batch, server->batch_len);
+    for (int i = 0; i < server->batch_len; i++)
+    {
+        ServerClient *client = &server->clients[server->batch_clients[i]];
+        const WriteRequest *write = &server->batch[i];
+        if (write->applied)
+        {
+            reply(client, "+OK");
+        }
+        else
+        {
+            reply(client, write->type == WAL_INSERT ? "-ERR duplicate id" : "-ERR not found");
+        }
+        client->pending_writes = 0;
+    }
+    server->writes += server->batch_len;
+    server->commits++;
+    server->batch_len = 0;
+}
+
+// Commit the batch if it holds writes of a client: a reply queued for the client now must
+// follow the replies those writes are owed, or pipelined replies come back out of order
+static void settle_writes(Server *server, ServerClient *client)
+{
+    if (client->pending_writes > 0)
+    {
+        flush_batch(server);
+    }
+}
+
+// Add a write to the batch; its reply is queued when the batch commits
+static void queue_write(Server *server, int slot, int type, int id, const char *name)
+{
+    if (server->batch_len == SERVER_BATCH_WRITES)
+    {
+        flush_batch(server);
+    }
+    WriteRequest *write = &server->batch[server->batch_len];
+    write->type = type;
+    write->id = id;
+    memset(write->name, 0, sizeof(write->name));
+    if (name != NULL)
+    {
+        snprintf(write->name, sizeof(write->name), "%s", name);
+    }
+    server->batch_clients[server->batch_len++] = slot;
+    server->clients[slot].pending_writes++;
+}
+
+// Reply to RANGE with up to limit rows in id order
+static void reply_range(Server *server, ServerClient *client, int lo, int hi, int limit)
+{
+    struct Row *rows = malloc(limit * sizeof(struct Row));
+    if (rows == NULL)
+    {
+        reply(client, "-ERR out of memory");
+        return;
+    }
+    RangeCursor cursor;
+    int count = 0;
+    select_range(server->db, lo, hi, &cursor);
+    while (count < limit && range_next(server->db, &cursor, &rows[count]))
+    {
+        count++;
+    }
+    reply(client, "*%d", count);
+    for (int i = 0; i < count; i++)
+    {
+        reply(client, "=%d %s", rows[i].id, rows[i].name);
+    }
+    free(rows);
+}
+
+// Run one request line of a client
+static void handle_request(Server *server, int slot, const char *line)
+{
+    ServerClient *client = &server->clients[slot];
+    char command[16];
+    char name[60];
+    char extra;
+    int id, lo, hi, limit;
+    server->requests++;
+    if (sscanf(line, "%15s", command) != 1)
+    {
+        settle_writes(server, client);
+        reply(client, "-ERR empty request");
+        return;
+    }
+
+    // Writes wait for the batch; anything else a client sends after its own writes must see
+    // them and be answered after them, so the batch commits first
+    if (strcmp(command, "INSERT") == 0 || strcmp(command, "UPDATE") == 0)
+    {
+        if (sscanf(line, "%*s %d %59s %c", &id, name, &extra) != 2 || id <= 0)
+        {
+            settle_writes(server, client);
+            reply(client, "-ERR usage: %s <id> <name> with a positive id", command);
+            return;
+        }
+        queue_write(server, slot, command[0] == 'I' ? WAL_INSERT : WAL_UPDATE, id, name);
+        return;
+    }
+    if (strcmp(command, "DELETE") == 0)
+    {
+        if (sscanf(line, "%*s %d %c", &id, &extra) != 1 || id <= 0)
+        {
+            settle_writes(server, client);
+            reply(client, "-ERR usage: DELETE <id> with a positive id");
+            return;
+        }
+        queue_write(server, slot, WAL_DELETE, id, NULL);
+        return;
+    }
+    settle_writes(server, client);
+
+    if (strcmp(command, "GET") == 0)
+    {
+        struct Row row;
+        if (sscanf(line, "%*s %d %c", &id, &extra) != 1 || id <= 0)
+        {
+            reply(client, "-ERR usage: GET <id> with a positive id");
+        }
+        else if (select_by_id(server->db, id, &row))
+        {
+            reply(client, "=%d %s", row.id, row.name);
+        }
+        else
+        {
+            reply(client, "-ERR not found");
+        }
+    }
+    else if (strcmp(command, "RANGE") == 0)
+    {
+        limit = SERVER_MAX_RANGE_ROWS;
+        int fields = sscanf(line, "%*s %d %d %d %c", &lo, &hi, &limit, &extra);
+        if (fields < 2 || fields > 3 || lo <= 0 || hi < lo || limit < 0 || limit > SERVER_MAX_RANGE_ROWS)
+        {
+            reply(client, "-ERR usage: RANGE <lo> <hi> [<n>] with 0 < lo <= hi and n <= %d",
+                  SERVER_MAX_RANGE_ROWS);
+        }
+        else if (server->db->hashed)
+        {
+            reply(client, "-ERR ranges need the B+tree index; this table is hashed");
+        }
+        else
+        {
+            reply_range(server, client, lo, hi, limit);
+        }
+    }
+    else if (strcmp(command, "COUNT") == 0)
+    {
+        reply(client, ":%ld", count_rows(server->db, 1, INT32_MAX));
+    }
+    else if (strcmp(command, "PING") == 0)
+    {
+        reply(client, "+PONG");
+    }
+    else if (strcmp(command, "QUIT") == 0)
+    {
+        reply(client, "+BYE");
+        client->closing = 1;
+    }
+    else
+    {
+        reply(client, "-ERR unknown command %s", command);
+    }
+}
+
+// Run the complete request lines a client has sent, as long as its replies are being read
+static void handle_input(Server *server, int slot)
+{
+    ServerClient *client = &server->clients[slot];
+    size_t start = 0;
+    while (!client->closing && client->out_len - client->out_sent < SERVER_OUTPUT_LIMIT)
+    {
+        char *newline = memchr(client->in + start, '\n', client->in_len - start);
+        if (newline == NULL)
+        {
+            break;
+        }
+        size_t end = newline - client->in;
+        if (end > start && client->in[end - 1] == '\r')
+        {
+            end--;
+        }
+        char line[SERVER_MAX_LINE + 1];
+        size_t len = end - start;
+        if (len > SERVER_MAX_LINE)
+        {
+            settle_writes(server, client);
+            reply(client, "-ERR request longer than %d bytes", SERVER_MAX_LINE);
+            client->closing = 1;
+            break;
+        }
+        memcpy(line, client->in + start, len);
+        line[len] = '\0';
+        start = newline - client->in + 1;
+        handle_request(server, slot, line);
+    }
+    memmove(client->in, client->in + start, client->in_len - start);
+    client->in_len -= start;
+    if (!client->closing && client->in_len == SERVER_INPUT_BYTES && memchr(client->in, '\n', client->in_len) == NULL)
+    {
+        // A full buffer without a newline
+        settle_writes(server, client);
+        reply(client, "-ERR request longer than %d bytes", SERVER_MAX_LINE);
+        client->closing = 1;
+    }
+}
+
+// Read what a client has sent and run its requests (returns 0 once it hung up)
+static int read_client(Server *server, int slot)
+{
+    ServerClient *client = &server->clients[slot];
+    while (client->in_len < SERVER_INPUT_BYTES)
+    {
+        ssize_t n = read(client->fd, client->in + client->in_len, SERVER_INPUT_BYTES - client->in_len);
+        if (n > 0)
+        {
+            client->in_len += n;
+            continue;
+        }
+        if (n == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+        {
+            handle_input(server, slot);
+            return 0;
+        }
+        break;
+    }
+    handle_input(server, slot);
+    return 1;
+}
+
+// Release a client slot
+static void close_client(Server *server, int slot)
+{
+    ServerClient *client = &server->clients[slot];
+    close(client->fd); // also removes it from the epoll set
+    free(client->in);
+    free(client->out);
+    memset(client, 0, sizeof(ServerClient));
+    client->fd = -1;
+    server->num_clients--;
+}
+
+// Accept every pending connection on a listener
+static void accept_clients(Server *server, int listen_fd)
+{
+    while (1)
+    {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return; // EAGAIN, or an error the next accept may not have
+        }
+        int slot = 0;
+        while (slot < SERVER_MAX_CLIENTS && server->clients[slot].fd != -1)
+        {
+            slot++;
+        }
+        char *in = slot < SERVER_MAX_CLIENTS ? malloc(SERVER_INPUT_BYTES) : NULL;
+        if (in == NULL || !set_nonblocking(fd))
+        {
+            printf("Error: Refusing a connection, %d clients connected\n", server->num_clients);
+            free(in);
+            close(fd);
+            continue;
+        }
+        if (listen_fd == server->tcp_fd)
+        {
+            // Replies to pipelined requests go out as soon as they are written
+            int nodelay = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+        }
+        ServerClient *client = &server->clients[slot];
+        memset(client, 0, sizeof(ServerClient));
+        client->fd = fd;
+        client->in = in;
+        client->events = EPOLLIN;
+        if (!watch(server, fd, EPOLLIN, slot, EPOLL_CTL_ADD))
+        {
+            printf("Error: Could not register a connection with epoll\n");
+            free(in);
+            close(fd);
+            client->fd = -1;
+            client->in = NULL;
+            continue;
+        }
+        server->num_clients++;
+    }
+}
+
+// Send a client its queued replies, then let it be read again once they drain, or close
+// it once it is done (returns 0 if the client was closed)
+static int send_replies(Server *server, int slot)
+{
+    ServerClient *client = &server->clients[slot];
+    while (client->out_sent < client->out_len)
+    {
+        ssize_t n = send(client->fd, client->out + client->out_sent, client->out_len - client->out_sent,
+                         MSG_NOSIGNAL);
+        if (n > 0)
+        {
+            client->out_sent += n;
+            continue;
+        }
+        if (n == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            break;
+        }
+        close_client(server, slot); // the peer is gone
+        return 0;
+    }
+    if (client->out_sent == client->out_len)
+    {
+        client->out_sent = client->out_len = 0;
+        if (client->closing)
+        {
+            close_client(server, slot);
+            return 0;
+        }
+    }
+
+    // Wait for room to send while replies are queued; stop reading while too many are
+    int events = client->out_sent < client->out_len ? EPOLLOUT : 0;
+    if (!client->closing && client->out_len - client->out_sent < SERVER_OUTPUT_LIMIT)
+    {
+        events |= EPOLLIN;
+    }
+    if (events != client->events)
+    {
+        watch(server, client->fd, events, slot, EPOLL_CTL_MOD);
+        client->events = events;
+    }
+    return 1;
+}
+
+// Serve clients until server_stop (returns 1 on a clean stop, 0 if the event loop failed)
+int server_run(Server *server)
+{
+    struct epoll_event events[64];
+    char *touched = calloc(SERVER_MAX_CLIENTS, 1);
+    if (touched == NULL)
+    {
+        printf("Error: Could not allocate memory for the server\n");
+        return 0;
+    }
+    int ok = 1;
+    while (!__atomic_load_n(&server->stopping, __ATOMIC_ACQUIRE))
+    {
+        int count = epoll_wait(server->epoll_fd, events, 64, IDLE_WAIT_MS);
+        if (count == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            perror("Error: epoll_wait failed");
+            ok = 0;
+            break;
+        }
+        if (count == 0)
+        {
+            checkpoint_if_needed(server->db);
+            continue;
+        }
+
+        // Read every ready client first, so their writes share one commit
+        for (int e = 0; e < count; e++)
+        {
+            int tag = (int)events[e].data.u32;
+            if (tag == TAG_TCP || tag == TAG_UNIX)
+            {
+                accept_clients(server, tag == TAG_TCP ? server->tcp_fd : server->unix_fd);
+                continue;
+            }
+            if (tag == TAG_WAKE)
+            {
+                continue;
+            }
+            ServerClient *client = &server->clients[tag];
+            if (client->fd == -1)
+            {
+                continue;
+            }
+            if (events[e].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+            {
+                if (!read_client(server, tag))
+                {
+                    client->closing = 1;
+                }
+            }
+            touched[tag] = 1;
+        }
+        flush_batch(server);
+
+        for (int slot = 0; slot < SERVER_MAX_CLIENTS; slot++)
+        {
+            if (!touched[slot])
+            {
+                continue;
+            }
+            touched[slot] = 0;
+            if (server->clients[slot].fd == -1 || !send_replies(server, slot))
+            {
+                continue;
+            }
+            // Requests left unread while replies backed up run once the replies drain
+            ServerClient *client = &server->clients[slot];
+            if (client->in_len > 0 && (client->events & EPOLLIN) && memchr(client->in, '\n', client->in_len))
+            {
+                handle_input(server, slot);
+                flush_batch(server);
+                send_replies(server, slot);
+            }
+        }
+    }
+    free(touched);
+    flush_batch(server);
+    return ok;
+}
+
+// Ask a running server_run to return; safe to call from a signal handler or another thread
+void server_stop(Server *server)
+{
+    uint64_t one = 1;
+    __atomic_store_n(&server->stopping, 1, __ATOMIC_RELEASE);
+    ssize_t written = write(server->wake_fd, &one, sizeof(one));
+    (void)written;
+}
+
+// Close every connection and listener (the database stays open)
+void server_close(Server *server)
+{
+    if (server->clients != NULL)
+    {
+        for (int slot = 0; slot < SERVER_MAX_CLIENTS; slot++)
+        {
+            if (server->clients[slot].fd != -1)
+            {
+                close_client(server, slot);
+            }
+        }
+    }
+    if (server->tcp_fd != -1)
+    {
+        close(server->tcp_fd);
+    }
+    if (server->unix_fd != -1)
+    {
+        close(server->unix_fd);
+        unlink(server->socket_path);
+    }
+    if (server->wake_fd != -1)
+    {
+        close(server->wake_fd);
+    }
+    if (server->epoll_fd != -1)
+    {
+        close(server->epoll_fd);
+    }
+    free(server->clients);
+    free(server->batch);
+    free(server->batch_clients);
+    free(server);
+}
@@ -1,8 +1,145 @@
 #include "../include/coredb.h"
+#include <signal.h>
 
-int main()
+// Server stopped by SIGINT or SIGTERM
+static Server *serving;
+
+// Stop the server so the database closes cleanly
+static void stop_serving(int signal_number)
+{
+    (void)signal_number;
+    server_stop(serving);
+}
+
+// Serve the database until a signal stops the server (returns 0 on a clean stop)
+static int serve(Database *db, const ServerOptions *server_options)
+{
+    serving = server_open(db, server_options);
+    if (serving == NULL)
+    {
+        return 1;
+    }
+    if (serving->tcp_fd != -1)
+    {
+        printf("Serving on %s:%d\n",
+               server_options->bind_address != NULL ? server_options->bind_address : "127.0.0.1", serving->port);
+    }
+    if (serving->unix_fd != -1)
+    {
+        printf("Serving on %s\n", serving->socket_path);
+    }
+    fflush(stdout);
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = stop_serving;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+
+    int ok = server_run(serving);
+    printf("Server stopped after %lu requests (%lu writes in %lu commits)\n", serving->requests,
+           serving->writes, serving->commits);
+    server_close(serving);
+    return ok ? 0 : 1;
+}
+
+// Print command-line usage
+static void print_usage(const char *program)
+{
+    printf("Usage: %s [--mmap] [--no-sync] [--clustered] [--hash] [--load <file> [--fill <percent>]]\n", program);
+    printf("       %s --serve [--port <port>] [--bind <address>] [--socket <path>] [options]\n", program);
+    printf("  --mmap       Serve index and data pages from a memory mapping of the file\n");
+    printf("  --no-sync    Commit without fdatasync (survives process crashes, not power loss)\n");
+    printf("  --clustered  Create a new database with the rows stored in the index leaves\n");
+    printf("  --hash       Create a new database indexed by a hash table (point lookups only)\n");
+    printf("  --load       Bulk load \"<id> <name>\" lines into an empty table, then exit\n");
+    printf("  --fill       Percent of each index node filled by --load (default %d)\n",
+           BULK_LOAD_FILL_PERCENT);
+    printf("  --serve      Serve clients over the network instead of reading commands from stdin\n");
+    printf("  --port       TCP port to serve on (default %d)\n", SERVER_DEFAULT_PORT);
+    printf("  --bind       Address to serve TCP on (default 127.0.0.1)\n");
+    printf("  --socket     Serve on a Unix socket; without --port, on the socket only\n");
+}
+
+int main(int argc, char *argv[])
 {
-    Database db = init_db("coredb.db");
+    DbOptions options = {0};
+    const char *load_path = NULL;
+    int fill_percent = BULK_LOAD_FILL_PERCENT;
+    int serve_clients = 0;
+    int port_given = 0;
+    ServerOptions server_options = {NULL, SERVER_DEFAULT_PORT, NULL};
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--mmap") == 0)
+        {
+            options.use_mmap = 1;
+        }
+        else if (strcmp(argv[i], "--no-sync") == 0)
+        {
+            options.no_sync = 1;
+        }
+        else if (strcmp(argv[i], "--clustered") == 0)
+        {
+            options.clustered = 1;
+        }
+        else if (strcmp(argv[i], "--hash") == 0)
+        {
+            options.hashed = 1;
+        }
+        else if (strcmp(argv[i], "--load") == 0 && i + 1 < argc)
+        {
+            load_path = argv[++i];
+        }
+        else if (strcmp(argv[i], "--fill") == 0 && i + 1 < argc)
+        {
+            fill_percent = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--serve") == 0)
+        {
+            serve_clients = 1;
+        }
+        else if (strcmp(argv[i], "--port") == 0 && i + 1 < argc)
+        {
+            server_options.port = atoi(argv[++i]);
+            port_given = 1;
+        }
+        else if (strcmp(argv[i], "--bind") == 0 && i + 1 < argc)
+        {
+            server_options.bind_address = argv[++i];
+        }
+        else if (strcmp(argv[i], "--socket") == 0 && i + 1 < argc)
+        {
+            server_options.socket_path = argv[++i];
+        }
+        else
+        {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    Database db = init_db_with_options("coredb.db", &options);
+    if (load_path != NULL)
+    {
+        int loaded = load_file(&db, load_path, fill_percent);
+        close_db(&db);
+        if (loaded < 0)
+        {
+            return 1;
+        }
+        printf("Loaded %d rows from %s\n", loaded, load_path);
+        return 0;
+    }
+    if (serve_clients)
+    {
+        if (server_options.socket_path != NULL && !port_given)
+        {
+            server_options.port = -1;
+        }
+        int status = serve(&db, &server_options);
+        close_db(&db);
+        return status;
+    }
     run_repl(&db);
     close_db(&db);
     printf("File closed successfully\n");
@@ -0,0 +1,1097 @@
+#include "../../include/coredb.h"
+#include <unistd.h>
+
+// Write the staged pages with one pwrite, retrying short writes (their checksums are
+// written with the header that installs them)
+static int stream_flush(PageStream *stream)
+{
+    const unsigned char *data = stream->batch;
+    size_t len = (size_t)stream->batch_pages * PAGE_SIZE;
+    off_t position = stream->batch_offset;
+    for (int i = 0; i < stream->batch_pages; i++)
+    {
+        page_checksums_set(stream->checksums, position + (off_t)i * PAGE_SIZE, data + (size_t)i * PAGE_SIZE);
+    }
+    while (len > 0)
+    {
+        ssize_t written = pwrite(stream->fd, data, len, position);
+        if (written <= 0)
+        {
+            perror("Error: Could not write bulk-loaded pages");
+            return 0;
+        }
+        data += written;
+        len -= (size_t)written;
+        position += written;
+    }
+    stream->batch_offset = stream->next_offset;
+    stream->batch_pages = 0;
+    return 1;
+}
+
+// Hand out the next page of the stream, zeroed (returns NULL if a write failed)
+static unsigned char *stream_page(PageStream *stream)
+{
+    if (stream->batch_pages == BULK_BATCH_PAGES && !stream_flush(stream))
+    {
+        return NULL;
+    }
+    unsigned char *page = stream->batch + (size_t)stream->batch_pages * PAGE_SIZE;
+    memset(page, 0, PAGE_SIZE);
+    stream->batch_pages++;
+    stream->next_offset += PAGE_SIZE;
+    return page;
+}
+
+// Return every page of an index subtree to the allocator
+static void free_tree(Database *db, off_t offset)
+{
+    BTreeNode node;
+    read_node(db, offset, &node);
+    if (!node.is_leaf)
+    {
+        for (int i = 0; i <= node.num_keys; i++)
+        {
+            free_tree(db, PAGE_OFFSET(node.data.internal.children[i]));
+        }
+    }
+    free_node(db, offset);
+}
+
+// Return every page of the data chain to the allocator
+static void free_data_chain(Database *db, off_t offset)
+{
+    while (offset != 0)
+    {
+        const void *page = fetch_data_page(db, offset);
+        off_t next = data_page_next(page);
+        buffer_pool_unpin(db->pool, offset, 0);
+        free_page(db, offset);
+        offset = next;
+    }
+}
+
+// Emit the densely packed data pages for sorted rows, recording each row's index entry
+static int write_data_pages(PageStream *stream, const struct Row *rows, int count,
+                            int data_pages, IndexEntry *entries, BuiltTable *table)
+{
+    for (int p = 0; p < data_pages; p++)
+    {
+        off_t offset = stream->next_offset;
+        void *page = stream_page(stream);
+        if (page == NULL)
+        {
+            return 0;
+        }
+        data_page_init(page);
+        int first = p * (int)MAX_ROWS;
+        int num_rows = count - first < (int)MAX_ROWS ? count - first : (int)MAX_ROWS;
+        for (int i = 0; i < num_rows; i++)
+        {
+            struct Row row = rows[first + i];
+            row.name[59] = '\0';
+            int slot = data_page_insert(page, &row); // fills slots 0, 1, 2, ...
+            entries[first + i].id = row.id;
+            entries[first + i].address = RID(offset, slot);
+        }
+        set_data_page_next(page, p + 1 < data_pages ? offset + PAGE_SIZE : 0);
+        if (p + 1 == data_pages && data_page_has_room(page))
+        {
+            // Only the tail can have room; it is the whole free-space map
+            ((DataPageHeader *)page)->in_free_list = 1;
+            table->free_space_head = offset;
+        }
+    }
+    return 1;
+}
+
+// Emit the leaves for sorted entries, or row leaves for sorted rows when entries is NULL;
+// keys are spread evenly, so every leaf holds about the same fill
+static int write_leaves(PageStream *stream, const IndexEntry *entries, const struct Row *rows,
+                        int count, int leaves, int *leaf_min, uint32_t *leaf_count)
+{
+    for (int j = 0; j < leaves; j++)
+    {
+        off_t offset = stream->next_offset;
+        BTreeNode *leaf = (BTreeNode *)stream_page(stream);
+        if (leaf == NULL)
+        {
+            return 0;
+        }
+        int first = (int)((long)count * j / leaves);
+        int last = (int)((long)count * (j + 1) / leaves);
+        leaf->is_leaf = entries != NULL ? NODE_LEAF : NODE_ROW_LEAF;
+        leaf->num_keys = last - first;
+        for (int k = first; k < last; k++)
+        {
+            if (entries != NULL)
+            {
+                leaf_set_entry(leaf, k - first, entries[k].id, entries[k].address);
+                continue;
+            }
+            leaf->data.rows.ids[k - first] = rows[k].id;
+            memcpy(leaf->data.rows.names[k - first], rows[k].name, sizeof(rows[k].name));
+            leaf->data.rows.names[k - first][59] = '\0';
+        }
+        leaf->next = j + 1 < leaves ? PAGE_NUMBER(offset + PAGE_SIZE) : 0;
+        leaf_min[j] = count > 0 ? (entries != NULL ? entries[first].id : rows[first].id) : 0;
+        leaf_count[j] = (uint32_t)(last - first);
+    }
+    return 1;
+}
+
+// Emit internal levels above consecutive child nodes until one root remains, given the
+// smallest id and the entry count of each child (returns the root offset)
+static off_t write_internal_levels(PageStream *stream, off_t level_base, int nodes,
+                                   int fanout, int *level_min, uint32_t *level_count)
+{
+    while (nodes > 1)
+    {
+        off_t parent_base = stream->next_offset;
+        int parents = (nodes + fanout - 1) / fanout;
+        for (int q = 0; q < parents; q++)
+        {
+            BTreeNode *node = (BTreeNode *)stream_page(stream);
+            if (node == NULL)
+            {
+                return -1;
+            }
+            int first = (int)((long)nodes * q / parents);
+            int last = (int)((long)nodes * (q + 1) / parents);
+            node->is_leaf = 0;
+            node->num_keys = last - first - 1;
+            uint32_t entries = 0;
+            for (int c = first; c < last; c++)
+            {
+                node->data.internal.children[c - first] = PAGE_NUMBER(level_base + (off_t)c * PAGE_SIZE);
+                node->data.internal.counts[c - first] = level_count[c];
+                entries += level_count[c];
+                if (c > first)
+                {
+                    // Separator: the smallest id in the subtree to its right
+                    node->data.internal.keys[c - first - 1] = level_min[c];
+                }
+            }
+            level_min[q] = level_min[first];
+            level_count[q] = entries;
+        }
+        level_base = parent_base;
+        nodes = parents;
+    }
+    return level_base;
+}
+
+// Emit an index over sorted, unique entries (or rows, for row leaves) bottom-up with
+// fill_percent of each node used (returns the root offset, -1 on failure)
+static off_t write_index(PageStream *stream, const IndexEntry *entries, const struct Row *rows,
+                         int count, int fill_percent)
+{
+    int max_keys = entries != NULL ? LEAF_MAX_KEYS : CLUSTERED_LEAF_ROWS;
+    int leaf_keys = max_keys * fill_percent / 100 > 0 ? max_keys * fill_percent / 100 : 1;
+    int fanout = MAX_CHILDREN * fill_percent / 100 > 2 ? MAX_CHILDREN * fill_percent / 100 : 2;
+    int leaves = count > 0 ? (count + leaf_keys - 1) / leaf_keys : 1;
+    int *level_min = malloc(leaves * sizeof(int));
+    uint32_t *level_count = malloc(leaves * sizeof(uint32_t));
+    if (level_min == NULL || level_count == NULL)
+    {
+        printf("Error: Could not allocate bulk load buffers\n");
+        free(level_min);
+        free(level_count);
+        return -1;
+    }
+    off_t leaf_base = stream->next_offset;
+    off_t root = -1;
+    if (write_leaves(stream, entries, rows, count, leaves, level_min, level_count))
+    {
+        root = write_internal_levels(stream, leaf_base, leaves, fanout, level_min, level_count);
+    }
+    free(level_min);
+    free(level_count);
+    return root;
+}
+
+// Plan the buckets for entries[first..first+count), which share the low depth bits pattern
+// of their hash: one bucket if they fit, else one per value of the next bit, partitioned
+// stably through scratch (returns 0 if the plan outgrows the directory)
+static int plan_buckets(IndexEntry *entries, IndexEntry *scratch, int first, int count,
+                        uint32_t pattern, int depth, HashBucketPlan *plan, int *planned, int max_depth)
+{
+    if (count <= HASH_BUCKET_KEYS)
+    {
+        plan[*planned] = (HashBucketPlan){first, count, pattern, depth};
+        (*planned)++;
+        return 1;
+    }
+    if (depth == max_depth)
+    {
+        printf("Error: Hash directory cannot grow past depth %d\n", max_depth);
+        return 0;
+    }
+    int low = 0;
+    int high = count;
+    for (int i = first; i < first + count; i++)
+    {
+        if (hash_id(entries[i].id) & (1u << depth))
+        {
+            scratch[--high] = entries[i];
+        }
+        else
+        {
+            scratch[low++] = entries[i];
+        }
+    }
+    // The high half was filled backwards; copy it back in order to keep ids sorted
+    memcpy(&entries[first], scratch, low * sizeof(IndexEntry));
+    for (int i = low; i < count; i++)
+    {
+        entries[first + i] = scratch[count - 1 - (i - low)];
+    }
+    return plan_buckets(entries, scratch, first, low, pattern, depth + 1, plan, planned, max_depth) &&
+           plan_buckets(entries, scratch, first + low, count - low, pattern | (1u << depth),
+                        depth + 1, plan, planned, max_depth);
+}
+
+// Group entries sorted by id on the low depth bits of their hash (a counting sort, which
+// keeps ids sorted within each group) and plan their buckets (returns the number of
+// buckets, -1 on failure)
+static int plan_hash_index(IndexEntry *entries, IndexEntry *scratch, int count, int depth,
+                           int max_depth, HashBucketPlan *plan)
+{
+    long groups = 1L << depth;
+    int *starts = calloc(groups + 1, sizeof(int));
+    if (starts == NULL)
+    {
+        printf("Error: Could not allocate bulk load buffers\n");
+        return -1;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        starts[(hash_id(entries[i].id) & (groups - 1)) + 1]++;
+    }
+    for (long g = 0; g < groups; g++)
+    {
+        starts[g + 1] += starts[g];
+    }
+    for (int i = 0; i < count; i++)
+    {
+        scratch[starts[hash_id(entries[i].id) & (groups - 1)]++] = entries[i];
+    }
+    memcpy(entries, scratch, count * sizeof(IndexEntry));
+
+    // starts[g] now ends group g
+    int planned = 0;
+    int first = 0;
+    for (long g = 0; g < groups; g++)
+    {
+        if (!plan_buckets(entries, scratch, first, starts[g] - first, (uint32_t)g, depth, plan,
+                          &planned, max_depth))
+        {
+            free(starts);
+            return -1;
+        }
+        first = starts[g];
+    }
+    free(starts);
+    return planned;
+}
+
+// Emit the planned buckets, chained in plan order, then the directory pages (each bucket
+// fills every slot of its pattern) and the directory root (returns its offset, -1 on failure)
+static off_t write_hash_pages(PageStream *stream, const IndexEntry *entries,
+                              const HashBucketPlan *plan, int planned)
+{
+    int global_depth = 0;
+    for (int b = 0; b < planned; b++)
+    {
+        global_depth = plan[b].depth > global_depth ? plan[b].depth : global_depth;
+    }
+    long slot_count = 1L << global_depth;
+    uint32_t *slots = malloc(slot_count * sizeof(uint32_t));
+    if (slots == NULL)
+    {
+        printf("Error: Could not allocate bulk load buffers\n");
+        return -1;
+    }
+
+    HashDirectory dir = {0};
+    dir.depth = global_depth;
+    dir.first_bucket = PAGE_NUMBER(stream->next_offset);
+    dir.buckets = planned;
+    for (int b = 0; b < planned; b++)
+    {
+        off_t offset = stream->next_offset;
+        HashBucket *bucket = (HashBucket *)stream_page(stream);
+        if (bucket == NULL)
+        {
+            free(slots);
+            return -1;
+        }
+        bucket->num_keys = plan[b].count;
+        bucket->depth = plan[b].depth;
+        bucket->next = b + 1 < planned ? PAGE_NUMBER(offset + PAGE_SIZE) : 0;
+        for (int k = 0; k < plan[b].count; k++)
+        {
+            const IndexEntry *entry = &entries[plan[b].first + k];
+            bucket->ids[k] = entry->id;
+            bucket->pages[k] = PAGE_NUMBER(entry->address);
+            bucket->slots[k] = (uint16_t)RID_SLOT(entry->address);
+        }
+        for (long s = plan[b].pattern; s < slot_count; s += 1L << plan[b].depth)
+        {
+            slots[s] = PAGE_NUMBER(offset);
+        }
+    }
+
+    for (long s = 0; s < slot_count; s += HASH_DIRECTORY_ENTRIES)
+    {
+        dir.pages[dir.num_pages++] = PAGE_NUMBER(stream->next_offset);
+        uint32_t *page = (uint32_t *)stream_page(stream);
+        if (page == NULL)
+        {
+            free(slots);
+            return -1;
+        }
+        long n = slot_count - s < HASH_DIRECTORY_ENTRIES ? slot_count - s : HASH_DIRECTORY_ENTRIES;
+        memcpy(page, &slots[s], n * sizeof(uint32_t));
+    }
+    free(slots);
+
+    off_t root = stream->next_offset;
+    void *page = stream_page(stream);
+    if (page == NULL)
+    {
+        return -1;
+    }
+    memcpy(page, &dir, sizeof(HashDirectory));
+    return root;
+}
+
+// Emit a hash index over entries sorted by id, with buckets of the depth at which they are
+// about fill_percent full; a bucket that would overflow splits one level deeper (returns
+// the root offset, -1 on failure)
+static off_t write_hash_index(PageStream *stream, IndexEntry *entries, int count, int fill_percent)
+{
+    int max_depth = 0;
+    while ((2L << max_depth) <= (long)HASH_MAX_DIRECTORY_PAGES * HASH_DIRECTORY_ENTRIES)
+    {
+        max_depth++;
+    }
+    int bucket_keys = HASH_BUCKET_KEYS * fill_percent / 100 > 0 ? HASH_BUCKET_KEYS * fill_percent / 100 : 1;
+    int depth = 0;
+    while ((1L << depth) * bucket_keys < count && depth < max_depth)
+    {
+        depth++;
+    }
+
+    // Every level of splits adds at most one bucket per HASH_BUCKET_KEYS + 1 entries
+    long max_buckets = (1L << depth) + (long)(max_depth - depth) * (count / (HASH_BUCKET_KEYS + 1)) + 1;
+    IndexEntry *scratch = malloc((count > 0 ? count : 1) * sizeof(IndexEntry));
+    HashBucketPlan *plan = malloc(max_buckets * sizeof(HashBucketPlan));
+    off_t root = -1;
+    if (scratch == NULL || plan == NULL)
+    {
+        printf("Error: Could not allocate bulk load buffers\n");
+    }
+    else
+    {
+        int planned = plan_hash_index(entries, scratch, count, depth, max_depth, plan);
+        root = planned < 0 ? -1 : write_hash_pages(stream, entries, plan, planned);
+    }
+    free(scratch);
+    free(plan);
+    return root;
+}
+
+// Start a page stream at the end of the file, where nothing is cached or mapped yet
+static int stream_open(Database *db, PageStream *stream)
+{
+    stream->fd = fileno(db->file);
+    stream->checksums = db->checksums;
+    stream->next_offset = db->header.page_count * PAGE_SIZE;
+    stream->batch_offset = stream->next_offset;
+    stream->batch_pages = 0;
+    stream->batch = malloc((size_t)BULK_BATCH_PAGES * PAGE_SIZE);
+    if (stream->batch == NULL)
+    {
+        printf("Error: Could not allocate bulk load buffers\n");
+        return 0;
+    }
+    return 1;
+}
+
+// Write out the rest of the stream and make its pages durable and visible to the pool
+// (the stream is released either way; ok says whether writing it succeeded so far)
+static int stream_close(Database *db, PageStream *stream, int ok)
+{
+    ok = ok && stream_flush(stream);
+    free(stream->batch);
+    if (ok && !db->no_sync && fdatasync(stream->fd) != 0)
+    {
+        perror("Error: Could not sync bulk-loaded pages");
+        ok = 0;
+    }
+    if (ok && db->use_mmap && buffer_pool_remap(db->pool, (size_t)stream->next_offset) < 0)
+    {
+        ok = 0;
+    }
+    // On failure the header still describes the old table; the next checkpoint trims the file
+    return ok;
+}
+
+// Write a table for sorted, unique rows after the end of the file in one sequential pass:
+// data pages are packed full and the index is built bottom-up with fill_percent of each
+// node used (a clustered table has no data pages: the rows fill the leaves). Nothing refers
+// to the new pages until install_table (returns 1 once durable).
+static int build_table(Database *db, const struct Row *rows, int count, int fill_percent,
+                       BuiltTable *table)
+{
+    if (db->clustered)
+    {
+        PageStream stream;
+        if (!stream_open(db, &stream))
+        {
+            return 0;
+        }
+        memset(table, 0, sizeof(BuiltTable));
+        table->root_offset = write_index(&stream, NULL, rows, count, fill_percent);
+        table->end_offset = stream.next_offset;
+        return stream_close(db, &stream, table->root_offset != -1);
+    }
+    int data_pages = count > 0 ? (count + (int)MAX_ROWS - 1) / (int)MAX_ROWS : 1;
+    IndexEntry *entries = malloc((count > 0 ? count : 1) * sizeof(IndexEntry));
+    PageStream stream;
+    if (entries == NULL)
+    {
+        printf("Error: Could not allocate bulk load buffers\n");
+        return 0;
+    }
+    if (!stream_open(db, &stream))
+    {
+        free(entries);
+        return 0;
+    }
+
+    memset(table, 0, sizeof(BuiltTable));
+    table->first_data_page = stream.next_offset;
+    table->last_data_page = stream.next_offset + (off_t)(data_pages - 1) * PAGE_SIZE;
+    table->data_pages = data_pages;
+    int ok = write_data_pages(&stream, rows, count, data_pages, entries, table);
+    if (db->hashed)
+    {
+        table->root_offset = ok ? write_hash_index(&stream, entries, count, fill_percent) : -1;
+    }
+    else
+    {
+        table->root_offset = ok ? write_index(&stream, entries, NULL, count, fill_percent) : -1;
+    }
+    table->end_offset = stream.next_offset;
+    free(entries);
+    return stream_close(db, &stream, table->root_offset != -1);
+}
+
+// Emit name index leaves for sorted keys, then internal levels above them until one root
+// remains (returns its offset, -1 on failure)
+static off_t write_name_index(PageStream *stream, const NameKey *keys, int count, int fill_percent)
+{
+    int leaf_keys = NAME_LEAF_KEYS * fill_percent / 100 > 0 ? NAME_LEAF_KEYS * fill_percent / 100 : 1;
+    int fanout = (NAME_INTERNAL_KEYS + 1) * fill_percent / 100 > 2 ? (NAME_INTERNAL_KEYS + 1) * fill_percent / 100 : 2;
+    int nodes = count > 0 ? (count + leaf_keys - 1) / leaf_keys : 1;
+    NameKey *level_min = malloc(nodes * sizeof(NameKey));
+    if (level_min == NULL)
+    {
+        printf("Error: Could not allocate bulk load buffers\n");
+        return -1;
+    }
+
+    off_t level_base = stream->next_offset;
+    for (int j = 0; j < nodes; j++)
+    {
+        off_t offset = stream->next_offset;
+        NameNode *leaf = (NameNode *)stream_page(stream);
+        if (leaf == NULL)
+        {
+            free(level_min);
+            return -1;
+        }
+        int first = (int)((long)count * j / nodes);
+        int last = (int)((long)count * (j + 1) / nodes);
+        leaf->is_leaf = 1;
+        leaf->num_keys = last - first;
+        memcpy(leaf->data.entries, &keys[first], (last - first) * sizeof(NameKey));
+        leaf->next = j + 1 < nodes ? PAGE_NUMBER(offset + PAGE_SIZE) : 0;
+        if (last > first)
+        {
+            level_min[j] = keys[first];
+        }
+    }
+
+    while (nodes > 1)
+    {
+        off_t parent_base = stream->next_offset;
+        int parents = (nodes + fanout - 1) / fanout;
+        for (int q = 0; q < parents; q++)
+        {
+            NameNode *node = (NameNode *)stream_page(stream);
+            if (node == NULL)
+            {
+                free(level_min);
+                return -1;
+            }
+            int first = (int)((long)nodes * q / parents);
+            int last = (int)((long)nodes * (q + 1) / parents);
+            node->num_keys = last - first - 1;
+            for (int c = first; c < last; c++)
+            {
+                node->data.internal.children[c - first] = PAGE_NUMBER(level_base + (off_t)c * PAGE_SIZE);
+                if (c > first)
+                {
+                    node->data.internal.keys[c - first - 1] = level_min[c];
+                }
+            }
+            level_min[q] = level_min[first];
+        }
+        level_base = parent_base;
+        nodes = parents;
+    }
+    free(level_min);
+    return level_base;
+}
+
+// Build the name index from a scan of the table, written after the end of the file in one
+// sequential pass like build_table, and point db->name_root at it (returns 1 once durable;
+// the header refers to it from the next checkpoint on)
+int build_name_index(Database *db)
+{
+    long capacity = db->header.row_count > 0 ? (long)db->header.row_count : 1;
+    NameKey *keys = malloc(capacity * sizeof(NameKey));
+    if (keys == NULL)
+    {
+        printf("Error: Could not allocate memory for the name index\n");
+        return 0;
+    }
+    RangeCursor cursor;
+    struct Row row;
+    long count = 0;
+    select_range(db, 1, INT32_MAX, &cursor);
+    while (count < capacity && range_next(db, &cursor, &row))
+    {
+        memset(&keys[count], 0, sizeof(NameKey));
+        strncpy(keys[count].name, row.name, sizeof(keys[count].name) - 1);
+        keys[count].id = row.id;
+        count++;
+    }
+    qsort(keys, count, sizeof(NameKey), compare_name_keys);
+
+    PageStream stream;
+    if (!stream_open(db, &stream))
+    {
+        free(keys);
+        return 0;
+    }
+    off_t root = write_name_index(&stream, keys, (int)count, BULK_LOAD_FILL_PERCENT);
+    off_t end_offset = stream.next_offset;
+    free(keys);
+    if (!stream_close(db, &stream, root != -1))
+    {
+        return 0;
+    }
+    db->header.page_count = end_offset / PAGE_SIZE;
+    __atomic_store_n(&db->name_root, root, __ATOMIC_RELEASE);
+    return 1;
+}
+
+// Point the header at a built table of count rows
+static void install_table(Database *db, const BuiltTable *table, int count)
+{
+    db->header.page_count = table->end_offset / PAGE_SIZE;
+    db->header.first_data_page = table->first_data_page;
+    db->header.last_data_page = table->last_data_page;
+    db->header.data_pages = table->data_pages;
+    db->header.row_count = count;
+    db->header.free_space_head = table->free_space_head;
+    __atomic_store_n(&db->root_offset, table->root_offset, __ATOMIC_RELEASE);
+}
+
+// Build an empty table from rows for bulk_load, as the writer
+static int load_rows(Database *db, struct Row *rows, int count, int fill_percent)
+{
+    if (fill_percent < 10 || fill_percent > 100)
+    {
+        printf("Error: Fill factor must be between 10 and 100 percent (got %d)\n", fill_percent);
+        return 0;
+    }
+    RangeCursor cursor;
+    int id;
+    off_t address;
+    select_range(db, 1, INT32_MAX, &cursor);
+    if (btree_next(db, &cursor, &id, &address))
+    {
+        printf("Error: Bulk load requires an empty table\n");
+        return 0;
+    }
+
+    // Sorted input (the usual case for reloads) skips the sort
+    int sorted = 1;
+    for (int i = 1; i < count && sorted; i++)
+    {
+        sorted = rows[i - 1].id <= rows[i].id;
+    }
+    if (!sorted)
+    {
+        qsort(rows, count, sizeof(struct Row), compare_row_ids);
+    }
+    for (int i = 0; i < count; i++)
+    {
+        if (rows[i].id <= 0)
+        {
+            printf("Error: ID must be a positive integer (got %d)\n", rows[i].id);
+            return 0;
+        }
+        if (i > 0 && rows[i].id == rows[i - 1].id)
+        {
+            printf("Error: Row with id=%d already exists\n", rows[i].id);
+            return 0;
+        }
+    }
+
+    // Start from a durable state with an empty log, since the load itself is not logged
+    checkpoint(db);
+
+    BuiltTable table;
+    if (!build_table(db, rows, count, fill_percent, &table))
+    {
+        return 0;
+    }
+
+    // Switch the header to the new table, then hand the old (empty) pages to the allocator;
+    // readers wait until the indexes and the filter describe the new table
+    off_t old_root = db->root_offset;
+    off_t old_data = db->header.first_data_page;
+    begin_restructure(db);
+    install_table(db, &table, count);
+    if (db->hashed)
+    {
+        hash_index_free(db, old_root);
+    }
+    else
+    {
+        free_tree(db, old_root);
+    }
+    free_data_chain(db, old_data);
+    name_index_free(db);
+    if (!build_name_index(db))
+    {
+        printf("Error: Could not build the name index\n");
+        exit(1); // nothing of the load is durable yet: the file still holds the empty table
+    }
+    if (!bloom_build(db))
+    {
+        printf("Error: Could not build the Bloom filter\n");
+        exit(1);
+    }
+    end_restructure(db);
+    checkpoint(db);
+    return 1;
+}
+
+// Build an empty table from rows in one sequential pass: data pages are packed full and
+// the index is built bottom-up with fill_percent of each node used (rows are sorted in place).
+// The rows are not logged; the load is made durable by a checkpoint before returning.
+int bulk_load(Database *db, struct Row *rows, int count, int fill_percent)
+{
+    lock_writer(db);
+    int loaded = load_rows(db, rows, count, fill_percent);
+    unlock_writer(db);
+    return loaded;
+}
+
+// Read an index page written before version 5
+static void read_legacy_node(Database *db, off_t offset, LegacyBTreeNode *node)
+{
+    void *page = buffer_pool_fetch(db->pool, offset);
+    if (page == NULL)
+    {
+        printf("Error: Failed to read node at offset %lld\n", (long long)offset);
+        exit(1);
+    }
+    memcpy(node, page, sizeof(LegacyBTreeNode));
+    buffer_pool_unpin(db->pool, offset, 0);
+}
+
+// Check that a link of an old index points at a page of the file
+static int legacy_link_valid(Database *db, off_t offset)
+{
+    off_t end = db->header.page_count * PAGE_SIZE;
+    return offset % PAGE_SIZE == 0 && offset >= HEADER_PAGES * PAGE_SIZE && offset < end;
+}
+
+// Collect the entries below a node of an index written before version 5, in key order
+// (returns 0 if out of memory)
+static int collect_legacy_entries(Database *db, off_t offset, IndexEntry **entries,
+                                  int *count, int *capacity)
+{
+    if (!legacy_link_valid(db, offset))
+    {
+        return 1; // links outside the file are treated as empty subtrees
+    }
+    LegacyBTreeNode node;
+    read_legacy_node(db, offset, &node);
+    if (!node.is_leaf)
+    {
+        for (int i = 0; i <= node.num_keys && i < LEGACY_MAX_CHILDREN; i++)
+        {
+            if (!collect_legacy_entries(db, node.data.internal.children[i], entries, count, capacity))
+            {
+                return 0;
+            }
+        }
+        return 1;
+    }
+
+    for (int i = 0; i < node.num_keys && i < LEGACY_MAX_KEYS; i++)
+    {
+        if (*count == *capacity)
+        {
+            *capacity = *capacity > 0 ? *capacity * 2 : 1024;
+            IndexEntry *grown = realloc(*entries, *capacity * sizeof(IndexEntry));
+            if (grown == NULL)
+            {
+                return 0;
+            }
+            *entries = grown;
+        }
+        (*entries)[(*count)++] = node.data.leaf.entries[i];
+    }
+    return 1;
+}
+
+// Return every page of an index written before version 5 to the allocator
+static void free_legacy_tree(Database *db, off_t offset)
+{
+    if (!legacy_link_valid(db, offset))
+    {
+        return;
+    }
+    LegacyBTreeNode node;
+    read_legacy_node(db, offset, &node);
+    if (!node.is_leaf)
+    {
+        for (int i = 0; i <= node.num_keys && i < LEGACY_MAX_CHILDREN; i++)
+        {
+            free_legacy_tree(db, node.data.internal.children[i]);
+        }
+    }
+    free_node(db, offset);
+}
+
+// Read the rows of a file written before version 4, whose index entries hold byte offsets
+// of rows (returns NULL if out of memory)
+static struct Row *read_legacy_rows(Database *db, const IndexEntry *entries, int *count)
+{
+    off_t end = db->header.page_count * PAGE_SIZE;
+    struct Row *rows = malloc((*count > 0 ? *count : 1) * sizeof(struct Row));
+    if (rows == NULL)
+    {
+        return NULL;
+    }
+    int n = 0;
+    for (int i = 0; i < *count; i++)
+    {
+        off_t address = entries[i].address;
+        off_t page_offset = address - address % PAGE_SIZE;
+        if (address % PAGE_SIZE + (off_t)sizeof(struct Row) > PAGE_SIZE || page_offset >= end)
+        {
+            continue;
+        }
+        const char *page = fetch_data_page(db, page_offset);
+        memcpy(&rows[n], page + address % PAGE_SIZE, sizeof(struct Row));
+        buffer_pool_unpin(db->pool, page_offset, 0);
+        rows[n].id = entries[i].id;
+        rows[n].name[59] = '\0';
+        n++;
+    }
+    *count = n;
+    return rows;
+}
+
+// Write a new index for entries that already hold record IDs (returns 1 once durable)
+static int build_index(Database *db, const IndexEntry *entries, int count, BuiltTable *table)
+{
+    PageStream stream;
+    if (!stream_open(db, &stream))
+    {
+        return 0;
+    }
+    table->root_offset = write_index(&stream, entries, NULL, count, BULK_LOAD_FILL_PERCENT);
+    table->end_offset = stream.next_offset;
+    return stream_close(db, &stream, table->root_offset != -1);
+}
+
+// Rewrite a table written by an older version. Files from before version 4 (byte-offset
+// index entries, packed data pages) get slotted pages indexed by record ID; version 4 files
+// keep their data pages and only get the compact index. The new pages are made durable and
+// switched in by the header before the old ones are freed, so a crash either redoes the
+// upgrade or finds it done; the log is replayed afterwards against the new table.
+int upgrade_table(Database *db, int legacy)
+{
+    IndexEntry *entries = NULL;
+    int count = 0;
+    int capacity = 0;
+    if (!collect_legacy_entries(db, db->root_offset, &entries, &count, &capacity))
+    {
+        printf("Error: Could not allocate memory to upgrade the table\n");
+        free(entries);
+        return 0;
+    }
+    int sorted = 1;
+    for (int i = 1; i < count && sorted; i++)
+    {
+        sorted = entries[i - 1].id < entries[i].id;
+    }
+    if (!sorted)
+    {
+        qsort(entries, count, sizeof(IndexEntry), compare_entry_ids);
+    }
+
+    int old_version = db->checkpointed_header.version;
+    off_t old_pages = db->header.page_count;
+    off_t old_root = db->root_offset;
+    off_t old_data = db->header.first_data_page;
+    BuiltTable table;
+    int ok;
+    if (old_version >= 4)
+    {
+        ok = build_index(db, entries, count, &table);
+        if (ok)
+        {
+            db->header.page_count = table.end_offset / PAGE_SIZE;
+            db->root_offset = table.root_offset;
+        }
+    }
+    else
+    {
+        struct Row *rows = read_legacy_rows(db, entries, &count);
+        ok = rows != NULL && build_table(db, rows, count, BULK_LOAD_FILL_PERCENT, &table);
+        if (rows == NULL)
+        {
+            printf("Error: Could not allocate memory to upgrade the table\n");
+        }
+        free(rows);
+        if (ok)
+        {
+            install_table(db, &table, count);
+        }
+    }
+    free(entries);
+    if (!ok)
+    {
+        return 0;
+    }
+    db->header.version = DB_VERSION;
+    write_header(db);
+    if (!db->no_sync && fsync(fileno(db->file)) != 0)
+    {
+        perror("Error: Could not sync database file");
+        exit(1);
+    }
+    db->checkpointed_header = db->header;
+
+    // Freeing dirties every old page; they are unreachable now, so they may be written
+    // out before the next checkpoint
+    db->pool->no_steal = 0;
+    if (legacy)
+    {
+        // Files from before the header page: every page after it belonged to the old table
+        for (off_t page = old_pages - 1; page >= HEADER_PAGES; page--)
+        {
+            free_page(db, page * PAGE_SIZE);
+        }
+    }
+    else
+    {
+        free_legacy_tree(db, old_root);
+        while (old_version < 4 && old_data != 0)
+        {
+            const char *page = fetch_data_page(db, old_data);
+            off_t next;
+            memcpy(&next, page + LEGACY_DATA_PAGE_NEXT_OFFSET, sizeof(off_t));
+            buffer_pool_unpin(db->pool, old_data, 0);
+            free_page(db, old_data);
+            old_data = next;
+        }
+    }
+    db->pool->no_steal = 1;
+    return 1;
+}
+
+// Copy an index page of a version 5 to 9 file (its internal nodes have no counts)
+static void read_uncounted_node(Database *db, off_t offset, UncountedNode *node)
+{
+    const void *page = buffer_pool_fetch(db->pool, offset);
+    if (page == NULL)
+    {
+        printf("Error: Failed to read node at offset %lld\n", (long long)offset);
+        exit(1);
+    }
+    memcpy(node, page, sizeof(UncountedNode));
+    buffer_pool_unpin(db->pool, offset, 0);
+}
+
+// Return every page of an index without counts to the allocator
+static void free_uncounted_tree(Database *db, off_t offset)
+{
+    UncountedNode node;
+    read_uncounted_node(db, offset, &node);
+    if (!node.internal.is_leaf)
+    {
+        for (int i = 0; i <= node.internal.num_keys; i++)
+        {
+            free_uncounted_tree(db, PAGE_OFFSET(node.internal.children[i]));
+        }
+    }
+    free_node(db, offset);
+}
+
+// Collect the entries (or, in row leaves, the rows) of an index without counts by walking
+// its leaf chain from the leftmost leaf (returns the number collected, -1 if out of memory)
+static long collect_uncounted_leaves(Database *db, IndexEntry **entries, struct Row **rows)
+{
+    UncountedNode page;
+    read_uncounted_node(db, db->root_offset, &page);
+    while (!page.internal.is_leaf)
+    {
+        read_uncounted_node(db, PAGE_OFFSET(page.internal.children[0]), &page);
+    }
+    const BTreeNode *node = &page.leaf;
+
+    long capacity = db->header.row_count > 0 ? (long)db->header.row_count : 1;
+    *entries = malloc(capacity * sizeof(IndexEntry));
+    *rows = db->clustered ? malloc(capacity * sizeof(struct Row)) : NULL;
+    long count = 0;
+    while (*entries != NULL && (*rows != NULL || !db->clustered))
+    {
+        for (int k = 0; k < node->num_keys && k < node_max_keys(node) && count < capacity; k++, count++)
+        {
+            if (db->clustered)
+            {
+                (*rows)[count].id = node->data.rows.ids[k];
+                memcpy((*rows)[count].name, node->data.rows.names[k], sizeof((*rows)[count].name));
+                continue;
+            }
+            (*entries)[count].id = node->data.leaf.ids[k];
+            (*entries)[count].address = leaf_rid(node, k);
+        }
+        if (node->next == 0)
+        {
+            return count;
+        }
+        read_uncounted_node(db, PAGE_OFFSET(node->next), &page);
+    }
+    return -1;
+}
+
+// Rebuild the index of a version 5 to 9 file with subtree counts in its internal nodes. The
+// leaves are read along their chain, the new index is made durable and switched in by the
+// header before the old pages are freed, as in upgrade_table (returns 1 on success).
+int upgrade_index_counts(Database *db)
+{
+    IndexEntry *entries;
+    struct Row *rows;
+    long count = collect_uncounted_leaves(db, &entries, &rows);
+    BuiltTable table;
+    int ok = count >= 0;
+    if (!ok)
+    {
+        printf("Error: Could not allocate memory to upgrade the index\n");
+    }
+    else if (db->clustered)
+    {
+        ok = build_table(db, rows, (int)count, BULK_LOAD_FILL_PERCENT, &table);
+    }
+    else
+    {
+        ok = build_index(db, entries, (int)count, &table);
+    }
+    free(entries);
+    free(rows);
+    if (!ok)
+    {
+        return 0;
+    }
+
+    off_t old_root = db->root_offset;
+    db->header.page_count = table.end_offset / PAGE_SIZE;
+    db->root_offset = table.root_offset;
+    db->header.version = DB_VERSION;
+    write_header(db);
+    if (!db->no_sync && fsync(fileno(db->file)) != 0)
+    {
+        perror("Error: Could not sync database file");
+        exit(1);
+    }
+    db->checkpointed_header = db->header;
+
+    // The old pages are unreachable now, so they may be written out before the next checkpoint
+    db->pool->no_steal = 0;
+    free_uncounted_tree(db, old_root);
+    db->pool->no_steal = 1;
+    return 1;
+}
+
+// Bulk load "<id> <name>" lines from a text file (returns rows loaded, -1 on failure)
+int load_file(Database *db, const char *path, int fill_percent)
+{
+    FILE *input = fopen(path, "r");
+    if (input == NULL)
+    {
+        perror("Error: Could not open load file");
+        return -1;
+    }
+
+    int count = 0;
+    int capacity = 1024;
+    struct Row *rows = malloc(capacity * sizeof(struct Row));
+    char line[128];
+    int line_number = 0;
+    while (rows != NULL && fgets(line, sizeof(line), input) != NULL)
+    {
+        line_number++;
+        line[strcspn(line, "\n")] = 0;
+        if (line[0] == '\0')
+        {
+            continue;
+        }
+        if (count == capacity)
+        {
+            capacity *= 2;
+            struct Row *grown = realloc(rows, capacity * sizeof(struct Row));
+            if (grown == NULL)
+            {
+                free(rows);
+                rows = NULL;
+                break;
+            }
+            rows = grown;
+        }
+        struct Row *row = &rows[count];
+        memset(row, 0, sizeof(struct Row));
+        if (sscanf(line, "%d %59s", &row->id, row->name) != 2)
+        {
+            printf("Error: Invalid row on line %d of %s. Use: <id> <name>\n", line_number, path);
+            free(rows);
+            fclose(input);
+            return -1;
+        }
+        count++;
+    }
+    fclose(input);
+    if (rows == NULL)
+    {
+        printf("Error: Could not allocate memory for load file rows\n");
+        return -1;
+    }
+
+    int ok = bulk_load(db, rows, count, fill_percent);
+    free(rows);
+    return ok ? count : -1;
+}
@@ -1,89 +1,488 @@
 #include "../../include/coredb.h"
 
-// Insert a row (returns 1 if inserted, 0 if failed due to duplicate ID)
-int insert_row(Database *db, int id, const char *name)
+// Queue the redo record of a change (returns 0 while replaying: it is already in the log)
+static uint64_t log_change(Database *db, int type, int id, const char *name)
 {
-    if (id <= 0)
+    if (db->replaying)
     {
-        printf("Error: ID must be a positive integer (got %d)\n", id);
         return 0;
     }
+    return wal_append(db->wal, type, id, name);
+}
 
-    // Check for duplicate ID
-    off_t address;
-    btree_search(db, id, &address);
-    if (address != -1)
+// Wait until every change logged up to lsn is durable; pages are written at the next checkpoint
+static void commit_logged(Database *db, uint64_t lsn)
+{
+    if (lsn == 0)
     {
-        printf("Error: Row with id=%d already exists\n", id);
+        return;
+    }
+    if (!wal_commit(db->wal, lsn))
+    {
+        printf("Error: Failed to commit to the write-ahead log\n");
+        exit(1);
+    }
+    checkpoint_if_needed(db);
+}
+
+// Commit a batch early once its dirty pages fill half the pool, so a checkpoint can
+// write them out (returns the LSN still waiting to be committed)
+static uint64_t relieve_batch(Database *db, uint64_t lsn)
+{
+    if (!db->use_mmap && db->pool->num_dirty >= db->pool->num_frames / 2)
+    {
+        commit_logged(db, lsn);
         return 0;
     }
+    return lsn;
+}
 
-    int current_page = db->num_pages - 1;
-    int *page_num_rows = (int *)db->pages[current_page]; // Pointer to the number of rows in the page
-    if ((unsigned long)*page_num_rows >= MAX_ROWS)
+// Rows of a batch to insert before the next relieve_batch: each row can dirty a name index
+// leaf of its own, so a step must fit the room left in the pool's first half
+static int batch_step(Database *db, int remaining)
+{
+    if (db->use_mmap || db->name_root == 0)
+    {
+        return remaining;
+    }
+    int room = (db->pool->num_frames / 2 - db->pool->num_dirty) / 2;
+    if (room < 1)
     {
-        if (db->num_pages >= db->max_pages)
+        room = 1;
+    }
+    return remaining < room ? remaining : room;
+}
+
+// Store rows in data pages taken from the free-space map, filling each page under a single
+// pin; entries receive the new record IDs (returns the number of rows stored). A clustered
+// table stores rows with their index entries, so only the ids are filled in.
+static int store_rows(Database *db, const struct Row *rows, int count, IndexEntry *entries)
+{
+    if (db->clustered)
+    {
+        for (int i = 0; i < count; i++)
         {
-            printf("Error: Maximum pages reached, cannot insert more rows\n");
-            return 0;
+            entries[i].id = rows[i].id;
+            entries[i].address = 0;
         }
-        void *new_page = malloc(PAGE_SIZE);
-        if (new_page == NULL)
+        db->header.row_count += count;
+        return count;
+    }
+    int stored = 0;
+    while (stored < count)
+    {
+        off_t page_offset = free_space_find(db);
+        if (page_offset == -1)
         {
             printf("Error: Could not allocate new page\n");
+            return stored;
+        }
+        void *page = fetch_data_page(db, page_offset);
+        while (stored < count && data_page_has_room(page))
+        {
+            struct Row new_row;
+            new_row.id = rows[stored].id;
+            strncpy(new_row.name, rows[stored].name, 59);
+            new_row.name[59] = '\0';
+
+            int slot = data_page_insert(page, &new_row);
+            entries[stored].id = new_row.id;
+            entries[stored].address = RID(page_offset, slot);
+            stored++;
+        }
+        if (!data_page_has_room(page))
+        {
+            free_space_pop(db, page_offset, page);
+        }
+        buffer_pool_unpin(db->pool, page_offset, 1);
+    }
+    db->header.row_count += stored;
+    return stored;
+}
+
+// Add the index entry of a stored row (in a clustered table, the row itself; returns 0 if
+// the index has no page left for it)
+static int index_row(Database *db, const IndexEntry *entry, const struct Row *row)
+{
+    if (db->clustered)
+    {
+        return btree_insert_row(db, row);
+    }
+    return btree_insert(db, entry->id, entry->address);
+}
+
+// Take back a row store_rows added but the indexes could not take (its id index entry
+// already gone), so no row is stored that a lookup cannot find
+static void unstore_row(Database *db, const IndexEntry *entry)
+{
+    db->header.row_count--;
+    if (db->clustered)
+    {
+        return; // the row lives only in its leaf entry
+    }
+    off_t page_offset = RID_PAGE(entry->address);
+    void *page = fetch_data_page(db, page_offset);
+    data_page_delete(page, RID_SLOT(entry->address));
+    free_space_push(db, page_offset, page);
+    buffer_pool_unpin(db->pool, page_offset, 1);
+}
+
+// Move the name index entry of an updated row from its old name to its new one. The new
+// entry goes in first, so when the index has no page left for it the old one is still in
+// place (returns 0 then).
+static int rename_in_index(Database *db, const char *old_name, const struct Row *row)
+{
+    if (strncmp(old_name, row->name, 60) == 0)
+    {
+        return 1;
+    }
+    if (!name_index_insert(db, row->name, row->id))
+    {
+        return 0;
+    }
+    name_index_delete(db, old_name, row->id);
+    return 1;
+}
+
+// Give a row read from address a new name, in its page and in the name index (returns 0,
+// leaving the row as it was, if the name index cannot take the new name)
+static int rename_row(Database *db, off_t address, struct Row *row, const char *name)
+{
+    char old_name[60];
+    memcpy(old_name, row->name, sizeof(old_name));
+    strncpy(row->name, name, 59);
+    row->name[59] = '\0';
+    if (!rename_in_index(db, old_name, row))
+    {
+        printf("Error: Could not index the new name of row id=%d\n", row->id);
+        memcpy(row->name, old_name, sizeof(old_name));
+        return 0;
+    }
+    write_row(db, address, row);
+    return 1;
+}
+
+// Sort a batch by id and drop invalid or repeated ids (returns the rows kept)
+static int prepare_batch(struct Row *rows, int count)
+{
+    qsort(rows, count, sizeof(struct Row), compare_row_ids);
+    int kept = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (rows[i].id <= 0)
+        {
+            printf("Error: ID must be a positive integer (got %d)\n", rows[i].id);
+            continue;
+        }
+        if (kept > 0 && rows[kept - 1].id == rows[i].id)
+        {
+            printf("Error: Row with id=%d appears twice in the batch\n", rows[i].id);
+            continue;
+        }
+        rows[kept++] = rows[i];
+    }
+    return kept;
+}
+
+// Find the row of an id and copy it out. A reader racing the writer may find the row moved
+// or its slot reused between the index lookup and the read, so the lookup is repeated
+// (returns 1 if found, 0 if the id is not in the index, -1 if its row cannot be read)
+static int locate_row(Database *db, int id, off_t *address, struct Row *row)
+{
+    if (db->clustered)
+    {
+        // The row sits in the leaf the lookup latches anyway
+        *address = -1;
+        return btree_search_row(db, id, row);
+    }
+    for (int attempt = 0; attempt < ROW_READ_ATTEMPTS; attempt++)
+    {
+        btree_search(db, id, address);
+        if (*address == -1)
+        {
             return 0;
         }
-        memset(new_page, 0, PAGE_SIZE); // Initialize the new page to zero
-        db->pages[db->num_pages] = new_page;
-        db->num_pages++;
-        current_page = db->num_pages - 1;
-        page_num_rows = (int *)db->pages[current_page]; // Update pointer to the new page
+        if (read_row(db, *address, row) && row->id == id)
+        {
+            return 1;
+        }
+    }
+    return -1;
+}
+
+// Insert a row and its index entries without logging it (returns 0 for a duplicate ID)
+static int insert_unlogged(Database *db, int id, const char *name)
+{
+    // Check for duplicate ID
+    off_t address;
+    btree_search(db, id, &address);
+    if (address != -1)
+    {
+        printf("Error: Row with id=%d already exists\n", id);
+        return 0;
     }
 
     struct Row new_row;
     new_row.id = id;
     strncpy(new_row.name, name, 59);
     new_row.name[59] = '\0';
+    version_record(db, id, NULL);
+    IndexEntry entry;
+    if (!store_rows(db, &new_row, 1, &entry))
+    {
+        return 0;
+    }
 
-    size_t offset = sizeof(int) + (*page_num_rows * sizeof(struct Row));
-    memcpy((char *)db->pages[current_page] + offset, &new_row, sizeof(struct Row));
+    // Insert into B-Tree and the name index, or leave the table as it was
+    if (!index_row(db, &entry, &new_row))
+    {
+        unstore_row(db, &entry);
+        printf("Error: Could not index row with id=%d\n", id);
+        return 0;
+    }
+    if (!name_index_insert(db, new_row.name, id))
+    {
+        btree_delete(db, id);
+        unstore_row(db, &entry);
+        printf("Error: Could not index row with id=%d\n", id);
+        return 0;
+    }
+    return 1;
+}
+
+// Insert a row (returns 1 if inserted, 0 if failed due to duplicate ID)
+int insert_row(Database *db, int id, const char *name)
+{
+    if (id <= 0)
+    {
+        printf("Error: ID must be a positive integer (got %d)\n", id);
+        return 0;
+    }
+    lock_writer(db);
+    uint64_t lsn = 0;
+    int inserted = insert_unlogged(db, id, name);
+    if (inserted)
+    {
+        lsn = log_change(db, WAL_INSERT, id, name);
+    }
+    unlock_writer(db);
+    // The next writer goes ahead while this one waits for the log, so their flushes group
+    commit_logged(db, lsn);
+    return inserted;
+}
 
-    (*page_num_rows)++;
-    int updated_num_rows = *page_num_rows;
-    memcpy(db->pages[current_page], &updated_num_rows, sizeof(int));
+// Insert a batch of rows: ids are sorted so rows bound for one leaf share a descent and a
+// single leaf write, rows fill data pages one at a time, and the batch is committed with one
+// log flush (returns the number inserted; invalid and existing ids are skipped)
+int insert_rows(Database *db, const struct Row *rows, int count)
+{
+    if (count <= 0)
+    {
+        return 0;
+    }
+    struct Row *batch = malloc(count * sizeof(struct Row));
+    int *ids = malloc(count * sizeof(int));
+    off_t *addresses = malloc(count * sizeof(off_t));
+    IndexEntry *entries = malloc(LEAF_MAX_KEYS * sizeof(IndexEntry));
+    if (batch == NULL || ids == NULL || addresses == NULL || entries == NULL)
+    {
+        printf("Error: Could not allocate memory for the batch\n");
+        free(batch);
+        free(ids);
+        free(addresses);
+        free(entries);
+        return 0;
+    }
+    memcpy(batch, rows, count * sizeof(struct Row));
+    int valid = prepare_batch(batch, count);
 
-    // Compute the row's address in the file
-    off_t row_address = DATA_START_OFFSET + (off_t)current_page * PAGE_SIZE + offset;
+    lock_writer(db);
+    // Check for duplicate IDs with shared descents
+    for (int i = 0; i < valid; i++)
+    {
+        ids[i] = batch[i].id;
+    }
+    btree_search_batch(db, ids, valid, addresses);
+    int n = 0;
+    for (int i = 0; i < valid; i++)
+    {
+        if (addresses[i] != -1)
+        {
+            printf("Error: Row with id=%d already exists\n", ids[i]);
+            continue;
+        }
+        batch[n] = batch[i];
+        ids[n++] = ids[i];
+    }
 
-    // Insert into B-Tree
-    btree_insert(db, id, row_address);
+    uint64_t lsn = 0;
+    int inserted = 0;
+    while (inserted < n)
+    {
+        // Rows that fit one leaf go in with one descent; a full leaf takes the splitting path
+        int run = btree_leaf_run(db, ids + inserted, batch_step(db, n - inserted));
+        int take = run > 0 ? run : 1;
+        for (int j = 0; j < take; j++)
+        {
+            version_record(db, ids[inserted + j], NULL);
+        }
+        int appended = store_rows(db, batch + inserted, take, entries);
+        if (appended < take)
+        {
+            run = appended;
+        }
+        if (run > 0)
+        {
+            btree_insert_run(db, entries, batch + inserted, run);
+        }
+        else if (appended == 1 && !index_row(db, &entries[0], &batch[inserted]))
+        {
+            unstore_row(db, &entries[0]);
+            printf("Error: Could not index row with id=%d\n", batch[inserted].id);
+            break; // out of pages
+        }
+        int named = 0;
+        while (named < appended && name_index_insert(db, batch[inserted + named].name, batch[inserted + named].id))
+        {
+            lsn = log_change(db, WAL_INSERT, batch[inserted + named].id, batch[inserted + named].name);
+            named++;
+        }
+        if (named < appended)
+        {
+            // The name index is out of pages: take back the rows it has no entry for
+            printf("Error: Could not index row with id=%d\n", batch[inserted + named].id);
+            for (int j = named; j < appended; j++)
+            {
+                btree_delete(db, batch[inserted + j].id);
+                unstore_row(db, &entries[j]);
+            }
+        }
+        inserted += named;
+        if (named < take)
+        {
+            break; // out of pages
+        }
+        lsn = relieve_batch(db, lsn);
+    }
+    unlock_writer(db);
+    commit_logged(db, lsn);
 
-    db->page_dirty[current_page] = 1;
-    write_buffer(db);
-    return 1;
+    free(batch);
+    free(ids);
+    free(addresses);
+    free(entries);
+    return inserted;
 }
 
-// select all rows, returns count of non-deleted rows
-int select_rows(Database *db, struct Row *rows, int max_rows)
+// Collect the rows that have not changed since the snapshot, in data page and slot order
+// (id order for a clustered table); changed rows are left to add_changed_rows
+static int scan_unchanged_rows(Database *db, const Snapshot *snapshot, struct Row *rows, int max_rows)
 {
     int count = 0;
-    for (int page = 0; page < db->num_pages && count < max_rows; page++)
+    struct Row old;
+    if (db->clustered)
+    {
+        RangeCursor cursor;
+        select_range(db, 1, INT32_MAX, &cursor);
+        while (count < max_rows && range_next(db, &cursor, &rows[count]))
+        {
+            if (snapshot_version(db, snapshot, rows[count].id, &old) < 0)
+            {
+                count++;
+            }
+        }
+        return count;
+    }
+    unsigned long version = read_begin(db);
+    off_t page_offset = db->header.first_data_page;
+    while (page_offset != 0 && count < max_rows)
     {
-        int *page_num_rows = (int *)db->pages[page]; // Pointer to the number of rows in the page
-        for (int i = 0; i < *page_num_rows && count < max_rows; i++)
+        const void *page = latch_data_page(db, page_offset, version);
+        if (page == NULL)
+        {
+            // Compaction or a bulk load changed the chain: scan it again
+            count = 0;
+            version = read_begin(db);
+            page_offset = db->header.first_data_page;
+            continue;
+        }
+        int num_slots = data_page_slots(page);
+        for (int slot = 0; slot < num_slots && count < max_rows; slot++)
         {
-            size_t offset = sizeof(int) + (i * sizeof(struct Row));
-            struct Row temp_row;
-            memcpy(&temp_row, (char *)db->pages[page] + offset, sizeof(struct Row));
-            if (temp_row.id != 0) // Check if row is not deleted
+            // Free slots are skipped
+            if (data_page_read(page, slot, &rows[count]) &&
+                snapshot_version(db, snapshot, rows[count].id, &old) < 0)
             {
-                rows[count++] = temp_row;
+                count++;
             }
         }
+        off_t next = data_page_next(page);
+        buffer_pool_unlatch(db->pool, page_offset);
+        page_offset = next;
     }
     return count;
 }
 
+// Add the rows changed since the snapshot as the snapshot saw them, after the count rows
+// scanned; a row that changed after the scan passed it was taken already
+static int add_changed_rows(Database *db, const Snapshot *snapshot, struct Row *rows, int count, int max_rows)
+{
+    int *changed = NULL;
+    int num_changed = 0;
+    int capacity = 0;
+    versions_changed(db, snapshot, 0, 1, INT32_MAX, &changed, &num_changed, &capacity);
+    if (num_changed == 0)
+    {
+        return count;
+    }
+    int *taken = malloc((count + 1) * sizeof(int));
+    if (taken == NULL)
+    {
+        printf("Error: Could not allocate memory for the scan\n");
+        free(changed);
+        return count;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        taken[i] = rows[i].id;
+    }
+    int num_taken = count;
+    qsort(taken, num_taken, sizeof(int), compare_ints);
+    qsort(changed, num_changed, sizeof(int), compare_ints);
+    for (int i = 0; i < num_changed && count < max_rows; i++)
+    {
+        if ((i > 0 && changed[i] == changed[i - 1]) ||
+            bsearch(&changed[i], taken, num_taken, sizeof(int), compare_ints) != NULL)
+        {
+            continue;
+        }
+        if (snapshot_version(db, snapshot, changed[i], &rows[count]) > 0)
+        {
+            count++;
+        }
+    }
+    if (db->clustered)
+    {
+        qsort(rows, count, sizeof(struct Row), compare_row_ids);
+    }
+    free(taken);
+    free(changed);
+    return count;
+}
+
+// select all rows as of one snapshot, in data page and slot order (id order for a clustered
+// table) with rows changed during the scan at the end; returns count of rows. Writers go on
+// meanwhile and the scan sees none of their changes.
+int select_rows(Database *db, struct Row *rows, int max_rows)
+{
+    Snapshot snapshot;
+    snapshot_begin(db, &snapshot);
+    int count = scan_unchanged_rows(db, &snapshot, rows, max_rows);
+    count = add_changed_rows(db, &snapshot, rows, count, max_rows);
+    snapshot_end(db, &snapshot);
+    return count;
+}
+
 // Select a row by ID (returns 1 if found, 0 if not)
 int select_by_id(Database *db, int id, struct Row *row)
 {
@@ -94,16 +493,13 @@ int select_by_id(Database *db, int id, struct Row *row)
     }
 
     off_t address;
-    btree_search(db, id, &address);
-    if (address == -1)
+    int found = locate_row(db, id, &address, row);
+    if (found == 0)
     {
         printf("Error: Row with id=%d not found\n", id);
         return 0;
     }
-
-    fseek(db->file, address, SEEK_SET);
-    size_t bytes_read = fread(row, sizeof(struct Row), 1, db->file);
-    if (bytes_read != 1)
+    if (found < 0)
     {
         printf("Error: Failed to read row at address %lld\n", (long long)address);
         return 0;
@@ -111,15 +507,270 @@ int select_by_id(Database *db, int id, struct Row *row)
     return 1;
 }
 
-// update a row
-int update_row(Database *db, int id, const char *name)
+// Open an ordered scan over ids lo..hi (returns 0 if the range is empty by definition)
+int select_range(Database *db, int lo, int hi, RangeCursor *cursor)
+{
+    cursor->leaf = 0;
+    cursor->index = 0;
+    cursor->hi = hi;
+    if (lo > hi)
+    {
+        return 0;
+    }
+    btree_seek(db, lo, cursor);
+    return 1;
+}
+
+// Open an ordered scan at the row with offset rows before it in id order (LIMIT/OFFSET
+// paging: one descent guided by the subtree counts instead of skipping rows one by one)
+int select_from_offset(Database *db, long offset, RangeCursor *cursor)
+{
+    cursor->leaf = 0;
+    cursor->index = 0;
+    cursor->hi = INT32_MAX;
+    if (db->hashed)
+    {
+        printf("Error: Paging needs the B+tree index; this table is hashed\n");
+        return 0;
+    }
+    if (offset < 0)
+    {
+        printf("Error: Offset must not be negative (got %ld)\n", offset);
+        return 0;
+    }
+    btree_seek_rank(db, offset, cursor);
+    return 1;
+}
+
+// Count the rows with ids in lo..hi from the subtree counts, with two rank descents
+// (returns -1 when a hashed table is asked for less than the whole id range)
+long count_rows(Database *db, int lo, int hi)
+{
+    if (lo > hi)
+    {
+        return 0;
+    }
+    if (lo <= 1 && hi == INT32_MAX)
+    {
+        return btree_count(db); // ids are positive: the whole table
+    }
+    if (db->hashed)
+    {
+        printf("Error: Counting a range needs the B+tree index; this table is hashed\n");
+        return -1;
+    }
+    long below_hi = hi == INT32_MAX ? btree_count(db) : btree_rank(db, hi + 1);
+    return below_hi - btree_rank(db, lo);
+}
+
+// Rank of an id in id order: the number of rows with a smaller id, whether or not the id
+// exists (-1 on a hashed table)
+long rank_of_id(Database *db, int id)
+{
+    if (db->hashed)
+    {
+        printf("Error: Ranks need the B+tree index; this table is hashed\n");
+        return -1;
+    }
+    return btree_rank(db, id);
+}
+
+// Fetch the next row of a range scan in id order (returns 0 when the range is exhausted)
+int range_next(Database *db, RangeCursor *cursor, struct Row *row)
+{
+    int id;
+    off_t address;
+    while (btree_next(db, cursor, &id, &address))
+    {
+        if (read_row(db, address, row) && row->id == id)
+        {
+            return 1;
+        }
+        // The row moved since its entry was read, or was deleted meanwhile
+        int found = locate_row(db, id, &address, row);
+        if (found > 0)
+        {
+            return 1;
+        }
+        if (found < 0)
+        {
+            printf("Error: Failed to read row at address %lld\n", (long long)address);
+            cursor->leaf = 0;
+            return 0;
+        }
+    }
+    return 0;
+}
+
+// Select a row by ID as of a snapshot (returns 1 if it existed then, 0 if not)
+int select_by_id_snapshot(Database *db, const Snapshot *snapshot, int id, struct Row *row)
 {
     if (id <= 0)
     {
         printf("Error: ID must be a positive integer (got %d)\n", id);
         return 0;
     }
+    off_t address;
+    int found = locate_row(db, id, &address, row);
+    if (found < 0)
+    {
+        printf("Error: Failed to read row at address %lld\n", (long long)address);
+        return 0;
+    }
+    // The current row is read first, so a change it missed has its record in place
+    int version = snapshot_version(db, snapshot, id, row);
+    if (version >= 0)
+    {
+        found = version;
+    }
+    if (!found)
+    {
+        printf("Error: Row with id=%d not found\n", id);
+    }
+    return found;
+}
+
+// Open a range scan over ids lo..hi as of a snapshot, which must stay open until the cursor
+// is closed (returns 0 if the range is empty by definition or the table is hashed)
+int select_range_snapshot(Database *db, const Snapshot *snapshot, int lo, int hi, SnapshotCursor *cursor)
+{
+    memset(cursor, 0, sizeof(SnapshotCursor));
+    cursor->snapshot = snapshot;
+    cursor->hi = hi;
+    cursor->last = hi;
+    cursor->index_done = 1;
+    if (db->hashed)
+    {
+        printf("Error: Snapshot ranges need the B+tree index; this table is hashed\n");
+        return 0;
+    }
+    if (lo < 1)
+    {
+        lo = 1; // ids are positive
+    }
+    if (lo > hi)
+    {
+        return 0;
+    }
+    select_range(db, lo, hi, &cursor->range);
+    cursor->last = lo - 1;
+    cursor->index_done = 0;
+    return 1;
+}
+
+// Fetch the next row of a snapshot range scan in id order (returns 0 when the range is
+// exhausted): the next id either comes from the index walk or changed since the snapshot,
+// and the version records say how the snapshot saw it
+int snapshot_next(Database *db, SnapshotCursor *cursor, struct Row *row)
+{
+    while (cursor->last < cursor->hi)
+    {
+        if (!cursor->index_ready && !cursor->index_done)
+        {
+            cursor->index_ready = range_next(db, &cursor->range, &cursor->index_row);
+            cursor->index_done = !cursor->index_ready;
+        }
+        // Look for changes after stepping the index: a row deleted before the walk reached
+        // it has its record in place by then
+        int before = cursor->num_changed;
+        cursor->seen = versions_changed(db, cursor->snapshot, cursor->seen, cursor->last + 1, cursor->hi,
+                                        &cursor->changed, &cursor->num_changed, &cursor->changed_capacity);
+        if (cursor->num_changed > before)
+        {
+            int *pending = cursor->changed + cursor->changed_pos;
+            int num_pending = cursor->num_changed - cursor->changed_pos;
+            qsort(pending, num_pending, sizeof(int), compare_ints);
+            int kept = 0;
+            for (int i = 0; i < num_pending; i++)
+            {
+                if (pending[i] > cursor->last && (kept == 0 || pending[i] != cursor->changed[kept - 1]))
+                {
+                    cursor->changed[kept++] = pending[i];
+                }
+            }
+            cursor->changed_pos = 0;
+            cursor->num_changed = kept;
+        }
+
+        if (cursor->index_ready && cursor->index_row.id <= cursor->last)
+        {
+            cursor->index_ready = 0; // a changed id taken already came back into the index
+            continue;
+        }
+        int from_index = cursor->index_ready;
+        int id = from_index ? cursor->index_row.id : 0;
+        if (cursor->changed_pos < cursor->num_changed &&
+            (!from_index || cursor->changed[cursor->changed_pos] <= id))
+        {
+            from_index = from_index && cursor->changed[cursor->changed_pos] == id;
+            id = cursor->changed[cursor->changed_pos++];
+        }
+        else if (!from_index)
+        {
+            break;
+        }
+        if (from_index)
+        {
+            cursor->index_ready = 0;
+        }
+        cursor->last = id;
+        int version = snapshot_version(db, cursor->snapshot, id, row);
+        if (version > 0)
+        {
+            return 1;
+        }
+        if (version < 0 && from_index)
+        {
+            *row = cursor->index_row;
+            return 1;
+        }
+    }
+    cursor->last = cursor->hi;
+    return 0;
+}
+
+// Release what a snapshot range scan holds (the snapshot itself stays open)
+void snapshot_cursor_close(SnapshotCursor *cursor)
+{
+    free(cursor->changed);
+    cursor->changed = NULL;
+    cursor->num_changed = 0;
+    cursor->changed_pos = 0;
+    cursor->changed_capacity = 0;
+}
+
+// Open a scan over the rows named name, or with prefix set the rows whose names start with
+// it, in name then id order through the name index
+void select_by_name(Database *db, const char *name, int prefix, NameCursor *cursor)
+{
+    name_index_seek(db, name, prefix, cursor);
+}
 
+// Fetch the next row of a name scan (returns 0 when no more names match)
+int name_next(Database *db, NameCursor *cursor, struct Row *row)
+{
+    int id;
+    while (name_index_next(db, cursor, &id))
+    {
+        off_t address;
+        if (locate_row(db, id, &address, row) > 0)
+        {
+            // A row renamed since its entry was read no longer belongs to the scan
+            size_t length = cursor->prefix ? strlen(cursor->name) : sizeof(row->name);
+            if (strncmp(row->name, cursor->name, length) == 0)
+            {
+                return 1;
+            }
+            continue;
+        }
+        printf("Error: Name index refers to missing row id=%d\n", id);
+    }
+    return 0;
+}
+
+// Update a row and its name index entry without logging it (returns 0 if it does not exist)
+static int update_unlogged(Database *db, int id, const char *name)
+{
     off_t address;
     btree_search(db, id, &address);
     if (address == -1)
@@ -129,127 +780,281 @@ int update_row(Database *db, int id, const char *name)
     }
 
     struct Row row;
-    fseek(db->file, address, SEEK_SET);
-    size_t bytes_read = fread(&row, sizeof(struct Row), 1, db->file);
-    if (bytes_read != 1)
+    if (!read_row(db, address, &row))
     {
         printf("Error: Failed to read row at address %lld\n", (long long)address);
         return 0;
     }
-    strncpy(row.name, name, 59);
-    row.name[59] = '\0';
-    fseek(db->file, address, SEEK_SET);
-    fwrite(&row, sizeof(struct Row), 1, db->file);
+    version_record(db, id, &row);
+    return rename_row(db, address, &row, name);
+}
 
-    // update in memory pages
-    for (int page = 0; page < db->num_pages; page++)
+// update a row
+int update_row(Database *db, int id, const char *name)
+{
+    if (id <= 0)
     {
-        int *page_num_rows = (int *)db->pages[page];
-        for (int i = 0; i < *page_num_rows; i++)
-        {
-            size_t offset = sizeof(int) + (i * sizeof(struct Row));
-            off_t computed_address = DATA_START_OFFSET + (off_t)page * PAGE_SIZE + offset;
-
-            if (computed_address == address)
-            {
-                memcpy((char *)db->pages[page] + offset, &row, sizeof(struct Row));
-                db->page_dirty[page] = 1;
-                break;
-            }
-        }
+        printf("Error: ID must be a positive integer (got %d)\n", id);
+        return 0;
     }
-    write_buffer(db);
-    return 1;
+    lock_writer(db);
+    uint64_t lsn = 0;
+    int updated = update_unlogged(db, id, name);
+    if (updated)
+    {
+        lsn = log_change(db, WAL_UPDATE, id, name);
+    }
+    unlock_writer(db);
+    commit_logged(db, lsn);
+    return updated;
 }
 
-// Compact pages by consolidating rows and removing empty pages
-void compact_pages(Database *db)
+// Update a batch of rows, sharing descents between ids in the same leaf and committing
+// with one log flush (returns the number updated; missing ids are skipped)
+int update_rows(Database *db, const struct Row *rows, int count)
 {
-    // Count total remaining rows
-    int total_rows = 0;
-    for (int p = 0; p < db->num_pages; p++)
+    if (count <= 0)
+    {
+        return 0;
+    }
+    struct Row *batch = malloc(count * sizeof(struct Row));
+    int *ids = malloc(count * sizeof(int));
+    off_t *addresses = malloc(count * sizeof(off_t));
+    if (batch == NULL || ids == NULL || addresses == NULL)
+    {
+        printf("Error: Could not allocate memory for the batch\n");
+        free(batch);
+        free(ids);
+        free(addresses);
+        return 0;
+    }
+    memcpy(batch, rows, count * sizeof(struct Row));
+    int n = prepare_batch(batch, count);
+    for (int i = 0; i < n; i++)
     {
-        int *page_num_rows = (int *)db->pages[p];
-        total_rows += *page_num_rows;
+        ids[i] = batch[i].id;
     }
+    lock_writer(db);
+    btree_search_batch(db, ids, n, addresses);
 
-    if (total_rows == 0)
+    uint64_t lsn = 0;
+    int updated = 0;
+    for (int i = 0; i < n; i++)
     {
-        // All rows deleted, keep one empty page
-        if (db->num_pages > 1)
+        if (addresses[i] == -1)
         {
-            for (int p = 1; p < db->num_pages; p++)
-            {
-                free(db->pages[p]);
-                db->pages[p] = NULL;
-            }
-            db->num_pages = 1;
-            memset(db->pages[0], 0, PAGE_SIZE);
-            int zero = 0;
-            memcpy(db->pages[0], &zero, sizeof(int));
-            db->page_dirty[0] = 1;
+            printf("Error: Row with id=%d not found\n", ids[i]);
+            continue;
         }
-        return;
+        struct Row row;
+        if (!read_row(db, addresses[i], &row))
+        {
+            printf("Error: Failed to read row at address %lld\n", (long long)addresses[i]);
+            continue;
+        }
+        version_record(db, row.id, &row);
+        if (!rename_row(db, addresses[i], &row, batch[i].name))
+        {
+            continue;
+        }
+        lsn = relieve_batch(db, log_change(db, WAL_UPDATE, row.id, row.name));
+        updated++;
     }
+    unlock_writer(db);
+    commit_logged(db, lsn);
+
+    free(batch);
+    free(ids);
+    free(addresses);
+    return updated;
+}
+
+// Move a row into a page with room and point its index entry at the new slot, then free
+// the old slot; no page stays pinned across the steps, so a checkpoint in between sees a
+// consistent table
+static void relocate_row(Database *db, const struct Row *row, off_t from_rid, off_t to_page)
+{
+    // Unchanged, but a snapshot scan of the pages may miss the row or meet it twice now; the
+    // record sends the scan to the version store for it instead
+    version_record(db, row->id, row);
+    void *page = fetch_data_page(db, to_page);
+    int slot = data_page_insert(page, row);
+    buffer_pool_unpin(db->pool, to_page, 1);
+    btree_update(db, row->id, RID(to_page, slot));
 
-    // Calculate how many pages we actually need
-    int rows_per_page = (PAGE_SIZE - sizeof(int)) / sizeof(struct Row);
-    int pages_needed = (total_rows + rows_per_page - 1) / rows_per_page; // Ceiling division
+    off_t from_page = RID_PAGE(from_rid);
+    page = fetch_data_page(db, from_page);
+    data_page_delete(page, RID_SLOT(from_rid));
+    buffer_pool_unpin(db->pool, from_page, 1);
+}
 
-    // Collect all rows into a temporary array
-    struct Row *all_rows = malloc(total_rows * sizeof(struct Row));
-    if (all_rows == NULL)
+// Live rows in a data page
+static int page_live_rows(Database *db, off_t offset)
+{
+    const DataPageHeader *header = fetch_data_page(db, offset);
+    int live = header->live_rows;
+    buffer_pool_unpin(db->pool, offset, 0);
+    return live;
+}
+
+// Whether a data page has room for one more row
+static int page_has_room(Database *db, off_t offset)
+{
+    const void *page = fetch_data_page(db, offset);
+    int has_room = data_page_has_room(page);
+    buffer_pool_unpin(db->pool, offset, 0);
+    return has_room;
+}
+
+// Shrink the data chain: rows from the last pages move into free slots of the first ones
+// (with their index entries), and the pages left empty at the tail are freed (returns the
+// number of pages freed). Not logged: a row is copied, repointed and then freed at its old
+// slot, so the table is consistent after every step and any checkpoint is safe.
+static int compact_pages(Database *db)
+{
+    int count = (int)db->header.data_pages;
+    off_t *pages = malloc(count * sizeof(off_t));
+    if (pages == NULL)
     {
         printf("Error: Could not allocate memory for compaction\n");
-        return;
+        return 0;
+    }
+    off_t offset = db->header.first_data_page;
+    for (int i = 0; i < count; i++)
+    {
+        pages[i] = offset;
+        const void *page = fetch_data_page(db, offset);
+        offset = data_page_next(page);
+        buffer_pool_unpin(db->pool, pages[i], 0);
     }
 
-    int row_index = 0;
-    for (int p = 0; p < db->num_pages; p++)
+    // Fill holes from the front of the chain with rows taken from the back
+    int write = 0;
+    int read = count - 1;
+    while (write < read)
     {
-        int *page_num_rows = (int *)db->pages[p];
-        for (int r = 0; r < *page_num_rows; r++)
+        if (!page_has_room(db, pages[write]))
+        {
+            write++;
+            continue;
+        }
+        const void *page = fetch_data_page(db, pages[read]);
+        struct Row row;
+        int slot = 0;
+        while (slot < data_page_slots(page) && !data_page_read(page, slot, &row))
         {
-            size_t offset = sizeof(int) + (r * sizeof(struct Row));
-            memcpy(&all_rows[row_index++], (char *)db->pages[p] + offset, sizeof(struct Row));
+            slot++;
         }
+        int found = slot < data_page_slots(page);
+        buffer_pool_unpin(db->pool, pages[read], 0);
+        if (!found)
+        {
+            read--;
+            continue;
+        }
+        relocate_row(db, &row, RID(pages[read], slot), pages[write]);
+        // Moves dirty index leaves all over the tree; let checkpoints drain the pool
+        checkpoint_if_needed(db);
     }
 
-    // Clear all existing pages
-    for (int p = 0; p < db->num_pages; p++)
+    // Everything after the last page with rows is empty (the first page always stays);
+    // scans of the chain start over once it is cut
+    begin_restructure(db);
+    int keep = count;
+    while (keep > 1 && page_live_rows(db, pages[keep - 1]) == 0)
     {
-        memset(db->pages[p], 0, PAGE_SIZE);
-        db->page_dirty[p] = 1;
+        keep--;
     }
+    void *tail = fetch_data_page(db, pages[keep - 1]);
+    set_data_page_next(tail, 0);
+    buffer_pool_unpin(db->pool, pages[keep - 1], 1);
+    db->header.last_data_page = pages[keep - 1];
+    db->header.data_pages = keep;
+    free_space_rebuild(db);
 
-    // Redistribute rows to pages_needed pages
-    row_index = 0;
-    for (int p = 0; p < pages_needed; p++)
+    for (int i = keep; i < count; i++)
     {
-        int rows_for_this_page = (p < total_rows % pages_needed) ?
-                                (total_rows / pages_needed) + 1 :
-                                (total_rows / pages_needed);
+        free_page(db, pages[i]);
+        checkpoint_if_needed(db);
+    }
+    end_restructure(db);
+    free(pages);
+    return count - keep;
+}
 
-        // Set row count for this page
-        memcpy(db->pages[p], &rows_for_this_page, sizeof(int));
+// Shrink the data chain (see compact_pages; returns the number of pages freed)
+int compact_table(Database *db)
+{
+    if (db->clustered)
+    {
+        return 0; // rows live in the leaves, which merge as they empty
+    }
+    lock_writer(db);
+    int freed = compact_pages(db);
+    unlock_writer(db);
+    return freed;
+}
 
-        // Copy rows to this page
-        for (int r = 0; r < rows_for_this_page; r++)
-        {
-            size_t offset = sizeof(int) + (r * sizeof(struct Row));
-            memcpy((char *)db->pages[p] + offset, &all_rows[row_index++], sizeof(struct Row));
-        }
+// Compact once free slots reach COMPACTION_FREE_PERCENT of the data page slots and add up
+// to at least a page, so the cost of moving rows is spread over many deletes
+void compact_if_needed(Database *db)
+{
+    DbHeader *header = &db->header;
+    if (db->replaying)
+    {
+        return; // a checkpoint must not empty the log while it is being replayed
+    }
+    lock_writer(db);
+    off_t capacity = header->data_pages * (off_t)MAX_ROWS;
+    off_t free_slots = capacity - header->row_count;
+    if (free_slots >= (off_t)MAX_ROWS && free_slots * 100 >= capacity * COMPACTION_FREE_PERCENT)
+    {
+        compact_table(db);
+    }
+    unlock_writer(db);
+}
+
+// Remove a row and its index entry without logging it (returns 0 if it does not exist)
+static int delete_unlogged(Database *db, int id)
+{
+    off_t address;
+    btree_search(db, id, &address);
+    if (address == -1)
+    {
+        printf("Error: Row with id=%d not found\n", id);
+        return 0;
+    }
+
+    // The name index entry is found by the row's name
+    struct Row row;
+    int readable = read_row(db, address, &row);
+    if (!readable)
+    {
+        row.id = id;
+        memset(row.name, 0, sizeof(row.name));
+    }
+    version_record(db, id, &row);
+    if (readable)
+    {
+        name_index_delete(db, row.name, id);
     }
 
-    // Free unused pages
-    for (int p = pages_needed; p < db->num_pages; p++)
+    // Delete from B-Tree
+    btree_delete(db, id);
+    if (db->clustered)
     {
-        free(db->pages[p]);
-        db->pages[p] = NULL;
+        db->header.row_count--; // the row went with its leaf entry
+        return 1;
     }
 
-    db->num_pages = pages_needed;
-    free(all_rows);
+    // Free the slot for the next insert; the page joins the free-space map if it was full
+    off_t page_offset = RID_PAGE(address);
+    void *page = fetch_data_page(db, page_offset);
+    data_page_delete(page, RID_SLOT(address));
+    free_space_push(db, page_offset, page);
+    buffer_pool_unpin(db->pool, page_offset, 1);
+    db->header.row_count--;
+    return 1;
 }
 
 // Delete a row
@@ -260,85 +1065,316 @@ int delete_row(Database *db, int id)
         printf("Error: ID must be a positive integer (got %d)\n", id);
         return 0;
     }
+    lock_writer(db);
+    uint64_t lsn = 0;
+    int deleted = delete_unlogged(db, id);
+    if (deleted)
+    {
+        lsn = log_change(db, WAL_DELETE, id, NULL);
+    }
+    unlock_writer(db);
+    if (!deleted)
+    {
+        return 0;
+    }
+    commit_logged(db, lsn);
+    compact_if_needed(db);
+    return 1;
+}
 
-    off_t address;
-    btree_search(db, id, &address);
-    if (address == -1)
+// Delete a batch of rows in id order (neighbouring ids reuse the same cached leaves and
+// data pages) and commit with one log flush (returns the number deleted)
+int delete_rows(Database *db, const int *ids, int count)
+{
+    if (count <= 0)
     {
-        printf("Error: Row with id=%d not found\n", id);
         return 0;
     }
+    int *sorted = malloc(count * sizeof(int));
+    if (sorted == NULL)
+    {
+        printf("Error: Could not allocate memory for the batch\n");
+        return 0;
+    }
+    memcpy(sorted, ids, count * sizeof(int));
+    qsort(sorted, count, sizeof(int), compare_ints);
 
-    // Delete from B-Tree
-    btree_delete(db, id);
+    uint64_t lsn = 0;
+    int deleted = 0;
+    lock_writer(db);
+    for (int i = 0; i < count; i++)
+    {
+        if (sorted[i] <= 0)
+        {
+            printf("Error: ID must be a positive integer (got %d)\n", sorted[i]);
+            continue;
+        }
+        if (!delete_unlogged(db, sorted[i]))
+        {
+            continue; // missing (or repeated) ids are reported and skipped
+        }
+        lsn = relieve_batch(db, log_change(db, WAL_DELETE, sorted[i], NULL));
+        deleted++;
+    }
+    unlock_writer(db);
+    commit_logged(db, lsn);
+    compact_if_needed(db);
+    free(sorted);
+    return deleted;
+}
 
-    // Delete from data pages
-    int found = 0;
-    for (int page = 0; page < db->num_pages; page++)
+// Apply one write of a batch without logging it (returns 1 if it was applied)
+static int apply_unlogged(Database *db, const WriteRequest *write)
+{
+    if (write->id <= 0)
+    {
+        printf("Error: ID must be a positive integer (got %d)\n", write->id);
+        return 0;
+    }
+    switch (write->type)
+    {
+    case WAL_INSERT:
+        return insert_unlogged(db, write->id, write->name);
+    case WAL_UPDATE:
+        return update_unlogged(db, write->id, write->name);
+    case WAL_DELETE:
+        return delete_unlogged(db, write->id);
+    default:
+        printf("Error: Unknown write type %d\n", write->type);
+        return 0;
+    }
+}
+
+// Apply a mixed batch of inserts, updates and deletes in order and commit it with one log
+// flush, recording in each request whether it was applied (returns the number applied).
+// Pipelined requests from the server arrive this way, so they share a log sync.
+int apply_writes(Database *db, WriteRequest *writes, int count)
+{
+    uint64_t lsn = 0;
+    int applied = 0;
+    int deleted = 0;
+    lock_writer(db);
+    for (int i = 0; i < count; i++)
     {
-        int *page_num_rows = (int *)db->pages[page];
-        for (int i = 0; i < *page_num_rows; i++)
+        WriteRequest *write = &writes[i];
+        write->applied = apply_unlogged(db, write);
+        if (write->applied)
         {
-            size_t offset = sizeof(int) + (i * sizeof(struct Row));
-            off_t computed_address = DATA_START_OFFSET + (off_t)page * PAGE_SIZE + offset;
-            if (computed_address == address)
-            {
-                found = 1;
-                // Shift all subsequent rows left to fill the gap
-                for (int j = i; j < *page_num_rows - 1; j++)
-                {
-                    size_t current_offset = sizeof(int) + (j * sizeof(struct Row));
-                    size_t next_offset = sizeof(int) + ((j + 1) * sizeof(struct Row));
-                    memcpy((char *)db->pages[page] + current_offset,
-                           (char *)db->pages[page] + next_offset,
-                           sizeof(struct Row));
-                }
-                // Clear the last slot after shifting
-                size_t last_offset = sizeof(int) + ((*page_num_rows - 1) * sizeof(struct Row));
-                memset((char *)db->pages[page] + last_offset, 0, sizeof(struct Row));
-                (*page_num_rows)--;
+            deleted += write->type == WAL_DELETE;
+            lsn = relieve_batch(db, log_change(db, write->type, write->id,
+                                               write->type == WAL_DELETE ? NULL : write->name));
+            applied++;
+        }
+    }
+    unlock_writer(db);
+    commit_logged(db, lsn);
+    if (deleted > 0)
+    {
+        compact_if_needed(db);
+    }
+    return applied;
+}
 
-                int updated_num_rows = *page_num_rows;
-                memcpy(db->pages[page], &updated_num_rows, sizeof(int));
+// A write of a batch by id, for checking each id's writes together
+typedef struct {
+    int id;
+    int position;
+} WritePosition;
 
-                // handle empty pages
-                if (*page_num_rows == 0)
-                {
-                    free(db->pages[page]);
-                    for (int k = page; k < db->num_pages - 1; k++)
-                    {
-                        db->pages[k] = db->pages[k + 1];
-                    }
-                    db->pages[db->num_pages - 1] = NULL;
-                    db->num_pages--;
-                    if (db->num_pages == 0)
-                    {
-                        void *new_page = malloc(PAGE_SIZE);
-                        if (new_page == NULL)
-                        {
-                            perror("Error: Could not allocate initial page\n");
-                            free(db->pages);
-                            fclose(db->file);
-                            exit(1);
-                        }
-                        memset(new_page, 0, PAGE_SIZE);
-                        db->pages[0] = new_page;
-                        db->num_pages = 1;
-                    }
-                }
-                db->page_dirty[page] = 1;
-                break;
-            }
+// Order writes by id, then by position in the batch
+static int compare_write_positions(const void *a, const void *b)
+{
+    const WritePosition *x = a;
+    const WritePosition *y = b;
+    if (x->id != y->id)
+    {
+        return x->id < y->id ? -1 : 1;
+    }
+    return x->position - y->position;
+}
+
+// Check that every write of a batch would apply in order against the table as it is now:
+// each id's writes are replayed over whether the id exists (returns 0 after reporting the
+// first write that would fail)
+static int check_writes(Database *db, const WriteRequest *writes, int count)
+{
+    WritePosition *order = malloc(count * sizeof(WritePosition));
+    if (order == NULL)
+    {
+        printf("Error: Could not allocate memory for the transaction\n");
+        return 0;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        order[i].id = writes[i].id;
+        order[i].position = i;
+    }
+    qsort(order, count, sizeof(WritePosition), compare_write_positions);
+
+    int ok = 1;
+    int exists = 0;
+    for (int i = 0; i < count && ok; i++)
+    {
+        const WriteRequest *write = &writes[order[i].position];
+        if (write->id <= 0)
+        {
+            printf("Error: ID must be a positive integer (got %d)\n", write->id);
+            ok = 0;
+            break;
+        }
+        if (i == 0 || write->id != order[i - 1].id)
+        {
+            off_t address;
+            btree_search(db, write->id, &address);
+            exists = address != -1;
         }
-        if (found)
+        switch (write->type)
+        {
+        case WAL_INSERT:
+            if (exists)
+            {
+                printf("Error: Row with id=%d already exists\n", write->id);
+                ok = 0;
+            }
+            exists = 1;
+            break;
+        case WAL_UPDATE:
+        case WAL_DELETE:
+            if (!exists)
+            {
+                printf("Error: Row with id=%d not found\n", write->id);
+                ok = 0;
+            }
+            exists = write->type == WAL_UPDATE;
+            break;
+        default:
+            printf("Error: Unknown write type %d\n", write->type);
+            ok = 0;
             break;
+        }
     }
-    if (found)
+    free(order);
+    return ok;
+}
+
+// Record in undo the write that takes a row back to how it is before write applies
+static void plan_undo(Database *db, const WriteRequest *write, WriteRequest *undo)
+{
+    off_t address;
+    struct Row row;
+    memset(undo, 0, sizeof(WriteRequest));
+    undo->id = write->id;
+    if (write->type == WAL_INSERT)
     {
-        // Compact pages after deletion
-        compact_pages(db);
-        write_buffer(db);
+        undo->type = WAL_DELETE;
+        return;
+    }
+    undo->type = write->type == WAL_DELETE ? WAL_INSERT : WAL_UPDATE;
+    if (locate_row(db, write->id, &address, &row) == 1)
+    {
+        memcpy(undo->name, row.name, sizeof(undo->name));
     }
+}
 
-    return found;
+// Take back the first count writes of a transaction that could not apply in full, last
+// first. Checkpoints on the way may have written part of the transaction already, so the
+// undoing writes are logged after a rollback marker and replay runs them too (returns the
+// LSN to commit).
+static uint64_t roll_back_writes(Database *db, WriteRequest *undo, int count, int batch_size)
+{
+    uint64_t lsn = log_change(db, WAL_ROLLBACK, batch_size, NULL);
+    uint64_t first = lsn + 1;
+    for (int i = count - 1; i >= 0; i--)
+    {
+        lsn = log_change(db, undo[i].type, undo[i].id, undo[i].type == WAL_DELETE ? NULL : undo[i].name);
+    }
+    db->sync->unapplied_lsn = first;
+    for (int i = count - 1; i >= 0; i--)
+    {
+        if (!apply_unlogged(db, &undo[i]))
+        {
+            printf("Error: Could not undo the change to row id=%d\n", undo[i].id);
+        }
+        db->sync->unapplied_lsn++;
+        if (!db->use_mmap && db->pool->num_dirty >= db->pool->num_frames / 2)
+        {
+            commit_logged(db, lsn);
+        }
+    }
+    return lsn;
+}
+
+// Apply a batch as one transaction: all of it or, if any write would fail, none of it
+// (returns 1 if committed). The writes are logged between begin and commit markers before
+// the first one touches a page, so replay after a crash applies all of them or none, and
+// the batch is made durable with one log flush. Checkpoints forced by a full pool on the
+// way keep the log, and record in the header how much of the batch their pages hold, so
+// replay resumes after it. A write that fails as it applies (an index with no page left
+// to split into) rolls back the ones before it.
+int commit_writes(Database *db, WriteRequest *writes, int count)
+{
+    if (count <= 0)
+    {
+        return 1;
+    }
+    WriteRequest *undo = malloc(count * sizeof(WriteRequest));
+    if (undo == NULL)
+    {
+        printf("Error: Could not allocate memory for the transaction\n");
+        return 0;
+    }
+    lock_writer(db);
+    if (!check_writes(db, writes, count))
+    {
+        unlock_writer(db);
+        free(undo);
+        return 0;
+    }
+    uint64_t begin = log_change(db, WAL_BEGIN, count, NULL);
+    for (int i = 0; i < count; i++)
+    {
+        log_change(db, writes[i].type, writes[i].id, writes[i].type == WAL_DELETE ? NULL : writes[i].name);
+    }
+    uint64_t lsn = log_change(db, WAL_COMMIT, count, NULL);
+
+    int deleted = 0;
+    int applied = 0;
+    db->sync->keep_log = 1;
+    db->sync->unapplied_lsn = begin + 1;
+    while (applied < count)
+    {
+        plan_undo(db, &writes[applied], &undo[applied]);
+        writes[applied].applied = apply_unlogged(db, &writes[applied]);
+        if (!writes[applied].applied)
+        {
+            break;
+        }
+        deleted += writes[applied].type == WAL_DELETE;
+        applied++;
+        db->sync->unapplied_lsn = begin + 1 + (uint64_t)applied;
+        if (!db->use_mmap && db->pool->num_dirty >= db->pool->num_frames / 2)
+        {
+            // Make the whole batch durable before a checkpoint writes part of it
+            commit_logged(db, lsn);
+        }
+    }
+    int committed = applied == count;
+    if (!committed)
+    {
+        lsn = roll_back_writes(db, undo, applied, count);
+        for (int i = 0; i < count; i++)
+        {
+            writes[i].applied = 0;
+        }
+        deleted = 0;
+    }
+    db->sync->keep_log = 0;
+    unlock_writer(db);
+    commit_logged(db, lsn);
+    free(undo);
+    if (deleted > 0)
+    {
+        compact_if_needed(db);
+    }
+    return committed;
 }
@@ -0,0 +1,223 @@
+#include "../../include/coredb.h"
+
+#define TXN_MAP_MIN 64
+
+// Slot of an id in the transaction's map (kept at most half full, see remember_write)
+static int map_slot(const Transaction *txn, int id)
+{
+    uint32_t h = (uint32_t)id * 2654435761u;
+    int mask = txn->map_capacity - 1;
+    int slot = (int)(h >> 8) & mask;
+    while (txn->map_ids[slot] != 0 && txn->map_ids[slot] != id)
+    {
+        slot = (slot + 1) & mask;
+    }
+    return slot;
+}
+
+// Latest write of an id in the transaction, NULL if it has none
+static const WriteRequest *latest_write(const Transaction *txn, int id)
+{
+    if (txn->map_capacity == 0)
+    {
+        return NULL;
+    }
+    int slot = map_slot(txn, id);
+    return txn->map_ids[slot] == id ? &txn->writes[txn->map_writes[slot]] : NULL;
+}
+
+// Whether a row exists as the transaction sees it: after its own writes, if any
+static int row_visible(const Transaction *txn, int id)
+{
+    const WriteRequest *write = latest_write(txn, id);
+    if (write != NULL)
+    {
+        return write->type != WAL_DELETE;
+    }
+    off_t address;
+    btree_search(txn->db, id, &address);
+    return address != -1;
+}
+
+// Grow the map to twice its size and put every id back (returns 0 on failure)
+static int grow_map(Transaction *txn)
+{
+    int capacity = txn->map_capacity > 0 ? txn->map_capacity * 2 : TXN_MAP_MIN;
+    int *ids = calloc(capacity, sizeof(int));
+    int *writes = malloc(capacity * sizeof(int));
+    if (ids == NULL || writes == NULL)
+    {
+        free(ids);
+        free(writes);
+        return 0;
+    }
+    int *old_ids = txn->map_ids;
+    int *old_writes = txn->map_writes;
+    int old_capacity = txn->map_capacity;
+    txn->map_ids = ids;
+    txn->map_writes = writes;
+    txn->map_capacity = capacity;
+    for (int i = 0; i < old_capacity; i++)
+    {
+        if (old_ids[i] != 0)
+        {
+            int slot = map_slot(txn, old_ids[i]);
+            txn->map_ids[slot] = old_ids[i];
+            txn->map_writes[slot] = old_writes[i];
+        }
+    }
+    free(old_ids);
+    free(old_writes);
+    return 1;
+}
+
+// Append a write to the transaction and point its id at it (returns 0 on failure)
+static int remember_write(Transaction *txn, int type, int id, const char *name)
+{
+    if (txn->count == txn->capacity)
+    {
+        int capacity = txn->capacity > 0 ? txn->capacity * 2 : TXN_MAP_MIN;
+        WriteRequest *writes = realloc(txn->writes, capacity * sizeof(WriteRequest));
+        if (writes == NULL)
+        {
+            printf("Error: Could not allocate memory for the transaction\n");
+            return 0;
+        }
+        txn->writes = writes;
+        txn->capacity = capacity;
+    }
+    if (2 * (txn->count + 1) > txn->map_capacity && !grow_map(txn))
+    {
+        printf("Error: Could not allocate memory for the transaction\n");
+        return 0;
+    }
+    WriteRequest *write = &txn->writes[txn->count];
+    memset(write, 0, sizeof(WriteRequest));
+    write->type = type;
+    write->id = id;
+    if (name != NULL)
+    {
+        strncpy(write->name, name, sizeof(write->name) - 1);
+    }
+    int slot = map_slot(txn, id);
+    txn->map_ids[slot] = id;
+    txn->map_writes[slot] = txn->count++;
+    return 1;
+}
+
+// Check that a transaction is open and an id is valid for it (reports why not)
+static int writable(const Transaction *txn, int id)
+{
+    if (!txn->active)
+    {
+        printf("Error: No transaction is open\n");
+        return 0;
+    }
+    if (id <= 0)
+    {
+        printf("Error: ID must be a positive integer (got %d)\n", id);
+        return 0;
+    }
+    return 1;
+}
+
+// Free what a transaction buffered and close it
+static void txn_release(Transaction *txn)
+{
+    free(txn->writes);
+    free(txn->map_ids);
+    free(txn->map_writes);
+    memset(txn, 0, sizeof(Transaction));
+}
+
+// Open a transaction on db: nothing reaches the table or the log until txn_commit
+void txn_begin(Database *db, Transaction *txn)
+{
+    memset(txn, 0, sizeof(Transaction));
+    txn->db = db;
+    txn->active = 1;
+}
+
+// Queue an insert (returns 0 if the id exists as the transaction sees it)
+int txn_insert(Transaction *txn, int id, const char *name)
+{
+    if (!writable(txn, id))
+    {
+        return 0;
+    }
+    if (row_visible(txn, id))
+    {
+        printf("Error: Row with id=%d already exists\n", id);
+        return 0;
+    }
+    return remember_write(txn, WAL_INSERT, id, name);
+}
+
+// Queue an update (returns 0 if the row does not exist as the transaction sees it)
+int txn_update(Transaction *txn, int id, const char *name)
+{
+    if (!writable(txn, id))
+    {
+        return 0;
+    }
+    if (!row_visible(txn, id))
+    {
+        printf("Error: Row with id=%d not found\n", id);
+        return 0;
+    }
+    return remember_write(txn, WAL_UPDATE, id, name);
+}
+
+// Queue a delete (returns 0 if the row does not exist as the transaction sees it)
+int txn_delete(Transaction *txn, int id)
+{
+    if (!writable(txn, id))
+    {
+        return 0;
+    }
+    if (!row_visible(txn, id))
+    {
+        printf("Error: Row with id=%d not found\n", id);
+        return 0;
+    }
+    return remember_write(txn, WAL_DELETE, id, NULL);
+}
+
+// Select a row by ID as the transaction sees it, its own changes included (returns 1 if found)
+int txn_select(Transaction *txn, int id, struct Row *row)
+{
+    const WriteRequest *write = txn->active && id > 0 ? latest_write(txn, id) : NULL;
+    if (write == NULL)
+    {
+        return select_by_id(txn->db, id, row);
+    }
+    if (write->type == WAL_DELETE)
+    {
+        printf("Error: Row with id=%d not found\n", id);
+        return 0;
+    }
+    row->id = id;
+    memcpy(row->name, write->name, sizeof(row->name));
+    return 1;
+}
+
+// Apply the transaction's changes as one and close it (returns 1 if committed, 0 if it was
+// rolled back because a change no longer applies: another writer took an id or removed a row)
+int txn_commit(Transaction *txn)
+{
+    if (!txn->active)
+    {
+        printf("Error: No transaction is open\n");
+        return 0;
+    }
+    int committed = commit_writes(txn->db, txn->writes, txn->count);
+    txn_release(txn);
+    return committed;
+}
+
+// Drop the transaction's changes and close it; nothing was applied or logged, so there is
+// nothing to undo
+void txn_abort(Transaction *txn)
+{
+    txn_release(txn);
+}
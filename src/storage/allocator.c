@@ -0,0 +1,192 @@
+#include "../../include/coredb.h"
+#include <unistd.h>
+
+// Read the header page, or build one for a new file or a file from before the header
+int read_header(Database *db, off_t file_size)
+{
+    DbHeader *header = &db->header;
+    memset(header, 0, sizeof(DbHeader));
+    memset(&db->checkpointed_header, 0, sizeof(DbHeader));
+
+    if (file_size == 0)
+    {
+        // Header page, then the root leaves of the id and name indexes; the first data
+        // page is allocated on load
+        header->root_offset = HEADER_PAGES * PAGE_SIZE;
+        header->name_root = (HEADER_PAGES + 1) * PAGE_SIZE;
+        header->magic = DB_MAGIC;
+        header->version = DB_VERSION;
+        header->page_count = HEADER_PAGES + 2;
+        db->root_offset = header->root_offset;
+        db->name_root = header->name_root;
+        return 0;
+    }
+
+    if (pread(fileno(db->file), header, sizeof(DbHeader), 0) != sizeof(DbHeader))
+    {
+        memset(header, 0, sizeof(DbHeader));
+        if (pread(fileno(db->file), &header->root_offset, sizeof(off_t), 0) != sizeof(off_t))
+        {
+            printf("Error: Could not read database header\n");
+            exit(1);
+        }
+    }
+    db->root_offset = header->root_offset;
+    db->name_root = header->magic == DB_MAGIC && header->version >= 7 ? header->name_root : 0;
+
+    if (header->magic == DB_MAGIC)
+    {
+        if (header->version > DB_VERSION)
+        {
+            printf("Error: Database file version %u is newer than supported version %d\n",
+                   header->version, DB_VERSION);
+            exit(1);
+        }
+        if (header->version < 8)
+        {
+            header->hashed = 0; // the header ended before this field
+        }
+        if (header->version < 9)
+        {
+            // No Bloom filter yet: one is built at open
+            header->bloom_offset = 0;
+            header->bloom_pages = 0;
+            header->bloom_keys = 0;
+        }
+        if (header->version < 11)
+        {
+            // No checkpoint LSN yet: the whole log replays
+            header->checkpoint_lsn = 0;
+            header->checksum = 0;
+            header->reserved = 0;
+        }
+        else if (header->checksum != header_checksum(header))
+        {
+            printf("Error: The database header fails its checksum\n");
+            exit(1);
+        }
+        db->checkpointed_header = *header;
+        header->version = DB_VERSION; // older headers are upgraded at the next checkpoint
+        return 0;
+    }
+
+    // Only root_offset was stored; the table is rebuilt by upgrade_table
+    off_t root_offset = header->root_offset;
+    memset(header, 0, sizeof(DbHeader));
+    header->root_offset = root_offset;
+    header->magic = DB_MAGIC;
+    header->version = DB_VERSION;
+    header->page_count = (file_size + PAGE_SIZE - 1) / PAGE_SIZE;
+    if (header->page_count < LEGACY_DATA_START_OFFSET / PAGE_SIZE)
+    {
+        header->page_count = LEGACY_DATA_START_OFFSET / PAGE_SIZE;
+    }
+    if (file_size > LEGACY_DATA_START_OFFSET)
+    {
+        header->first_data_page = LEGACY_DATA_START_OFFSET;
+    }
+    return 1;
+}
+
+// CRC32C of a header, taking its checksum field as zero
+uint32_t header_checksum(const DbHeader *header)
+{
+    DbHeader copy = *header;
+    copy.checksum = 0;
+    return crc32c(&copy, sizeof(DbHeader));
+}
+
+// Persist the header page (root offset, page count and free list), after the checksums of
+// the pages it points to
+void write_header(Database *db)
+{
+    db->header.root_offset = db->root_offset;
+    db->header.name_root = db->name_root;
+    db->header.checksum = header_checksum(&db->header);
+    if (!page_checksums_flush(db->checksums))
+    {
+        printf("Error: Failed to write page checksums\n");
+        exit(1);
+    }
+    if (db->use_mmap)
+    {
+        // Keep the private mapping in step with the file
+        memcpy(db->pool->map, &db->header, sizeof(DbHeader));
+    }
+    if (pwrite(fileno(db->file), &db->header, sizeof(DbHeader), 0) != sizeof(DbHeader))
+    {
+        printf("Error: Failed to write database header\n");
+        exit(1);
+    }
+}
+
+// Grow the file and its mapping so new pages can be touched in mmap mode
+static int grow_mapped_file(Database *db, off_t new_size)
+{
+    if (ftruncate(fileno(db->file), new_size) != 0)
+    {
+        perror("Error: Could not extend database file");
+        return 0;
+    }
+    // The mapping grows in place, so readers can keep using the pages they hold
+    return buffer_pool_remap(db->pool, (size_t)new_size) >= 0;
+}
+
+// Take a page from the free list, or add one at the end of the file (returns -1 on failure)
+off_t allocate_page(Database *db)
+{
+    DbHeader *header = &db->header;
+    if (header->free_head != 0)
+    {
+        off_t offset = header->free_head;
+        const unsigned char *page = buffer_pool_fetch(db->pool, offset);
+        if (page == NULL)
+        {
+            printf("Error: Failed to read free page at offset %lld\n", (long long)offset);
+            return -1;
+        }
+        memcpy(&header->free_head, page, sizeof(off_t));
+        buffer_pool_unpin(db->pool, offset, 0);
+        // The new owner rewrites the page, so the free-list copy is never needed again
+        buffer_pool_discard(db->pool, offset);
+        header->free_count--;
+        return offset;
+    }
+
+    off_t offset = header->page_count * PAGE_SIZE;
+    if (db->use_mmap && !grow_mapped_file(db, offset + PAGE_SIZE))
+    {
+        return -1;
+    }
+    header->page_count++;
+    return offset;
+}
+
+// Add pages at the end of the file for a structure kept in one extent (returns the offset
+// of the first, -1 on failure)
+off_t allocate_extent(Database *db, int pages)
+{
+    off_t offset = db->header.page_count * PAGE_SIZE;
+    if (db->use_mmap && !grow_mapped_file(db, offset + (off_t)pages * PAGE_SIZE))
+    {
+        return -1;
+    }
+    db->header.page_count += pages;
+    return offset;
+}
+
+// Put a page on the free list for reuse by the next allocation
+void free_page(Database *db, off_t offset)
+{
+    unsigned char *page = buffer_pool_fetch_new(db->pool, offset);
+    if (page == NULL)
+    {
+        printf("Error: Failed to free page at offset %lld\n", (long long)offset);
+        exit(1);
+    }
+    memset(page, 0, PAGE_SIZE);
+    memcpy(page, &db->header.free_head, sizeof(off_t));
+    buffer_pool_unpin(db->pool, offset, 1);
+    db->header.free_head = offset;
+    db->header.free_count++;
+}
@@ -0,0 +1,894 @@
+#include "../../include/coredb.h"
+#include <unistd.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+// Address space reserved by the mmap backend. The file is mapped into it piece by piece as
+// it grows, so mapped pages never move under the threads reading them.
+#define MMAP_ADDRESS_SPACE (sizeof(size_t) >= 8 ? (size_t)1 << 36 : (size_t)1 << 30)
+// Minimum bytes mapped at a time (and the granularity of the mapped size), so small files
+// do not map on every new page
+#define MMAP_MIN_RESERVE ((size_t)1024 * 1024)
+// Latches of mapped pages are allocated in chunks of this many pages
+#define MAP_LATCH_CHUNK 1024
+// Rounds of looking for an unpinned frame before the pool counts as exhausted: readers
+// hold their pins only for the length of one page access
+#define CLAIM_ATTEMPTS 1000
+
+// Hash a page offset to a bucket index
+static int bucket_for(BufferPool *pool, off_t offset)
+{
+    unsigned long page_num = (unsigned long)(offset / PAGE_SIZE);
+    return (int)((page_num * 2654435761UL) & (unsigned long)(pool->num_buckets - 1));
+}
+
+// Find the frame caching a page, -1 if it is not resident. Claims relink the chains while
+// the walk runs without the pool lock, so a walk may miss (callers then retry under the
+// lock) but never loops: no chain is longer than the frame count.
+static int find_frame(BufferPool *pool, off_t offset)
+{
+    int f = __atomic_load_n(&pool->buckets[bucket_for(pool, offset)], __ATOMIC_ACQUIRE);
+    for (int steps = 0; f != -1 && steps < pool->num_frames; steps++)
+    {
+        if (__atomic_load_n(&pool->frames[f].offset, __ATOMIC_ACQUIRE) == offset)
+        {
+            return f;
+        }
+        f = __atomic_load_n(&pool->frames[f].hash_next, __ATOMIC_ACQUIRE);
+    }
+    return -1;
+}
+
+// Find the frame of a page the caller has pinned (it cannot leave its chain meanwhile)
+static int find_pinned_frame(BufferPool *pool, off_t offset)
+{
+    int f = find_frame(pool, offset);
+    if (f == -1)
+    {
+        pthread_mutex_lock(&pool->lock);
+        f = find_frame(pool, offset);
+        pthread_mutex_unlock(&pool->lock);
+    }
+    return f;
+}
+
+// Link a frame into the hash chain for its page (pool lock held)
+static void hash_insert(BufferPool *pool, int f)
+{
+    int b = bucket_for(pool, pool->frames[f].offset);
+    __atomic_store_n(&pool->frames[f].hash_next, pool->buckets[b], __ATOMIC_RELEASE);
+    __atomic_store_n(&pool->buckets[b], f, __ATOMIC_RELEASE);
+}
+
+// Unlink a frame from the hash chain for its page (pool lock held)
+static void hash_remove(BufferPool *pool, int f)
+{
+    int b = bucket_for(pool, pool->frames[f].offset);
+    int *link = &pool->buckets[b];
+    while (*link != -1)
+    {
+        if (*link == f)
+        {
+            __atomic_store_n(link, pool->frames[f].hash_next, __ATOMIC_RELEASE);
+            break;
+        }
+        link = &pool->frames[*link].hash_next;
+    }
+    __atomic_store_n(&pool->frames[f].hash_next, -1, __ATOMIC_RELEASE);
+}
+
+// Whether the calling thread holds a latch exclusively
+static int latch_owned(PageLatch *latch)
+{
+    if (__atomic_load_n(&latch->depth, __ATOMIC_ACQUIRE) == 0)
+    {
+        return 0;
+    }
+    pthread_t owner;
+    __atomic_load(&latch->owner, &owner, __ATOMIC_RELAXED);
+    return pthread_equal(owner, pthread_self());
+}
+
+// Take a page latch, shared or exclusive; a thread that holds it exclusively already only
+// deepens its hold
+static void latch_acquire(PageLatch *latch, int exclusive)
+{
+    if (latch_owned(latch))
+    {
+        __atomic_store_n(&latch->depth, latch->depth + 1, __ATOMIC_RELAXED);
+        return;
+    }
+    if (!exclusive)
+    {
+        pthread_rwlock_rdlock(&latch->lock);
+        return;
+    }
+    pthread_rwlock_wrlock(&latch->lock);
+    pthread_t self = pthread_self();
+    __atomic_store(&latch->owner, &self, __ATOMIC_RELAXED);
+    __atomic_store_n(&latch->depth, 1, __ATOMIC_RELEASE);
+}
+
+// Mark a latch the calling thread has just locked exclusively as its own
+static void latch_own(PageLatch *latch)
+{
+    pthread_t self = pthread_self();
+    __atomic_store(&latch->owner, &self, __ATOMIC_RELAXED);
+    __atomic_store_n(&latch->depth, 1, __ATOMIC_RELEASE);
+}
+
+// Release one hold of a page latch
+static void latch_release(PageLatch *latch)
+{
+    if (latch_owned(latch))
+    {
+        int depth = latch->depth - 1;
+        __atomic_store_n(&latch->depth, depth, __ATOMIC_RELEASE);
+        if (depth > 0)
+        {
+            return;
+        }
+    }
+    pthread_rwlock_unlock(&latch->lock);
+}
+
+// Initialize the latch of a frame or mapped page
+static void latch_init(PageLatch *latch)
+{
+    pthread_rwlock_init(&latch->lock, NULL);
+    latch->depth = 0;
+}
+
+// Mark a frame dirty on behalf of the writer that has it pinned
+static void mark_frame_dirty(BufferPool *pool, BufferFrame *frame)
+{
+    if (!__atomic_load_n(&frame->dirty, __ATOMIC_RELAXED))
+    {
+        __atomic_store_n(&frame->dirty, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&pool->num_dirty, 1, __ATOMIC_RELAXED);
+    }
+}
+
+// Mark a frame clean after its page was written (or forgotten)
+static void mark_frame_clean(BufferPool *pool, BufferFrame *frame)
+{
+    if (__atomic_load_n(&frame->dirty, __ATOMIC_RELAXED))
+    {
+        __atomic_store_n(&frame->dirty, 0, __ATOMIC_RELAXED);
+        __atomic_sub_fetch(&pool->num_dirty, 1, __ATOMIC_RELAXED);
+    }
+}
+
+// Write a frame back to disk if it is dirty
+static int write_frame(BufferPool *pool, int f)
+{
+    BufferFrame *frame = &pool->frames[f];
+    if (!frame->dirty)
+    {
+        return 1;
+    }
+    if (pool->checksums != NULL)
+    {
+        page_checksums_set(pool->checksums, frame->offset, frame->data);
+    }
+    ssize_t written = pwrite(pool->fd, frame->data, PAGE_SIZE, frame->offset);
+    if (written != PAGE_SIZE)
+    {
+        printf("Error: Failed to write page at offset %lld\n", (long long)frame->offset);
+        return 0;
+    }
+    mark_frame_clean(pool, frame);
+    __atomic_add_fetch(&pool->writebacks, 1, __ATOMIC_RELAXED);
+    return 1;
+}
+
+// Write a modified page of the private mapping back to the file
+static int write_mapped_page(BufferPool *pool, size_t page)
+{
+    if (!pool->map_dirty[page])
+    {
+        return 1;
+    }
+    off_t offset = (off_t)page * PAGE_SIZE;
+    if (pool->checksums != NULL)
+    {
+        page_checksums_set(pool->checksums, offset, pool->map + offset);
+    }
+    if (pwrite(pool->fd, pool->map + offset, PAGE_SIZE, offset) != PAGE_SIZE)
+    {
+        printf("Error: Failed to write page at offset %lld\n", (long long)offset);
+        return 0;
+    }
+    pool->map_dirty[page] = 0;
+    pool->num_dirty--;
+    pool->writebacks++;
+    return 1;
+}
+
+// Pick a frame to reuse with the CLOCK policy and lock out pins on it (its pin count goes
+// to -1); -1 if every frame is pinned. Pool lock held.
+static int choose_victim(BufferPool *pool)
+{
+    // Two full sweeps: the first may only clear reference bits
+    for (int scanned = 0; scanned < pool->num_frames * 2; scanned++)
+    {
+        int f = pool->clock_hand;
+        pool->clock_hand = (pool->clock_hand + 1) % pool->num_frames;
+
+        BufferFrame *frame = &pool->frames[f];
+        if (__atomic_load_n(&frame->pin_count, __ATOMIC_ACQUIRE) != 0)
+        {
+            continue;
+        }
+        if (frame->offset != -1)
+        {
+            if (__atomic_load_n(&frame->dirty, __ATOMIC_RELAXED) && pool->no_steal)
+            {
+                continue; // Dirty pages wait for the next checkpoint
+            }
+            if (__atomic_load_n(&frame->referenced, __ATOMIC_RELAXED))
+            {
+                __atomic_store_n(&frame->referenced, 0, __ATOMIC_RELAXED);
+                continue;
+            }
+        }
+        // A reader that found the frame without the lock may pin it first
+        int unpinned = 0;
+        if (__atomic_compare_exchange_n(&frame->pin_count, &unpinned, -1, 0, __ATOMIC_ACQUIRE,
+                                        __ATOMIC_RELAXED))
+        {
+            return f;
+        }
+    }
+    return -1;
+}
+
+// Claim a frame for a page that is not resident yet (pool lock held). The frame comes back
+// pinned once and latched exclusively, so others who find it wait for its contents.
+static int claim_frame(BufferPool *pool, off_t offset)
+{
+    int f = choose_victim(pool);
+    if (f == -1)
+    {
+        return -1;
+    }
+
+    // Latches are only held under a pin, so nobody holds this one and the try succeeds
+    // (a blocking lock here would order the pool lock before page latches)
+    BufferFrame *frame = &pool->frames[f];
+    if (pthread_rwlock_trywrlock(&frame->latch.lock) != 0)
+    {
+        __atomic_store_n(&frame->pin_count, 0, __ATOMIC_RELEASE);
+        return -1;
+    }
+    if (frame->offset != -1)
+    {
+        if (!write_frame(pool, f))
+        {
+            pthread_rwlock_unlock(&frame->latch.lock);
+            __atomic_store_n(&frame->pin_count, 0, __ATOMIC_RELEASE);
+            return -1;
+        }
+        hash_remove(pool, f);
+        __atomic_add_fetch(&pool->evictions, 1, __ATOMIC_RELAXED);
+    }
+
+    __atomic_store_n(&frame->offset, offset, __ATOMIC_RELEASE);
+    frame->dirty = 0;
+    __atomic_store_n(&frame->referenced, 1, __ATOMIC_RELAXED);
+    hash_insert(pool, f);
+    __atomic_store_n(&frame->pin_count, 1, __ATOMIC_RELEASE);
+    return f;
+}
+
+// Pin a frame found without the pool lock, if it still caches the page (returns 1 if pinned)
+static int try_pin(BufferPool *pool, int f, off_t offset)
+{
+    BufferFrame *frame = &pool->frames[f];
+    int pins = __atomic_load_n(&frame->pin_count, __ATOMIC_RELAXED);
+    do
+    {
+        if (pins < 0)
+        {
+            return 0; // being claimed for another page
+        }
+    } while (!__atomic_compare_exchange_n(&frame->pin_count, &pins, pins + 1, 1, __ATOMIC_ACQUIRE,
+                                          __ATOMIC_RELAXED));
+    if (__atomic_load_n(&frame->offset, __ATOMIC_ACQUIRE) != offset)
+    {
+        __atomic_sub_fetch(&frame->pin_count, 1, __ATOMIC_RELEASE);
+        return 0;
+    }
+    return 1;
+}
+
+// Claim a frame for a page that missed and fill it, from disk or with zeros for a page the
+// caller overwrites (returns the frame, still latched exclusively by the claim, or -1)
+static int load_frame(BufferPool *pool, off_t offset, int overwrite, int *resident)
+{
+    int f = -1;
+    for (int attempt = 0; attempt < CLAIM_ATTEMPTS; attempt++)
+    {
+        pthread_mutex_lock(&pool->lock);
+        // Another thread may have loaded the page since the walk without the lock
+        f = find_frame(pool, offset);
+        if (f != -1)
+        {
+            __atomic_add_fetch(&pool->frames[f].pin_count, 1, __ATOMIC_ACQUIRE);
+            pthread_mutex_unlock(&pool->lock);
+            *resident = 1;
+            return f;
+        }
+        f = claim_frame(pool, offset);
+        pthread_mutex_unlock(&pool->lock);
+        if (f != -1)
+        {
+            break;
+        }
+        sched_yield();
+    }
+    *resident = 0;
+    if (f == -1)
+    {
+        printf("Error: Buffer pool exhausted, all %d frames are pinned or dirty\n", pool->num_frames);
+        return -1;
+    }
+
+    BufferFrame *frame = &pool->frames[f];
+    __atomic_add_fetch(&pool->misses, 1, __ATOMIC_RELAXED);
+    if (overwrite)
+    {
+        memset(frame->data, 0, PAGE_SIZE);
+        return f;
+    }
+    ssize_t bytes_read = pread(pool->fd, frame->data, PAGE_SIZE, offset);
+    if (bytes_read != PAGE_SIZE ||
+        (pool->checksums != NULL && !page_checksums_check(pool->checksums, offset, frame->data)))
+    {
+        // Give the frame back so a failed read (or a corrupt page) leaves no stale mapping;
+        // threads waiting for the page see the frame change and retry
+        pthread_mutex_lock(&pool->lock);
+        hash_remove(pool, f);
+        __atomic_store_n(&frame->offset, -1, __ATOMIC_RELEASE);
+        pthread_mutex_unlock(&pool->lock);
+        pthread_rwlock_unlock(&frame->latch.lock);
+        __atomic_sub_fetch(&frame->pin_count, 1, __ATOMIC_RELEASE);
+        return -1;
+    }
+    return f;
+}
+
+// Pin a page and take its latch (shared for readers, exclusive for the writer's changes);
+// returns the frame, -1 if the page cannot be read
+static int pin_frame(BufferPool *pool, off_t offset, int exclusive, int overwrite)
+{
+    while (1)
+    {
+        int f = find_frame(pool, offset);
+        if (f == -1 || !try_pin(pool, f, offset))
+        {
+            int resident;
+            f = load_frame(pool, offset, overwrite, &resident);
+            if (f == -1)
+            {
+                return -1;
+            }
+            if (!resident)
+            {
+                // The claim's exclusive latch becomes the caller's latch
+                if (exclusive)
+                {
+                    latch_own(&pool->frames[f].latch);
+                }
+                else
+                {
+                    pthread_rwlock_unlock(&pool->frames[f].latch.lock);
+                    pthread_rwlock_rdlock(&pool->frames[f].latch.lock);
+                }
+                return f;
+            }
+        }
+
+        BufferFrame *frame = &pool->frames[f];
+        __atomic_add_fetch(&pool->hits, 1, __ATOMIC_RELAXED);
+        latch_acquire(&frame->latch, exclusive);
+        // A frame still loading when it was pinned may have failed its read meanwhile
+        if (__atomic_load_n(&frame->offset, __ATOMIC_ACQUIRE) == offset)
+        {
+            if (!__atomic_load_n(&frame->referenced, __ATOMIC_RELAXED))
+            {
+                __atomic_store_n(&frame->referenced, 1, __ATOMIC_RELAXED);
+            }
+            return f;
+        }
+        latch_release(&frame->latch);
+        __atomic_sub_fetch(&frame->pin_count, 1, __ATOMIC_RELEASE);
+    }
+}
+
+// Create a buffer pool with a fixed number of page frames
+BufferPool *buffer_pool_create(int fd, int num_frames)
+{
+    if (num_frames <= 0)
+    {
+        printf("Error: Buffer pool needs at least one frame\n");
+        return NULL;
+    }
+
+    BufferPool *pool = malloc(sizeof(BufferPool));
+    if (pool == NULL)
+    {
+        return NULL;
+    }
+    memset(pool, 0, sizeof(BufferPool));
+    pool->fd = fd;
+    pool->num_frames = num_frames;
+
+    // Power-of-two bucket count, at least twice the frame count
+    pool->num_buckets = 1;
+    while (pool->num_buckets < num_frames * 2)
+    {
+        pool->num_buckets <<= 1;
+    }
+
+    pool->frames = malloc(num_frames * sizeof(BufferFrame));
+    pool->buckets = malloc(pool->num_buckets * sizeof(int));
+    if (pool->frames == NULL || pool->buckets == NULL)
+    {
+        free(pool->frames);
+        free(pool->buckets);
+        free(pool);
+        return NULL;
+    }
+
+    for (int b = 0; b < pool->num_buckets; b++)
+    {
+        pool->buckets[b] = -1;
+    }
+    for (int f = 0; f < num_frames; f++)
+    {
+        BufferFrame *frame = &pool->frames[f];
+        frame->offset = -1;
+        frame->pin_count = 0;
+        frame->dirty = 0;
+        frame->referenced = 0;
+        frame->hash_next = -1;
+        frame->data = malloc(PAGE_SIZE);
+        if (frame->data == NULL)
+        {
+            for (int k = 0; k < f; k++)
+            {
+                free(pool->frames[k].data);
+                pthread_rwlock_destroy(&pool->frames[k].latch.lock);
+            }
+            free(pool->frames);
+            free(pool->buckets);
+            free(pool);
+            return NULL;
+        }
+        latch_init(&frame->latch);
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    return pool;
+}
+
+// Size to map for a file of file_size bytes: at least double the current size, in whole
+// MMAP_MIN_RESERVE steps so every piece starts on a system page boundary
+static size_t mapping_reserve(size_t file_size, size_t current)
+{
+    size_t reserve = current * 2;
+    if (reserve < MMAP_MIN_RESERVE)
+    {
+        reserve = MMAP_MIN_RESERVE;
+    }
+    if (reserve < file_size)
+    {
+        reserve = file_size;
+    }
+    return (reserve + MMAP_MIN_RESERVE - 1) / MMAP_MIN_RESERVE * MMAP_MIN_RESERVE;
+}
+
+// Latch of a mapped page
+static PageLatch *map_latch(BufferPool *pool, off_t offset)
+{
+    size_t page = (size_t)(offset / PAGE_SIZE);
+    return &pool->map_latches[page / MAP_LATCH_CHUNK][page % MAP_LATCH_CHUNK];
+}
+
+// Map the file from pool->map_size up to new_size and give the new pages their latches
+// (returns 0 on failure)
+static int extend_mapping(BufferPool *pool, size_t new_size)
+{
+    if (new_size > pool->map_limit)
+    {
+        printf("Error: Database outgrew the %zu bytes reserved for its mapping\n", pool->map_limit);
+        return 0;
+    }
+    for (size_t chunk = pool->map_size / PAGE_SIZE / MAP_LATCH_CHUNK;
+         chunk < (new_size / PAGE_SIZE + MAP_LATCH_CHUNK - 1) / MAP_LATCH_CHUNK; chunk++)
+    {
+        if (pool->map_latches[chunk] != NULL)
+        {
+            continue;
+        }
+        PageLatch *latches = malloc(MAP_LATCH_CHUNK * sizeof(PageLatch));
+        if (latches == NULL)
+        {
+            return 0;
+        }
+        for (int i = 0; i < MAP_LATCH_CHUNK; i++)
+        {
+            latch_init(&latches[i]);
+        }
+        pool->map_latches[chunk] = latches;
+    }
+
+    unsigned char *map_dirty = realloc(pool->map_dirty, new_size / PAGE_SIZE);
+    if (map_dirty == NULL)
+    {
+        return 0;
+    }
+    memset(map_dirty + pool->map_size / PAGE_SIZE, 0, (new_size - pool->map_size) / PAGE_SIZE);
+    pool->map_dirty = map_dirty;
+
+    // Private mapping: stores stay in memory until buffer_pool_flush_all writes them, so the
+    // file only changes at checkpoints. The mapping may extend past EOF; callers grow the
+    // file before touching new pages.
+    void *piece = mmap(pool->map + pool->map_size, new_size - pool->map_size, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_FIXED, pool->fd, (off_t)pool->map_size);
+    if (piece == MAP_FAILED)
+    {
+        perror("Error: Could not map database file");
+        return 0;
+    }
+    pool->map_size = new_size;
+    return 1;
+}
+
+// Create a pool that serves pages straight from a mapping of the file
+BufferPool *buffer_pool_create_mmap(int fd, size_t file_size)
+{
+    BufferPool *pool = malloc(sizeof(BufferPool));
+    if (pool == NULL)
+    {
+        return NULL;
+    }
+    memset(pool, 0, sizeof(BufferPool));
+    pool->fd = fd;
+    pool->map_limit = MMAP_ADDRESS_SPACE;
+    pool->map_latches = calloc(pool->map_limit / PAGE_SIZE / MAP_LATCH_CHUNK, sizeof(PageLatch *));
+    if (pool->map_latches == NULL)
+    {
+        free(pool);
+        return NULL;
+    }
+
+    // Reserve the address space without memory behind it; the file is mapped over its start
+    void *map = mmap(NULL, pool->map_limit, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (map == MAP_FAILED)
+    {
+        perror("Error: Could not reserve address space for the database mapping");
+        free(pool->map_latches);
+        free(pool);
+        return NULL;
+    }
+    pool->map = map;
+    if (!extend_mapping(pool, mapping_reserve(file_size, 0)))
+    {
+        buffer_pool_destroy(pool);
+        return NULL;
+    }
+    pthread_mutex_init(&pool->lock, NULL);
+    return pool;
+}
+
+// Grow the mapping so it covers file_size bytes, in place (returns 0, or -1 on error)
+int buffer_pool_remap(BufferPool *pool, size_t file_size)
+{
+    if (pool->map == NULL || file_size <= pool->map_size)
+    {
+        return 0;
+    }
+    return extend_mapping(pool, mapping_reserve(file_size, pool->map_size)) ? 0 : -1;
+}
+
+// Release all frames (dirty pages must be flushed by the caller first)
+void buffer_pool_destroy(BufferPool *pool)
+{
+    if (pool == NULL)
+    {
+        return;
+    }
+    pthread_mutex_destroy(&pool->lock);
+    if (pool->map != NULL)
+    {
+        munmap(pool->map, pool->map_limit);
+        for (size_t chunk = 0; chunk < pool->map_limit / PAGE_SIZE / MAP_LATCH_CHUNK; chunk++)
+        {
+            if (pool->map_latches[chunk] == NULL)
+            {
+                break;
+            }
+            for (int i = 0; i < MAP_LATCH_CHUNK; i++)
+            {
+                pthread_rwlock_destroy(&pool->map_latches[chunk][i].lock);
+            }
+            free(pool->map_latches[chunk]);
+        }
+        free(pool->map_latches);
+        free(pool->map_dirty);
+        free(pool);
+        return;
+    }
+    for (int f = 0; f < pool->num_frames; f++)
+    {
+        free(pool->frames[f].data);
+        pthread_rwlock_destroy(&pool->frames[f].latch.lock);
+    }
+    free(pool->frames);
+    free(pool->buckets);
+    free(pool);
+}
+
+// Pin a page for the writer, reading it from disk on a miss. The page stays latched
+// exclusively until buffer_pool_unpin, so readers never see it half changed.
+void *buffer_pool_fetch(BufferPool *pool, off_t offset)
+{
+    if (pool->map != NULL)
+    {
+        latch_acquire(map_latch(pool, offset), 1);
+        __atomic_add_fetch(&pool->hits, 1, __ATOMIC_RELAXED);
+        return pool->map + offset;
+    }
+    int f = pin_frame(pool, offset, 1, 0);
+    return f == -1 ? NULL : pool->frames[f].data;
+}
+
+// Pin a page that the caller is about to overwrite completely (no disk read)
+void *buffer_pool_fetch_new(BufferPool *pool, off_t offset)
+{
+    if (pool->map != NULL)
+    {
+        latch_acquire(map_latch(pool, offset), 1);
+        __atomic_add_fetch(&pool->hits, 1, __ATOMIC_RELAXED);
+        return pool->map + offset;
+    }
+    int f = pin_frame(pool, offset, 1, 1);
+    return f == -1 ? NULL : pool->frames[f].data;
+}
+
+// Release a pin, marking the page dirty if the caller modified it
+void buffer_pool_unpin(BufferPool *pool, off_t offset, int is_dirty)
+{
+    if (pool->map != NULL)
+    {
+        // Mapped pages are never evicted; only remember which ones need writing
+        if (is_dirty && !pool->map_dirty[offset / PAGE_SIZE])
+        {
+            pool->map_dirty[offset / PAGE_SIZE] = 1;
+            pool->num_dirty++;
+        }
+        latch_release(map_latch(pool, offset));
+        return;
+    }
+
+    int f = find_pinned_frame(pool, offset);
+    if (f == -1 || __atomic_load_n(&pool->frames[f].pin_count, __ATOMIC_RELAXED) <= 0)
+    {
+        printf("Error: Unpin of page at offset %lld that is not pinned\n", (long long)offset);
+        return;
+    }
+    BufferFrame *frame = &pool->frames[f];
+    if (is_dirty)
+    {
+        mark_frame_dirty(pool, frame);
+    }
+    latch_release(&frame->latch);
+    __atomic_sub_fetch(&frame->pin_count, 1, __ATOMIC_RELEASE);
+}
+
+// Latch a page for reading, next to a writer that changes other pages: the page cannot be
+// changed or evicted until buffer_pool_unlatch (returns NULL if it cannot be read)
+const void *buffer_pool_latch(BufferPool *pool, off_t offset)
+{
+    if (pool->map != NULL)
+    {
+        latch_acquire(map_latch(pool, offset), 0);
+        __atomic_add_fetch(&pool->hits, 1, __ATOMIC_RELAXED);
+        return pool->map + offset;
+    }
+    int f = pin_frame(pool, offset, 0, 0);
+    return f == -1 ? NULL : pool->frames[f].data;
+}
+
+// Release a page latched by buffer_pool_latch
+void buffer_pool_unlatch(BufferPool *pool, off_t offset)
+{
+    if (pool->map != NULL)
+    {
+        latch_release(map_latch(pool, offset));
+        return;
+    }
+    int f = find_pinned_frame(pool, offset);
+    if (f == -1)
+    {
+        printf("Error: Unlatch of page at offset %lld that is not latched\n", (long long)offset);
+        return;
+    }
+    latch_release(&pool->frames[f].latch);
+    __atomic_sub_fetch(&pool->frames[f].pin_count, 1, __ATOMIC_RELEASE);
+}
+
+// Forget a cached page without writing it back (its owner is about to replace it)
+void buffer_pool_discard(BufferPool *pool, off_t offset)
+{
+    if (pool->map != NULL)
+    {
+        size_t page = (size_t)(offset / PAGE_SIZE);
+        if (page < pool->map_size / PAGE_SIZE && pool->map_dirty[page])
+        {
+            pool->map_dirty[page] = 0;
+            pool->num_dirty--;
+        }
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    int f = find_frame(pool, offset);
+    int unpinned = 0;
+    // A page still latched by a reader stays cached; its new owner overwrites it in place
+    if (f != -1 && __atomic_compare_exchange_n(&pool->frames[f].pin_count, &unpinned, -1, 0,
+                                               __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+    {
+        BufferFrame *frame = &pool->frames[f];
+        mark_frame_clean(pool, frame);
+        hash_remove(pool, f);
+        __atomic_store_n(&frame->offset, -1, __ATOMIC_RELEASE);
+        __atomic_store_n(&frame->referenced, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&frame->pin_count, 0, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+// Write one cached page back to disk (returns 1 on success or if not cached)
+int buffer_pool_flush_page(BufferPool *pool, off_t offset)
+{
+    if (pool->map != NULL)
+    {
+        return write_mapped_page(pool, offset / PAGE_SIZE);
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    int f = find_frame(pool, offset);
+    int ok = f == -1 || write_frame(pool, f);
+    pthread_mutex_unlock(&pool->lock);
+    return ok;
+}
+
+// Write every dirty page back to disk (returns 1 if all writes succeeded)
+int buffer_pool_flush_all(BufferPool *pool)
+{
+    int ok = 1;
+    if (pool->map != NULL)
+    {
+        for (size_t page = 0; page < pool->map_size / PAGE_SIZE; page++)
+        {
+            if (!write_mapped_page(pool, page))
+            {
+                ok = 0;
+            }
+        }
+        return ok;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    for (int f = 0; f < pool->num_frames; f++)
+    {
+        if (pool->frames[f].offset != -1 && !write_frame(pool, f))
+        {
+            ok = 0;
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return ok;
+}
+
+// List every dirty page without writing it (returns the number listed). Only the writer
+// dirties pages, and dirty frames are not evicted, so the list stays valid while it writes.
+int buffer_pool_collect_dirty(BufferPool *pool, PageWrite *writes, int max_writes)
+{
+    int count = 0;
+    if (pool->map != NULL)
+    {
+        for (size_t page = 0; page < pool->map_size / PAGE_SIZE && count < max_writes; page++)
+        {
+            if (pool->map_dirty[page])
+            {
+                writes[count].offset = (off_t)page * PAGE_SIZE;
+                writes[count].data = pool->map + writes[count].offset;
+                count++;
+            }
+        }
+        return count;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    for (int f = 0; f < pool->num_frames && count < max_writes; f++)
+    {
+        BufferFrame *frame = &pool->frames[f];
+        if (frame->offset != -1 && frame->dirty)
+        {
+            writes[count].offset = frame->offset;
+            writes[count].data = frame->data;
+            count++;
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return count;
+}
+
+// Mark a page clean after the caller wrote it to disk
+void buffer_pool_mark_clean(BufferPool *pool, off_t offset)
+{
+    if (pool->map != NULL)
+    {
+        size_t page = (size_t)(offset / PAGE_SIZE);
+        if (pool->map_dirty[page])
+        {
+            pool->map_dirty[page] = 0;
+            pool->num_dirty--;
+            pool->writebacks++;
+        }
+        return;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    int f = find_frame(pool, offset);
+    if (f != -1 && pool->frames[f].dirty)
+    {
+        mark_frame_clean(pool, &pool->frames[f]);
+        __atomic_add_fetch(&pool->writebacks, 1, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+// Snapshot the pool counters and occupancy
+void buffer_pool_get_stats(BufferPool *pool, BufferPoolStats *stats)
+{
+    memset(stats, 0, sizeof(BufferPoolStats));
+    stats->num_frames = pool->num_frames;
+    stats->hits = __atomic_load_n(&pool->hits, __ATOMIC_RELAXED);
+    stats->misses = __atomic_load_n(&pool->misses, __ATOMIC_RELAXED);
+    stats->evictions = __atomic_load_n(&pool->evictions, __ATOMIC_RELAXED);
+    stats->writebacks = __atomic_load_n(&pool->writebacks, __ATOMIC_RELAXED);
+    stats->mapped_bytes = pool->map_size;
+    stats->pages_dirty = __atomic_load_n(&pool->num_dirty, __ATOMIC_RELAXED);
+    if (pool->map != NULL)
+    {
+        return;
+    }
+    pthread_mutex_lock(&pool->lock);
+    for (int f = 0; f < pool->num_frames; f++)
+    {
+        BufferFrame *frame = &pool->frames[f];
+        if (frame->offset == -1)
+        {
+            continue;
+        }
+        stats->pages_cached++;
+        if (__atomic_load_n(&frame->pin_count, __ATOMIC_RELAXED) > 0)
+        {
+            stats->pages_pinned++;
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+// Reset the hit/miss/eviction counters
+void buffer_pool_reset_stats(BufferPool *pool)
+{
+    __atomic_store_n(&pool->hits, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&pool->misses, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&pool->evictions, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&pool->writebacks, 0, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,323 @@
+#include "../../include/coredb.h"
+#include <fcntl.h>
+#include <unistd.h>
+
+// CRC32C of the entries of a checksum block
+static uint32_t block_checksum(const PageChecksumBlock *block)
+{
+    return crc32c(block->entries, sizeof(block->entries));
+}
+
+// Whether a block read from the file is all zeros (a hole nothing was written to)
+static int block_is_empty(const PageChecksumBlock *block)
+{
+    const unsigned char *bytes = (const unsigned char *)block;
+    for (size_t i = 0; i < sizeof(PageChecksumBlock); i++)
+    {
+        if (bytes[i] != 0)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Block holding the entries of pages b * PAGE_CHECKSUMS_PER_BLOCK on, read from the file
+// on first use; a torn block is forgotten, so its pages go unchecked until rewritten
+// (lock held; exits when memory runs out)
+static PageChecksumBlock *load_block(PageChecksums *checksums, long b)
+{
+    if (b >= checksums->num_blocks)
+    {
+        long capacity = checksums->num_blocks > 0 ? checksums->num_blocks : 16;
+        while (capacity <= b)
+        {
+            capacity *= 2;
+        }
+        PageChecksumBlock **blocks = realloc(checksums->blocks, capacity * sizeof(PageChecksumBlock *));
+        unsigned char *dirty = blocks != NULL ? realloc(checksums->dirty, (size_t)capacity) : NULL;
+        if (blocks == NULL || dirty == NULL)
+        {
+            printf("Error: Could not allocate memory for page checksums\n");
+            exit(1);
+        }
+        memset(blocks + checksums->num_blocks, 0, (capacity - checksums->num_blocks) * sizeof(PageChecksumBlock *));
+        memset(dirty + checksums->num_blocks, 0, (size_t)(capacity - checksums->num_blocks));
+        checksums->blocks = blocks;
+        checksums->dirty = dirty;
+        checksums->num_blocks = capacity;
+    }
+    if (checksums->blocks[b] != NULL)
+    {
+        return checksums->blocks[b];
+    }
+
+    PageChecksumBlock *block = malloc(sizeof(PageChecksumBlock));
+    if (block == NULL)
+    {
+        printf("Error: Could not allocate memory for page checksums\n");
+        exit(1);
+    }
+    ssize_t bytes_read = pread(checksums->fd, block, sizeof(PageChecksumBlock), (off_t)b * PAGE_SIZE);
+    if (bytes_read != (ssize_t)sizeof(PageChecksumBlock) || block_is_empty(block))
+    {
+        memset(block, 0, sizeof(PageChecksumBlock));
+    }
+    else if (block->magic != PAGE_CHECKSUM_BLOCK_MAGIC || block->crc != block_checksum(block))
+    {
+        printf("Warning: Dropping torn checksum block %ld, pages %ld to %ld go unchecked until rewritten\n", b,
+               b * PAGE_CHECKSUMS_PER_BLOCK, (b + 1) * PAGE_CHECKSUMS_PER_BLOCK - 1);
+        memset(block, 0, sizeof(PageChecksumBlock));
+        checksums->dropped_blocks++;
+    }
+    checksums->blocks[b] = block;
+    return block;
+}
+
+// Entry of the page at a file offset (lock held)
+static PageChecksum *entry_for(PageChecksums *checksums, off_t offset)
+{
+    long page = (long)(offset / PAGE_SIZE);
+    PageChecksumBlock *block = load_block(checksums, page / PAGE_CHECKSUMS_PER_BLOCK);
+    return &block->entries[page % PAGE_CHECKSUMS_PER_BLOCK];
+}
+
+// Open (or create) the checksum file; blocks are read as the pages they cover are
+PageChecksums *page_checksums_open(const char *path, int truncate, int no_sync)
+{
+    PageChecksums *checksums = malloc(sizeof(PageChecksums));
+    if (checksums == NULL)
+    {
+        return NULL;
+    }
+    memset(checksums, 0, sizeof(PageChecksums));
+    checksums->no_sync = no_sync;
+    checksums->fd = open(path, O_RDWR | O_CREAT | (truncate ? O_TRUNC : 0), 0644);
+    if (checksums->fd == -1)
+    {
+        perror("Error: Could not open page checksum file");
+        free(checksums);
+        return NULL;
+    }
+    pthread_mutex_init(&checksums->lock, NULL);
+    return checksums;
+}
+
+// Close the checksum file (changed blocks must have been written)
+void page_checksums_close(PageChecksums *checksums)
+{
+    if (checksums == NULL)
+    {
+        return;
+    }
+    for (long b = 0; b < checksums->num_blocks; b++)
+    {
+        free(checksums->blocks[b]);
+    }
+    free(checksums->blocks);
+    free(checksums->dirty);
+    close(checksums->fd);
+    pthread_mutex_destroy(&checksums->lock);
+    free(checksums);
+}
+
+// Forget every checksum, for a file an older version may have written without keeping them
+// (returns 1 on success)
+int page_checksums_reset(PageChecksums *checksums)
+{
+    pthread_mutex_lock(&checksums->lock);
+    for (long b = 0; b < checksums->num_blocks; b++)
+    {
+        free(checksums->blocks[b]);
+        checksums->blocks[b] = NULL;
+        checksums->dirty[b] = 0;
+    }
+    checksums->num_dirty = 0;
+    int ok = ftruncate(checksums->fd, 0) == 0;
+    pthread_mutex_unlock(&checksums->lock);
+    return ok;
+}
+
+// Record the checksum of a page about to be written at a file offset (the header page has
+// a checksum of its own)
+void page_checksums_set(PageChecksums *checksums, off_t offset, const void *page)
+{
+    if (offset < HEADER_PAGES * PAGE_SIZE)
+    {
+        return;
+    }
+    uint32_t crc = crc32c(page, PAGE_SIZE);
+    pthread_mutex_lock(&checksums->lock);
+    PageChecksum *entry = entry_for(checksums, offset);
+    entry->crc = crc;
+    entry->valid = 1;
+    entry->lsn = checksums->lsn;
+    long b = (long)(offset / PAGE_SIZE) / PAGE_CHECKSUMS_PER_BLOCK;
+    if (!checksums->dirty[b])
+    {
+        checksums->dirty[b] = 1;
+        checksums->num_dirty++;
+    }
+    pthread_mutex_unlock(&checksums->lock);
+}
+
+// Check a page just read from a file offset against its checksum (returns 0 if it does
+// not match; pages without a checksum pass)
+int page_checksums_check(PageChecksums *checksums, off_t offset, const void *page)
+{
+    if (offset < HEADER_PAGES * PAGE_SIZE)
+    {
+        return 1;
+    }
+    uint32_t crc = crc32c(page, PAGE_SIZE);
+    pthread_mutex_lock(&checksums->lock);
+    PageChecksum *entry = entry_for(checksums, offset);
+    int ok = !entry->valid || entry->crc == crc;
+    uint32_t stored = entry->crc;
+    if (!entry->valid)
+    {
+        checksums->unchecked++;
+    }
+    else if (ok)
+    {
+        checksums->verified++;
+    }
+    else
+    {
+        checksums->failures++;
+    }
+    pthread_mutex_unlock(&checksums->lock);
+    if (!ok)
+    {
+        printf("Error: Page at offset %lld fails its checksum (stored %08x, read %08x)\n", (long long)offset,
+               stored, crc);
+    }
+    return ok;
+}
+
+// List the blocks changed since they were last written, sealed with their own checksum
+// (returns the number listed)
+int page_checksums_collect_dirty(PageChecksums *checksums, PageWrite *writes, int max_writes)
+{
+    int count = 0;
+    pthread_mutex_lock(&checksums->lock);
+    for (long b = 0; b < checksums->num_blocks && count < max_writes; b++)
+    {
+        if (checksums->dirty[b])
+        {
+            PageChecksumBlock *block = checksums->blocks[b];
+            block->magic = PAGE_CHECKSUM_BLOCK_MAGIC;
+            block->crc = block_checksum(block);
+            writes[count].offset = (off_t)b * PAGE_SIZE;
+            writes[count].data = block;
+            count++;
+        }
+    }
+    pthread_mutex_unlock(&checksums->lock);
+    return count;
+}
+
+// Mark listed blocks clean once they are written
+void page_checksums_mark_clean(PageChecksums *checksums, const PageWrite *writes, int count)
+{
+    pthread_mutex_lock(&checksums->lock);
+    for (int i = 0; i < count; i++)
+    {
+        long b = (long)(writes[i].offset / PAGE_SIZE);
+        if (checksums->dirty[b])
+        {
+            checksums->dirty[b] = 0;
+            checksums->num_dirty--;
+        }
+    }
+    pthread_mutex_unlock(&checksums->lock);
+}
+
+// Write the changed blocks and make them durable, for pages written outside a checkpoint
+// (returns 1 on success)
+int page_checksums_flush(PageChecksums *checksums)
+{
+    if (__atomic_load_n(&checksums->num_dirty, __ATOMIC_RELAXED) == 0)
+    {
+        return 1;
+    }
+    PageWrite *writes = malloc(checksums->num_dirty * sizeof(PageWrite));
+    if (writes == NULL)
+    {
+        printf("Error: Could not allocate the checksum write list\n");
+        return 0;
+    }
+    int count = page_checksums_collect_dirty(checksums, writes, checksums->num_dirty);
+    int num_writes;
+    int ok = write_page_runs(checksums->fd, writes, count, &num_writes);
+    if (ok && !checksums->no_sync && fdatasync(checksums->fd) != 0)
+    {
+        perror("Error: Could not sync page checksum file");
+        ok = 0;
+    }
+    if (ok)
+    {
+        page_checksums_mark_clean(checksums, writes, count);
+    }
+    free(writes);
+    return ok;
+}
+
+// Snapshot the checks made by page reads so far
+void page_checksums_get_stats(PageChecksums *checksums, ChecksumStats *stats)
+{
+    pthread_mutex_lock(&checksums->lock);
+    stats->verified = checksums->verified;
+    stats->failures = checksums->failures;
+    stats->unchecked = checksums->unchecked;
+    stats->dropped_blocks = checksums->dropped_blocks;
+    pthread_mutex_unlock(&checksums->lock);
+    stats->hardware = crc32c_hardware();
+}
+
+// Read every page of the file as it is on disk and compare it with its checksum, printing
+// the pages that fail (returns 1 if none does). Holds the writer lock, so no checkpoint
+// writes pages meanwhile.
+int verify_page_checksums(Database *db, ChecksumStats *stats)
+{
+    memset(stats, 0, sizeof(ChecksumStats));
+    stats->hardware = crc32c_hardware();
+    unsigned char *page = malloc(PAGE_SIZE);
+    if (page == NULL)
+    {
+        printf("Error: Could not allocate memory to verify checksums\n");
+        return 0;
+    }
+    lock_writer(db);
+    PageChecksums *checksums = db->checksums;
+    for (off_t number = HEADER_PAGES; number < db->checkpointed_header.page_count; number++)
+    {
+        off_t offset = PAGE_OFFSET(number);
+        if (pread(fileno(db->file), page, PAGE_SIZE, offset) != PAGE_SIZE)
+        {
+            break; // pages allocated since the last checkpoint are not in the file yet
+        }
+        uint32_t crc = crc32c(page, PAGE_SIZE);
+        pthread_mutex_lock(&checksums->lock);
+        PageChecksum entry = *entry_for(checksums, offset);
+        pthread_mutex_unlock(&checksums->lock);
+        if (!entry.valid)
+        {
+            stats->unchecked++;
+        }
+        else if (entry.crc == crc)
+        {
+            stats->verified++;
+        }
+        else
+        {
+            printf("Error: Page at offset %lld fails its checksum (stored %08x, read %08x)\n", (long long)offset,
+                   entry.crc, crc);
+            stats->failures++;
+        }
+    }
+    stats->dropped_blocks = checksums->dropped_blocks;
+    unlock_writer(db);
+    free(page);
+    return stats->failures == 0;
+}
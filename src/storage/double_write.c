@@ -0,0 +1,259 @@
+#include "../../include/coredb.h"
+#include <fcntl.h>
+#include <unistd.h>
+
+// Bytes before the first image: the header and descriptors, rounded up to a page
+static off_t images_start(int count)
+{
+    size_t size = sizeof(DoubleWriteHeader) + (size_t)count * sizeof(DoubleWriteEntry);
+    return (off_t)((size + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE);
+}
+
+// Write a whole buffer at a file position, retrying short writes
+static int write_fully(int fd, const void *data, size_t len, off_t position)
+{
+    const unsigned char *bytes = data;
+    while (len > 0)
+    {
+        ssize_t written = pwrite(fd, bytes, len, position);
+        if (written <= 0)
+        {
+            return 0;
+        }
+        bytes += written;
+        len -= (size_t)written;
+        position += written;
+    }
+    return 1;
+}
+
+// Open (or create) the double-write file
+DoubleWrite *double_write_open(const char *path, int truncate, int no_sync)
+{
+    DoubleWrite *dw = malloc(sizeof(DoubleWrite));
+    if (dw == NULL)
+    {
+        return NULL;
+    }
+    memset(dw, 0, sizeof(DoubleWrite));
+    dw->no_sync = no_sync;
+    dw->fd = open(path, O_RDWR | O_CREAT | (truncate ? O_TRUNC : 0), 0644);
+    if (dw->fd == -1)
+    {
+        perror("Error: Could not open double-write file");
+        free(dw);
+        return NULL;
+    }
+    return dw;
+}
+
+// Close the double-write file
+void double_write_close(DoubleWrite *dw)
+{
+    if (dw == NULL)
+    {
+        return;
+    }
+    close(dw->fd);
+    free(dw);
+}
+
+// Copy a checkpoint's database pages, checksum blocks and header (NULL if unchanged) to the
+// double-write file and make the copy durable, before any of them is written in place
+// (returns 1 on success, adding the bytes written to *bytes)
+int double_write_stage(DoubleWrite *dw, const PageWrite *pages, int count, const PageWrite *blocks,
+                       int num_blocks, const DbHeader *header, uint64_t lsn, size_t *bytes)
+{
+    int total = count + num_blocks + (header != NULL);
+    off_t start = images_start(total);
+    unsigned char *descriptors = calloc(1, (size_t)start);
+    PageWrite *images = malloc((total > 0 ? total : 1) * sizeof(PageWrite));
+    unsigned char *header_page = calloc(1, PAGE_SIZE);
+    if (descriptors == NULL || images == NULL || header_page == NULL)
+    {
+        printf("Error: Could not allocate the double-write batch\n");
+        free(descriptors);
+        free(images);
+        free(header_page);
+        return 0;
+    }
+
+    // Images go in the order of their descriptors, which the checksum follows too
+    DoubleWriteEntry *entries = (DoubleWriteEntry *)(descriptors + sizeof(DoubleWriteHeader));
+    for (int i = 0; i < total; i++)
+    {
+        const PageWrite *source;
+        if (i < count)
+        {
+            source = &pages[i];
+            entries[i].file = DOUBLE_WRITE_DATABASE;
+            entries[i].length = PAGE_SIZE;
+        }
+        else if (i < count + num_blocks)
+        {
+            source = &blocks[i - count];
+            entries[i].file = DOUBLE_WRITE_CHECKSUMS;
+            entries[i].length = PAGE_SIZE;
+        }
+        else
+        {
+            memcpy(header_page, header, sizeof(DbHeader));
+            entries[i].file = DOUBLE_WRITE_DATABASE;
+            entries[i].length = sizeof(DbHeader);
+            entries[i].offset = 0;
+            images[i].offset = start + (off_t)i * PAGE_SIZE;
+            images[i].data = header_page;
+            continue;
+        }
+        entries[i].offset = source->offset;
+        images[i].offset = start + (off_t)i * PAGE_SIZE;
+        images[i].data = source->data;
+    }
+    uint32_t crc = crc32c(entries, (size_t)total * sizeof(DoubleWriteEntry));
+    for (int i = 0; i < total; i++)
+    {
+        crc = crc32c_extend(crc, images[i].data, PAGE_SIZE);
+    }
+    DoubleWriteHeader *batch = (DoubleWriteHeader *)descriptors;
+    batch->magic = DOUBLE_WRITE_MAGIC;
+    batch->count = (uint32_t)total;
+    batch->lsn = lsn;
+    batch->crc = crc;
+
+    int num_writes;
+    int ok = write_fully(dw->fd, descriptors, (size_t)start, 0) && write_page_runs(dw->fd, images, total, &num_writes);
+    if (ok && !dw->no_sync && fdatasync(dw->fd) != 0)
+    {
+        perror("Error: Could not sync double-write file");
+        ok = 0;
+    }
+    if (ok)
+    {
+        dw->batches++;
+        *bytes += (size_t)start + (size_t)total * PAGE_SIZE;
+    }
+    else
+    {
+        printf("Error: Could not write the double-write batch\n");
+    }
+    free(descriptors);
+    free(images);
+    free(header_page);
+    return ok;
+}
+
+// Drop the batch once its pages are durable in place, so it is never replayed over newer
+// pages (returns 1 on success)
+int double_write_clear(DoubleWrite *dw)
+{
+    int ok = ftruncate(dw->fd, 0) == 0;
+    if (ok && !dw->no_sync)
+    {
+        ok = fsync(dw->fd) == 0;
+    }
+    if (!ok)
+    {
+        perror("Error: Could not clear double-write file");
+    }
+    return ok;
+}
+
+// Read a batch's descriptors and check the whole batch against its checksum (returns the
+// descriptors, NULL for an empty, torn or foreign batch)
+static DoubleWriteEntry *read_batch(DoubleWrite *dw, DoubleWriteHeader *batch, unsigned char *page)
+{
+    if (pread(dw->fd, batch, sizeof(DoubleWriteHeader), 0) != (ssize_t)sizeof(DoubleWriteHeader) ||
+        batch->magic != DOUBLE_WRITE_MAGIC || batch->count == 0)
+    {
+        return NULL;
+    }
+    size_t size = (size_t)batch->count * sizeof(DoubleWriteEntry);
+    DoubleWriteEntry *entries = malloc(size);
+    if (entries == NULL ||
+        pread(dw->fd, entries, size, sizeof(DoubleWriteHeader)) != (ssize_t)size)
+    {
+        free(entries);
+        return NULL;
+    }
+    uint32_t crc = crc32c(entries, size);
+    off_t start = images_start((int)batch->count);
+    for (uint32_t i = 0; i < batch->count; i++)
+    {
+        if (entries[i].file > DOUBLE_WRITE_CHECKSUMS || entries[i].length > PAGE_SIZE || entries[i].offset < 0 ||
+            pread(dw->fd, page, PAGE_SIZE, start + (off_t)i * PAGE_SIZE) != PAGE_SIZE)
+        {
+            free(entries);
+            return NULL;
+        }
+        crc = crc32c_extend(crc, page, PAGE_SIZE);
+    }
+    if (crc != batch->crc)
+    {
+        free(entries);
+        return NULL;
+    }
+    return entries;
+}
+
+// Finish a checkpoint a crash interrupted: a whole batch in the double-write file means
+// its pages may be torn or missing in place, so every one that differs is written again.
+// A torn batch means the crash came before any page was written in place, and is dropped.
+// Returns the pages repaired, -1 on failure.
+int double_write_recover(DoubleWrite *dw, int db_fd, int checksum_fd)
+{
+    off_t size = lseek(dw->fd, 0, SEEK_END);
+    if (size <= 0)
+    {
+        return 0;
+    }
+    unsigned char *image = malloc(PAGE_SIZE);
+    unsigned char *current = malloc(PAGE_SIZE);
+    if (image == NULL || current == NULL)
+    {
+        printf("Error: Could not allocate memory to read the double-write file\n");
+        free(image);
+        free(current);
+        return -1;
+    }
+    DoubleWriteHeader batch;
+    DoubleWriteEntry *entries = read_batch(dw, &batch, image);
+    int repaired = 0;
+    int ok = 1;
+    if (entries == NULL)
+    {
+        printf("Warning: Dropping an incomplete double-write batch (the checkpoint it began wrote nothing)\n");
+    }
+    else
+    {
+        off_t start = images_start((int)batch.count);
+        for (uint32_t i = 0; i < batch.count && ok; i++)
+        {
+            int fd = entries[i].file == DOUBLE_WRITE_DATABASE ? db_fd : checksum_fd;
+            size_t length = entries[i].length;
+            ok = pread(dw->fd, image, PAGE_SIZE, start + (off_t)i * PAGE_SIZE) == PAGE_SIZE;
+            if (ok && (pread(fd, current, length, entries[i].offset) != (ssize_t)length ||
+                       memcmp(current, image, length) != 0))
+            {
+                ok = write_fully(fd, image, length, entries[i].offset);
+                repaired++;
+            }
+        }
+        if (ok && repaired > 0 && !dw->no_sync)
+        {
+            ok = fsync(db_fd) == 0 && fdatasync(checksum_fd) == 0;
+        }
+        if (ok && repaired > 0)
+        {
+            printf("Repaired %d pages from the double-write file\n", repaired);
+        }
+        free(entries);
+    }
+    free(image);
+    free(current);
+    if (!ok)
+    {
+        printf("Error: Could not restore pages from the double-write file\n");
+        return -1;
+    }
+    return double_write_clear(dw) ? repaired : -1;
+}
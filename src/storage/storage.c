@@ -1,40 +1,399 @@
 #include "../../include/coredb.h"
+#include <unistd.h>
+#include <limits.h>
+#include <sys/uio.h>
 
-// Read a page from file into memory
-int read_page_from_file(Database *db, int page_num)
+#ifndef IOV_MAX
+#define IOV_MAX 1024
+#endif
+
+// Order page writes by file offset
+static int compare_page_writes(const void *a, const void *b)
+{
+    off_t left = ((const PageWrite *)a)->offset;
+    off_t right = ((const PageWrite *)b)->offset;
+    return (left > right) - (left < right);
+}
+
+// Write pages with one pwritev per run of adjacent pages (returns 1 on success)
+int write_page_runs(int fd, PageWrite *writes, int count, int *num_writes)
+{
+    struct iovec iov[IOV_MAX];
+    qsort(writes, count, sizeof(PageWrite), compare_page_writes);
+    *num_writes = 0;
+
+    int i = 0;
+    while (i < count)
+    {
+        // Extend the run while the next page starts where this one ends
+        int run = 0;
+        off_t run_start = writes[i].offset;
+        while (i + run < count && run < IOV_MAX &&
+               writes[i + run].offset == run_start + (off_t)run * PAGE_SIZE)
+        {
+            iov[run].iov_base = (void *)writes[i + run].data;
+            iov[run].iov_len = PAGE_SIZE;
+            run++;
+        }
+
+        ssize_t expected = (ssize_t)run * PAGE_SIZE;
+        ssize_t written = pwritev(fd, iov, run, run_start);
+        if (written != expected)
+        {
+            printf("Error: Failed to write %d pages at offset %lld\n", run, (long long)run_start);
+            return 0;
+        }
+        (*num_writes)++;
+        i += run;
+    }
+    return 1;
+}
+
+// Pin a data page in the buffer pool
+void *fetch_data_page(Database *db, off_t offset)
+{
+    void *page = buffer_pool_fetch(db->pool, offset);
+    if (page == NULL)
+    {
+        printf("Error: Failed to read data page at offset %lld\n", (long long)offset);
+        exit(1);
+    }
+    return page;
+}
+
+// Latch a data page for a reader that started at version (see read_begin); NULL, with
+// nothing latched, once the writer has begun to cut or replace the data chain
+const void *latch_data_page(Database *db, off_t offset, unsigned long version)
+{
+    const void *page = buffer_pool_latch(db->pool, offset);
+    if (!read_valid(db, version))
+    {
+        if (page != NULL)
+        {
+            buffer_pool_unlatch(db->pool, offset);
+        }
+        return NULL;
+    }
+    if (page == NULL)
+    {
+        printf("Error: Failed to read data page at offset %lld\n", (long long)offset);
+        exit(1);
+    }
+    return page;
+}
+
+// Slot directory of a data page
+static uint16_t *page_slots(const void *page)
+{
+    return (uint16_t *)((char *)page + sizeof(DataPageHeader));
+}
+
+// Format an empty slotted data page
+void data_page_init(void *page)
+{
+    memset(page, 0, PAGE_SIZE);
+    DataPageHeader *header = page;
+    header->magic = DATA_PAGE_MAGIC;
+    header->rows_start = PAGE_SIZE;
+    header->free_bytes = PAGE_SIZE - sizeof(DataPageHeader);
+}
+
+// Offset of the page after this one in the data page chain, 0 at the end
+off_t data_page_next(const void *page)
+{
+    return ((const DataPageHeader *)page)->next;
+}
+
+// Link a data page to its successor
+void set_data_page_next(void *page, off_t next)
+{
+    ((DataPageHeader *)page)->next = next;
+}
+
+// Number of slots in the directory; slots past it are never in use
+int data_page_slots(const void *page)
+{
+    return ((const DataPageHeader *)page)->num_slots;
+}
+
+// Whether one more row fits, counting a new directory entry if no slot is free
+int data_page_has_room(const void *page)
+{
+    const DataPageHeader *header = page;
+    size_t needed = sizeof(struct Row) + (header->live_rows < header->num_slots ? 0 : sizeof(uint16_t));
+    return header->free_bytes >= needed;
+}
+
+// Pack the live rows against the end of the page; slots keep their numbers, so record
+// IDs stay valid while the rows move
+static void defragment_page(void *page)
+{
+    unsigned char copy[PAGE_SIZE];
+    memcpy(copy, page, PAGE_SIZE);
+    DataPageHeader *header = page;
+    uint16_t *slots = page_slots(page);
+    uint16_t rows_start = PAGE_SIZE;
+    for (int slot = 0; slot < header->num_slots; slot++)
+    {
+        if (slots[slot] != 0)
+        {
+            rows_start -= sizeof(struct Row);
+            memcpy((char *)page + rows_start, copy + slots[slot], sizeof(struct Row));
+            slots[slot] = rows_start;
+        }
+    }
+    header->rows_start = rows_start;
+}
+
+// Store a row in the lowest free slot (returns the slot, -1 if the page is full)
+int data_page_insert(void *page, const struct Row *row)
+{
+    DataPageHeader *header = page;
+    uint16_t *slots = page_slots(page);
+    if (!data_page_has_room(page))
+    {
+        return -1;
+    }
+    int slot = 0;
+    while (slot < header->num_slots && slots[slot] != 0)
+    {
+        slot++;
+    }
+    int new_slot = (slot == header->num_slots);
+    size_t directory_end = sizeof(DataPageHeader) + (header->num_slots + new_slot) * sizeof(uint16_t);
+    if (header->rows_start < directory_end + sizeof(struct Row))
+    {
+        // Holes left by deletes add up to room for the row, just not in one piece
+        defragment_page(page);
+    }
+
+    header->rows_start -= sizeof(struct Row);
+    memcpy((char *)page + header->rows_start, row, sizeof(struct Row));
+    slots[slot] = header->rows_start;
+    if (new_slot)
+    {
+        header->num_slots++;
+    }
+    header->live_rows++;
+    header->free_bytes -= sizeof(struct Row) + (new_slot ? sizeof(uint16_t) : 0);
+    return slot;
+}
+
+// Free a slot (returns 0 if it holds no row); trailing free slots leave the directory
+int data_page_delete(void *page, int slot)
+{
+    DataPageHeader *header = page;
+    uint16_t *slots = page_slots(page);
+    if (slot < 0 || slot >= header->num_slots || slots[slot] == 0)
+    {
+        return 0;
+    }
+    if (slots[slot] == header->rows_start)
+    {
+        header->rows_start += sizeof(struct Row);
+    }
+    slots[slot] = 0;
+    header->live_rows--;
+    header->free_bytes += sizeof(struct Row);
+    while (header->num_slots > 0 && slots[header->num_slots - 1] == 0)
+    {
+        header->num_slots--;
+        header->free_bytes += sizeof(uint16_t);
+    }
+    if (header->live_rows == 0)
+    {
+        header->rows_start = PAGE_SIZE;
+    }
+    return 1;
+}
+
+// Copy out the row in a slot (returns 0 if the slot is free, or the page is no longer a
+// data page: a reader's record ID can outlive the page it named)
+int data_page_read(const void *page, int slot, struct Row *row)
 {
-    if (page_num < 0 || page_num >= db->num_pages)
+    const uint16_t *slots = page_slots(page);
+    if (((const DataPageHeader *)page)->magic != DATA_PAGE_MAGIC || slot < 0 ||
+        slot >= data_page_slots(page) || slots[slot] == 0 || slots[slot] > PAGE_SIZE - sizeof(struct Row))
     {
         return 0;
     }
-    
-    fseek(db->file, DATA_START_OFFSET + (off_t)page_num * PAGE_SIZE, SEEK_SET);
-    size_t bytes_read = fread(db->pages[page_num], 1, PAGE_SIZE, db->file);
-    return (bytes_read == PAGE_SIZE);
+    memcpy(row, (const char *)page + slots[slot], sizeof(struct Row));
+    return 1;
+}
+
+// Make the data chain usable: a new file gets its first page (clustered tables have no
+// chain). Only the header knows the chain, so pages are read on demand afterwards.
+int open_data_pages(Database *db)
+{
+    if (db->header.first_data_page == 0 && !db->clustered)
+    {
+        return append_data_page(db);
+    }
+    return 1;
 }
 
-// Write a page from memory to file
-int write_page_to_file(Database *db, int page_num)
+// Append an empty data page taken from the page allocator and list it in the free-space
+// map (returns 1 on success)
+int append_data_page(Database *db)
 {
-    if (page_num < 0 || page_num >= db->num_pages)
+    off_t offset = allocate_page(db);
+    if (offset == -1)
+    {
+        return 0;
+    }
+    void *page = buffer_pool_fetch_new(db->pool, offset);
+    if (page == NULL)
     {
+        free_page(db, offset);
         return 0;
     }
-    
-    fseek(db->file, DATA_START_OFFSET + (off_t)page_num * PAGE_SIZE, SEEK_SET);
-    size_t bytes_written = fwrite(db->pages[page_num], 1, PAGE_SIZE, db->file);
-    return (bytes_written == PAGE_SIZE);
+    data_page_init(page);
+    free_space_push(db, offset, page);
+    buffer_pool_unpin(db->pool, offset, 1);
+
+    DbHeader *header = &db->header;
+    if (header->last_data_page != 0)
+    {
+        void *last = fetch_data_page(db, header->last_data_page);
+        set_data_page_next(last, offset);
+        buffer_pool_unpin(db->pool, header->last_data_page, 1);
+    }
+    else
+    {
+        header->first_data_page = offset;
+    }
+    header->last_data_page = offset;
+    header->data_pages++;
+    return 1;
+}
+
+// List a pinned data page in the free-space map unless it already is
+void free_space_push(Database *db, off_t offset, void *page)
+{
+    DataPageHeader *header = page;
+    if (header->in_free_list)
+    {
+        return;
+    }
+    header->in_free_list = 1;
+    header->next_free = db->header.free_space_head;
+    db->header.free_space_head = offset;
 }
 
-// Flush all dirty pages to disk
-void flush_all_pages(Database *db)
+// Unlist a pinned page that just filled up; inserts take the head of the map, so that is
+// where it is (anywhere else it stays listed and free_space_find skips it later)
+void free_space_pop(Database *db, off_t offset, void *page)
 {
-    for (int i = 0; i < db->num_pages; i++)
+    DataPageHeader *header = page;
+    if (db->header.free_space_head != offset)
     {
-        if (db->page_dirty[i])
+        return;
+    }
+    db->header.free_space_head = header->next_free;
+    header->in_free_list = 0;
+    header->next_free = 0;
+}
+
+// Find a data page with room for a row: listed pages that are full are dropped from the
+// map on the way, and a new page is appended when none is left (returns -1 if no page
+// could be allocated)
+off_t free_space_find(Database *db)
+{
+    while (db->header.free_space_head != 0)
+    {
+        off_t offset = db->header.free_space_head;
+        DataPageHeader *header = fetch_data_page(db, offset);
+        if (data_page_has_room(header))
+        {
+            buffer_pool_unpin(db->pool, offset, 0);
+            return offset;
+        }
+        db->header.free_space_head = header->next_free;
+        header->in_free_list = 0;
+        header->next_free = 0;
+        buffer_pool_unpin(db->pool, offset, 1);
+    }
+    if (!append_data_page(db))
+    {
+        return -1;
+    }
+    return db->header.free_space_head;
+}
+
+// Rebuild the free-space map from the data chain, listing pages with room in chain order
+void free_space_rebuild(Database *db)
+{
+    off_t listed = 0;
+    db->header.free_space_head = 0;
+    off_t offset = db->header.first_data_page;
+    while (offset != 0)
+    {
+        DataPageHeader *header = fetch_data_page(db, offset);
+        off_t next = header->next;
+        int has_room = data_page_has_room(header);
+        int changed = header->in_free_list != has_room || header->next_free != 0;
+        header->in_free_list = has_room;
+        header->next_free = 0;
+        buffer_pool_unpin(db->pool, offset, changed);
+        if (has_room)
         {
-            write_page_to_file(db, i);
-            db->page_dirty[i] = 0;
+            if (listed == 0)
+            {
+                db->header.free_space_head = offset;
+            }
+            else
+            {
+                DataPageHeader *previous = fetch_data_page(db, listed);
+                previous->next_free = offset;
+                buffer_pool_unpin(db->pool, listed, 1);
+            }
+            listed = offset;
         }
+        // Touches every page of the chain; write them out as the pool fills
+        checkpoint_if_needed(db);
+        offset = next;
+    }
+}
+
+// Read the row a record ID points to (in a clustered table, a row leaf entry)
+int read_row(Database *db, off_t rid, struct Row *row)
+{
+    if (db->clustered)
+    {
+        return btree_read_row(db, rid, row);
+    }
+    off_t page_offset = RID_PAGE(rid);
+    const void *page = buffer_pool_latch(db->pool, page_offset);
+    if (page == NULL)
+    {
+        return 0;
+    }
+    // The slot may hold another row by now: callers compare the id
+    int found = data_page_read(page, RID_SLOT(rid), row);
+    buffer_pool_unlatch(db->pool, page_offset);
+    return found;
+}
+
+// Overwrite the row a record ID points to in place, marking its page dirty
+int write_row(Database *db, off_t rid, const struct Row *row)
+{
+    if (db->clustered)
+    {
+        return btree_write_row(db, rid, row);
+    }
+    off_t page_offset = RID_PAGE(rid);
+    char *page = buffer_pool_fetch(db->pool, page_offset);
+    if (page == NULL)
+    {
+        return 0;
+    }
+    int slot = RID_SLOT(rid);
+    const uint16_t *slots = page_slots(page);
+    int found = slot < data_page_slots(page) && slots[slot] != 0;
+    if (found)
+    {
+        memcpy(page + slots[slot], row, sizeof(struct Row));
     }
+    buffer_pool_unpin(db->pool, page_offset, found);
+    return found;
 }
@@ -0,0 +1,242 @@
+#include "../../include/coredb.h"
+#include <fcntl.h>
+#include <unistd.h>
+
+// Checksum of a record, covering every field after the checksum itself
+static uint32_t record_checksum(const WalRecord *record)
+{
+    const unsigned char *start = (const unsigned char *)record + sizeof(record->checksum);
+    return checksum32(start, sizeof(WalRecord) - sizeof(record->checksum));
+}
+
+// Read the record at a file position, rejecting short or corrupt records
+static int read_record_at(Wal *wal, off_t position, WalRecord *record)
+{
+    ssize_t bytes_read = pread(wal->fd, record, sizeof(WalRecord), position);
+    if (bytes_read != (ssize_t)sizeof(WalRecord))
+    {
+        return 0;
+    }
+    return record->checksum == record_checksum(record);
+}
+
+// Write a whole buffer at a file position, retrying short writes
+static int write_fully(int fd, const unsigned char *data, size_t len, off_t position)
+{
+    while (len > 0)
+    {
+        ssize_t written = pwrite(fd, data, len, position);
+        if (written <= 0)
+        {
+            return 0;
+        }
+        data += written;
+        len -= (size_t)written;
+        position += written;
+    }
+    return 1;
+}
+
+// Open (or create) the log, dropping a torn tail left by a crash; LSNs start no lower than
+// first_lsn
+Wal *wal_open(const char *path, int truncate, int no_sync, uint64_t first_lsn)
+{
+    Wal *wal = malloc(sizeof(Wal));
+    if (wal == NULL)
+    {
+        return NULL;
+    }
+    memset(wal, 0, sizeof(Wal));
+    wal->no_sync = no_sync;
+    wal->fd = open(path, O_RDWR | O_CREAT | (truncate ? O_TRUNC : 0), 0644);
+    if (wal->fd == -1)
+    {
+        perror("Error: Could not open write-ahead log");
+        free(wal);
+        return NULL;
+    }
+    pthread_mutex_init(&wal->lock, NULL);
+    pthread_cond_init(&wal->flushed, NULL);
+
+    // Find the end of the valid prefix: checksums match and LSNs are consecutive
+    WalRecord record;
+    off_t position = 0;
+    uint64_t last_lsn = 0;
+    while (read_record_at(wal, position, &record) &&
+           (last_lsn == 0 || record.lsn == last_lsn + 1))
+    {
+        last_lsn = record.lsn;
+        position += sizeof(WalRecord);
+    }
+    off_t file_size = lseek(wal->fd, 0, SEEK_END);
+    if (file_size > position)
+    {
+        printf("Warning: Discarding %lld bytes of torn write-ahead log tail\n",
+               (long long)(file_size - position));
+        if (ftruncate(wal->fd, position) != 0)
+        {
+            perror("Warning: Could not truncate write-ahead log");
+        }
+    }
+    wal->size = position;
+    // LSNs keep rising across an empty log, past every one a checkpoint has absorbed
+    wal->next_lsn = last_lsn + 1 > first_lsn ? last_lsn + 1 : first_lsn;
+    wal->durable_lsn = wal->next_lsn;
+    return wal;
+}
+
+// Close the log (pending records must have been committed)
+void wal_close(Wal *wal)
+{
+    if (wal == NULL)
+    {
+        return;
+    }
+    close(wal->fd);
+    pthread_mutex_destroy(&wal->lock);
+    pthread_cond_destroy(&wal->flushed);
+    free(wal->buffer);
+    free(wal->spare);
+    free(wal);
+}
+
+// Queue a redo record in memory and return its LSN
+uint64_t wal_append(Wal *wal, int type, int id, const char *name)
+{
+    WalRecord record;
+    memset(&record, 0, sizeof(WalRecord));
+    record.type = (uint32_t)type;
+    record.id = id;
+    if (name != NULL)
+    {
+        strncpy(record.name, name, sizeof(record.name) - 1);
+    }
+
+    pthread_mutex_lock(&wal->lock);
+    if (wal->buffer_len + sizeof(WalRecord) > wal->buffer_cap)
+    {
+        size_t new_cap = wal->buffer_cap ? wal->buffer_cap * 2 : 64 * sizeof(WalRecord);
+        unsigned char *grown = realloc(wal->buffer, new_cap);
+        if (grown == NULL)
+        {
+            pthread_mutex_unlock(&wal->lock);
+            printf("Error: Could not grow write-ahead log buffer\n");
+            exit(1);
+        }
+        wal->buffer = grown;
+        wal->buffer_cap = new_cap;
+    }
+    record.lsn = wal->next_lsn++;
+    record.checksum = record_checksum(&record);
+    memcpy(wal->buffer + wal->buffer_len, &record, sizeof(WalRecord));
+    wal->buffer_len += sizeof(WalRecord);
+    wal->records++;
+    pthread_mutex_unlock(&wal->lock);
+    return record.lsn;
+}
+
+// Make every record up to lsn durable. Concurrent committers form a group:
+// one leader writes and syncs everything queued so far while the others wait.
+int wal_commit(Wal *wal, uint64_t lsn)
+{
+    int ok = 1;
+    pthread_mutex_lock(&wal->lock);
+    wal->commits++;
+    while (wal->durable_lsn <= lsn && ok)
+    {
+        if (wal->flush_in_progress)
+        {
+            // Follower: the current leader may already cover this record
+            pthread_cond_wait(&wal->flushed, &wal->lock);
+            continue;
+        }
+
+        // Leader: take the whole queue, then write it without holding the lock
+        unsigned char *batch = wal->buffer;
+        size_t batch_len = wal->buffer_len;
+        size_t batch_cap = wal->buffer_cap;
+        uint64_t batch_end = wal->next_lsn;
+        off_t position = wal->size;
+        wal->buffer = wal->spare;
+        wal->buffer_cap = wal->spare_cap;
+        wal->buffer_len = 0;
+        wal->flush_in_progress = 1;
+        pthread_mutex_unlock(&wal->lock);
+
+        ok = write_fully(wal->fd, batch, batch_len, position);
+        if (ok && !wal->no_sync)
+        {
+            ok = (fdatasync(wal->fd) == 0);
+        }
+
+        pthread_mutex_lock(&wal->lock);
+        wal->spare = batch;
+        wal->spare_cap = batch_cap;
+        wal->flush_in_progress = 0;
+        if (ok)
+        {
+            wal->size += (off_t)batch_len;
+            wal->durable_lsn = batch_end;
+            wal->bytes_written += batch_len;
+            wal->flushes++;
+        }
+        else
+        {
+            perror("Error: Could not write to write-ahead log");
+        }
+        pthread_cond_broadcast(&wal->flushed);
+    }
+    pthread_mutex_unlock(&wal->lock);
+    return ok;
+}
+
+// Read the record at *position and advance it (returns 0 at the end of the log)
+int wal_read_record(Wal *wal, off_t *position, WalRecord *record)
+{
+    if (*position + (off_t)sizeof(WalRecord) > wal->size)
+    {
+        return 0;
+    }
+    if (!read_record_at(wal, *position, record))
+    {
+        return 0;
+    }
+    *position += sizeof(WalRecord);
+    return 1;
+}
+
+// Empty the log once a checkpoint has made its changes durable in the database file. A
+// group commit in flight writes at the position it took, so the log is cut only after it
+// lands; otherwise the next batch would follow a hole that ends the log at the next open.
+int wal_reset(Wal *wal)
+{
+    pthread_mutex_lock(&wal->lock);
+    while (wal->flush_in_progress)
+    {
+        pthread_cond_wait(&wal->flushed, &wal->lock);
+    }
+    int ok = (ftruncate(wal->fd, 0) == 0);
+    if (ok && !wal->no_sync)
+    {
+        ok = (fsync(wal->fd) == 0);
+    }
+    if (ok)
+    {
+        wal->size = 0;
+    }
+    pthread_mutex_unlock(&wal->lock);
+    return ok;
+}
+
+// Snapshot the log counters
+void wal_get_stats(Wal *wal, WalStats *stats)
+{
+    pthread_mutex_lock(&wal->lock);
+    stats->records = wal->records;
+    stats->commits = wal->commits;
+    stats->flushes = wal->flushes;
+    stats->bytes_written = wal->bytes_written;
+    stats->size = wal->size;
+    stats->next_lsn = wal->next_lsn;
+    pthread_mutex_unlock(&wal->lock);
+}
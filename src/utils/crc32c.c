@@ -0,0 +1,137 @@
+#include "../../include/coredb.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#define CRC32C_X86 1
+#endif
+
+// Reflected Castagnoli polynomial
+#define CRC32C_POLY 0x82f63b78u
+
+// Slice-by-8 tables: table[k][b] is the CRC of byte b followed by k zero bytes
+static uint32_t crc32c_table[8][256];
+static pthread_once_t crc32c_once = PTHREAD_ONCE_INIT;
+static int crc32c_sse42;
+
+// Fill the software tables and pick the hardware path when the CPU has it
+static void crc32c_init(void)
+{
+    for (int b = 0; b < 256; b++)
+    {
+        uint32_t crc = (uint32_t)b;
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc >> 1) ^ (CRC32C_POLY & (0u - (crc & 1)));
+        }
+        crc32c_table[0][b] = crc;
+    }
+    for (int b = 0; b < 256; b++)
+    {
+        for (int k = 1; k < 8; k++)
+        {
+            uint32_t previous = crc32c_table[k - 1][b];
+            crc32c_table[k][b] = (previous >> 8) ^ crc32c_table[0][previous & 0xff];
+        }
+    }
+#ifdef CRC32C_X86
+    __builtin_cpu_init();
+    crc32c_sse42 = __builtin_cpu_supports("sse4.2");
+#endif
+}
+
+// Continue a CRC32C over more bytes without the SSE4.2 instructions, eight bytes a step
+uint32_t crc32c_software(uint32_t crc, const void *data, size_t len)
+{
+    pthread_once(&crc32c_once, crc32c_init);
+    const unsigned char *bytes = data;
+    crc = ~crc;
+    while (len > 0 && ((uintptr_t)bytes & 7) != 0)
+    {
+        crc = (crc >> 8) ^ crc32c_table[0][(crc ^ *bytes++) & 0xff];
+        len--;
+    }
+    while (len >= 8)
+    {
+        uint64_t word;
+        memcpy(&word, bytes, sizeof(word));
+        word ^= crc; // little endian: the low four bytes take the running CRC
+        crc = crc32c_table[7][word & 0xff] ^ crc32c_table[6][(word >> 8) & 0xff] ^
+              crc32c_table[5][(word >> 16) & 0xff] ^ crc32c_table[4][(word >> 24) & 0xff] ^
+              crc32c_table[3][(word >> 32) & 0xff] ^ crc32c_table[2][(word >> 40) & 0xff] ^
+              crc32c_table[1][(word >> 48) & 0xff] ^ crc32c_table[0][word >> 56];
+        bytes += 8;
+        len -= 8;
+    }
+    while (len > 0)
+    {
+        crc = (crc >> 8) ^ crc32c_table[0][(crc ^ *bytes++) & 0xff];
+        len--;
+    }
+    return ~crc;
+}
+
+#ifdef CRC32C_X86
+// Continue a CRC32C with the SSE4.2 crc32 instruction, eight bytes at a time
+__attribute__((target("sse4.2"))) static uint32_t crc32c_sse(uint32_t crc, const void *data, size_t len)
+{
+    const unsigned char *bytes = data;
+    uint32_t state = ~crc;
+    while (len > 0 && ((uintptr_t)bytes & 7) != 0)
+    {
+        state = _mm_crc32_u8(state, *bytes++);
+        len--;
+    }
+#ifdef __x86_64__
+    uint64_t wide = state;
+    while (len >= 8)
+    {
+        uint64_t word;
+        memcpy(&word, bytes, sizeof(word));
+        wide = _mm_crc32_u64(wide, word);
+        bytes += 8;
+        len -= 8;
+    }
+    state = (uint32_t)wide;
+#endif
+    while (len >= 4)
+    {
+        uint32_t word;
+        memcpy(&word, bytes, sizeof(word));
+        state = _mm_crc32_u32(state, word);
+        bytes += 4;
+        len -= 4;
+    }
+    while (len > 0)
+    {
+        state = _mm_crc32_u8(state, *bytes++);
+        len--;
+    }
+    return ~state;
+}
+#endif
+
+// Whether crc32c runs on the SSE4.2 instructions
+int crc32c_hardware(void)
+{
+    pthread_once(&crc32c_once, crc32c_init);
+    return crc32c_sse42;
+}
+
+// Continue a CRC32C over more bytes (start from 0): crc32c_extend(crc32c(a), b) is the
+// CRC32C of a followed by b
+uint32_t crc32c_extend(uint32_t crc, const void *data, size_t len)
+{
+#ifdef CRC32C_X86
+    if (crc32c_hardware())
+    {
+        return crc32c_sse(crc, data, len);
+    }
+#endif
+    return crc32c_software(crc, data, len);
+}
+
+// CRC32C (Castagnoli) of a byte range, used for page and header checksums
+uint32_t crc32c(const void *data, size_t len)
+{
+    return crc32c_extend(0, data, len);
+}
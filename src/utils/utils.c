@@ -12,3 +12,53 @@ void format_row_name(char *dest, const char *src, size_t max_len)
     strncpy(dest, src, max_len - 1);
     dest[max_len - 1] = '\0';
 }
+
+// Order rows by id for qsort
+int compare_row_ids(const void *a, const void *b)
+{
+    int left = ((const struct Row *)a)->id;
+    int right = ((const struct Row *)b)->id;
+    return (left > right) - (left < right);
+}
+
+// Order index entries by id for qsort
+int compare_entry_ids(const void *a, const void *b)
+{
+    int left = ((const IndexEntry *)a)->id;
+    int right = ((const IndexEntry *)b)->id;
+    return (left > right) - (left < right);
+}
+
+// Order name index keys by name, then id, for qsort (names are zero padded)
+int compare_name_keys(const void *a, const void *b)
+{
+    const NameKey *left = a;
+    const NameKey *right = b;
+    int order = memcmp(left->name, right->name, sizeof(left->name));
+    if (order != 0)
+    {
+        return order;
+    }
+    return (left->id > right->id) - (left->id < right->id);
+}
+
+// Order ints for qsort
+int compare_ints(const void *a, const void *b)
+{
+    int left = *(const int *)a;
+    int right = *(const int *)b;
+    return (left > right) - (left < right);
+}
+
+// FNV-1a checksum over a byte range
+uint32_t checksum32(const void *data, size_t len)
+{
+    const unsigned char *bytes = data;
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
@@ -0,0 +1,112 @@
+#include "test_common.h"
+#include <fcntl.h>
+#include <unistd.h>
+
+#define INDEX_KEYS 5000
+
+// Insert keys straight into the index, checkpointing so dirty nodes never fill the pool
+static void insert_keys(Database *db, int start_id, int count)
+{
+    for (int id = start_id; id < start_id + count; id++)
+    {
+        btree_insert(db, id, (off_t)id);
+        if (id % 500 == 0)
+        {
+            checkpoint(db);
+        }
+    }
+}
+
+// Check that every key in a range is found with the address insert_keys gave it
+static int keys_present(Database *db, int start_id, int count)
+{
+    off_t address;
+    for (int id = start_id; id < start_id + count; id++)
+    {
+        btree_search(db, id, &address);
+        if (address != (off_t)id)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Write a file in the layout used before the header page: root offset only, a root leaf
+// in the first of ten index pages, and data pages from LEGACY_DATA_START_OFFSET on
+static void write_legacy_file(const char *filename)
+{
+    unsigned char page[PAGE_SIZE];
+    int fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+    memset(page, 0, PAGE_SIZE);
+    off_t root_offset = PAGE_SIZE;
+    memcpy(page, &root_offset, sizeof(off_t));
+    pwrite(fd, page, PAGE_SIZE, 0);
+
+    LegacyBTreeNode root = {0};
+    root.is_leaf = 1;
+    root.num_keys = 2;
+    for (int i = 0; i < 2; i++)
+    {
+        root.data.leaf.entries[i].id = i + 1;
+        root.data.leaf.entries[i].address = LEGACY_DATA_START_OFFSET + sizeof(int) + i * sizeof(struct Row);
+    }
+    memset(page, 0, PAGE_SIZE);
+    memcpy(page, &root, sizeof(LegacyBTreeNode));
+    pwrite(fd, page, PAGE_SIZE, PAGE_SIZE);
+
+    memset(page, 0, PAGE_SIZE);
+    int num_rows = 2;
+    struct Row rows[2] = {{1, "Old1"}, {2, "Old2"}};
+    memcpy(page, &num_rows, sizeof(int));
+    memcpy(page + sizeof(int), rows, sizeof(rows));
+    pwrite(fd, page, PAGE_SIZE, LEGACY_DATA_START_OFFSET);
+    close(fd);
+}
+
+// Test the persistent page allocator and its free list
+void test_allocator()
+{
+    Database db = setup_test_db("test.db");
+
+    // Test 46: The index grows past the ten pages of the old fixed index region
+    insert_keys(&db, 1, INDEX_KEYS);
+    int grown = db.header.page_count > HEADER_PAGES + LEGACY_INDEX_PAGES;
+    log_test(46, "Index should grow beyond the old fixed index region", grown && keys_present(&db, 1, INDEX_KEYS));
+
+    // Test 47: New nodes after a restart do not overwrite live ones
+    close_db(&db);
+    db = init_db("test.db");
+    off_t pages_before = db.header.page_count;
+    insert_keys(&db, INDEX_KEYS + 1, INDEX_KEYS);
+    int intact = keys_present(&db, 1, 2 * INDEX_KEYS);
+    log_test(47, "Allocation should resume after restart without clobbering nodes", intact && db.header.page_count > pages_before);
+
+    // Test 48: Freed pages are reused, also after a restart
+    off_t freed = allocate_node(&db);
+    free_node(&db, freed);
+    int reused = (allocate_node(&db) == freed);
+    free_node(&db, freed);
+    close_db(&db);
+    db = init_db("test.db");
+    int persisted = (db.header.free_count == 1 && allocate_node(&db) == freed && db.header.free_count == 0);
+    log_test(48, "Freed pages should be reused from the persisted free list", reused && persisted);
+    cleanup_test_db(&db, "test.db");
+
+    // Test 49: Files from before the header page are migrated in place
+    remove_test_files("test.db");
+    write_legacy_file("test.db");
+    db = init_db("test.db");
+    struct Row row;
+    int migrated = select_by_id(&db, 2, &row) && strcmp(row.name, "Old2") == 0;
+    migrated &= (db.header.free_count == LEGACY_INDEX_PAGES + 1); // old index and data pages
+    create_test_rows(&db, 3, 100);
+    close_db(&db);
+    db = init_db("test.db");
+    migrated &= select_by_id(&db, 1, &row) && strcmp(row.name, "Old1") == 0;
+    migrated &= select_by_id(&db, 102, &row) && strcmp(row.name, "Name102") == 0;
+    migrated &= (db.header.magic == DB_MAGIC);
+    log_test(49, "Legacy files should migrate to the allocator layout", migrated);
+    cleanup_test_db(&db, "test.db");
+}
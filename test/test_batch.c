@@ -0,0 +1,84 @@
+#include "test_common.h"
+
+#define BATCH_ROWS 5000
+
+// Check that every id in a range holds the expected name prefix
+static int names_match(Database *db, int start_id, int count, const char *prefix)
+{
+    for (int id = start_id; id < start_id + count; id++)
+    {
+        struct Row row;
+        char name[60];
+        snprintf(name, 60, "%s%d", prefix, id);
+        if (!select_by_id(db, id, &row) || strcmp(row.name, name) != 0)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Fill a batch with ids start..start+count-1 in scattered order
+static void fill_batch(struct Row *rows, int start_id, int count, const char *prefix)
+{
+    for (int i = 0; i < count; i++)
+    {
+        rows[i].id = start_id + (int)(((long)i * 7919) % count);
+        snprintf(rows[i].name, 60, "%s%d", prefix, rows[i].id);
+    }
+}
+
+// Test batched insert, update and delete
+void test_batch_operations()
+{
+    struct Row *rows = malloc(BATCH_ROWS * sizeof(struct Row));
+    // The batch also dirties a name index leaf per few rows: give it a pool large enough
+    // to take the whole batch before the first commit
+    DbOptions options;
+    memset(&options, 0, sizeof(DbOptions));
+    options.pool_frames = 1024;
+    options.no_sync = 1;
+    remove_test_files("test.db");
+    Database db = init_db_with_options("test.db", &options);
+
+    // Test 62: A batch insert commits once and skips duplicate ids
+    create_test_rows(&db, 1, 10);
+    fill_batch(rows, 1, BATCH_ROWS, "Name");
+    WalStats before, after;
+    wal_get_stats(db.wal, &before);
+    int inserted = insert_rows(&db, rows, BATCH_ROWS);
+    wal_get_stats(db.wal, &after);
+    log_test(62, "Batch insert should skip existing ids and commit once", inserted == BATCH_ROWS - 10 && after.commits - before.commits == 1 && names_match(&db, 1, BATCH_ROWS, "Name"));
+
+    // Test 63: A batch update changes only the rows that exist
+    fill_batch(rows, 1, BATCH_ROWS, "New");
+    rows[0].id = BATCH_ROWS + 1; // missing
+    snprintf(rows[0].name, 60, "Missing");
+    int updated = update_rows(&db, rows, BATCH_ROWS);
+    log_test(63, "Batch update should update existing rows only", updated == BATCH_ROWS - 1 && names_match(&db, 2, BATCH_ROWS - 1, "New") && !select_by_id(&db, BATCH_ROWS + 1, &rows[0]));
+
+    // Test 64: A batch delete removes its rows, and the batches replay from the log
+    int *ids = malloc(BATCH_ROWS / 2 * sizeof(int));
+    for (int i = 0; i < BATCH_ROWS / 2; i++)
+    {
+        ids[i] = BATCH_ROWS - i;
+    }
+    int deleted = delete_rows(&db, ids, BATCH_ROWS / 2);
+    int gone = !select_by_id(&db, BATCH_ROWS, &rows[0]) && !select_by_id(&db, BATCH_ROWS / 2 + 1, &rows[0]);
+    // Drop the buffer pool without a checkpoint to force a replay
+    release_db(&db);
+    db = init_db_with_options("test.db", &options);
+    log_test(64, "Batch delete should remove its rows and survive replay", deleted == BATCH_ROWS / 2 && gone && names_match(&db, 2, BATCH_ROWS / 2 - 1, "New") && !select_by_id(&db, BATCH_ROWS, &rows[0]));
+    cleanup_test_db(&db, "test.db");
+
+    // Test 65: Batches larger than a small buffer pool commit in pieces instead of failing
+    options.pool_frames = 16;
+    remove_test_files("test.db");
+    db = init_db_with_options("test.db", &options);
+    fill_batch(rows, 1, BATCH_ROWS, "Name");
+    inserted = insert_rows(&db, rows, BATCH_ROWS);
+    log_test(65, "Batches should fit a small buffer pool", inserted == BATCH_ROWS && names_match(&db, 1, BATCH_ROWS, "Name"));
+    cleanup_test_db(&db, "test.db");
+    free(ids);
+    free(rows);
+}
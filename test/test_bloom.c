@@ -0,0 +1,118 @@
+#include "test_common.h"
+#include <fcntl.h>
+#include <unistd.h>
+
+#define BLOOM_ROWS 20000
+
+// Check that every id in 1..count is found (the filter never rules out a present id)
+static int all_found(Database *db, int count)
+{
+    for (int id = 1; id <= count; id++)
+    {
+        struct Row row;
+        if (!select_by_id(db, id, &row) || row.id != id)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Insert ids from..to one by one, each with a name of its own
+static void insert_range(Database *db, int from, int to)
+{
+    for (int id = from; id <= to; id++)
+    {
+        char name[60];
+        snprintf(name, sizeof(name), "Name%d", id);
+        insert_row(db, id, name);
+    }
+}
+
+// Rewrite a closed file as version 8, from before the Bloom filter (and the subtree counts)
+static void downgrade_to_version8(const char *filename)
+{
+    DbHeader header;
+    int fd = open(filename, O_RDWR);
+    pread(fd, &header, sizeof(DbHeader), 0);
+    strip_subtree_counts(fd, header.root_offset);
+    header.version = 8;
+    header.bloom_offset = 0;
+    header.bloom_pages = 0;
+    header.bloom_keys = 0;
+    pwrite(fd, &header, sizeof(DbHeader), 0);
+    close(fd);
+}
+
+// Test the Bloom filter in front of the primary index
+void test_bloom()
+{
+    // Test 86: Appends and lookups of absent ids are answered by the filter, without
+    // touching an index page
+    Database db = setup_test_db("test.db");
+    insert_range(&db, 1, BLOOM_ROWS / 4);
+    BloomStats stats;
+    bloom_get_stats(&db, &stats);
+    int skipped = stats.checks >= BLOOM_ROWS / 4 && stats.negatives >= stats.checks * 95 / 100;
+    buffer_pool_reset_stats(db.pool);
+    struct Row row;
+    int absent = 0;
+    for (int id = BLOOM_ROWS + 1; id <= 2 * BLOOM_ROWS; id++)
+    {
+        absent += !select_by_id(&db, id, &row);
+    }
+    BufferPoolStats pool_stats;
+    buffer_pool_get_stats(db.pool, &pool_stats);
+    int untouched = pool_stats.hits + pool_stats.misses < BLOOM_ROWS / 20;
+    log_test(86, "The Bloom filter should spare descents for new and absent ids", skipped && absent == BLOOM_ROWS && untouched && all_found(&db, BLOOM_ROWS / 4));
+
+    // Test 87: Duplicates are still rejected, the filter grows with the table, and its
+    // false positive rate stays low
+    int pages = stats.pages;
+    int duplicate = insert_row(&db, 7, "Again");
+    struct Row *rows = malloc(BLOOM_ROWS * sizeof(struct Row));
+    for (int i = 0; i < BLOOM_ROWS; i++)
+    {
+        rows[i].id = BLOOM_ROWS / 4 - 10 + i + 1; // the first ten exist
+        snprintf(rows[i].name, sizeof(rows[i].name), "Name%d", rows[i].id);
+    }
+    int inserted = insert_rows(&db, rows, BLOOM_ROWS);
+    int total = BLOOM_ROWS / 4 - 10 + BLOOM_ROWS;
+    checkpoint(&db);
+    bloom_get_stats(&db, &stats);
+    // A batch that resizes the filter midway adds some of its ids twice
+    int grown = stats.pages > pages && stats.keys >= total;
+    long keys = stats.keys;
+    unsigned long before_negatives = stats.negatives;
+    unsigned long before_false = stats.false_positives;
+    for (int id = 2 * BLOOM_ROWS + 1; id <= 3 * BLOOM_ROWS; id++)
+    {
+        select_by_id(&db, id, &row);
+    }
+    bloom_get_stats(&db, &stats);
+    unsigned long misses = stats.false_positives - before_false;
+    unsigned long ruled_out = stats.negatives - before_negatives;
+    int rate_low = misses + ruled_out == BLOOM_ROWS && misses < BLOOM_ROWS / 50;
+    log_test(87, "The Bloom filter should resize and keep few false positives", !duplicate && inserted == total - BLOOM_ROWS / 4 && grown && rate_low && all_found(&db, total));
+
+    // Test 88: The filter persists across reopens, takes the ids log replay inserts without
+    // a rebuild, and files from before it get one at open
+    close_db(&db);
+    db = init_db("test.db");
+    bloom_get_stats(&db, &stats);
+    int persisted = db.bloom.offset == db.header.bloom_offset && stats.keys == keys && !select_by_id(&db, 3 * BLOOM_ROWS, &row);
+    insert_range(&db, total + 1, total + 100);
+    // Drop the buffer pool without a checkpoint to force a replay
+    release_db(&db);
+    db = init_db("test.db");
+    bloom_get_stats(&db, &stats);
+    int replayed = stats.keys == keys + 100 && all_found(&db, total + 100);
+    close_db(&db);
+    downgrade_to_version8("test.db");
+    db = init_db("test.db");
+    bloom_get_stats(&db, &stats);
+    int built = db.bloom.offset != 0 && stats.keys == total + 100 && all_found(&db, total + 100) && !select_by_id(&db, 3 * BLOOM_ROWS, &row);
+    log_test(88, "The Bloom filter should persist and be rebuilt when missing", persisted && replayed && built);
+    cleanup_test_db(&db, "test.db");
+    free(rows);
+}
@@ -0,0 +1,102 @@
+#include "test_common.h"
+
+#define DELETE_ROWS 20000
+
+// Insert ids 1..count in a scattered order so leaves split all over the key space
+static void insert_scattered(Database *db, int first, int count)
+{
+    struct Row *rows = malloc(count * sizeof(struct Row));
+    for (int i = 0; i < count; i++)
+    {
+        rows[i].id = first + (int)(((long)i * 7919) % count);
+        snprintf(rows[i].name, sizeof(rows[i].name), "Name%d", rows[i].id);
+    }
+    insert_rows(db, rows, count);
+    free(rows);
+}
+
+// Check that exactly the ids lo..hi with id % step == 0 are found
+static int only_multiples_present(Database *db, int lo, int hi, int step)
+{
+    for (int id = lo; id <= hi; id++)
+    {
+        off_t address;
+        btree_search(db, id, &address);
+        if ((address != -1) != (id % step == 0))
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Test deletes that rebalance the B-tree
+void test_btree_delete()
+{
+    DbOptions options;
+    memset(&options, 0, sizeof(DbOptions));
+    options.no_sync = 1;
+    remove_test_files("test.db");
+    Database db = init_db_with_options("test.db", &options);
+
+    // Test 69: Mass deletes merge leaves, collapse the root and free the pages
+    insert_scattered(&db, 1, DELETE_ROWS);
+    BTreeStats before, after;
+    int valid = btree_verify(&db, &before);
+    int *ids = malloc(DELETE_ROWS * sizeof(int));
+    int count = 0;
+    for (int id = 1; id <= DELETE_ROWS; id++)
+    {
+        if (id % 200 != 0)
+        {
+            ids[count++] = id;
+        }
+    }
+    off_t free_before = db.header.free_count;
+    delete_rows(&db, ids, count);
+    valid &= btree_verify(&db, &after);
+    log_test(69, "Deletes should rebalance the tree and collapse the root", valid && before.height == 2 && after.height == 1 && after.nodes == 1 && after.keys == DELETE_ROWS / 200 && db.header.free_count > free_before && only_multiples_present(&db, 1, DELETE_ROWS, 200));
+
+    // Test 70: Insert/delete churn keeps every node at least half full
+    int churn_valid = 1;
+    long most_nodes = 0;
+    for (int round = 1; round <= 5; round++)
+    {
+        insert_scattered(&db, DELETE_ROWS * round + 1, DELETE_ROWS / 2);
+        count = 0;
+        for (int id = DELETE_ROWS * round + 1; id <= DELETE_ROWS * round + DELETE_ROWS / 2; id++)
+        {
+            if (id % 3 != 0)
+            {
+                ids[count++] = id;
+            }
+        }
+        delete_rows(&db, ids, count);
+        churn_valid &= btree_verify(&db, &after) && after.underfull == 0;
+        most_nodes = after.nodes > most_nodes ? after.nodes : most_nodes;
+    }
+    long bound = 2 * after.keys / (LEAF_MAX_KEYS / 2) + 2;
+    log_test(70, "Churn should keep node occupancy and height bounded", churn_valid && after.height <= 2 && most_nodes <= bound && only_multiples_present(&db, DELETE_ROWS * 5 + 1, DELETE_ROWS * 5 + DELETE_ROWS / 2, 3));
+
+    // Test 71: Emptying the table leaves a single empty root that takes new keys again
+    count = 0;
+    RangeCursor cursor;
+    int id;
+    off_t address;
+    select_range(&db, 1, INT32_MAX, &cursor);
+    while (btree_next(&db, &cursor, &id, &address))
+    {
+        ids[count++] = id;
+    }
+    delete_rows(&db, ids, count);
+    int emptied = btree_verify(&db, &after) && after.height == 1 && after.keys == 0;
+    off_t pages = db.header.page_count;
+    insert_scattered(&db, 1, DELETE_ROWS / 2);
+    valid = btree_verify(&db, &after) && after.keys == DELETE_ROWS / 2;
+    close_db(&db);
+    db = init_db_with_options("test.db", &options);
+    valid &= btree_verify(&db, &after) && after.keys == DELETE_ROWS / 2;
+    log_test(71, "An emptied tree should reuse its pages for new keys", emptied && valid && db.header.page_count == pages);
+    free(ids);
+    cleanup_test_db(&db, "test.db");
+}
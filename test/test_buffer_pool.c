@@ -0,0 +1,91 @@
+#include "test_common.h"
+#include <fcntl.h>
+#include <unistd.h>
+
+// Fill a page with a recognizable byte pattern
+static void fill_page(unsigned char *page, int seed)
+{
+    for (int i = 0; i < PAGE_SIZE; i++)
+    {
+        page[i] = (unsigned char)(seed + i);
+    }
+}
+
+// Check a page against the pattern written by fill_page
+static int page_matches(const unsigned char *page, int seed)
+{
+    for (int i = 0; i < PAGE_SIZE; i++)
+    {
+        if (page[i] != (unsigned char)(seed + i))
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Test buffer pool caching, eviction and pinning
+void test_buffer_pool()
+{
+    Database db = setup_test_db("test.db");
+
+    // Test 31: Repeated lookups are served from memory
+    create_test_rows(&db, 1, 300);
+    buffer_pool_reset_stats(db.pool);
+    off_t address;
+    int found_all = 1;
+    for (int i = 0; i < 100; i++)
+    {
+        btree_search(&db, 150, &address);
+        found_all &= (address != -1);
+    }
+    BufferPoolStats stats;
+    buffer_pool_get_stats(db.pool, &stats);
+    log_test(31, "Hot lookups should never miss the buffer pool", found_all && stats.misses == 0 && stats.hits >= 100);
+
+    // Test 32: Cold lookup after restart misses once, then stays cached
+    close_db(&db);
+    db = init_db("test.db");
+    btree_search(&db, 150, &address);
+    buffer_pool_get_stats(db.pool, &stats);
+    unsigned long cold_misses = stats.misses;
+    btree_search(&db, 150, &address);
+    buffer_pool_get_stats(db.pool, &stats);
+    log_test(32, "Lookup after restart should only miss on first access", address != -1 && cold_misses > 0 && stats.misses == cold_misses);
+    cleanup_test_db(&db, "test.db");
+
+    // Test 33: Dirty pages survive eviction from a small pool
+    int fd = open("test_pool.db", O_RDWR | O_CREAT | O_TRUNC, 0644);
+    BufferPool *pool = buffer_pool_create(fd, 2);
+    for (int p = 0; p < 6; p++)
+    {
+        unsigned char *page = buffer_pool_fetch_new(pool, (off_t)p * PAGE_SIZE);
+        fill_page(page, p);
+        buffer_pool_unpin(pool, (off_t)p * PAGE_SIZE, 1);
+    }
+    int all_match = 1;
+    for (int p = 0; p < 6; p++)
+    {
+        unsigned char *page = buffer_pool_fetch(pool, (off_t)p * PAGE_SIZE);
+        all_match &= (page != NULL && page_matches(page, p));
+        buffer_pool_unpin(pool, (off_t)p * PAGE_SIZE, 0);
+    }
+    buffer_pool_get_stats(pool, &stats);
+    log_test(33, "Evicted dirty pages should be written back and re-read", all_match && stats.evictions >= 4 && stats.writebacks >= 4);
+
+    // Test 34: Pinned pages are never evicted
+    void *first = buffer_pool_fetch(pool, 0);
+    void *second = buffer_pool_fetch(pool, PAGE_SIZE);
+    void *third = buffer_pool_fetch(pool, 2 * PAGE_SIZE);
+    int exhausted = (third == NULL);
+    buffer_pool_unpin(pool, PAGE_SIZE, 0);
+    third = buffer_pool_fetch(pool, 2 * PAGE_SIZE);
+    int first_intact = page_matches(first, 0);
+    log_test(34, "Pinned pages should not be evicted", second != NULL && exhausted && third != NULL && first_intact);
+    buffer_pool_unpin(pool, 0, 0);
+    buffer_pool_unpin(pool, 2 * PAGE_SIZE, 0);
+
+    buffer_pool_destroy(pool);
+    close(fd);
+    remove("test_pool.db");
+}
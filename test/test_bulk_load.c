@@ -0,0 +1,76 @@
+#include "test_common.h"
+
+#define BULK_ROWS 20000
+
+// Check that ids lo..hi come back from an ordered scan with the names create_test_rows uses
+static int scan_matches(Database *db, int lo, int hi)
+{
+    RangeCursor cursor;
+    struct Row row;
+    int expected = lo;
+    select_range(db, lo, hi, &cursor);
+    while (range_next(db, &cursor, &row))
+    {
+        char name[60];
+        snprintf(name, 60, "Name%d", expected);
+        if (row.id != expected || strcmp(row.name, name) != 0)
+        {
+            return 0;
+        }
+        expected++;
+    }
+    return expected == hi + 1;
+}
+
+// Test bottom-up bulk loading
+void test_bulk_load()
+{
+    struct Row *rows = malloc(BULK_ROWS * sizeof(struct Row));
+    for (int i = 0; i < BULK_ROWS; i++)
+    {
+        // Unsorted input is sorted by the loader
+        rows[i].id = (int)(((long)i * 7919) % BULK_ROWS) + 1;
+        snprintf(rows[i].name, 60, "Name%d", rows[i].id);
+    }
+
+    // Test 58: A bulk load packs data pages and writes no log records
+    Database db = setup_test_db("test.db");
+    int loaded = bulk_load(&db, rows, BULK_ROWS, BULK_LOAD_FILL_PERCENT);
+    WalStats wal_stats;
+    wal_get_stats(db.wal, &wal_stats);
+    int expected_pages = (BULK_ROWS + (int)MAX_ROWS - 1) / (int)MAX_ROWS;
+    log_test(58, "Bulk load should pack data pages and bypass the log", loaded && db.header.data_pages == expected_pages && wal_stats.records == 0 && scan_matches(&db, 1, BULK_ROWS));
+
+    // Test 59: The loaded table survives a restart and keeps accepting inserts
+    close_db(&db);
+    db = init_db("test.db");
+    struct Row row;
+    int persisted = select_by_id(&db, 1, &row) && select_by_id(&db, BULK_ROWS, &row) && scan_matches(&db, 1, BULK_ROWS);
+    create_test_rows(&db, BULK_ROWS + 1, 500);
+    delete_row(&db, 5000);
+    int edited = !select_by_id(&db, 5000, &row) && scan_matches(&db, 5001, BULK_ROWS + 500);
+    log_test(59, "Bulk-loaded tables should persist and accept changes", persisted && edited);
+
+    // Test 60: Loads into a non-empty table and duplicate ids are rejected
+    int refused = !bulk_load(&db, rows, 10, BULK_LOAD_FILL_PERCENT);
+    cleanup_test_db(&db, "test.db");
+    db = setup_test_db("test.db");
+    rows[1].id = rows[0].id;
+    int duplicate_refused = !bulk_load(&db, rows, 10, BULK_LOAD_FILL_PERCENT);
+    log_test(60, "Bulk load should reject non-empty tables and duplicate ids", refused && duplicate_refused && db.header.data_pages == 1);
+    cleanup_test_db(&db, "test.db");
+
+    // Test 61: Rows are loaded from a text file
+    FILE *input = fopen("test_load.txt", "w");
+    for (int id = 300; id >= 1; id--)
+    {
+        fprintf(input, "%d Name%d\n", id, id);
+    }
+    fclose(input);
+    db = setup_test_db("test.db");
+    loaded = load_file(&db, "test_load.txt", 50);
+    log_test(61, "Load files should be bulk loaded", loaded == 300 && scan_matches(&db, 1, 300));
+    cleanup_test_db(&db, "test.db");
+    remove("test_load.txt");
+    free(rows);
+}
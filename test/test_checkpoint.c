@@ -0,0 +1,41 @@
+#include "test_common.h"
+
+// Test incremental checkpoints and their triggers
+void test_checkpoint()
+{
+    Database db = setup_test_db("test.db");
+
+    // Test 43: A checkpoint after one update writes only the pages it touched: the row's
+    // data page and the name index leaves of its old and new name (one or two), with the
+    // block of page checksums covering them and the header's new checkpoint LSN
+    create_test_rows(&db, 1, 100);
+    checkpoint(&db);
+    update_row(&db, 50, "Touched");
+    size_t bytes = checkpoint(&db);
+    CheckpointStats *stats = &db.checkpoint_stats;
+    log_test(43, "Checkpoint after a single update should write only the pages it touched", bytes == (size_t)(stats->last_pages + 1) * PAGE_SIZE + sizeof(DbHeader) && stats->last_pages >= 2 && stats->last_pages <= 3);
+
+    // Test 44: Adjacent dirty pages are coalesced into fewer writes
+    create_test_rows(&db, 101, 300);
+    checkpoint(&db);
+    log_test(44, "Adjacent dirty pages should share a write", stats->last_pages > 2 && stats->last_writes < stats->last_pages);
+    cleanup_test_db(&db, "test.db");
+
+    // Test 45: The log size trigger checkpoints in the background and data survives reopening
+    remove_test_files("test.db");
+    DbOptions options;
+    memset(&options, 0, sizeof(DbOptions));
+    options.checkpoint_wal_bytes = 10 * sizeof(WalRecord);
+    db = init_db_with_options("test.db", &options);
+    unsigned long initial = db.checkpoint_stats.checkpoints;
+    create_test_rows(&db, 1, 25);
+    WalStats wal_stats;
+    wal_get_stats(db.wal, &wal_stats);
+    int triggered = db.checkpoint_stats.checkpoints - initial == 2 && wal_stats.size == 5 * (off_t)sizeof(WalRecord);
+    close_db(&db);
+    db = init_db("test.db");
+    struct Row row;
+    int persisted = select_by_id(&db, 1, &row) && select_by_id(&db, 25, &row);
+    log_test(45, "Log size trigger should checkpoint every N bytes", triggered && persisted);
+    cleanup_test_db(&db, "test.db");
+}
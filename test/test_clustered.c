@@ -0,0 +1,105 @@
+#include "test_common.h"
+#include <limits.h>
+
+#define CLUSTERED_ROWS 5000
+
+// Open a fresh database with the given layout
+static Database open_fresh(int clustered)
+{
+    DbOptions options;
+    memset(&options, 0, sizeof(DbOptions));
+    options.no_sync = 1;
+    options.clustered = clustered;
+    remove_test_files("test.db");
+    return init_db_with_options("test.db", &options);
+}
+
+// Pool misses of a point lookup right after a restart
+static unsigned long cold_lookup_misses(Database *db, int id)
+{
+    close_db(db);
+    *db = init_db("test.db");
+    BufferPoolStats stats;
+    struct Row row;
+    buffer_pool_reset_stats(db->pool);
+    int found = select_by_id(db, id, &row);
+    buffer_pool_get_stats(db->pool, &stats);
+    return found ? stats.misses : 0;
+}
+
+// Check that a full scan returns exactly the ids not divisible by 3, in order, with names
+static int scan_matches(Database *db, int count)
+{
+    RangeCursor cursor;
+    struct Row row;
+    int expected = 1;
+    select_range(db, 1, INT32_MAX, &cursor);
+    while (range_next(db, &cursor, &row))
+    {
+        char name[60];
+        snprintf(name, sizeof(name), "Name%d", expected);
+        if (row.id != expected || strcmp(row.name, name) != 0)
+        {
+            return 0;
+        }
+        expected += expected % 3 == 2 ? 2 : 1;
+    }
+    return expected > count;
+}
+
+// Test the clustered layout, with rows stored in the index leaves
+void test_clustered()
+{
+    // Test 76: Point lookups end at the leaf, one page read less than the heap layout
+    Database db = open_fresh(0);
+    create_test_rows(&db, 1, CLUSTERED_ROWS);
+    BTreeStats heap_stats;
+    btree_verify(&db, &heap_stats);
+    unsigned long heap_misses = cold_lookup_misses(&db, CLUSTERED_ROWS / 2);
+    cleanup_test_db(&db, "test.db");
+
+    db = open_fresh(1);
+    create_test_rows(&db, 1, CLUSTERED_ROWS);
+    BTreeStats stats;
+    int valid = btree_verify(&db, &stats);
+    unsigned long misses = cold_lookup_misses(&db, CLUSTERED_ROWS / 2);
+    log_test(76, "Clustered lookups should read only the index path", valid && db.clustered && db.header.data_pages == 0 && misses == (unsigned long)stats.height && heap_misses == (unsigned long)heap_stats.height + 1);
+
+    // Test 77: Updates and deletes change the leaves; scans return rows in id order
+    struct Row row;
+    int ids[CLUSTERED_ROWS];
+    int count = 0;
+    for (int id = 3; id <= CLUSTERED_ROWS; id += 3)
+    {
+        ids[count++] = id;
+    }
+    delete_rows(&db, ids, count);
+    update_row(&db, 7, "Changed");
+    int updated = select_by_id(&db, 7, &row) && strcmp(row.name, "Changed") == 0;
+    update_row(&db, 7, "Name7");
+    valid = btree_verify(&db, &stats) && stats.underfull == 0 && stats.keys == CLUSTERED_ROWS - count;
+    log_test(77, "Clustered updates, deletes and scans should keep rows in the leaves", updated && valid && scan_matches(&db, CLUSTERED_ROWS) && compact_table(&db) == 0);
+
+    // Test 78: The layout is a property of the file: it survives a restart and log replay,
+    // and bulk loads fill row leaves directly
+    insert_row(&db, CLUSTERED_ROWS + 3, "Logged");
+    close_db(&db);
+    db = init_db("test.db");
+    int reopened = db.clustered && select_by_id(&db, CLUSTERED_ROWS + 3, &row) && strcmp(row.name, "Logged") == 0 && btree_verify(&db, &stats);
+    cleanup_test_db(&db, "test.db");
+
+    db = open_fresh(1);
+    struct Row *rows = malloc(CLUSTERED_ROWS * sizeof(struct Row));
+    for (int i = 0; i < CLUSTERED_ROWS; i++)
+    {
+        rows[i].id = CLUSTERED_ROWS - i;
+        snprintf(rows[i].name, sizeof(rows[i].name), "Name%d", rows[i].id);
+    }
+    int loaded = bulk_load(&db, rows, CLUSTERED_ROWS, 100);
+    free(rows);
+    close_db(&db);
+    db = init_db("test.db");
+    loaded = loaded && btree_verify(&db, &stats) && stats.leaves == (CLUSTERED_ROWS + CLUSTERED_LEAF_ROWS - 1) / CLUSTERED_LEAF_ROWS && select_by_id(&db, 4321, &row) && strcmp(row.name, "Name4321") == 0;
+    log_test(78, "Clustered files should keep their layout across restarts and bulk loads", reopened && loaded && db.header.data_pages == 0);
+    cleanup_test_db(&db, "test.db");
+}
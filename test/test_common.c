@@ -1,5 +1,7 @@
 #include "test_common.h"
+#include <fcntl.h>
 #include <stdio.h>
+#include <unistd.h>
 
 // Global test statistics
 int total_tests = 0;
@@ -26,10 +28,23 @@ void print_test_summary(void)
     printf("%s%d/%d tests passed!%s\n", PURPLE, passed_tests, total_tests, RESET);
 }
 
+// Remove a database file and the files beside it (log, page checksums, double-write copy)
+void remove_test_files(const char *filename)
+{
+    const char *sidecars[] = {"wal", "crc", "dwb"};
+    char path[256];
+    remove(filename);
+    for (int i = 0; i < 3; i++)
+    {
+        snprintf(path, sizeof(path), "%s.%s", filename, sidecars[i]);
+        remove(path);
+    }
+}
+
 // Setup test database
 Database setup_test_db(const char *filename)
 {
-    remove(filename); // Ensure clean state
+    remove_test_files(filename); // Ensure clean state
     return init_db(filename);
 }
 
@@ -37,7 +52,7 @@ Database setup_test_db(const char *filename)
 void cleanup_test_db(Database *db, const char *filename)
 {
     close_db(db);
-    remove(filename); // Clean up test file
+    remove_test_files(filename); // Clean up test file
 }
 
 // Create test rows for testing
@@ -65,3 +80,38 @@ void verify_row_exists(Database *db, int id, const char *expected_name)
         printf("Failed to verify row %d\n", id);
     }
 }
+
+// Rewrite the internal nodes of the index under offset in the layout of versions 5 to 9,
+// without subtree counts (for tests that turn a closed file into an older one)
+void strip_subtree_counts(int fd, off_t offset)
+{
+    BTreeNode node;
+    pread(fd, &node, sizeof(BTreeNode), offset);
+    if (node.is_leaf)
+    {
+        return;
+    }
+    UncountedNode old;
+    memset(&old, 0, sizeof(UncountedNode));
+    old.internal.num_keys = node.num_keys;
+    memcpy(old.internal.keys, node.data.internal.keys, node.num_keys * sizeof(int32_t));
+    memcpy(old.internal.children, node.data.internal.children, (node.num_keys + 1) * sizeof(uint32_t));
+    pwrite(fd, &old, sizeof(UncountedNode), offset);
+    for (int c = 0; c <= node.num_keys; c++)
+    {
+        strip_subtree_counts(fd, PAGE_OFFSET(node.data.internal.children[c]));
+    }
+}
+
+// Point a standard stream at /dev/null (or back at the saved descriptor), so a file it is
+// redirected to does not run into a file size limit set by a test
+int redirect_stream(FILE *stream, int saved)
+{
+    fflush(stream);
+    int fd = fileno(stream);
+    int previous = saved == -1 ? dup(fd) : -1;
+    int target = saved == -1 ? open("/dev/null", O_WRONLY) : saved;
+    dup2(target, fd);
+    close(target);
+    return previous;
+}
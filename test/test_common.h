@@ -3,6 +3,9 @@
 
 #include "../include/coredb.h"
 
+// Ten data pages' worth of rows, the table size most tests work with
+#define TEST_PAGES 10
+
 // Test logging with colors
 #define GREEN "\033[32m"
 #define RED "\033[31m"
@@ -18,6 +21,7 @@ void log_test(int test_num, const char *message, int passed);
 void print_test_summary(void);
 
 // Test database setup/teardown
+void remove_test_files(const char *filename);
 Database setup_test_db(const char *filename);
 void cleanup_test_db(Database *db, const char *filename);
 
@@ -25,4 +29,11 @@ void cleanup_test_db(Database *db, const char *filename);
 void create_test_rows(Database *db, int start_id, int count);
 void verify_row_exists(Database *db, int id, const char *expected_name);
 
+// Quiet a stream during a full-disk test (saved: -1 to redirect it, returning the saved
+// descriptor; that descriptor to restore it)
+int redirect_stream(FILE *stream, int saved);
+
+// Older file formats, for upgrade tests
+void strip_subtree_counts(int fd, off_t offset);
+
 #endif // TEST_COMMON_H
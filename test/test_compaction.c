@@ -9,12 +9,12 @@ void test_compaction()
     int inserted = insert_row(&db, 1, "Alice");
     inserted &= insert_row(&db, 2, "Bob");
     inserted &= insert_row(&db, 3, "Charlie");
-    struct Row rows[MAX_ROWS * MAX_PAGES];
-    int count = select_rows(&db, rows, MAX_ROWS * MAX_PAGES);
+    struct Row rows[MAX_ROWS * TEST_PAGES];
+    int count = select_rows(&db, rows, MAX_ROWS * TEST_PAGES);
     log_test(27, "Should insert 3 rows", inserted == 1 && count == 3 && rows[0].id == 1 && rows[1].id == 2 && rows[2].id == 3);
 
     int deleted = delete_row(&db, 2);
-    count = select_rows(&db, rows, MAX_ROWS * MAX_PAGES);
+    count = select_rows(&db, rows, MAX_ROWS * TEST_PAGES);
     log_test(28, "Should compact rows after deleting ID 2", deleted == 1 && count == 2 && rows[0].id == 1 && rows[1].id == 3 && strcmp(rows[0].name, "Alice") == 0 && strcmp(rows[1].name, "Charlie") == 0);
 
     // Test 29: Fill a page, delete all, verify page removal
@@ -33,13 +33,13 @@ void test_compaction()
             delete_row(&db, (int)i);
         }
     }
-    count = select_rows(&db, rows, MAX_ROWS * MAX_PAGES);
+    count = select_rows(&db, rows, MAX_ROWS * TEST_PAGES);
     // Expect roughly half the rows to remain (odd IDs)
-    log_test(29, "Should remove empty page and retain roughly half rows", count > 30 && count < 50 && db.num_pages == 1);
+    log_test(29, "Should remove empty page and retain roughly half rows", count > 30 && count < 50 && db.header.data_pages == 1);
 
     // Test 30: Insert after compaction
     inserted = insert_row(&db, 4, "David");
-    int new_count = select_rows(&db, rows, MAX_ROWS * MAX_PAGES);
+    int new_count = select_rows(&db, rows, MAX_ROWS * TEST_PAGES);
     log_test(30, "Should insert new row after compaction", inserted == 1 && new_count == count + 1);
 
     cleanup_test_db(&db, "test.db");
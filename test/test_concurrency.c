@@ -0,0 +1,192 @@
+#include "test_common.h"
+#include <limits.h>
+
+#define STABLE_ROWS 4000    // odd ids 1..2*STABLE_ROWS-1, never changed while readers run
+#define READERS 4
+#define WRITER_ROUNDS 2
+
+// A table the writer changes while readers check the rows it leaves alone
+typedef struct {
+    Database *db;
+    int done;               // set by the writer when it is finished
+    int hashed;             // scans come back in bucket order
+    long lookups;
+    long scans;
+    int failures;
+} SharedTable;
+
+// Insert the even ids between the stable rows (splitting leaves or buckets all over the
+// index), then delete them again (merging leaves and compacting), WRITER_ROUNDS times
+static void *writer_thread(void *arg)
+{
+    SharedTable *table = arg;
+    int *ids = malloc(STABLE_ROWS * sizeof(int));
+    for (int round = 0; round < WRITER_ROUNDS; round++)
+    {
+        for (int i = 0; i < STABLE_ROWS; i++)
+        {
+            char name[60];
+            ids[i] = 2 * (i + 1);
+            snprintf(name, sizeof(name), "Temp%d", ids[i]);
+            insert_row(table->db, ids[i], name);
+        }
+        for (int i = 0; i < STABLE_ROWS; i += 500)
+        {
+            delete_rows(table->db, ids + i, STABLE_ROWS - i < 500 ? STABLE_ROWS - i : 500);
+        }
+    }
+    free(ids);
+    __atomic_store_n(&table->done, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+// Check that a scan of the whole table returns every stable row, and no row twice, in id
+// order unless hashed
+static int scan_complete(SharedTable *table)
+{
+    char *seen = calloc(2 * STABLE_ROWS + 1, 1);
+    RangeCursor cursor;
+    struct Row row;
+    int last = 0;
+    int ok = 1;
+    select_range(table->db, 1, INT_MAX, &cursor);
+    while (range_next(table->db, &cursor, &row))
+    {
+        if (!table->hashed && row.id <= last)
+        {
+            ok = 0;
+        }
+        last = row.id;
+        if (row.id > 2 * STABLE_ROWS || seen[row.id])
+        {
+            ok = 0;
+        }
+        else
+        {
+            seen[row.id] = 1;
+        }
+    }
+    for (int id = 1; id < 2 * STABLE_ROWS; id += 2)
+    {
+        ok = ok && seen[id];
+    }
+    free(seen);
+    return ok;
+}
+
+// Check that a name scan returns each stable row once
+static int names_complete(SharedTable *table)
+{
+    NameCursor cursor;
+    struct Row row;
+    int count = 0;
+    int last = 0;
+    select_by_name(table->db, "Stable", 1, &cursor);
+    while (name_next(table->db, &cursor, &row))
+    {
+        // Names carry the id zero padded, so name order is id order
+        if (row.id <= last)
+        {
+            return 0;
+        }
+        last = row.id;
+        count++;
+    }
+    return count == STABLE_ROWS;
+}
+
+// Look up stable rows and scan the table until the writer is done
+static void *reader_thread(void *arg)
+{
+    SharedTable *table = arg;
+    unsigned int seed = (unsigned int)(size_t)&seed;
+    long lookups = 0;
+    long scans = 0;
+    int failures = 0;
+    while (!__atomic_load_n(&table->done, __ATOMIC_ACQUIRE))
+    {
+        for (int i = 0; i < 200; i++)
+        {
+            int id = 2 * (int)(rand_r(&seed) % STABLE_ROWS) + 1;
+            char name[60];
+            struct Row row;
+            snprintf(name, sizeof(name), "Stable%06d", id);
+            if (!select_by_id(table->db, id, &row) || row.id != id || strcmp(row.name, name) != 0)
+            {
+                failures++;
+            }
+            lookups++;
+        }
+        failures += !scan_complete(table);
+        failures += !table->hashed && !names_complete(table);
+        scans++;
+    }
+    __atomic_add_fetch(&table->lookups, lookups, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&table->scans, scans, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&table->failures, failures, __ATOMIC_RELAXED);
+    return NULL;
+}
+
+// Fill a table with the stable rows, then run the writer next to READERS readers; returns
+// 1 if no reader saw a stable row missing, changed or out of order and the index is intact
+static int run_shared(DbOptions *options, SharedTable *table)
+{
+    options->no_sync = 1;
+    remove_test_files("test.db");
+    Database db = init_db_with_options("test.db", options);
+    struct Row *rows = malloc(STABLE_ROWS * sizeof(struct Row));
+    for (int i = 0; i < STABLE_ROWS; i++)
+    {
+        rows[i].id = 2 * i + 1;
+        snprintf(rows[i].name, sizeof(rows[i].name), "Stable%06d", rows[i].id);
+    }
+    insert_rows(&db, rows, STABLE_ROWS);
+    free(rows);
+
+    memset(table, 0, sizeof(SharedTable));
+    table->db = &db;
+    table->hashed = options->hashed;
+    pthread_t readers[READERS];
+    pthread_t writer;
+    for (int r = 0; r < READERS; r++)
+    {
+        pthread_create(&readers[r], NULL, reader_thread, table);
+    }
+    pthread_create(&writer, NULL, writer_thread, table);
+    pthread_join(writer, NULL);
+    for (int r = 0; r < READERS; r++)
+    {
+        pthread_join(readers[r], NULL);
+    }
+
+    BTreeStats stats;
+    long names;
+    int intact = btree_verify(&db, &stats) && stats.keys == STABLE_ROWS &&
+                 name_index_verify(&db, &names) && names == STABLE_ROWS;
+    cleanup_test_db(&db, "test.db");
+    return intact && table->failures == 0 && table->lookups > 0 && table->scans > 0;
+}
+
+// Test lookups and scans running next to a writer
+void test_concurrency()
+{
+    // Test 92: Readers of a heap table, through a pool small enough to evict, see every row
+    // the writer leaves alone while it splits and merges leaves around them
+    DbOptions options;
+    memset(&options, 0, sizeof(DbOptions));
+    options.pool_frames = 64;
+    SharedTable table;
+    log_test(92, "Readers should see consistent rows while the writer splits and merges", run_shared(&options, &table));
+
+    // Test 93: The same holds for a clustered table served from a mapping of the file
+    memset(&options, 0, sizeof(DbOptions));
+    options.clustered = 1;
+    options.use_mmap = 1;
+    log_test(93, "Readers of a mapped clustered table should run next to the writer", run_shared(&options, &table));
+
+    // Test 94: Hashed tables answer lookups while buckets split under them, and a scan that
+    // a split overtakes returns each row once
+    memset(&options, 0, sizeof(DbOptions));
+    options.hashed = 1;
+    log_test(94, "Readers of a hashed table should run next to bucket splits", run_shared(&options, &table));
+}
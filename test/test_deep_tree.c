@@ -0,0 +1,62 @@
+#include "test_common.h"
+
+#define DEEP_ROWS 200000
+#define DEEP_BATCH 10000
+
+// Insert ids first, first + stride, ... (mod DEEP_ROWS, plus one) in batches
+static void insert_strided(Database *db, int stride)
+{
+    struct Row *rows = malloc(DEEP_BATCH * sizeof(struct Row));
+    for (int start = 0; start < DEEP_ROWS; start += DEEP_BATCH)
+    {
+        for (int i = 0; i < DEEP_BATCH; i++)
+        {
+            rows[i].id = (int)(((long)(start + i) * stride) % DEEP_ROWS) + 1;
+            snprintf(rows[i].name, sizeof(rows[i].name), "Name%d", rows[i].id);
+        }
+        insert_rows(db, rows, DEEP_BATCH);
+    }
+    free(rows);
+}
+
+// Check that every id 1..DEEP_ROWS is found in the index
+static int all_keys_found(Database *db)
+{
+    for (int id = 1; id <= DEEP_ROWS; id++)
+    {
+        off_t address;
+        btree_search(db, id, &address);
+        if (address == -1)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Test inserts that split nodes at every level of a tree three levels deep
+void test_deep_tree()
+{
+    DbOptions options;
+    memset(&options, 0, sizeof(DbOptions));
+    options.no_sync = 1;
+    remove_test_files("test.db");
+    Database db = init_db_with_options("test.db", &options);
+
+    // Test 72: Sequential inserts split internal nodes below the root
+    BTreeStats stats;
+    insert_strided(&db, 1);
+    int valid = btree_verify(&db, &stats);
+    log_test(72, "Sequential inserts should grow a third level", valid && stats.height == 3 && stats.keys == DEEP_ROWS && all_keys_found(&db));
+    cleanup_test_db(&db, "test.db");
+
+    // Test 73: Scattered inserts split full nodes on the way down and survive a restart
+    remove_test_files("test.db");
+    db = init_db_with_options("test.db", &options);
+    insert_strided(&db, 7919);
+    close_db(&db);
+    db = init_db_with_options("test.db", &options);
+    valid = btree_verify(&db, &stats);
+    log_test(73, "Scattered inserts should keep a deep tree valid", valid && stats.height == 3 && stats.underfull == 0 && all_keys_found(&db));
+    cleanup_test_db(&db, "test.db");
+}
@@ -0,0 +1,65 @@
+#include "test_common.h"
+
+// Check that every id in a range can be found with the name create_test_rows gave it
+static int rows_readable(Database *db, int start_id, int count, int step)
+{
+    for (int id = start_id; id < start_id + count; id += step)
+    {
+        struct Row row;
+        char name[60];
+        snprintf(name, 60, "Name%d", id);
+        if (!select_by_id(db, id, &row) || strcmp(row.name, name) != 0)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Test slot reuse through the free-space map and threshold compaction
+void test_free_space()
+{
+    Database db = setup_test_db("test.db");
+    int total = MAX_ROWS * TEST_PAGES;
+    create_test_rows(&db, 1, total);
+
+    // Test 66: A delete frees its slot for the next insert and moves no other row
+    off_t before, after, freed_rid, reused_rid;
+    btree_search(&db, 2, &before);
+    btree_search(&db, 1, &freed_rid);
+    delete_row(&db, 1);
+    btree_search(&db, 2, &after);
+    create_test_rows(&db, total + 1, 1);
+    btree_search(&db, total + 1, &reused_rid);
+    log_test(66, "Deletes should free the slot for reuse without moving rows", before == after && reused_rid == freed_rid && db.header.data_pages == TEST_PAGES && db.header.row_count == total && rows_readable(&db, 2, total, 1));
+
+    // Test 67: Free slots past the threshold are compacted away with the index following
+    for (int id = 3; id <= total; id += 3)
+    {
+        delete_row(&db, id);
+    }
+    RangeCursor cursor;
+    struct Row row;
+    int scanned = 0;
+    select_range(&db, 1, total + 1, &cursor);
+    while (range_next(&db, &cursor, &row))
+    {
+        scanned++;
+    }
+    int live = total - total / 3;
+    log_test(67, "Compaction should run on the threshold and keep the index correct", db.header.data_pages < TEST_PAGES && db.header.row_count == live && scanned == live && rows_readable(&db, 2, total - 1, 3) && rows_readable(&db, 4, total - 3, 3));
+
+    // Test 68: The free-space map survives a restart and still leads inserts to free slots
+    compact_table(&db);
+    btree_search(&db, 2, &freed_rid);
+    delete_row(&db, 2);
+    off_t pages = db.header.data_pages;
+    close_db(&db);
+    db = init_db("test.db");
+    create_test_rows(&db, total + 2, 1);
+    btree_search(&db, total + 2, &reused_rid);
+    struct Row rows[MAX_ROWS * TEST_PAGES];
+    int count = select_rows(&db, rows, MAX_ROWS * TEST_PAGES);
+    log_test(68, "Free slots should persist and be reused after a restart", reused_rid == freed_rid && db.header.data_pages == pages && count == live && db.header.row_count == live && !select_by_id(&db, 2, &row));
+    cleanup_test_db(&db, "test.db");
+}
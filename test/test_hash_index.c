@@ -0,0 +1,119 @@
+#include "test_common.h"
+#include <limits.h>
+
+#define HASH_ROWS 20000
+#define HASH_LOAD_ROWS 100000
+
+// Open a fresh database with a hashed primary index
+static Database open_hashed(void)
+{
+    DbOptions options;
+    memset(&options, 0, sizeof(DbOptions));
+    options.no_sync = 1;
+    options.hashed = 1;
+    remove_test_files("test.db");
+    return init_db_with_options("test.db", &options);
+}
+
+// Check that every id in 1..count not divisible by skip (0: none skipped) holds "Name<id>",
+// and that the skipped ids are gone
+static int hashed_rows_intact(Database *db, int count, int skip)
+{
+    for (int id = 1; id <= count; id++)
+    {
+        struct Row row;
+        char name[60];
+        snprintf(name, sizeof(name), "Name%d", id);
+        int found = select_by_id(db, id, &row);
+        if (skip > 0 && id % skip == 0 ? found : !found || strcmp(row.name, name) != 0)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Count the rows a full scan returns (in bucket order)
+static int scan_count(Database *db)
+{
+    RangeCursor cursor;
+    struct Row row;
+    int count = 0;
+    select_range(db, 1, INT_MAX, &cursor);
+    while (range_next(db, &cursor, &row))
+    {
+        count++;
+    }
+    return count;
+}
+
+// Test the hashed primary index behind the btree_* functions
+void test_hash_index()
+{
+    // Test 83: Single-row and batched inserts, lookups, updates and deletes go through the
+    // hash table, whose buckets split and whose directory doubles as it grows
+    Database db = open_hashed();
+    for (int i = 0; i < HASH_ROWS / 2; i++)
+    {
+        int id = 1 + (int)(((long)i * 7919) % (HASH_ROWS / 2));
+        char name[60];
+        snprintf(name, sizeof(name), "Name%d", id);
+        insert_row(&db, id, name);
+    }
+    struct Row *rows = malloc(HASH_ROWS / 2 * sizeof(struct Row));
+    for (int i = 0; i < HASH_ROWS / 2; i++)
+    {
+        rows[i].id = HASH_ROWS / 2 + 1 + i;
+        snprintf(rows[i].name, sizeof(rows[i].name), "Name%d", rows[i].id);
+    }
+    int inserted = insert_rows(&db, rows, HASH_ROWS / 2);
+    HashStats stats;
+    int valid = hash_index_verify(&db, &stats);
+    struct Row row;
+    log_test(83, "Hashed tables should serve point operations from split buckets", inserted == HASH_ROWS / 2 && valid && stats.depth > 1 && stats.keys == HASH_ROWS && hashed_rows_intact(&db, HASH_ROWS, 0) && !select_by_id(&db, HASH_ROWS + 1, &row));
+
+    // Test 84: Deletes, compaction (which repoints entries) and log replay keep it in step
+    int *ids = malloc(HASH_ROWS / 3 * sizeof(int));
+    int count = 0;
+    for (int id = 3; id <= HASH_ROWS; id += 3)
+    {
+        ids[count++] = id;
+    }
+    int deleted = delete_rows(&db, ids, count);
+    compact_table(&db);
+    update_row(&db, 1, "Name1");
+    insert_row(&db, HASH_ROWS + 1, "Name20001");
+    // Drop the buffer pool without a checkpoint to force a replay
+    release_db(&db);
+    db = init_db("test.db");
+    valid = db.hashed && hash_index_verify(&db, &stats) && stats.keys == HASH_ROWS - count + 1;
+    log_test(84, "Hashed tables should survive deletes, compaction and replay", deleted == count && valid && hashed_rows_intact(&db, HASH_ROWS, 3) && select_by_id(&db, HASH_ROWS + 1, &row) && scan_count(&db) == HASH_ROWS - count + 1);
+    cleanup_test_db(&db, "test.db");
+    free(ids);
+    free(rows);
+
+    // Test 85: Bulk loads build the hash table directly, and it keeps growing afterwards
+    db = open_hashed();
+    rows = malloc(HASH_LOAD_ROWS * sizeof(struct Row));
+    for (int i = 0; i < HASH_LOAD_ROWS; i++)
+    {
+        rows[i].id = HASH_LOAD_ROWS - i;
+        snprintf(rows[i].name, sizeof(rows[i].name), "Name%d", rows[i].id);
+    }
+    int loaded = bulk_load(&db, rows, HASH_LOAD_ROWS, 90);
+    valid = hash_index_verify(&db, &stats);
+    // Bucket counts are powers of two (plus overflow splits), so buckets are at least half
+    // as full as asked
+    int packed = stats.keys == HASH_LOAD_ROWS && stats.buckets <= 2L * HASH_LOAD_ROWS / (HASH_BUCKET_KEYS * 90 / 100);
+    for (int i = 0; i < 1000; i++)
+    {
+        rows[i].id = HASH_LOAD_ROWS + 1 + i;
+        snprintf(rows[i].name, sizeof(rows[i].name), "Name%d", rows[i].id);
+    }
+    insert_rows(&db, rows, 1000);
+    close_db(&db);
+    db = init_db("test.db");
+    log_test(85, "Bulk loads should build a packed hash table", loaded && valid && packed && hash_index_verify(&db, &stats) && hashed_rows_intact(&db, HASH_LOAD_ROWS + 1000, 0));
+    cleanup_test_db(&db, "test.db");
+    free(rows);
+}
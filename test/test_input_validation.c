@@ -7,28 +7,28 @@ void test_invalid_inputs()
 
     // Test 16: Insert negative ID
     int inserted = insert_row(&db, -1, "Invalid");
-    struct Row rows[MAX_ROWS * MAX_PAGES];
-    int count = select_rows(&db, rows, MAX_ROWS * MAX_PAGES);
+    struct Row rows[MAX_ROWS * TEST_PAGES];
+    int count = select_rows(&db, rows, MAX_ROWS * TEST_PAGES);
     log_test(16, "Should not insert negative ID -1", inserted == 0 && count == 0);
 
     // Test 17: Insert zero ID
     inserted = insert_row(&db, 0, "Invalid");
-    count = select_rows(&db, rows, MAX_ROWS * MAX_PAGES);
+    count = select_rows(&db, rows, MAX_ROWS * TEST_PAGES);
     log_test(17, "Should not insert zero ID", inserted == 0 && count == 0);
 
     // Test 18: Insert valid row, then duplicate
     inserted = insert_row(&db, 1, "Alice");
-    count = select_rows(&db, rows, MAX_ROWS * MAX_PAGES);
+    count = select_rows(&db, rows, MAX_ROWS * TEST_PAGES);
     log_test(18, "Should insert first row with ID 1", inserted == 1 && count == 1 && rows[0].id == 1 && strcmp(rows[0].name, "Alice") == 0);
 
     inserted = insert_row(&db, 1, "Duplicate");
-    count = select_rows(&db, rows, MAX_ROWS * MAX_PAGES);
+    count = select_rows(&db, rows, MAX_ROWS * TEST_PAGES);
     log_test(19, "Should not insert duplicate ID 1", inserted == 0 && count == 1 && rows[0].id == 1 && strcmp(rows[0].name, "Alice") == 0);
 
-    // Test 20: Fill all pages to test max capacity (629 rows to reach 630 total)
+    // Test 20: Fill ten pages (609 rows to reach 610 total)
     int successful_inserts = 0;
-    for (unsigned long i = 2; i <= MAX_ROWS * MAX_PAGES; i++)
-    { // 2 to 630 = 629 rows
+    for (unsigned long i = 2; i <= MAX_ROWS * TEST_PAGES; i++)
+    { // 2 to 610 = 609 rows
         char name[60];
         snprintf(name, 60, "Name%lu", i);
         inserted = insert_row(&db, (int)i, name);
@@ -42,13 +42,14 @@ void test_invalid_inputs()
             // Don't return; continue to Test 21
         }
     }
-    count = select_rows(&db, rows, MAX_ROWS * MAX_PAGES);
-    log_test(20, "Should insert up to max rows", count == MAX_ROWS * MAX_PAGES && successful_inserts == MAX_ROWS * MAX_PAGES - 1);
-
-    // Test 21: Insert after max rows reached
-    inserted = insert_row(&db, MAX_ROWS * MAX_PAGES + 1, "TooMany");
-    count = select_rows(&db, rows, MAX_ROWS * MAX_PAGES);
-    log_test(21, "Should not insert after max rows reached", inserted == 0 && count == MAX_ROWS * MAX_PAGES);
+    count = select_rows(&db, rows, MAX_ROWS * TEST_PAGES);
+    log_test(20, "Should insert up to max rows", count == MAX_ROWS * TEST_PAGES && successful_inserts == MAX_ROWS * TEST_PAGES - 1);
+
+    // Test 21: Insert past the old ten-page table limit
+    inserted = insert_row(&db, MAX_ROWS * TEST_PAGES + 1, "Beyond");
+    struct Row row;
+    int found = select_by_id(&db, MAX_ROWS * TEST_PAGES + 1, &row);
+    log_test(21, "Should keep inserting past the old page limit", inserted == 1 && found && strcmp(row.name, "Beyond") == 0);
 
     cleanup_test_db(&db, "test.db");
 }
@@ -0,0 +1,59 @@
+#include "test_common.h"
+#include <fcntl.h>
+#include <unistd.h>
+
+// Test the memory-mapped storage mode
+void test_mmap_storage()
+{
+    DbOptions options = {0};
+    options.use_mmap = 1;
+    remove_test_files("test.db");
+    Database db = init_db_with_options("test.db", &options);
+
+    // Test 35: Rows spanning several pages are served from the mapping
+    create_test_rows(&db, 1, 100);
+    struct Row row;
+    int found = select_by_id(&db, 80, &row);
+    off_t address;
+    btree_search(&db, 80, &address);
+    struct Row mapped;
+    int in_mapping = data_page_read(db.pool->map + RID_PAGE(address), RID_SLOT(address), &mapped) &&
+                     memcmp(&mapped, &row, sizeof(struct Row)) == 0;
+    log_test(35, "Mapped database should serve rows in place", found && row.id == 80 && strcmp(row.name, "Name80") == 0 && db.header.data_pages == 2 && in_mapping);
+
+    // Test 36: Update and delete write through the mapping
+    int updated = update_row(&db, 10, "Mapped");
+    int deleted = delete_row(&db, 100);
+    found = select_by_id(&db, 10, &row);
+    struct Row rows[MAX_ROWS * TEST_PAGES];
+    int count = select_rows(&db, rows, MAX_ROWS * TEST_PAGES);
+    log_test(36, "Mapped database should apply updates and deletes", updated && deleted && found && strcmp(row.name, "Mapped") == 0 && count == 99);
+
+    // Test 37: The file format is shared with the stdio backend
+    close_db(&db);
+    db = init_db("test.db");
+    found = select_by_id(&db, 10, &row);
+    count = select_rows(&db, rows, MAX_ROWS * TEST_PAGES);
+    log_test(37, "Mapped file should reopen without mmap", found && strcmp(row.name, "Mapped") == 0 && count == 99);
+    cleanup_test_db(&db, "test.db");
+
+    // Test 38: Growing the file past the reservation remaps without losing data
+    int fd = open("test_map.db", O_RDWR | O_CREAT | O_TRUNC, 0644);
+    int ok = ftruncate(fd, PAGE_SIZE) == 0;
+    BufferPool *pool = buffer_pool_create_mmap(fd, PAGE_SIZE);
+    memcpy(buffer_pool_fetch(pool, 0), "coredb", 7);
+    size_t grown = pool->map_size * 3;
+    ok &= ftruncate(fd, (off_t)grown) == 0;
+    ok &= buffer_pool_remap(pool, grown) >= 0;
+    unsigned char *last = buffer_pool_fetch(pool, (off_t)grown - PAGE_SIZE);
+    last[0] = 42;
+    buffer_pool_unpin(pool, (off_t)grown - PAGE_SIZE, 1);
+    ok &= memcmp(buffer_pool_fetch(pool, 0), "coredb", 7) == 0 && pool->map_size >= grown;
+    ok &= buffer_pool_flush_all(pool);
+    buffer_pool_destroy(pool);
+    unsigned char byte = 0;
+    ok &= pread(fd, &byte, 1, (off_t)grown - PAGE_SIZE) == 1 && byte == 42;
+    close(fd);
+    remove("test_map.db");
+    log_test(38, "Mapping should grow with the file and keep its contents", ok);
+}
@@ -0,0 +1,218 @@
+#include "test_common.h"
+#include <limits.h>
+
+#define VERSIONED_ROWS 2000 // ids 1..VERSIONED_ROWS, all renamed together each round
+#define VERSION_ROUNDS 6
+#define SNAPSHOT_READERS 3
+
+// A table the writer changes in whole batches while readers check that every snapshot
+// sees one batch boundary
+typedef struct {
+    Database *db;
+    int done;               // set by the writer when it is finished
+    long scans;
+    int failures;
+} VersionedTable;
+
+// Each round renames every row in one batch, then deletes the even ids in one batch and
+// inserts them back in another
+static void *batch_writer(void *arg)
+{
+    VersionedTable *table = arg;
+    struct Row *rows = malloc(VERSIONED_ROWS * sizeof(struct Row));
+    int *evens = malloc(VERSIONED_ROWS / 2 * sizeof(int));
+    for (int round = 1; round <= VERSION_ROUNDS; round++)
+    {
+        for (int i = 0; i < VERSIONED_ROWS; i++)
+        {
+            rows[i].id = i + 1;
+            snprintf(rows[i].name, sizeof(rows[i].name), "Round%d", round);
+        }
+        update_rows(table->db, rows, VERSIONED_ROWS);
+        for (int i = 0; i < VERSIONED_ROWS / 2; i++)
+        {
+            evens[i] = 2 * (i + 1);
+            rows[i].id = evens[i];
+        }
+        delete_rows(table->db, evens, VERSIONED_ROWS / 2);
+        insert_rows(table->db, rows, VERSIONED_ROWS / 2);
+    }
+    free(rows);
+    free(evens);
+    __atomic_store_n(&table->done, 1, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+// Check rows read from one snapshot: one name throughout, every odd id, and the even ids
+// all there or all gone, in id order when ordered is set
+static int consistent(const struct Row *rows, int count, int ordered)
+{
+    if (count != VERSIONED_ROWS && count != VERSIONED_ROWS / 2)
+    {
+        return 0;
+    }
+    char *seen = calloc(VERSIONED_ROWS + 1, 1);
+    int ok = 1;
+    for (int i = 0; i < count && ok; i++)
+    {
+        ok = rows[i].id >= 1 && rows[i].id <= VERSIONED_ROWS && !seen[rows[i].id] &&
+             strcmp(rows[i].name, rows[0].name) == 0 && (!ordered || i == 0 || rows[i].id > rows[i - 1].id);
+        if (ok)
+        {
+            seen[rows[i].id] = 1;
+        }
+    }
+    for (int id = 1; id <= VERSIONED_ROWS && ok; id++)
+    {
+        ok = seen[id] || (id % 2 == 0 && count == VERSIONED_ROWS / 2);
+    }
+    free(seen);
+    return ok;
+}
+
+// Read the whole table from a snapshot range scan
+static int scan_snapshot(Database *db, const Snapshot *snapshot, struct Row *rows)
+{
+    SnapshotCursor cursor;
+    int count = 0;
+    select_range_snapshot(db, snapshot, 1, INT_MAX, &cursor);
+    while (count < VERSIONED_ROWS + 1 && snapshot_next(db, &cursor, &rows[count]))
+    {
+        count++;
+    }
+    snapshot_cursor_close(&cursor);
+    return count;
+}
+
+// Alternate snapshot range scans and select_rows until the writer is done
+static void *snapshot_reader(void *arg)
+{
+    VersionedTable *table = arg;
+    struct Row *rows = malloc((VERSIONED_ROWS + 1) * sizeof(struct Row));
+    long scans = 0;
+    int failures = 0;
+    while (!__atomic_load_n(&table->done, __ATOMIC_ACQUIRE))
+    {
+        Snapshot snapshot;
+        snapshot_begin(table->db, &snapshot);
+        int count = scan_snapshot(table->db, &snapshot, rows);
+        snapshot_end(table->db, &snapshot);
+        failures += !consistent(rows, count, 1);
+
+        count = select_rows(table->db, rows, VERSIONED_ROWS + 1);
+        failures += !consistent(rows, count, table->db->clustered);
+        scans++;
+    }
+    free(rows);
+    __atomic_add_fetch(&table->scans, scans, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&table->failures, failures, __ATOMIC_RELAXED);
+    return NULL;
+}
+
+// Fill a table named Round0, hold a snapshot open while the writer runs all its rounds next
+// to SNAPSHOT_READERS readers, and check the old snapshot still reads Round0 at the end;
+// returns 1 if every read was consistent and the versions were dropped afterwards
+static int run_versioned(DbOptions *options)
+{
+    options->no_sync = 1;
+    remove_test_files("test.db");
+    Database db = init_db_with_options("test.db", options);
+    struct Row *rows = malloc((VERSIONED_ROWS + 1) * sizeof(struct Row));
+    for (int i = 0; i < VERSIONED_ROWS; i++)
+    {
+        rows[i].id = i + 1;
+        strcpy(rows[i].name, "Round0");
+    }
+    insert_rows(&db, rows, VERSIONED_ROWS);
+
+    VersionedTable table;
+    memset(&table, 0, sizeof(VersionedTable));
+    table.db = &db;
+    Snapshot old;
+    snapshot_begin(&db, &old);
+    pthread_t writer;
+    pthread_t readers[SNAPSHOT_READERS];
+    pthread_create(&writer, NULL, batch_writer, &table);
+    for (int t = 0; t < SNAPSHOT_READERS; t++)
+    {
+        pthread_create(&readers[t], NULL, snapshot_reader, &table);
+    }
+    pthread_join(writer, NULL);
+    for (int t = 0; t < SNAPSHOT_READERS; t++)
+    {
+        pthread_join(readers[t], NULL);
+    }
+
+    int count = scan_snapshot(&db, &old, rows);
+    struct Row row;
+    int ok = table.failures == 0 && table.scans > 0 && consistent(rows, count, 1) && count == VERSIONED_ROWS &&
+             strcmp(rows[0].name, "Round0") == 0 && select_by_id_snapshot(&db, &old, 2, &row) &&
+             strcmp(row.name, "Round0") == 0;
+    VersionStats stats;
+    versions_get_stats(&db, &stats);
+    ok = ok && stats.records >= 2 * VERSIONED_ROWS;
+    snapshot_end(&db, &old);
+    versions_get_stats(&db, &stats);
+    ok = ok && stats.records == 0 && stats.snapshots == 0;
+
+    count = select_rows(&db, rows, VERSIONED_ROWS + 1);
+    char latest[60];
+    snprintf(latest, sizeof(latest), "Round%d", VERSION_ROUNDS);
+    ok = ok && consistent(rows, count, db.clustered) && count == VERSIONED_ROWS && strcmp(rows[0].name, latest) == 0;
+    free(rows);
+    cleanup_test_db(&db, "test.db");
+    return ok;
+}
+
+// Test snapshot reads over the version store
+void test_mvcc()
+{
+    // Test 98: A snapshot keeps seeing rows as they were when it was taken, through updates,
+    // deletes and inserts, until it is closed and the old versions are dropped
+    Database db = setup_test_db("test.db");
+    create_test_rows(&db, 1, 10);
+    Snapshot snapshot;
+    snapshot_begin(&db, &snapshot);
+    update_row(&db, 2, "Changed");
+    update_row(&db, 2, "ChangedAgain");
+    delete_row(&db, 3);
+    insert_row(&db, 20, "Late");
+    struct Row old_two, old_three, now_two, late;
+    int ok = select_by_id_snapshot(&db, &snapshot, 2, &old_two) && select_by_id_snapshot(&db, &snapshot, 3, &old_three) &&
+             !select_by_id_snapshot(&db, &snapshot, 20, &late) && select_by_id(&db, 2, &now_two) &&
+             !select_by_id(&db, 3, &late);
+    ok = ok && strcmp(old_two.name, "Name2") == 0 && strcmp(old_three.name, "Name3") == 0 &&
+         strcmp(now_two.name, "ChangedAgain") == 0;
+    SnapshotCursor cursor;
+    struct Row row;
+    int count = 0;
+    select_range_snapshot(&db, &snapshot, 1, 100, &cursor);
+    while (snapshot_next(&db, &cursor, &row))
+    {
+        char expected[60];
+        snprintf(expected, sizeof(expected), "Name%d", row.id);
+        count++;
+        ok = ok && row.id == count && strcmp(row.name, expected) == 0;
+    }
+    snapshot_cursor_close(&cursor);
+    VersionStats held, released;
+    versions_get_stats(&db, &held);
+    snapshot_end(&db, &snapshot);
+    versions_get_stats(&db, &released);
+    log_test(98, "A snapshot should read rows as they were when it was taken",
+             ok && count == 10 && held.records == 4 && held.snapshots == 1 && released.records == 0 &&
+                 released.collected == 4);
+    cleanup_test_db(&db, "test.db");
+
+    // Test 99: Snapshot scans of a heap table see whole batches while a writer renames,
+    // deletes and reinserts rows, and an old snapshot outlives every round
+    DbOptions options;
+    memset(&options, 0, sizeof(DbOptions));
+    log_test(99, "Snapshot scans of a heap table should be consistent under a writer", run_versioned(&options));
+
+    // Test 100: The same on a clustered table, with rows in the index leaves
+    memset(&options, 0, sizeof(DbOptions));
+    options.clustered = 1;
+    log_test(100, "Snapshot scans of a clustered table should be consistent under a writer",
+             run_versioned(&options));
+}
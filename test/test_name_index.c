@@ -0,0 +1,124 @@
+#include "test_common.h"
+#include <fcntl.h>
+#include <unistd.h>
+
+#define NAME_ROWS 2000
+#define NAME_GROUPS 50
+
+// Fill rows 1..count whose names repeat every NAME_GROUPS ids
+static void fill_groups(struct Row *rows, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        rows[i].id = i + 1;
+        snprintf(rows[i].name, sizeof(rows[i].name), "Group%d", (i + 1) % NAME_GROUPS);
+    }
+}
+
+// Count the rows a name lookup returns, checking that each carries a matching name and
+// that rows with one name come back in id order (-1 on a mismatch)
+static int count_names(Database *db, const char *name, int prefix)
+{
+    NameCursor cursor;
+    struct Row row;
+    char last_name[60] = "";
+    int last_id = 0;
+    int count = 0;
+    select_by_name(db, name, prefix, &cursor);
+    while (name_next(db, &cursor, &row))
+    {
+        int matches = prefix ? strncmp(row.name, name, strlen(name)) == 0 : strcmp(row.name, name) == 0;
+        if (!matches || (strcmp(row.name, last_name) == 0 && row.id <= last_id))
+        {
+            return -1;
+        }
+        snprintf(last_name, sizeof(last_name), "%s", row.name);
+        last_id = row.id;
+        count++;
+    }
+    return count;
+}
+
+// Check that the name index holds one entry per row
+static int index_complete(Database *db)
+{
+    long keys;
+    return name_index_verify(db, &keys) && keys == db->header.row_count;
+}
+
+// Rewrite a closed file as version 6, from before the name index (and the subtree counts)
+static void downgrade_to_version6(const char *filename)
+{
+    DbHeader header;
+    int fd = open(filename, O_RDWR);
+    pread(fd, &header, sizeof(DbHeader), 0);
+    strip_subtree_counts(fd, header.root_offset);
+    header.version = 6;
+    header.name_root = 0;
+    pwrite(fd, &header, sizeof(DbHeader), 0);
+    close(fd);
+}
+
+// Test the secondary index on name
+void test_name_index()
+{
+    struct Row *rows = malloc(NAME_ROWS * sizeof(struct Row));
+
+    // Test 79: Equality and prefix lookups return every row with the name, duplicates included
+    Database db = setup_test_db("test.db");
+    fill_groups(rows, NAME_ROWS);
+    for (int i = 0; i < NAME_ROWS; i++)
+    {
+        insert_row(&db, rows[i].id, rows[i].name);
+    }
+    int per_group = NAME_ROWS / NAME_GROUPS;
+    int equal = count_names(&db, "Group7", 0) == per_group && count_names(&db, "Group", 0) == 0 &&
+                count_names(&db, "Missing", 0) == 0;
+    // Group1 and Group10..Group19
+    int prefixed = count_names(&db, "Group1", 1) == 11 * per_group && count_names(&db, "Group", 1) == NAME_ROWS;
+    log_test(79, "Name lookups should return every row with the name or prefix", equal && prefixed && index_complete(&db));
+
+    // Test 80: Updates and deletes keep the index in step with the table
+    update_row(&db, 7, "Renamed");
+    int ids[NAME_ROWS / NAME_GROUPS];
+    for (int i = 0; i < per_group; i++)
+    {
+        ids[i] = 3 + i * NAME_GROUPS;
+    }
+    delete_rows(&db, ids, per_group);
+    delete_row(&db, 8);
+    rows[0].id = 9;
+    snprintf(rows[0].name, sizeof(rows[0].name), "Renamed");
+    update_rows(&db, rows, 1);
+    int maintained = count_names(&db, "Renamed", 0) == 2 && count_names(&db, "Group7", 0) == per_group - 1 &&
+                     count_names(&db, "Group3", 0) == 0 && count_names(&db, "Group8", 0) == per_group - 1;
+    log_test(80, "Updates and deletes should keep the name index in step", maintained && index_complete(&db));
+
+    // Test 81: The index survives log replay, and bulk loads build it
+    insert_row(&db, NAME_ROWS + 1, "Logged");
+    // Drop the buffer pool without a checkpoint to force a replay
+    release_db(&db);
+    db = init_db("test.db");
+    int replayed = count_names(&db, "Logged", 0) == 1 && count_names(&db, "Renamed", 0) == 2 && index_complete(&db);
+    cleanup_test_db(&db, "test.db");
+
+    db = setup_test_db("test.db");
+    fill_groups(rows, NAME_ROWS);
+    int loaded = bulk_load(&db, rows, NAME_ROWS, 100);
+    close_db(&db);
+    db = init_db("test.db");
+    loaded = loaded && count_names(&db, "Group42", 0) == per_group && index_complete(&db);
+    log_test(81, "The name index should survive replay and be built by bulk loads", replayed && loaded);
+
+    // Test 82: A version 6 file gets its name index built at open
+    close_db(&db);
+    downgrade_to_version6("test.db");
+    db = init_db("test.db");
+    int built = db.name_root != 0 && count_names(&db, "Group1", 1) == 11 * per_group && index_complete(&db);
+    insert_row(&db, NAME_ROWS + 1, "Group1");
+    close_db(&db);
+    db = init_db("test.db");
+    log_test(82, "Older files should get the name index at open", built && db.header.version == DB_VERSION && count_names(&db, "Group1", 0) == per_group + 1);
+    cleanup_test_db(&db, "test.db");
+    free(rows);
+}
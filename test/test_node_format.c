@@ -0,0 +1,114 @@
+#include "test_common.h"
+#include <fcntl.h>
+#include <unistd.h>
+
+#define FORMAT_ROWS 20000
+#define V4_ROWS 400
+
+// Write a version 4 file: slotted data pages from page 4 on, indexed through a root over
+// two leaves in the old node layout (off_t links, id/record ID pairs)
+static void write_version4_file(const char *filename)
+{
+    unsigned char page[PAGE_SIZE];
+    int fd = open(filename, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    off_t data_base = 4 * PAGE_SIZE;
+    int data_pages = (V4_ROWS + (int)MAX_ROWS - 1) / (int)MAX_ROWS;
+    IndexEntry entries[V4_ROWS];
+
+    for (int p = 0; p < data_pages; p++)
+    {
+        off_t offset = data_base + (off_t)p * PAGE_SIZE;
+        data_page_init(page);
+        for (int k = p * (int)MAX_ROWS; k < V4_ROWS && k < (p + 1) * (int)MAX_ROWS; k++)
+        {
+            struct Row row = {0};
+            row.id = k + 1;
+            snprintf(row.name, sizeof(row.name), "Name%d", k + 1);
+            entries[k].id = row.id;
+            entries[k].address = RID(offset, data_page_insert(page, &row));
+        }
+        set_data_page_next(page, p + 1 < data_pages ? offset + PAGE_SIZE : 0);
+        ((DataPageHeader *)page)->in_free_list = (p + 1 == data_pages);
+        pwrite(fd, page, PAGE_SIZE, offset);
+    }
+
+    LegacyBTreeNode node = {0};
+    node.num_keys = 1;
+    node.data.internal.keys[0] = V4_ROWS / 2 + 1;
+    node.data.internal.children[0] = 2 * PAGE_SIZE;
+    node.data.internal.children[1] = 3 * PAGE_SIZE;
+    memset(page, 0, PAGE_SIZE);
+    memcpy(page, &node, sizeof(LegacyBTreeNode));
+    pwrite(fd, page, PAGE_SIZE, PAGE_SIZE);
+    for (int half = 0; half < 2; half++)
+    {
+        memset(&node, 0, sizeof(LegacyBTreeNode));
+        node.is_leaf = 1;
+        node.num_keys = V4_ROWS / 2;
+        memcpy(node.data.leaf.entries, &entries[half * V4_ROWS / 2], V4_ROWS / 2 * sizeof(IndexEntry));
+        node.data.leaf.next = half == 0 ? 3 * PAGE_SIZE : 0;
+        memset(page, 0, PAGE_SIZE);
+        memcpy(page, &node, sizeof(LegacyBTreeNode));
+        pwrite(fd, page, PAGE_SIZE, (off_t)(2 + half) * PAGE_SIZE);
+    }
+
+    DbHeader header = {0};
+    header.root_offset = PAGE_SIZE;
+    header.magic = DB_MAGIC;
+    header.version = 4;
+    header.page_count = 4 + data_pages;
+    header.first_data_page = data_base;
+    header.last_data_page = data_base + (off_t)(data_pages - 1) * PAGE_SIZE;
+    header.data_pages = data_pages;
+    header.row_count = V4_ROWS;
+    header.free_space_head = header.last_data_page;
+    memset(page, 0, PAGE_SIZE);
+    memcpy(page, &header, sizeof(DbHeader));
+    pwrite(fd, page, PAGE_SIZE, 0);
+    close(fd);
+}
+
+// Check that ids 1..count come back with their names
+static int rows_intact(Database *db, int count)
+{
+    for (int id = 1; id <= count; id++)
+    {
+        struct Row row;
+        char name[60];
+        snprintf(name, sizeof(name), "Name%d", id);
+        if (!select_by_id(db, id, &row) || strcmp(row.name, name) != 0)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Test the compact index node layout and the upgrade of older index pages
+void test_node_format()
+{
+    // Test 74: Compact nodes fit a page and hold more keys than the old layout
+    Database db = setup_test_db("test.db");
+    create_test_rows(&db, 1, FORMAT_ROWS);
+    BTreeStats stats;
+    int valid = btree_verify(&db, &stats);
+    int fits = sizeof(BTreeNode) <= PAGE_SIZE && LEAF_MAX_KEYS > 1.5 * LEGACY_MAX_KEYS &&
+               INTERNAL_MAX_KEYS > LEGACY_MAX_KEYS;
+    log_test(74, "Compact nodes should fit a page and need fewer leaves", valid && fits && stats.keys == FORMAT_ROWS && stats.leaves <= FORMAT_ROWS / (LEAF_MAX_KEYS / 2) + 1);
+    cleanup_test_db(&db, "test.db");
+
+    // Test 75: A version 4 file gets the compact index at open, keeping its data pages
+    remove_test_files("test.db");
+    write_version4_file("test.db");
+    db = init_db("test.db");
+    int data_pages = (V4_ROWS + (int)MAX_ROWS - 1) / (int)MAX_ROWS;
+    valid = btree_verify(&db, &stats);
+    int upgraded = db.header.version == DB_VERSION && db.header.first_data_page == 4 * PAGE_SIZE &&
+                   db.header.free_count >= 3 && stats.keys == V4_ROWS && rows_intact(&db, V4_ROWS);
+    insert_row(&db, V4_ROWS + 1, "Name401");
+    int reused = db.header.data_pages == data_pages;
+    close_db(&db);
+    db = init_db("test.db");
+    log_test(75, "Version 4 files should be upgraded to compact nodes at open", valid && upgraded && reused && btree_verify(&db, &stats) && rows_intact(&db, V4_ROWS + 1));
+    cleanup_test_db(&db, "test.db");
+}
@@ -0,0 +1,52 @@
+#include "test_common.h"
+
+// Compare every child search implementation with the linear scan for one key array
+static int child_searches_agree(const int *keys, int num_keys)
+{
+    int low = num_keys > 0 ? keys[0] - 2 : 0;
+    int high = num_keys > 0 ? keys[num_keys - 1] + 2 : 2;
+    for (int id = low; id <= high; id++)
+    {
+        int expected = child_index_linear(keys, num_keys, id);
+        if (child_index_binary(keys, num_keys, id) != expected ||
+            child_index_simd(keys, num_keys, id) != expected)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Test binary and vectorized search inside nodes
+void test_node_search()
+{
+    // Test 53: Binary and SIMD child search match the linear scan at every node size
+    int keys[INTERNAL_MAX_KEYS];
+    int agree = 1;
+    for (int num_keys = 0; num_keys <= INTERNAL_MAX_KEYS && agree; num_keys++)
+    {
+        for (int i = 0; i < num_keys; i++)
+        {
+            keys[i] = 3 * i + (i % 2); // strictly increasing, uneven gaps
+        }
+        agree = child_searches_agree(keys, num_keys);
+    }
+    printf("Node search uses %s compare\n", node_search_simd_name());
+    log_test(53, "Binary and SIMD child search should match a linear scan", agree);
+
+    // Test 54: Leaf search finds the insert position, including before and after every key
+    BTreeNode leaf = {0};
+    leaf.is_leaf = 1;
+    leaf.num_keys = LEAF_MAX_KEYS;
+    for (int i = 0; i < LEAF_MAX_KEYS; i++)
+    {
+        leaf.data.leaf.ids[i] = 2 * (i + 1);
+    }
+    int positions_ok = (node_leaf_index(&leaf, 1) == 0 && node_leaf_index(&leaf, 2 * LEAF_MAX_KEYS + 1) == LEAF_MAX_KEYS);
+    for (int i = 0; i < LEAF_MAX_KEYS; i++)
+    {
+        positions_ok &= (node_leaf_index(&leaf, 2 * (i + 1)) == i);
+        positions_ok &= (node_leaf_index(&leaf, 2 * (i + 1) + 1) == i + 1);
+    }
+    log_test(54, "Leaf search should return the first entry not below the id", positions_ok);
+}
@@ -0,0 +1,299 @@
+#include "test_common.h"
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define ORDER_ROWS 20000
+#define FULL_DISK_ROWS 3000
+
+// Open a fresh database with the given layout
+static Database open_fresh(int clustered)
+{
+    DbOptions options;
+    memset(&options, 0, sizeof(DbOptions));
+    options.no_sync = 1;
+    options.clustered = clustered;
+    remove_test_files("test.db");
+    return init_db_with_options("test.db", &options);
+}
+
+// Check counts and ranks against the present[] map for a spread of ranges and ids
+static int counts_match(Database *db, const char *present, int max_id)
+{
+    long below = 0;
+    for (int id = 1; id <= max_id + 1; id++)
+    {
+        if (id % 97 == 0 && rank_of_id(db, id) != below)
+        {
+            return 0;
+        }
+        below += id <= max_id && present[id];
+    }
+    if (count_rows(db, 1, INT_MAX) != below)
+    {
+        return 0;
+    }
+    for (int lo = 1; lo <= max_id; lo += max_id / 13)
+    {
+        int hi = lo + max_id / 5;
+        long expected = 0;
+        for (int id = lo; id <= hi && id <= max_id; id++)
+        {
+            expected += present[id];
+        }
+        if (count_rows(db, lo, hi) != expected)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Check that the page at offset of the given limit holds the right ids in order
+static int page_matches(Database *db, const char *present, int max_id, long offset, int limit)
+{
+    RangeCursor cursor;
+    struct Row row;
+    long rank = 0;
+    int id = 1;
+    while (id <= max_id && (rank < offset || !present[id]))
+    {
+        rank += present[id];
+        id++;
+    }
+    if (!select_from_offset(db, offset, &cursor))
+    {
+        return 0;
+    }
+    for (int n = 0; n < limit && range_next(db, &cursor, &row); n++)
+    {
+        while (id <= max_id && !present[id])
+        {
+            id++;
+        }
+        if (row.id != id)
+        {
+            return 0;
+        }
+        id++;
+    }
+    return 1;
+}
+
+// Count the rows whose names start with prefix
+static int count_prefix(Database *db, const char *prefix)
+{
+    NameCursor cursor;
+    struct Row row;
+    int count = 0;
+    select_by_name(db, prefix, 1, &cursor);
+    while (name_next(db, &cursor, &row))
+    {
+        count++;
+    }
+    return count;
+}
+
+// Batch inserts and renames on a full disk: names that all land in one name index leaf
+// run it out of pages, and the rows they were for must be left out (or keep their old
+// names) with the index still holding one entry per row
+static int names_survive_full_disk(Database *db, int rows, long *stored)
+{
+    struct Row *batch = malloc(rows * sizeof(struct Row));
+    int count = 0;
+    for (int id = 5; id <= rows; id += 5)
+    {
+        batch[count].id = id; // deleted, so the id index has room and the name index fills
+        snprintf(batch[count].name, sizeof(batch[count].name), "Full%06d", id);
+        count++;
+    }
+    int inserted = insert_rows(db, batch, count);
+    *stored += inserted;
+    count = 0;
+    for (int id = 1; id <= rows; id++)
+    {
+        if (id % 5 != 0)
+        {
+            batch[count].id = id;
+            snprintf(batch[count].name, sizeof(batch[count].name), "Renamed%06d", id);
+            count++;
+        }
+    }
+    int updated = update_rows(db, batch, count);
+    int renamed = update_row(db, 1, "Renamed999999");
+    long names;
+    struct Row row;
+    int intact = inserted < rows / 5 && updated < count && name_index_verify(db, &names) && names == *stored &&
+                 count_prefix(db, "Full") == inserted && count_prefix(db, "Renamed") == updated + renamed &&
+                 select_by_id(db, 1, &row) && renamed == (strcmp(row.name, "Renamed999999") == 0);
+    free(batch);
+    return intact;
+}
+
+// Fill a table, free a fifth of its row slots and stop the file from growing, then insert
+// until an index split finds no page; the failed insert must leave neither a row nor a
+// count behind, and go through once the file can grow again (layout: 0 B+tree, 1 clustered,
+// 2 hashed, which starts from one full bucket so the inserts split it)
+static int survives_full_disk(int layout)
+{
+    DbOptions options;
+    memset(&options, 0, sizeof(DbOptions));
+    options.no_sync = 1;
+    options.use_mmap = 1;
+    options.clustered = layout == 1;
+    options.hashed = layout == 2;
+    remove_test_files("test.db");
+    Database db = init_db_with_options("test.db", &options);
+    int rows = layout == 2 ? HASH_BUCKET_KEYS : FULL_DISK_ROWS;
+    create_test_rows(&db, 1, rows);
+    for (int id = 5; id <= rows; id += 5)
+    {
+        delete_row(&db, id);
+    }
+    bloom_build(&db); // sized for the rows left, so the inserts below need no bigger filter
+    checkpoint(&db);
+    while (db.header.free_head != 0)
+    {
+        allocate_page(&db); // leaked, so the next page must come from the end of the file
+    }
+
+    struct stat st;
+    stat("test.db", &st);
+    struct rlimit saved;
+    getrlimit(RLIMIT_FSIZE, &saved);
+    struct rlimit full = saved;
+    full.rlim_cur = (rlim_t)st.st_size;
+    int saved_out = redirect_stream(stdout, -1);
+    int saved_err = redirect_stream(stderr, -1);
+    signal(SIGXFSZ, SIG_IGN);
+    setrlimit(RLIMIT_FSIZE, &full);
+    int failed_id = 0;
+    long stored = rows - rows / 5;
+    for (int id = rows + 1; id <= 2 * rows && failed_id == 0; id++)
+    {
+        // The name of a deleted row lands where a name index leaf has room, so the id
+        // index is the one that runs out of pages
+        char name[60];
+        snprintf(name, sizeof(name), "Name%d", (id - rows) * 5);
+        if (insert_row(&db, id, name))
+        {
+            stored++;
+        }
+        else
+        {
+            failed_id = id;
+        }
+    }
+    int named = names_survive_full_disk(&db, rows, &stored);
+    BTreeStats stats;
+    struct Row row;
+    int intact = failed_id != 0 && named && db.header.row_count == stored && btree_count(&db) == stored &&
+                 !select_by_id(&db, failed_id, &row) && btree_verify(&db, &stats) && stats.keys == stored;
+    setrlimit(RLIMIT_FSIZE, &saved);
+    signal(SIGXFSZ, SIG_DFL);
+    redirect_stream(stdout, saved_out);
+    redirect_stream(stderr, saved_err);
+
+    int retried = insert_row(&db, failed_id, "Full") && select_by_id(&db, failed_id, &row) &&
+                  btree_count(&db) == stored + 1 && btree_verify(&db, &stats) && stats.keys == stored + 1;
+    cleanup_test_db(&db, "test.db");
+    return intact && retried;
+}
+
+// Rewrite a closed file as version 9, from before the subtree counts
+static void downgrade_to_version9(const char *filename)
+{
+    DbHeader header;
+    int fd = open(filename, O_RDWR);
+    pread(fd, &header, sizeof(DbHeader), 0);
+    strip_subtree_counts(fd, header.root_offset);
+    header.version = 9;
+    pwrite(fd, &header, sizeof(DbHeader), 0);
+    close(fd);
+}
+
+// Test the subtree counts kept in internal nodes
+void test_order_stats()
+{
+    // Test 89: Inserts in scattered order split nodes and keep every count exact
+    Database db = open_fresh(0);
+    char *present = calloc(ORDER_ROWS + 1, 1);
+    for (int i = 0; i < ORDER_ROWS; i++)
+    {
+        int id = 1 + (int)(((long)i * 7919) % ORDER_ROWS);
+        char name[60];
+        snprintf(name, sizeof(name), "Name%d", id);
+        insert_row(&db, id, name);
+        present[id] = 1;
+    }
+    BTreeStats stats;
+    int valid = btree_verify(&db, &stats);
+    log_test(89, "Subtree counts should answer COUNT and rank after splits", valid && stats.height >= 2 && counts_match(&db, present, ORDER_ROWS));
+
+    // Test 90: Deletes (with borrows and merges) keep the counts, and LIMIT/OFFSET pages
+    // start at the right row
+    int *ids = malloc(ORDER_ROWS * sizeof(int));
+    int count = 0;
+    for (int id = 1; id <= ORDER_ROWS; id++)
+    {
+        if (id % 3 != 0 || id > ORDER_ROWS / 2)
+        {
+            ids[count++] = id;
+            present[id] = 0;
+        }
+    }
+    delete_rows(&db, ids, count / 2);
+    for (int i = count / 2; i < count; i++)
+    {
+        delete_row(&db, ids[i]);
+    }
+    valid = btree_verify(&db, &stats);
+    long left = count_rows(&db, 1, INT_MAX);
+    int paged = page_matches(&db, present, ORDER_ROWS, 0, 10) && page_matches(&db, present, ORDER_ROWS, 1234, 50) && page_matches(&db, present, ORDER_ROWS, left - 5, 10);
+    RangeCursor cursor;
+    struct Row row;
+    select_from_offset(&db, left, &cursor);
+    int past_end = !range_next(&db, &cursor, &row);
+    log_test(90, "Subtree counts should survive deletes and drive offset paging", valid && left == ORDER_ROWS / 6 && counts_match(&db, present, ORDER_ROWS) && paged && past_end);
+    cleanup_test_db(&db, "test.db");
+
+    // Test 91: Bulk loads and clustered tables carry counts, they persist, and files from
+    // before them get counts at open
+    int counted = 1;
+    struct Row *rows = malloc(ORDER_ROWS / 2 * sizeof(struct Row));
+    for (int clustered = 0; clustered <= 1; clustered++)
+    {
+        db = open_fresh(clustered);
+        memset(present, 0, ORDER_ROWS + 1);
+        for (int i = 0; i < ORDER_ROWS / 2; i++)
+        {
+            rows[i].id = 2 * (i + 1);
+            snprintf(rows[i].name, sizeof(rows[i].name), "Name%d", rows[i].id);
+            present[rows[i].id] = 1;
+        }
+        bulk_load(&db, rows, ORDER_ROWS / 2, 90);
+        counted = counted && btree_verify(&db, &stats) && stats.height >= 2 && counts_match(&db, present, ORDER_ROWS);
+        insert_row(&db, 1, "Name1");
+        present[1] = 1;
+        close_db(&db);
+        db = init_db("test.db");
+        counted = counted && db.clustered == clustered && btree_verify(&db, &stats) && count_rows(&db, 1, ORDER_ROWS) == ORDER_ROWS / 2 + 1 && page_matches(&db, present, ORDER_ROWS, 777, 20);
+        close_db(&db);
+        downgrade_to_version9("test.db");
+        db = init_db("test.db");
+        counted = counted && db.header.version == DB_VERSION && btree_verify(&db, &stats) && counts_match(&db, present, ORDER_ROWS) && rank_of_id(&db, 3) == 2;
+        cleanup_test_db(&db, "test.db");
+    }
+    log_test(91, "Bulk loaded, clustered and upgraded trees should carry counts", counted);
+
+    // Test 108: An insert or rename whose index split finds no page fails without a stray
+    // row, entry or count
+    log_test(108, "A write that cannot split an index should leave the table as it was",
+             survives_full_disk(0) && survives_full_disk(1) && survives_full_disk(2));
+    free(rows);
+    free(ids);
+    free(present);
+}
@@ -0,0 +1,60 @@
+#include "test_common.h"
+
+#define PAGING_FRAMES 16
+#define PAGING_ROWS 3000
+
+// Check that every row in a range is found by id with the name create_test_rows gave it
+static int rows_present(Database *db, int start_id, int count)
+{
+    for (int id = start_id; id < start_id + count; id++)
+    {
+        struct Row row;
+        char name[60];
+        snprintf(name, 60, "Name%d", id);
+        if (!select_by_id(db, id, &row) || strcmp(row.name, name) != 0)
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Test demand-paged data pages behind a bounded buffer pool
+void test_paging()
+{
+    DbOptions options;
+    memset(&options, 0, sizeof(DbOptions));
+    options.pool_frames = PAGING_FRAMES;
+    options.no_sync = 1;
+    remove_test_files("test.db");
+    Database db = init_db_with_options("test.db", &options);
+
+    // Test 50: A table many times larger than the buffer pool stays fully readable
+    create_test_rows(&db, 1, PAGING_ROWS);
+    BufferPoolStats stats;
+    buffer_pool_get_stats(db.pool, &stats);
+    int expected_pages = (PAGING_ROWS + (int)MAX_ROWS - 1) / (int)MAX_ROWS;
+    int readable = rows_present(&db, 1, PAGING_ROWS);
+    log_test(50, "Tables larger than the buffer pool should stay readable", readable && db.header.data_pages == expected_pages && stats.pages_cached <= PAGING_FRAMES && stats.evictions > 0);
+
+    // Test 51: Opening reads no data pages, whatever the table size
+    close_db(&db);
+    db = init_db_with_options("test.db", &options);
+    buffer_pool_get_stats(db.pool, &stats);
+    int cold = (stats.pages_cached == 0 && stats.misses == 0);
+    struct Row rows[MAX_ROWS * TEST_PAGES];
+    int count = select_rows(&db, rows, MAX_ROWS * TEST_PAGES);
+    log_test(51, "Open should not read data pages up front", cold && count == MAX_ROWS * TEST_PAGES && db.header.data_pages == expected_pages);
+    cleanup_test_db(&db, "test.db");
+
+    // Test 52: Rows moved by compaction keep working index entries
+    db = setup_test_db("test.db");
+    create_test_rows(&db, 1, MAX_ROWS * 8);
+    for (int id = 1; id <= (int)MAX_ROWS; id++)
+    {
+        delete_row(&db, id); // a page of free slots, below the compaction threshold
+    }
+    int freed = compact_table(&db);
+    log_test(52, "Compacted pages should keep index addresses correct", freed == 1 && db.header.data_pages == 7 && rows_present(&db, MAX_ROWS + 1, MAX_ROWS * 7));
+    cleanup_test_db(&db, "test.db");
+}
@@ -7,6 +7,30 @@ void test_unique_id_enforcement(void);
 void test_invalid_inputs(void);
 void test_update(void);
 void test_compaction(void);
+void test_buffer_pool(void);
+void test_mmap_storage(void);
+void test_wal(void);
+void test_checkpoint(void);
+void test_allocator(void);
+void test_paging(void);
+void test_node_search(void);
+void test_range_scan(void);
+void test_bulk_load(void);
+void test_batch_operations(void);
+void test_free_space(void);
+void test_btree_delete(void);
+void test_deep_tree(void);
+void test_node_format(void);
+void test_clustered(void);
+void test_name_index(void);
+void test_hash_index(void);
+void test_bloom(void);
+void test_order_stats(void);
+void test_concurrency(void);
+void test_server(void);
+void test_mvcc(void);
+void test_txn(void);
+void test_checksum(void);
 
 int main()
 {
@@ -23,6 +47,30 @@ int main()
     test_invalid_inputs();
     test_update();
     test_compaction();
+    test_buffer_pool();
+    test_mmap_storage();
+    test_wal();
+    test_checkpoint();
+    test_allocator();
+    test_paging();
+    test_node_search();
+    test_range_scan();
+    test_bulk_load();
+    test_batch_operations();
+    test_free_space();
+    test_btree_delete();
+    test_deep_tree();
+    test_node_format();
+    test_clustered();
+    test_name_index();
+    test_hash_index();
+    test_bloom();
+    test_order_stats();
+    test_concurrency();
+    test_server();
+    test_mvcc();
+    test_txn();
+    test_checksum();
     
     printf("================================\n");
     print_test_summary();
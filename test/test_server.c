@@ -0,0 +1,203 @@
+#include "test_common.h"
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define SOCKET_PATH "test_server.sock"
+#define PIPELINED_INSERTS 500
+
+// Run the event loop of a server until server_stop
+static void *serve_thread(void *arg)
+{
+    server_run(arg);
+    return NULL;
+}
+
+// Start a server for db on a free TCP port and SOCKET_PATH, running on its own thread
+static Server *start_server(Database *db, pthread_t *thread)
+{
+    ServerOptions options = {NULL, 0, SOCKET_PATH};
+    Server *server = server_open(db, &options);
+    if (server != NULL)
+    {
+        pthread_create(thread, NULL, serve_thread, server);
+    }
+    return server;
+}
+
+// Stop a server started by start_server
+static void stop_server(Server *server, pthread_t thread)
+{
+    server_stop(server);
+    pthread_join(thread, NULL);
+    server_close(server);
+}
+
+// Connect to the server over TCP, or over its Unix socket (returns -1 on failure)
+static int connect_to(Server *server, int use_unix)
+{
+    if (use_unix)
+    {
+        struct sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strcpy(addr.sun_path, SOCKET_PATH);
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd != -1 && connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+        {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons((uint16_t)server->port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd != -1 && connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Send requests in one write and read replies until lines of them arrived or the server
+// hung up (returns the bytes read into buffer, NUL terminated)
+static size_t exchange(int fd, const char *requests, int lines, char *buffer, size_t size)
+{
+    size_t sent = 0;
+    size_t len = strlen(requests);
+    while (sent < len)
+    {
+        ssize_t n = write(fd, requests + sent, len - sent);
+        if (n <= 0)
+        {
+            break;
+        }
+        sent += n;
+    }
+    size_t received = 0;
+    int seen = 0;
+    while (seen < lines && received < size - 1)
+    {
+        ssize_t n = read(fd, buffer + received, size - 1 - received);
+        if (n <= 0)
+        {
+            break;
+        }
+        for (ssize_t i = 0; i < n; i++)
+        {
+            seen += buffer[received + i] == '\n';
+        }
+        received += n;
+    }
+    buffer[received] = '\0';
+    return received;
+}
+
+// Test the network server and its line protocol
+void test_server()
+{
+    // Test 95: Pipelined requests over TCP get their replies in order, and reads see the
+    // writes the same client sent before them (blanks before a command are allowed)
+    remove_test_files("test.db");
+    DbOptions db_options;
+    memset(&db_options, 0, sizeof(DbOptions));
+    db_options.no_sync = 1;
+    Database db = init_db_with_options("test.db", &db_options);
+    pthread_t thread;
+    Server *server = start_server(&db, &thread);
+    char replies[65536];
+    int fd = server != NULL ? connect_to(server, 0) : -1;
+    exchange(fd,
+             "PING\r\nINSERT 1 alice\nINSERT 2 bob\nINSERT 2 again\n GET 1\nUPDATE 2 bobby\n"
+             "\tRANGE 1 10\nCOUNT\n DELETE 1\nGET 1\nQUIT\n",
+             14, replies, sizeof(replies));
+    log_test(95, "Pipelined requests should get ordered replies over TCP",
+             fd != -1 && strcmp(replies, "+PONG\r\n+OK\r\n+OK\r\n-ERR duplicate id\r\n=1 alice\r\n+OK\r\n"
+                                         "*2\r\n=1 alice\r\n=2 bobby\r\n:2\r\n+OK\r\n-ERR not found\r\n"
+                                         "+BYE\r\n") == 0);
+    if (fd != -1)
+    {
+        close(fd);
+    }
+
+    // Test 96: A pipeline of writes is applied in a few batches, each with a single commit,
+    // and the rows are in the table afterwards
+    char *requests = malloc(PIPELINED_INSERTS * 32 + 16);
+    size_t len = 0;
+    for (int i = 0; i < PIPELINED_INSERTS; i++)
+    {
+        len += sprintf(requests + len, "INSERT %d row%d\n", 100 + i, i);
+    }
+    strcpy(requests + len, "COUNT\n");
+    WalStats before, after;
+    wal_get_stats(db.wal, &before);
+    unsigned long commits_before = server != NULL ? server->commits : 0;
+    fd = server != NULL ? connect_to(server, 0) : -1;
+    exchange(fd, requests, PIPELINED_INSERTS + 1, replies, sizeof(replies));
+    wal_get_stats(db.wal, &after);
+    char *count = strstr(replies, ":");
+    unsigned long batches = server != NULL ? server->commits - commits_before : 0;
+    log_test(96, "Pipelined writes should be committed in batches",
+             fd != -1 && count != NULL && strcmp(count, ":501\r\n") == 0 && batches >= 1 &&
+                 batches <= PIPELINED_INSERTS / 50 && after.flushes - before.flushes == batches);
+    free(requests);
+    if (fd != -1)
+    {
+        close(fd);
+    }
+
+    // Test 97: Clients on the Unix socket are served next to each other; a request that
+    // is too long gets an error and ends only its own connection
+    int first = server != NULL ? connect_to(server, 1) : -1;
+    int second = server != NULL ? connect_to(server, 1) : -1;
+    char long_line[SERVER_MAX_LINE + 16];
+    memset(long_line, 'x', sizeof(long_line) - 2);
+    long_line[sizeof(long_line) - 2] = '\n';
+    long_line[sizeof(long_line) - 1] = '\0';
+    char first_replies[256];
+    exchange(first, long_line, 1, first_replies, sizeof(first_replies));
+    char tail[16];
+    int closed = first != -1 && read(first, tail, sizeof(tail)) == 0;
+    exchange(second, "GET 2\nDELETE 999\nRANGE 5 1\n", 3, replies, sizeof(replies));
+    log_test(97, "Unix socket clients should be served and bad requests refused",
+             first != -1 && second != -1 && strncmp(first_replies, "-ERR request longer", 19) == 0 && closed &&
+                 strncmp(replies, "=2 bobby\r\n-ERR not found\r\n-ERR usage: RANGE", 43) == 0);
+    if (first != -1)
+    {
+        close(first);
+    }
+    if (second != -1)
+    {
+        close(second);
+    }
+
+    // Test 109: Replies a request gets at once (bad and empty requests, a line that is too
+    // long) still come after the replies owed to the writes pipelined before it
+    fd = server != NULL ? connect_to(server, 0) : -1;
+    exchange(fd, "INSERT 7 a\nINSERT x\nINSERT 7 b\n\nPING\n", 5, replies, sizeof(replies));
+    int ordered = strcmp(replies, "+OK\r\n-ERR usage: INSERT <id> <name> with a positive id\r\n"
+                                  "-ERR duplicate id\r\n-ERR empty request\r\n+PONG\r\n") == 0;
+    char *pipeline = malloc(sizeof(long_line) + 16);
+    snprintf(pipeline, sizeof(long_line) + 16, "DELETE 7\n%s", long_line);
+    exchange(fd, pipeline, 2, replies, sizeof(replies));
+    log_test(109, "Immediate replies should follow the replies of earlier pipelined writes",
+             fd != -1 && ordered && strncmp(replies, "+OK\r\n-ERR request longer", 24) == 0);
+    free(pipeline);
+    if (fd != -1)
+    {
+        close(fd);
+    }
+
+    if (server != NULL)
+    {
+        stop_server(server, thread);
+    }
+    cleanup_test_db(&db, "test.db");
+}
@@ -0,0 +1,200 @@
+#include "test_common.h"
+#include <signal.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+#define TXN_ROWS 10000
+#define SPILL_ROWS 3000     // enough to fill half of SPILL_FRAMES with dirty pages several times
+#define SPILL_FRAMES 16
+#define FULL_ROWS 3000
+#define FULL_INSERTS 400    // more than the index leaves hold once the file cannot grow
+
+// Count the rows with ids in first..first+count-1
+static int rows_present(Database *db, int first, int count)
+{
+    int present = 0;
+    for (int id = first; id < first + count; id++)
+    {
+        off_t address;
+        btree_search(db, id, &address);
+        present += address != -1;
+    }
+    return present;
+}
+
+// Check that a table of FULL_ROWS rows less every fifth one is as it was before the
+// transaction that failed on it
+static int untouched_by_txn(Database *db)
+{
+    struct Row first;
+    long names;
+    BTreeStats stats;
+    long rows = FULL_ROWS - FULL_ROWS / 5;
+    return db->header.row_count == rows && btree_verify(db, &stats) && stats.keys == rows &&
+           name_index_verify(db, &names) && names == rows && select_by_id(db, 1, &first) &&
+           strcmp(first.name, "Name1") == 0 && rows_present(db, 2, 1) == 1 && rows_present(db, 5, 1) == 0 &&
+           rows_present(db, FULL_ROWS + 1, FULL_INSERTS) == 0;
+}
+
+// Queue a transaction that changes rows 1, 2 and 5 and then adds FULL_INSERTS rows
+static void queue_full_txn(Database *db, Transaction *txn)
+{
+    txn_begin(db, txn);
+    txn_update(txn, 1, "Changed");
+    txn_delete(txn, 2);
+    txn_insert(txn, 5, "Back");
+    for (int id = FULL_ROWS + 1; id <= FULL_ROWS + FULL_INSERTS; id++)
+    {
+        txn_insert(txn, id, "Added");
+    }
+}
+
+// Test explicit transactions
+void test_txn()
+{
+    // Test 101: A transaction reads its own changes, others do not see them before the
+    // commit, and a rollback leaves nothing behind, not even log records
+    Database db = setup_test_db("test.db");
+    create_test_rows(&db, 1, 5);
+    Transaction txn;
+    txn_begin(&db, &txn);
+    int queued = txn_insert(&txn, 10, "Ten") && txn_update(&txn, 1, "One") && txn_delete(&txn, 2) &&
+                 !txn_insert(&txn, 3, "Taken") && !txn_update(&txn, 2, "Gone") && txn_insert(&txn, 2, "Again");
+    struct Row own, outside, again;
+    int isolated = txn_select(&txn, 1, &own) && strcmp(own.name, "One") == 0 && txn_select(&txn, 2, &again) &&
+                   strcmp(again.name, "Again") == 0 && select_by_id(&db, 1, &outside) &&
+                   strcmp(outside.name, "Name1") == 0 && rows_present(&db, 10, 1) == 0;
+    WalStats before, after;
+    wal_get_stats(db.wal, &before);
+    txn_abort(&txn);
+    wal_get_stats(db.wal, &after);
+    int rolled_back = !txn.active && after.records == before.records && rows_present(&db, 10, 1) == 0 &&
+                      select_by_id(&db, 1, &outside) && strcmp(outside.name, "Name1") == 0;
+
+    txn_begin(&db, &txn);
+    txn_insert(&txn, 10, "Ten");
+    txn_update(&txn, 1, "One");
+    txn_delete(&txn, 2);
+    txn_insert(&txn, 2, "Again");
+    int committed = txn_commit(&txn) && select_by_id(&db, 1, &own) && strcmp(own.name, "One") == 0 &&
+                    select_by_id(&db, 2, &again) && strcmp(again.name, "Again") == 0 && rows_present(&db, 10, 1) == 1;
+    log_test(101, "A transaction should see its own changes and roll back without a trace",
+             queued && isolated && rolled_back && committed && db.header.row_count == 6);
+    cleanup_test_db(&db, "test.db");
+
+    // Test 102: A 10,000-row transaction commits with one log flush, and a transaction whose
+    // change no longer applies at commit is rolled back whole
+    remove_test_files("test.db");
+    DbOptions options;
+    memset(&options, 0, sizeof(DbOptions));
+    options.no_sync = 1;
+    options.pool_frames = 4096;
+    db = init_db_with_options("test.db", &options);
+    txn_begin(&db, &txn);
+    for (int i = 1; i <= TXN_ROWS; i++)
+    {
+        char name[60];
+        snprintf(name, sizeof(name), "Txn%d", i);
+        txn_insert(&txn, i, name);
+    }
+    wal_get_stats(db.wal, &before);
+    committed = txn_commit(&txn);
+    wal_get_stats(db.wal, &after);
+    int one_flush = committed && after.flushes - before.flushes == 1 &&
+                    after.records - before.records == TXN_ROWS + 2 && rows_present(&db, 1, TXN_ROWS) == TXN_ROWS;
+
+    txn_begin(&db, &txn);
+    txn_insert(&txn, TXN_ROWS + 1, "Mine");
+    txn_delete(&txn, 1);
+    insert_row(&db, TXN_ROWS + 1, "Theirs"); // another writer takes the id first
+    wal_get_stats(db.wal, &before);
+    int conflicted = !txn_commit(&txn);
+    wal_get_stats(db.wal, &after);
+    struct Row theirs;
+    conflicted = conflicted && after.records == before.records && rows_present(&db, 1, 1) == 1 &&
+                 select_by_id(&db, TXN_ROWS + 1, &theirs) && strcmp(theirs.name, "Theirs") == 0;
+    log_test(102, "A large transaction should commit with one flush and a conflict should roll back",
+             one_flush && conflicted);
+    cleanup_test_db(&db, "test.db");
+
+    // Test 103: After a crash a committed transaction is all there, even one that filled a
+    // small pool and forced checkpoints on the way, and one the log ends in is all gone
+    remove_test_files("test.db");
+    memset(&options, 0, sizeof(DbOptions));
+    options.no_sync = 1;
+    options.pool_frames = SPILL_FRAMES;
+    db = init_db_with_options("test.db", &options);
+    txn_begin(&db, &txn);
+    for (int i = 1; i <= SPILL_ROWS; i++)
+    {
+        char name[60];
+        snprintf(name, sizeof(name), "Spill%d", i);
+        txn_insert(&txn, i, name);
+    }
+    unsigned long checkpoints = db.checkpoint_stats.checkpoints;
+    committed = txn_commit(&txn);
+    int spilled = db.checkpoint_stats.checkpoints > checkpoints;
+    // An unfinished transaction: its records reach the log, the commit marker never does
+    wal_append(db.wal, WAL_BEGIN, 2, NULL);
+    wal_append(db.wal, WAL_INSERT, SPILL_ROWS + 1, "Lost");
+    uint64_t lsn = wal_append(db.wal, WAL_DELETE, 1, NULL);
+    wal_commit(db.wal, lsn);
+    release_db(&db);
+
+    db = init_db_with_options("test.db", &options);
+    BTreeStats stats;
+    int recovered = committed && spilled && rows_present(&db, 1, SPILL_ROWS) == SPILL_ROWS &&
+                    rows_present(&db, SPILL_ROWS + 1, 1) == 0 && db.header.row_count == SPILL_ROWS &&
+                    btree_verify(&db, &stats);
+    insert_row(&db, SPILL_ROWS + 2, "After");
+    release_db(&db);
+    db = init_db_with_options("test.db", &options);
+    recovered = recovered && rows_present(&db, SPILL_ROWS + 2, 1) == 1;
+    log_test(103, "Recovery should replay committed transactions whole and drop unfinished ones", recovered);
+    cleanup_test_db(&db, "test.db");
+
+    // Test 111: A transaction whose index split finds no page as it applies (the file cannot
+    // grow) is rolled back whole and reported as failed, also after a crash
+    remove_test_files("test.db");
+    memset(&options, 0, sizeof(DbOptions));
+    options.no_sync = 1;
+    options.use_mmap = 1;
+    db = init_db_with_options("test.db", &options);
+    create_test_rows(&db, 1, FULL_ROWS);
+    for (int id = 5; id <= FULL_ROWS; id += 5)
+    {
+        delete_row(&db, id);
+    }
+    bloom_build(&db);
+    checkpoint(&db);
+    while (db.header.free_head != 0)
+    {
+        allocate_page(&db); // leaked, so the next page must come from the end of the file
+    }
+    struct stat st;
+    stat("test.db", &st);
+    struct rlimit saved;
+    getrlimit(RLIMIT_FSIZE, &saved);
+    struct rlimit full = saved;
+    full.rlim_cur = (rlim_t)st.st_size;
+    int saved_out = redirect_stream(stdout, -1);
+    int saved_err = redirect_stream(stderr, -1);
+    signal(SIGXFSZ, SIG_IGN);
+    setrlimit(RLIMIT_FSIZE, &full);
+    queue_full_txn(&db, &txn);
+    int failed = !txn_commit(&txn) && untouched_by_txn(&db);
+    setrlimit(RLIMIT_FSIZE, &saved);
+    signal(SIGXFSZ, SIG_DFL);
+    redirect_stream(stdout, saved_out);
+    redirect_stream(stderr, saved_err);
+    release_db(&db);
+
+    db = init_db_with_options("test.db", &options);
+    int undone = untouched_by_txn(&db);
+    queue_full_txn(&db, &txn);
+    committed = txn_commit(&txn) && rows_present(&db, FULL_ROWS + 1, FULL_INSERTS) == FULL_INSERTS &&
+                rows_present(&db, 2, 1) == 0 && select_by_id(&db, 5, &again) && strcmp(again.name, "Back") == 0;
+    log_test(111, "A transaction that runs out of pages as it applies should roll back whole",
+             failed && undone && committed);
+    cleanup_test_db(&db, "test.db");
+}
@@ -0,0 +1,163 @@
+#include "test_common.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sched.h>
+
+#define COMMIT_THREADS 8
+#define COMMITS_PER_THREAD 50
+#define FLUSH_RECORDS 200000 // a group commit long enough for a checkpoint to overlap it
+
+// Size of a file on disk
+static off_t file_size(const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+    {
+        return -1;
+    }
+    fseek(file, 0, SEEK_END);
+    off_t size = ftello(file);
+    fclose(file);
+    return size;
+}
+
+// Run statements in a child process that exits without closing the database
+static void crash_after(void (*statements)(Database *db))
+{
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        Database db = init_db("test.db");
+        statements(&db);
+        _exit(0);
+    }
+    waitpid(pid, NULL, 0);
+}
+
+static void insert_update_delete(Database *db)
+{
+    create_test_rows(db, 1, 10);
+    update_row(db, 3, "Logged");
+    delete_row(db, 7);
+}
+
+static void insert_more(Database *db)
+{
+    create_test_rows(db, 20, 3);
+}
+
+// Append and commit records from several threads at once
+static void *commit_worker(void *arg)
+{
+    Wal *wal = arg;
+    for (int i = 0; i < COMMITS_PER_THREAD; i++)
+    {
+        uint64_t lsn = wal_append(wal, WAL_INSERT, i + 1, "Worker");
+        wal_commit(wal, lsn);
+    }
+    return NULL;
+}
+
+// Lead a group commit of many records
+static void *flush_worker(void *arg)
+{
+    Wal *wal = arg;
+    uint64_t lsn = 0;
+    for (int i = 0; i < FLUSH_RECORDS; i++)
+    {
+        lsn = wal_append(wal, WAL_UPDATE, 1, "Flushed");
+    }
+    wal_commit(wal, lsn);
+    return NULL;
+}
+
+// Test the write-ahead log, recovery and group commit
+void test_wal()
+{
+    Database db = setup_test_db("test.db");
+
+    // Test 39: Statements append to the log instead of rewriting pages
+    off_t size_before = file_size("test.db");
+    create_test_rows(&db, 1, 100);
+    WalStats stats;
+    wal_get_stats(db.wal, &stats);
+    log_test(39, "Inserts should only append to the write-ahead log", file_size("test.db") == size_before && stats.commits == 100 && stats.size == 100 * (off_t)sizeof(WalRecord));
+    cleanup_test_db(&db, "test.db");
+
+    // Test 40: Committed changes survive a crash before any checkpoint
+    remove_test_files("test.db");
+    crash_after(insert_update_delete);
+    db = init_db("test.db");
+    struct Row row;
+    int found = select_by_id(&db, 3, &row);
+    int gone = !select_by_id(&db, 7, &row);
+    struct Row rows[MAX_ROWS * TEST_PAGES];
+    int count = select_rows(&db, rows, MAX_ROWS * TEST_PAGES);
+    wal_get_stats(db.wal, &stats);
+    log_test(40, "Recovery should replay the log after a crash", found && gone && count == 9 && stats.size == 0);
+    close_db(&db);
+
+    // Test 41: A torn record at the end of the log is ignored
+    crash_after(insert_more);
+    int fd = open("test.db.wal", O_WRONLY | O_APPEND);
+    ssize_t torn = write(fd, "partial record", 14);
+    close(fd);
+    db = init_db("test.db");
+    count = select_rows(&db, rows, MAX_ROWS * TEST_PAGES);
+    found = select_by_id(&db, 22, &row);
+    log_test(41, "Recovery should stop at a torn log tail", torn == 14 && found && count == 12);
+    cleanup_test_db(&db, "test.db");
+
+    // Test 42: Concurrent commits are grouped into fewer writes and syncs
+    remove("test_group.wal");
+    Wal *wal = wal_open("test_group.wal", 1, 0, 1);
+    pthread_t threads[COMMIT_THREADS];
+    for (int t = 0; t < COMMIT_THREADS; t++)
+    {
+        pthread_create(&threads[t], NULL, commit_worker, wal);
+    }
+    for (int t = 0; t < COMMIT_THREADS; t++)
+    {
+        pthread_join(threads[t], NULL);
+    }
+    wal_get_stats(wal, &stats);
+    int readable = 0;
+    off_t position = 0;
+    WalRecord record;
+    while (wal_read_record(wal, &position, &record))
+    {
+        readable++;
+    }
+    wal_close(wal);
+    remove("test_group.wal");
+    log_test(42, "Group commit should batch concurrent commits", readable == COMMIT_THREADS * COMMITS_PER_THREAD && stats.flushes < stats.commits);
+
+    // Test 107: A checkpoint that empties the log while another thread leads a group commit
+    // leaves no hole in front of the records committed after it, so a crash loses none
+    // (without syncs, which the file system may order behind the leader's)
+    remove_test_files("test.db");
+    DbOptions options;
+    memset(&options, 0, sizeof(DbOptions));
+    options.no_sync = 1;
+    options.checkpoint_wal_bytes = (off_t)1 << 40; // only the checkpoint below
+    db = init_db_with_options("test.db", &options);
+    create_test_rows(&db, 1, 10);
+    pthread_t leader;
+    pthread_create(&leader, NULL, flush_worker, db.wal);
+    while (!__atomic_load_n(&db.wal->flush_in_progress, __ATOMIC_ACQUIRE))
+    {
+        sched_yield();
+    }
+    checkpoint(&db);
+    pthread_join(leader, NULL);
+    insert_row(&db, 11, "After");
+    off_t logged = file_size("test.db.wal");
+    wal_get_stats(db.wal, &stats);
+    release_db(&db);
+    db = init_db_with_options("test.db", &options);
+    int kept = select_by_id(&db, 11, &row) && strcmp(row.name, "After") == 0 && select_by_id(&db, 1, &row) &&
+               strcmp(row.name, "Name1") == 0;
+    log_test(107, "A checkpoint should not empty the log under a group commit", kept && logged == stats.size);
+    cleanup_test_db(&db, "test.db");
+}